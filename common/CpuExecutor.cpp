@@ -22,6 +22,7 @@
 #include <nnapi/SharedMemory.h>
 #include <nnapi/TypeUtils.h>
 
+#include <algorithm>
 #include <limits>
 #include <memory>
 #include <utility>
@@ -56,6 +57,11 @@
 #include "RNN.h"
 #include "SVDF.h"
 #include "Tile.h"
+
+#ifdef NN_EXPERIMENTAL_FEATURE
+#include "Densify.h"
+#include "FullyConnected.h"
+#endif  // NN_EXPERIMENTAL_FEATURE
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -66,8 +72,15 @@ class OperationExecutionContext : public IOperationExecutionContext {
     DISALLOW_IMPLICIT_CONSTRUCTORS(OperationExecutionContext);
 
    public:
-    OperationExecutionContext(const Operation* operation, RunTimeOperandInfo* operands)
-        : operation(operation), operands(operands) {}
+    OperationExecutionContext(const Operation* operation, RunTimeOperandInfo* operands,
+                              OperationStateCache* stateCache = nullptr,
+                              OperationStateCache::Key stateKey = {},
+                              bool allowInPlaceExecution = false)
+        : operation(operation),
+          operands(operands),
+          stateCache(stateCache),
+          stateKey(stateKey),
+          allowInPlaceExecution(allowInPlaceExecution) {}
 
     uint32_t getNumInputs() const override;
     OperandType getInputType(uint32_t index) const override;
@@ -83,10 +96,17 @@ class OperationExecutionContext : public IOperationExecutionContext {
     // Return false on failure and store the result code.
     // Use getResultCode() to retrieve it at the end of the operation execution.
     bool setOutputShape(uint32_t index, const Shape& shape) override;
+    bool setViewOutputShape(uint32_t outputIndex, uint32_t inputIndex,
+                            const Shape& shape) override;
     int getResultCode() const;
 
     bool isOmittedInput(uint32_t index) const override;
     bool isOmittedOutput(uint32_t index) const override;
+    bool isConstantInput(uint32_t index) const override;
+    const SparseTensor* getSparseInput(uint32_t index) const override;
+
+    std::shared_ptr<const OperationState> getCachedState() const override;
+    void setCachedState(std::shared_ptr<const OperationState> state) override;
 
     // Return false if any of inputs or outputs is omitted, i.e. has lifetime of NO_VALUE.
     bool checkNoOmittedOperand() const;
@@ -100,6 +120,10 @@ class OperationExecutionContext : public IOperationExecutionContext {
 
     const Operation* operation;
     RunTimeOperandInfo* operands;
+    OperationStateCache* stateCache;
+    OperationStateCache::Key stateKey;
+    // See OperationRegistration::Flag::allowInPlaceExecution.
+    bool allowInPlaceExecution;
 
     int result = ANEURALNETWORKS_NO_ERROR;
 };
@@ -241,10 +265,57 @@ bool setInfoAndAllocateIfNeeded(RunTimeOperandInfo* info, const Shape& shape, in
     return true;
 }
 
+// Returns true if the operand holds a constant of the model, whose value is the same in every
+// execution.
+static bool isConstantOperand(const RunTimeOperandInfo& info) {
+    return info.lifetime == Operand::LifeTime::CONSTANT_COPY ||
+           info.lifetime == Operand::LifeTime::CONSTANT_REFERENCE ||
+           info.lifetime == Operand::LifeTime::POINTER;
+}
+
+// Lets a temporary output take over the buffer of a temporary input holding the same bytes, such
+// as the input of RESHAPE, instead of allocating its own. This is only done if the operation being
+// executed is the last consumer of the input, so that no other operation can observe that the two
+// share storage. The buffer is then owned by the output, and consumeOperationInputs does not free
+// it along with the input.
+static void shareInputBufferIfLastUse(const RunTimeOperandInfo& input, const Shape& outputShape,
+                                      RunTimeOperandInfo* output) {
+    // Slices of a shared block must keep their bytes until the whole block is released.
+    if (input.lifetime != Operand::LifeTime::TEMPORARY_VARIABLE || input.numberOfUsesLeft != 1 ||
+        input.buffer == nullptr || input.sharedBlock != nullptr) {
+        return;
+    }
+    if (output->lifetime != Operand::LifeTime::TEMPORARY_VARIABLE || output->buffer != nullptr ||
+        isExtension(outputShape.type)) {
+        return;
+    }
+    if (nonExtensionOperandSizeOfData(outputShape.type, outputShape.dimensions) != input.length) {
+        return;
+    }
+    output->buffer = input.buffer;
+    output->length = input.length;
+}
+
 bool OperationExecutionContext::setOutputShape(uint32_t index, const Shape& shape) {
+    if (allowInPlaceExecution && index == 0) {
+        // Hand the output the buffer of the first input it can overwrite element by element.
+        RunTimeOperandInfo* output = getOutputInfo(index);
+        for (uint32_t i = 0; i < operation->inputs.size() && output->buffer == nullptr; i++) {
+            const RunTimeOperandInfo& input = *getInputInfo(i);
+            if (input.type == shape.type && input.dimensions == shape.dimensions) {
+                shareInputBufferIfLastUse(input, shape, output);
+            }
+        }
+    }
     return setInfoAndAllocateIfNeeded(getOutputInfo(index), shape, &result);
 }
 
+bool OperationExecutionContext::setViewOutputShape(uint32_t outputIndex, uint32_t inputIndex,
+                                                   const Shape& shape) {
+    shareInputBufferIfLastUse(*getInputInfo(inputIndex), shape, getOutputInfo(outputIndex));
+    return setOutputShape(outputIndex, shape);
+}
+
 bool OperationExecutionContext::isOmittedInput(uint32_t index) const {
     return getInputInfo(index)->lifetime == Operand::LifeTime::NO_VALUE;
 }
@@ -253,6 +324,24 @@ bool OperationExecutionContext::isOmittedOutput(uint32_t index) const {
     return getOutputInfo(index)->lifetime == Operand::LifeTime::NO_VALUE;
 }
 
+bool OperationExecutionContext::isConstantInput(uint32_t index) const {
+    return isConstantOperand(*getInputInfo(index));
+}
+
+const SparseTensor* OperationExecutionContext::getSparseInput(uint32_t index) const {
+    return getInputInfo(index)->sparse.get();
+}
+
+std::shared_ptr<const OperationState> OperationExecutionContext::getCachedState() const {
+    return stateCache != nullptr ? stateCache->get(stateKey) : nullptr;
+}
+
+void OperationExecutionContext::setCachedState(std::shared_ptr<const OperationState> state) {
+    if (stateCache != nullptr) {
+        stateCache->set(stateKey, std::move(state));
+    }
+}
+
 bool OperationExecutionContext::checkNoOmittedOperand() const {
     for (uint32_t i = 0; i < operation->inputs.size(); i++) {
         NN_RET_CHECK(!isOmittedInput(i))
@@ -279,6 +368,17 @@ bool OperationExecutionContext::checkNoZeroSizedInput() const {
 
 }  // namespace
 
+std::shared_ptr<const OperationState> OperationStateCache::get(const Key& key) const {
+    std::lock_guard<std::mutex> guard(mMutex);
+    const auto it = mStates.find(key);
+    return it != mStates.end() ? it->second : nullptr;
+}
+
+void OperationStateCache::set(const Key& key, std::shared_ptr<const OperationState> state) {
+    std::lock_guard<std::mutex> guard(mMutex);
+    mStates[key] = std::move(state);
+}
+
 // Used to keep a pointer to a memory pool.
 //
 // In the case of an "mmap_fd" pool, owns the mmap region
@@ -522,19 +622,27 @@ static bool convertFromNhwc(RunTimeOperandInfo& to, const RunTimeOperandInfo& fr
 }
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
-// Decrements the usage count for the operands listed.  Frees the memory
-// allocated for any temporary variable with a count of zero.
-static void consumeOperationInputs(const std::vector<uint32_t>& inputs,
-                                   RunTimeOperandInfo* operands) {
-    for (uint32_t i : inputs) {
+// Decrements the usage count for the inputs of the operation.  Frees the memory
+// allocated for any temporary variable with a count of zero, unless an output of
+// the operation has taken over that memory as a view of the input.
+static void consumeOperationInputs(const Operation& operation, RunTimeOperandInfo* operands) {
+    for (uint32_t i : operation.inputs) {
         auto& info = operands[i];
         // Check if it's a static or model input/output.
         if (info.numberOfUsesLeft == 0) {
             continue;
         }
         info.numberOfUsesLeft--;
-        if (info.numberOfUsesLeft == 0 && info.buffer != nullptr) {
-            delete[] info.buffer;
+        if (info.numberOfUsesLeft == 0 && info.buffer != nullptr && info.sharedBlock != nullptr) {
+            info.sharedBlock.reset();
+            info.buffer = nullptr;
+        } else if (info.numberOfUsesLeft == 0 && info.buffer != nullptr) {
+            const bool isViewedByOutput =
+                    std::any_of(operation.outputs.begin(), operation.outputs.end(),
+                                [&](uint32_t o) { return operands[o].buffer == info.buffer; });
+            if (!isViewedByOutput) {
+                delete[] info.buffer;
+            }
             info.buffer = nullptr;
         }
     }
@@ -547,12 +655,173 @@ static void freeUnusedSubgraphOperands(std::vector<RunTimeOperandInfo>* operands
     for (auto& info : *operands) {
         if (info.lifetime == Operand::LifeTime::TEMPORARY_VARIABLE && info.numberOfUsesLeft == 0 &&
             info.buffer != nullptr) {
-            delete[] info.buffer;
+            if (info.sharedBlock != nullptr) {
+                info.sharedBlock.reset();
+            } else {
+                delete[] info.buffer;
+            }
             info.buffer = nullptr;
         }
     }
 }
 
+// Whether a temporary can be given a slice of a block shared with other operands ahead of
+// execution, which requires its size to be known from the model.
+static bool canUseSharedBlock(const RunTimeOperandInfo& info) {
+    return info.lifetime == Operand::LifeTime::TEMPORARY_VARIABLE && info.buffer == nullptr &&
+           info.sharedBlock == nullptr && !isExtension(info.type) && !info.dimensions.empty() &&
+           nonExtensionOperandSizeOfData(info.type, info.dimensions) > 0;
+}
+
+// Plans whole as a block shared with the given parts, each of which gets the slice of the block it
+// occupies in whole along axis. This is only done if the parts are contiguous in whole, i.e. all
+// dimensions before axis are 1, and hold their data the same way as whole does. The block itself
+// is allocated by allocateSharedBlockOutputs.
+static void shareBlockIfContiguous(uint32_t wholeIndex, const std::vector<uint32_t>& partIndexes,
+                                   const RunTimeOperandInfo& axisInfo,
+                                   RunTimeOperandInfo* operands) {
+    RunTimeOperandInfo& whole = operands[wholeIndex];
+    if (!isConstantOperand(axisInfo) || axisInfo.buffer == nullptr || !canUseSharedBlock(whole)) {
+        return;
+    }
+    const int32_t rank = whole.dimensions.size();
+    int32_t axis = getScalarData<int32_t>(axisInfo);
+    if (axis < 0) axis += rank;
+    if (axis < 0 || axis >= rank) return;
+    for (int32_t d = 0; d < axis; ++d) {
+        if (whole.dimensions[d] != 1) return;
+    }
+    std::vector<uint32_t> sortedPartIndexes = partIndexes;
+    std::sort(sortedPartIndexes.begin(), sortedPartIndexes.end());
+    if (std::adjacent_find(sortedPartIndexes.begin(), sortedPartIndexes.end()) !=
+        sortedPartIndexes.end()) {
+        return;
+    }
+    uint32_t partsLength = 0;
+    for (uint32_t i : partIndexes) {
+        const RunTimeOperandInfo& part = operands[i];
+        if (i == wholeIndex || !canUseSharedBlock(part) || part.type != whole.type ||
+            part.scale != whole.scale || part.zeroPoint != whole.zeroPoint ||
+            part.dimensions.size() != whole.dimensions.size()) {
+            return;
+        }
+        partsLength += nonExtensionOperandSizeOfData(part.type, part.dimensions);
+    }
+    const uint32_t length = nonExtensionOperandSizeOfData(whole.type, whole.dimensions);
+    if (partsLength != length) return;
+
+    auto block = std::make_shared<SharedBlock>(length);
+    whole.sharedBlock = block;
+    whole.sharedBlockOffset = 0;
+    whole.length = length;
+    uint32_t offset = 0;
+    for (uint32_t i : partIndexes) {
+        RunTimeOperandInfo& part = operands[i];
+        part.sharedBlock = block;
+        part.sharedBlockOffset = offset;
+        part.length = nonExtensionOperandSizeOfData(part.type, part.dimensions);
+        offset += part.length;
+    }
+}
+
+// Lets the producers of the inputs of CONCATENATION write straight into its output, and the
+// consumers of the outputs of SPLIT read straight from its input, whenever each of them is a
+// contiguous slice of the larger tensor. The operation then finds its data already in place and
+// copies nothing. Operands taking part in one such block are left out of any other.
+static void planSharedBlocks(const Model::Subgraph& subgraph, RunTimeOperandInfo* operands) {
+    for (const Operation& operation : subgraph.operations) {
+        if (operation.type == OperationType::CONCATENATION && operation.inputs.size() >= 2 &&
+            operation.outputs.size() == 1) {
+            const std::vector<uint32_t> parts(operation.inputs.begin(),
+                                              operation.inputs.end() - 1);
+            shareBlockIfContiguous(operation.outputs[0], parts, operands[operation.inputs.back()],
+                                   operands);
+        } else if (operation.type == OperationType::SPLIT && operation.inputs.size() == 3) {
+            shareBlockIfContiguous(operation.inputs[0], operation.outputs,
+                                   operands[operation.inputs[1]], operands);
+        }
+    }
+}
+
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+// Points the outputs of the operation that are slices of a shared block at their slice,
+// allocating the block if no other operand of it has been written yet. Together with the
+// release of each slice by consumeOperationInputs, this keeps a block alive only from the first
+// write to one of its operands to the last read of one of them.
+static void allocateSharedBlockOutputs(const Operation& operation, RunTimeOperandInfo* operands) {
+    for (uint32_t i : operation.outputs) {
+        RunTimeOperandInfo& info = operands[i];
+        if (info.sharedBlock != nullptr && info.buffer == nullptr) {
+            info.buffer = info.sharedBlock->get() + info.sharedBlockOffset;
+        }
+    }
+}
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+
+#if defined(NN_INCLUDE_CPU_IMPLEMENTATION) && defined(NN_EXPERIMENTAL_FEATURE)
+// Whether every use of the operand in the subgraph is as the weights of a TENSOR_FLOAT32
+// FULLY_CONNECTED, which can read them in sparse form.
+static bool isOnlyUsedAsSparseWeights(const Model::Subgraph& subgraph, uint32_t index,
+                                      const RunTimeOperandInfo* operands) {
+    for (const Operation& operation : subgraph.operations) {
+        for (uint32_t i = 0; i < operation.inputs.size(); ++i) {
+            if (operation.inputs[i] != index) continue;
+            if (operation.type != OperationType::FULLY_CONNECTED ||
+                i != fully_connected::kWeightsTensor ||
+                operands[operation.inputs[fully_connected::kInputTensor]].type !=
+                        OperandType::TENSOR_FLOAT32) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Leaves the output of each DENSIFY of constants unmaterialized when every consumer of it reads
+// the sparse operands directly, which saves both the dense tensor and the work on its zeros. The
+// output gets its dense dimensions here, since no operation will set them.
+static void planSparseOperands(const Model::Subgraph& subgraph, RunTimeOperandInfo* operands) {
+    namespace op = densify_op;
+    for (const Operation& operation : subgraph.operations) {
+        if (operation.type != OperationType::DENSIFY || operation.outputs.size() != 1 ||
+            operation.inputs.size() < op::kMinNumInputs) {
+            continue;
+        }
+        RunTimeOperandInfo& output = operands[operation.outputs[0]];
+        if (output.lifetime != Operand::LifeTime::TEMPORARY_VARIABLE || output.buffer != nullptr ||
+            output.type != OperandType::TENSOR_FLOAT32 || output.numberOfUsesLeft == 0 ||
+            !isOnlyUsedAsSparseWeights(subgraph, operation.outputs[0], operands)) {
+            continue;
+        }
+        auto sparse = std::make_shared<SparseTensor>();
+        bool isConstant = true;
+        for (uint32_t i : operation.inputs) {
+            const RunTimeOperandInfo& input = operands[i];
+            isConstant = isConstant && (isConstantOperand(input) ||
+                                        input.lifetime == Operand::LifeTime::NO_VALUE);
+            sparse->shapes.push_back(input.shape());
+            sparse->buffers.push_back(input.buffer);
+        }
+        if (!isConstant || sparse->shapes[op::kInputDimensions].dimensions.size() != 1 ||
+            sparse->shapes[op::kInputBlockMap].dimensions.size() != 1) {
+            continue;
+        }
+        const std::vector<uint32_t> dimensions = op::getDenseDimensions(
+                static_cast<const int32_t*>(sparse->buffers[op::kInputTravOrder]),
+                static_cast<const int32_t*>(sparse->buffers[op::kInputBlockMap]),
+                static_cast<const int32_t*>(sparse->buffers[op::kInputDimensions]),
+                sparse->shapes[op::kInputDimensions].dimensions[0],
+                sparse->shapes[op::kInputBlockMap].dimensions[0]);
+        if (dimensions.size() != 2 ||
+            !combineDimensions(output.dimensions, dimensions).has_value()) {
+            continue;
+        }
+        output.dimensions = dimensions;
+        output.sparse = std::move(sparse);
+    }
+}
+#endif  // defined(NN_INCLUDE_CPU_IMPLEMENTATION) && defined(NN_EXPERIMENTAL_FEATURE)
+
 // Ignore the .pools entry in model and request.  This will have been taken care of
 // by the caller.
 int CpuExecutor::run(const Model& model, const Request& request,
@@ -573,6 +842,10 @@ int CpuExecutor::run(const Model& model, const Request& request,
     updateForArguments(model.main.inputIndexes, request.inputs, requestPoolInfos, operands.data());
     updateForArguments(model.main.outputIndexes, request.outputs, requestPoolInfos,
                        operands.data());
+    planSharedBlocks(model.main, operands.data());
+#if defined(NN_INCLUDE_CPU_IMPLEMENTATION) && defined(NN_EXPERIMENTAL_FEATURE)
+    planSparseOperands(model.main, operands.data());
+#endif  // defined(NN_INCLUDE_CPU_IMPLEMENTATION) && defined(NN_EXPERIMENTAL_FEATURE)
     int result = executeSubgraph(model.main, operands.data());
     freeUnusedSubgraphOperands(&operands);
 
@@ -599,9 +872,17 @@ int CpuExecutor::run(const Model& model, const Request& request,
 
 int CpuExecutor::executeSubgraph(const Model::Subgraph& subgraph, RunTimeOperandInfo* operands) {
     VLOG(CPUEXE) << "CpuExecutor::executeSubgraph " << subgraph;
+    // Subgraphs other than the main one are only ever executed from Model::referenced.
+    uint32_t subgraphIndex = 0;
+    for (uint32_t i = 0; i < mReferencedSubgraphs->size(); ++i) {
+        if (&(*mReferencedSubgraphs)[i] == &subgraph) {
+            subgraphIndex = i + 1;
+            break;
+        }
+    }
     // The graph has serialized the operation in execution order.
-    for (const auto& operation : subgraph.operations) {
-        NN_RETURN_IF_ERROR(executeOperation(operation, operands));
+    for (uint32_t i = 0; i < subgraph.operations.size(); ++i) {
+        NN_RETURN_IF_ERROR(executeOperation(subgraph.operations[i], operands, {subgraphIndex, i}));
     }
     return ANEURALNETWORKS_NO_ERROR;
 }
@@ -715,12 +996,14 @@ void CpuExecutor::updateForArguments(const std::vector<uint32_t>& indexes,
     }
 }
 
-int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
-                                  [[maybe_unused]] RunTimeOperandInfo* operands) {
+int CpuExecutor::executeOperation(
+        [[maybe_unused]] const Operation& operation, [[maybe_unused]] RunTimeOperandInfo* operands,
+        [[maybe_unused]] const OperationStateCache::Key& operationKey) {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
     if (hasDeadlinePassed(mDeadline)) {
         return ANEURALNETWORKS_MISSED_DEADLINE_TRANSIENT;
     }
+    allocateSharedBlockOutputs(operation, operands);
     if (operation.type == OperationType::IF) {
         int result = executeIfOperation(operation, operands);
         if (result != ANEURALNETWORKS_NO_ERROR) {
@@ -735,6 +1018,12 @@ int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
         }
         return result;
     }
+    if (operation.type == OperationType::DENSIFY && !operation.outputs.empty() &&
+        operands[operation.outputs[0]].sparse != nullptr) {
+        // The consumers of the output read the sparse operands instead. See planSparseOperands.
+        consumeOperationInputs(operation, operands);
+        return ANEURALNETWORKS_NO_ERROR;
+    }
 
     // VLOG(CPUEXE) << "CpuExecutor::executeOperation(" << operation << ")";
     const std::vector<uint32_t>& ins = operation.inputs;
@@ -802,10 +1091,13 @@ int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
             RunTimeOperandInfo& output = operands[outs[0]];
             Shape outShape = output.shape();
 
-            success = reshapePrepare(input.shape(),
-                                     reinterpret_cast<const int32_t*>(targetShape.buffer),
-                                     getNumberOfElements(targetShape.shape()), &outShape) &&
-                      setInfoAndAllocateIfNeeded(&output, outShape, &result) &&
+            if (!reshapePrepare(input.shape(),
+                                reinterpret_cast<const int32_t*>(targetShape.buffer),
+                                getNumberOfElements(targetShape.shape()), &outShape)) {
+                break;
+            }
+            shareInputBufferIfLastUse(input, outShape, &output);
+            success = setInfoAndAllocateIfNeeded(&output, outShape, &result) &&
                       copyData(input.buffer, input.shape(), output.buffer, outShape);
         } break;
         case OperationType::DEPTH_TO_SPACE: {
@@ -1361,8 +1653,11 @@ int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
             RunTimeOperandInfo& output = operands[outs[0]];
             Shape outShape = output.shape();
 
-            success = expand_dims::prepare(input.shape(), axis, &outShape) &&
-                      setInfoAndAllocateIfNeeded(&output, outShape, &result) &&
+            if (!expand_dims::prepare(input.shape(), axis, &outShape)) {
+                break;
+            }
+            shareInputBufferIfLastUse(input, outShape, &output);
+            success = setInfoAndAllocateIfNeeded(&output, outShape, &result) &&
                       expand_dims::eval(input.buffer, input.shape(), axis, output.buffer, outShape);
         } break;
         case OperationType::SPLIT: {
@@ -1528,7 +1823,61 @@ int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
                 break;
             }
 
-            if (input_tmp.type == OperandType::TENSOR_FLOAT32) {
+            std::shared_ptr<const OperationState> packedFilter;
+            if (mOperationStateCache != nullptr && isConstantOperand(filter)) {
+                const float* filterScales =
+                        filter.type == OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL
+                                ? std::get<Operand::SymmPerChannelQuantParams>(filter.extraParams)
+                                          .scales.data()
+                                : nullptr;
+                const auto cachedFilter = mOperationStateCache->get(operationKey);
+                packedFilter = packGroupedConvFilter(cachedFilter, input_tmp.shape(),
+                                                     filter.buffer, filter.shape(), filterScales,
+                                                     outShape, numGroups, activation);
+                if (packedFilter != nullptr && packedFilter != cachedFilter) {
+                    mOperationStateCache->set(operationKey, packedFilter);
+                }
+            }
+
+            if (packedFilter != nullptr) {
+                switch (input_tmp.type) {
+                    case OperandType::TENSOR_FLOAT32:
+                        success = groupedConvPacked(
+                                reinterpret_cast<const float*>(input_tmp.buffer),
+                                input_tmp.shape(), *packedFilter,
+                                reinterpret_cast<const float*>(bias.buffer), padding_left,
+                                padding_top, stride_width, stride_height,
+                                reinterpret_cast<float*>(output_tmp.buffer), outShape);
+                        break;
+                    case OperandType::TENSOR_FLOAT16:
+                        success = groupedConvPacked(
+                                reinterpret_cast<const _Float16*>(input_tmp.buffer),
+                                input_tmp.shape(), *packedFilter,
+                                reinterpret_cast<const _Float16*>(bias.buffer), padding_left,
+                                padding_top, stride_width, stride_height,
+                                reinterpret_cast<_Float16*>(output_tmp.buffer), outShape);
+                        break;
+                    case OperandType::TENSOR_QUANT8_ASYMM:
+                        success = groupedConvPacked(
+                                reinterpret_cast<const uint8_t*>(input_tmp.buffer),
+                                input_tmp.shape(), *packedFilter,
+                                reinterpret_cast<const int32_t*>(bias.buffer), padding_left,
+                                padding_top, stride_width, stride_height,
+                                reinterpret_cast<uint8_t*>(output_tmp.buffer), outShape);
+                        break;
+                    case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
+                        success = groupedConvPacked(
+                                reinterpret_cast<const int8_t*>(input_tmp.buffer),
+                                input_tmp.shape(), *packedFilter,
+                                reinterpret_cast<const int32_t*>(bias.buffer), padding_left,
+                                padding_top, stride_width, stride_height,
+                                reinterpret_cast<int8_t*>(output_tmp.buffer), outShape);
+                        break;
+                    default:
+                        success = false;
+                        break;
+                }
+            } else if (input_tmp.type == OperandType::TENSOR_FLOAT32) {
                 success = groupedConvFloat32(
                         reinterpret_cast<const float*>(input_tmp.buffer), input_tmp.shape(),
                         reinterpret_cast<const float*>(filter.buffer), filter.shape(),
@@ -1654,7 +2003,9 @@ int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
                        operationRegistration->execute == nullptr) {
                 LOG(ERROR) << "Incomplete operation registration: " << operation.type;
             } else {
-                OperationExecutionContext context(&operation, operands);
+                OperationExecutionContext context(
+                        &operation, operands, mOperationStateCache, operationKey,
+                        operationRegistration->flags.allowInPlaceExecution);
                 success = operationRegistration->flags.allowOmittedOperand ||
                           context.checkNoOmittedOperand();
                 success = success && (operationRegistration->flags.allowZeroSizedInput ||
@@ -1672,7 +2023,7 @@ int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
         LOG(ERROR) << operation.type << " failed.";
     }
 
-    consumeOperationInputs(ins, operands);
+    consumeOperationInputs(operation, operands);
     return result;
 #else
     LOG(ERROR) << "Built without CPU execution support";
@@ -1725,7 +2076,7 @@ int CpuExecutor::executeIfOperation(const Operation& operation, RunTimeOperandIn
                               branchOperands[branchSubgraph.outputIndexes[i]]);
     }
 
-    consumeOperationInputs(operation.inputs, operands);
+    consumeOperationInputs(operation, operands);
     return ANEURALNETWORKS_NO_ERROR;
 }
 
@@ -1766,7 +2117,7 @@ int CpuExecutor::executeWhileOperation(const Operation& operation, RunTimeOperan
                 freeLoopOutputs(tmp2);
                 freeUnusedSubgraphOperands(&condOperands);
                 freeUnusedSubgraphOperands(&bodyOperands);
-                consumeOperationInputs(operation.inputs, operands);
+                consumeOperationInputs(operation, operands);
             });
 
     // For body outputs with unknown shape, we skip double buffering and
@@ -22,13 +22,19 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 #include <sstream>
+#include <type_traits>
 #include <vector>
 
 #include "ActivationFunctor.h"
 #include "nnapi/Validation.h"
 
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+#include "CpuOperationUtils.h"
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+
 namespace android {
 namespace nn {
 
@@ -60,6 +66,47 @@ void CalculateActivationRangeImpl(int32_t activation, const Shape& outputShape,
     }
 }
 
+struct StridedDimension {
+    uint32_t size;
+    int64_t srcStride;
+    int64_t dstStride;
+};
+
+// Drops the dimensions of size 1, and merges each dimension into the next inner one whenever both
+// views step over it as one contiguous range of the inner one. Returns the remaining dimensions,
+// outermost first.
+std::vector<StridedDimension> collapseStridedDimensions(const std::vector<int64_t>& srcStrides,
+                                                        const std::vector<int64_t>& dstStrides,
+                                                        const std::vector<uint32_t>& dimensions) {
+    std::vector<StridedDimension> collapsed;
+    for (size_t i = dimensions.size(); i-- > 0;) {
+        if (dimensions[i] == 1) continue;
+        if (!collapsed.empty()) {
+            StridedDimension& inner = collapsed.back();
+            if (srcStrides[i] == inner.srcStride * inner.size &&
+                dstStrides[i] == inner.dstStride * inner.size) {
+                inner.size *= dimensions[i];
+                continue;
+            }
+        }
+        collapsed.push_back({dimensions[i], srcStrides[i], dstStrides[i]});
+    }
+    std::reverse(collapsed.begin(), collapsed.end());
+    return collapsed;
+}
+
+// Copies count elements of type T between strided locations. With the element type fixed at
+// compile time, this loop is vectorized into gathers and scatters on targets that have them.
+template <typename T>
+void copyStridedElements(const uint8_t* src, int64_t srcStride, uint8_t* dst, int64_t dstStride,
+                         uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        T value;
+        memcpy(&value, src + i * srcStride, sizeof(T));
+        memcpy(dst + i * dstStride, &value, sizeof(T));
+    }
+}
+
 }  // namespace
 
 bool handleNegativeAxis(int32_t numberOfDimensions, int32_t* axis) {
@@ -660,5 +707,216 @@ bool groupedConvPrepare(const Shape& input, const Shape& filter, const Shape& bi
     return true;
 }
 
+std::vector<int64_t> getPackedStrides(const std::vector<uint32_t>& dimensions,
+                                      uint32_t elementSize) {
+    std::vector<int64_t> strides(dimensions.size());
+    int64_t stride = elementSize;
+    for (size_t i = dimensions.size(); i-- > 0;) {
+        strides[i] = stride;
+        stride *= dimensions[i];
+    }
+    return strides;
+}
+
+void stridedCopy(const void* src, const std::vector<int64_t>& srcStrides, void* dst,
+                 const std::vector<int64_t>& dstStrides, const std::vector<uint32_t>& dimensions,
+                 uint32_t elementSize) {
+    CHECK_EQ(srcStrides.size(), dimensions.size());
+    CHECK_EQ(dstStrides.size(), dimensions.size());
+    if (std::find(dimensions.begin(), dimensions.end(), 0u) != dimensions.end()) return;
+    const uint8_t* srcBytes = static_cast<const uint8_t*>(src);
+    uint8_t* dstBytes = static_cast<uint8_t*>(dst);
+
+    std::vector<StridedDimension> outer =
+            collapseStridedDimensions(srcStrides, dstStrides, dimensions);
+    if (outer.empty()) {
+        memcpy(dstBytes, srcBytes, elementSize);
+        return;
+    }
+    const StridedDimension inner = outer.back();
+    outer.pop_back();
+    const bool isContiguous = inner.srcStride == elementSize && inner.dstStride == elementSize;
+    const auto copyRow = [&inner, isContiguous, elementSize](const uint8_t* from, uint8_t* to) {
+        if (isContiguous) {
+            memcpy(to, from, static_cast<size_t>(inner.size) * elementSize);
+            return;
+        }
+        switch (elementSize) {
+            case 1:
+                copyStridedElements<uint8_t>(from, inner.srcStride, to, inner.dstStride,
+                                             inner.size);
+                break;
+            case 2:
+                copyStridedElements<uint16_t>(from, inner.srcStride, to, inner.dstStride,
+                                              inner.size);
+                break;
+            case 4:
+                copyStridedElements<uint32_t>(from, inner.srcStride, to, inner.dstStride,
+                                              inner.size);
+                break;
+            case 8:
+                copyStridedElements<uint64_t>(from, inner.srcStride, to, inner.dstStride,
+                                              inner.size);
+                break;
+            default:
+                for (uint32_t i = 0; i < inner.size; ++i) {
+                    memcpy(to + i * inner.dstStride, from + i * inner.srcStride, elementSize);
+                }
+        }
+    };
+
+    // Walks the rows [begin, end) of the outer dimensions like an odometer.
+    const auto copyRows = [&outer, &copyRow, srcBytes, dstBytes](uint32_t begin, uint32_t end) {
+        std::vector<uint32_t> index(outer.size());
+        int64_t srcOffset = 0;
+        int64_t dstOffset = 0;
+        uint32_t rest = begin;
+        for (size_t i = outer.size(); i-- > 0;) {
+            index[i] = rest % outer[i].size;
+            rest /= outer[i].size;
+            srcOffset += index[i] * outer[i].srcStride;
+            dstOffset += index[i] * outer[i].dstStride;
+        }
+        for (uint32_t row = begin; row < end; ++row) {
+            copyRow(srcBytes + srcOffset, dstBytes + dstOffset);
+            for (size_t i = outer.size(); i-- > 0;) {
+                srcOffset += outer[i].srcStride;
+                dstOffset += outer[i].dstStride;
+                if (++index[i] < outer[i].size) break;
+                srcOffset -= outer[i].srcStride * outer[i].size;
+                dstOffset -= outer[i].dstStride * outer[i].size;
+                index[i] = 0;
+            }
+        }
+    };
+
+    uint32_t numRows = 1;
+    for (const StridedDimension& dimension : outer) {
+        numRows *= dimension.size;
+    }
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+    // Copies below this many bytes are not worth splitting across threads.
+    constexpr uint64_t kMinStridedCopyBytesPerThread = 128 * 1024;
+    const uint64_t rowBytes = static_cast<uint64_t>(inner.size) * elementSize;
+    const uint32_t minRowsPerThread = static_cast<uint32_t>(
+            std::max<uint64_t>(1, kMinStridedCopyBytesPerThread / rowBytes));
+    parallelFor(numRows, minRowsPerThread, copyRows);
+#else
+    copyRows(0, numRows);
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+}
+
+namespace {
+
+// Calls fn(begin, end) over [0, size), split across threads if the elements converted amount to
+// enough bytes.
+template <typename Fn>
+void forEachElementChunk(uint32_t size, uint32_t bytesPerElement, const Fn& fn) {
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+    // Conversions below this many bytes read and written are not worth splitting across threads.
+    constexpr uint32_t kMinConversionBytesPerThread = 128 * 1024;
+    parallelFor(size, std::max<uint32_t>(1, kMinConversionBytesPerThread / bytesPerElement), fn);
+#else
+    (void)bytesPerElement;
+    fn(0u, size);
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+}
+
+// Rounds half away from zero like std::round, but with operations that vectorize.
+inline float roundHalfAwayFromZero(float value) {
+    const float truncated = std::trunc(value);
+    const float fraction = value - truncated;
+    return truncated + (std::abs(fraction) >= 0.5f ? std::copysign(1.0f, value) : 0.0f);
+}
+
+}  // namespace
+
+template <typename FloatT, typename QuantT>
+void quantizeElements(const FloatT* input, uint32_t size, float scale, int32_t zeroPoint,
+                      QuantT* output) {
+    const float minValue = std::numeric_limits<QuantT>::min();
+    const float maxValue = std::numeric_limits<QuantT>::max();
+    const float offset = zeroPoint;
+    forEachElementChunk(size, sizeof(FloatT) + sizeof(QuantT), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const float value =
+                    offset + roundHalfAwayFromZero(static_cast<float>(input[i]) / scale);
+            output[i] = static_cast<QuantT>(std::max(minValue, std::min(maxValue, value)));
+        }
+    });
+}
+
+template <typename QuantT, typename FloatT>
+void dequantizeElements(const QuantT* input, uint32_t size, float scale, int32_t zeroPoint,
+                        FloatT* output) {
+    forEachElementChunk(size, sizeof(QuantT) + sizeof(FloatT), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const int32_t value = input[i];
+            output[i] = static_cast<FloatT>(scale * (value - zeroPoint));
+        }
+    });
+}
+
+template <typename FloatT>
+void dequantizePerChannelElements(const int8_t* input, uint32_t outerSize, uint32_t numChannels,
+                                  uint32_t innerSize, const float* scales, int32_t zeroPoint,
+                                  FloatT* output) {
+    // Splits the rows of innerSize elements, each of which has a single scale.
+    const uint32_t numRows = outerSize * numChannels;
+    const uint32_t bytesPerRow = std::max(1u, innerSize) * (sizeof(int8_t) + sizeof(FloatT));
+    forEachElementChunk(numRows, bytesPerRow, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+            const float scale = scales[row % numChannels];
+            const int8_t* rowInput = input + row * innerSize;
+            FloatT* rowOutput = output + row * innerSize;
+            for (uint32_t i = 0; i < innerSize; ++i) {
+                const int32_t value = rowInput[i];
+                rowOutput[i] = static_cast<FloatT>(scale * (value - zeroPoint));
+            }
+        }
+    });
+}
+
+template <typename FromT, typename ToT>
+void castElements(const FromT* input, uint32_t size, ToT* output) {
+    forEachElementChunk(size, sizeof(FromT) + sizeof(ToT), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const FromT value = input[i];
+            if constexpr (std::is_same_v<ToT, uint8_t>) {
+                output[i] = value < 0 ? 0 : value > 255 ? 255 : static_cast<uint8_t>(value);
+            } else {
+                output[i] = static_cast<ToT>(value);
+            }
+        }
+    });
+}
+
+template void quantizeElements(const float*, uint32_t, float, int32_t, uint8_t*);
+template void quantizeElements(const float*, uint32_t, float, int32_t, int8_t*);
+template void quantizeElements(const _Float16*, uint32_t, float, int32_t, uint8_t*);
+template void quantizeElements(const _Float16*, uint32_t, float, int32_t, int8_t*);
+
+template void dequantizeElements(const uint8_t*, uint32_t, float, int32_t, float*);
+template void dequantizeElements(const uint8_t*, uint32_t, float, int32_t, _Float16*);
+template void dequantizeElements(const int8_t*, uint32_t, float, int32_t, float*);
+template void dequantizeElements(const int8_t*, uint32_t, float, int32_t, _Float16*);
+
+template void dequantizePerChannelElements(const int8_t*, uint32_t, uint32_t, uint32_t,
+                                           const float*, int32_t, float*);
+template void dequantizePerChannelElements(const int8_t*, uint32_t, uint32_t, uint32_t,
+                                           const float*, int32_t, _Float16*);
+
+#define NN_INSTANTIATE_CAST_ELEMENTS(FromT)                            \
+    template void castElements(const FromT*, uint32_t, _Float16*);     \
+    template void castElements(const FromT*, uint32_t, float*);        \
+    template void castElements(const FromT*, uint32_t, int32_t*);      \
+    template void castElements(const FromT*, uint32_t, uint8_t*);
+
+NN_INSTANTIATE_CAST_ELEMENTS(_Float16)
+NN_INSTANTIATE_CAST_ELEMENTS(float)
+NN_INSTANTIATE_CAST_ELEMENTS(int32_t)
+NN_INSTANTIATE_CAST_ELEMENTS(uint8_t)
+#undef NN_INSTANTIATE_CAST_ELEMENTS
+
 }  // namespace nn
 }  // namespace android
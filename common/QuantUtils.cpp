@@ -3,10 +3,119 @@
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 namespace android {
 namespace nn {
 
+namespace {
+
+template <typename T>
+void getActivationRange(int32_t activation, const Shape& outputShape, int32_t* activationMin,
+                        int32_t* activationMax) {
+    if constexpr (std::is_same_v<T, int8_t>) {
+        CalculateActivationRangeInt8(activation, outputShape, activationMin, activationMax);
+    } else {
+        CalculateActivationRangeUint8(activation, outputShape, activationMin, activationMax);
+    }
+}
+
+}  // namespace
+
+template <typename T>
+bool getRequantizationParams(double realMultiplier, int32_t inputOffset, const Shape& outputShape,
+                             int32_t activation, RequantizationParams* params) {
+    NN_RET_CHECK(QuantizeMultiplier(realMultiplier, &params->multiplier, &params->shift));
+    params->inputOffset = inputOffset;
+    params->outputOffset = outputShape.offset;
+    getActivationRange<T>(activation, outputShape, &params->outputActivationMin,
+                          &params->outputActivationMax);
+    return true;
+}
+
+template bool getRequantizationParams<uint8_t>(double realMultiplier, int32_t inputOffset,
+                                               const Shape& outputShape, int32_t activation,
+                                               RequantizationParams* params);
+template bool getRequantizationParams<int8_t>(double realMultiplier, int32_t inputOffset,
+                                              const Shape& outputShape, int32_t activation,
+                                              RequantizationParams* params);
+
+template <typename T>
+bool getPerChannelRequantizationParams(const Shape& inputShape,
+                                       const std::vector<float>& filterScales,
+                                       const Shape& outputShape, int32_t activation,
+                                       PerChannelRequantizationParams* params) {
+    const uint32_t numChannels = filterScales.size();
+    params->multipliers.resize(numChannels);
+    params->shifts.resize(numChannels);
+    for (uint32_t c = 0; c < numChannels; ++c) {
+        Shape filterChannelShape = {.type = OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL,
+                                    .scale = filterScales[c]};
+        Shape biasChannelShape = {.type = OperandType::TENSOR_INT32,
+                                  .scale = filterScales[c] * inputShape.scale};
+        double realMultiplier = 0.0;
+        NN_RET_CHECK(GetQuantizedConvolutionMultiplier(inputShape, filterChannelShape,
+                                                       biasChannelShape, outputShape,
+                                                       &realMultiplier));
+        NN_RET_CHECK(QuantizeMultiplier(realMultiplier, &params->multipliers[c],
+                                        &params->shifts[c]));
+    }
+    params->outputOffset = outputShape.offset;
+    getActivationRange<T>(activation, outputShape, &params->outputActivationMin,
+                          &params->outputActivationMax);
+    return true;
+}
+
+template bool getPerChannelRequantizationParams<uint8_t>(const Shape& inputShape,
+                                                         const std::vector<float>& filterScales,
+                                                         const Shape& outputShape,
+                                                         int32_t activation,
+                                                         PerChannelRequantizationParams* params);
+template bool getPerChannelRequantizationParams<int8_t>(const Shape& inputShape,
+                                                        const std::vector<float>& filterScales,
+                                                        const Shape& outputShape,
+                                                        int32_t activation,
+                                                        PerChannelRequantizationParams* params);
+
+template <typename T>
+std::shared_ptr<const PerChannelRequantizationState> getPerChannelRequantizationState(
+        IOperationExecutionContext* context, uint32_t inputIndex, uint32_t filterIndex,
+        uint32_t outputIndex, int32_t activation) {
+    const Shape inputShape = context->getInputShape(inputIndex);
+    const Shape outputShape = context->getOutputShape(outputIndex);
+    const auto& filterScales =
+            std::get<Operand::SymmPerChannelQuantParams>(context->getInputExtraParams(filterIndex))
+                    .scales;
+    auto state = context->getCachedState<PerChannelRequantizationState>();
+    if (state != nullptr && state->inputScale == inputShape.scale &&
+        state->outputScale == outputShape.scale && state->outputOffset == outputShape.offset &&
+        state->activation == activation &&
+        state->params.multipliers.size() == filterScales.size()) {
+        return state;
+    }
+    auto newState = std::make_shared<PerChannelRequantizationState>();
+    newState->inputScale = inputShape.scale;
+    newState->outputScale = outputShape.scale;
+    newState->outputOffset = outputShape.offset;
+    newState->activation = activation;
+    if (!getPerChannelRequantizationParams<T>(inputShape, filterScales, outputShape, activation,
+                                              &newState->params)) {
+        return nullptr;
+    }
+    context->setCachedState(newState);
+    return newState;
+}
+
+template std::shared_ptr<const PerChannelRequantizationState>
+getPerChannelRequantizationState<uint8_t>(IOperationExecutionContext* context,
+                                          uint32_t inputIndex, uint32_t filterIndex,
+                                          uint32_t outputIndex, int32_t activation);
+template std::shared_ptr<const PerChannelRequantizationState>
+getPerChannelRequantizationState<int8_t>(IOperationExecutionContext* context, uint32_t inputIndex,
+                                         uint32_t filterIndex, uint32_t outputIndex,
+                                         int32_t activation);
+
 void ApplyLayerNorm(const int16_t* input, const int16_t* layer_norm_weights, const int32_t* bias,
                     int32_t layer_norm_scale_a, int32_t layer_norm_scale_b, int32_t variance_limit,
                     int n_batch, int n_input, int16_t* output) {
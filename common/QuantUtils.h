@@ -10,9 +10,13 @@
 #include <public/gemmlowp.h>
 #pragma clang diagnostic pop
 
+#include <algorithm>
 #include <limits>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
+#include "ActivationFunctor.h"
 #include "LegacyUtils.h"
 #include "OperationsExecutionUtils.h"
 
@@ -29,6 +33,93 @@ inline int32_t MultiplyByQuantizedMultiplier(int32_t x, int32_t quantized_multip
             right_shift);
 }
 
+// Fixed-point parameters that requantize a 32-bit value x into an 8-bit quantized tensor as
+//   clamp(outputOffset + MultiplyByQuantizedMultiplier(x + inputOffset, multiplier, shift),
+//         outputActivationMin, outputActivationMax).
+// x is either an int32 accumulator (inputOffset is 0) or an element of another quantized tensor.
+// Deriving the multiplier takes a floating-point decomposition, so operations compute these once
+// and keep them in their cached OperationState rather than on every execution.
+struct RequantizationParams {
+    int32_t inputOffset = 0;
+    int32_t multiplier = 0;
+    int32_t shift = 0;
+    int32_t outputOffset = 0;
+    int32_t outputActivationMin = 0;
+    int32_t outputActivationMax = 0;
+};
+
+// Per-channel counterpart of RequantizationParams, used for the outputs of operations with
+// TENSOR_QUANT8_SYMM_PER_CHANNEL filters. Holds one multiplier and shift per output channel.
+struct PerChannelRequantizationParams {
+    std::vector<int32_t> multipliers;
+    std::vector<int32_t> shifts;
+    int32_t outputOffset = 0;
+    int32_t outputActivationMin = 0;
+    int32_t outputActivationMax = 0;
+};
+
+// Computes the parameters that requantize values with the given real multiplier into
+// outputShape, clamped to the range of the fused activation. T is the output element type.
+template <typename T>
+bool getRequantizationParams(double realMultiplier, int32_t inputOffset, const Shape& outputShape,
+                             int32_t activation, RequantizationParams* params);
+
+// Computes the parameters that requantize the accumulators of an operation whose filter is
+// quantized per channel with filterScales, e.g. CONV_2D with a TENSOR_QUANT8_SYMM_PER_CHANNEL
+// filter. The accumulator of channel c has the scale inputShape.scale * filterScales[c], computed
+// and checked as GetQuantizedConvolutionMultiplier does, so that a per-channel filter whose scales
+// are all equal gives the same results as a per-tensor one.
+template <typename T>
+bool getPerChannelRequantizationParams(const Shape& inputShape,
+                                       const std::vector<float>& filterScales,
+                                       const Shape& outputShape, int32_t activation,
+                                       PerChannelRequantizationParams* params);
+
+// Per-channel requantization parameters of an operation, kept on the prepared model together with
+// the quantization and fused activation they were derived from.
+struct PerChannelRequantizationState : public OperationState {
+    float inputScale = 0.0f;
+    float outputScale = 0.0f;
+    int32_t outputOffset = 0;
+    int32_t activation = 0;
+    PerChannelRequantizationParams params;
+};
+
+// Returns the per-channel requantization parameters of the accumulators of an operation with a
+// TENSOR_QUANT8_SYMM_PER_CHANNEL filter, reusing the state cached on the prepared model when it
+// still matches. T is the output element type. Returns nullptr on failure.
+template <typename T>
+std::shared_ptr<const PerChannelRequantizationState> getPerChannelRequantizationState(
+        IOperationExecutionContext* context, uint32_t inputIndex, uint32_t filterIndex,
+        uint32_t outputIndex, int32_t activation);
+
+// Same as MultiplyByQuantizedMultiplier, with the shift already split into its left and right
+// parts so that the loops below are free of per-element branches.
+inline int32_t MultiplyByQuantizedMultiplierSplitShift(int32_t x, int32_t multiplier,
+                                                       int32_t leftShift, int32_t rightShift) {
+    return gemmlowp::RoundingDivideByPOT(
+            gemmlowp::SaturatingRoundingDoublingHighMul(x * (1 << leftShift), multiplier),
+            rightShift);
+}
+
+// Requantizes size values from input to output. InputT is int32_t for accumulators, or the
+// element type of a quantized tensor that is being rescaled.
+template <typename InputT, typename T>
+inline void requantize(const InputT* input, uint32_t size, const RequantizationParams& params,
+                       T* output) {
+    const int32_t leftShift = std::max(params.shift, 0);
+    const int32_t rightShift = std::max(-params.shift, 0);
+    for (uint32_t i = 0; i < size; ++i) {
+        const int32_t value =
+                params.outputOffset +
+                MultiplyByQuantizedMultiplierSplitShift(
+                        static_cast<int32_t>(input[i]) + params.inputOffset, params.multiplier,
+                        leftShift, rightShift);
+        output[i] = static_cast<T>(std::min(std::max(value, params.outputActivationMin),
+                                            params.outputActivationMax));
+    }
+}
+
 template <typename T>
 void MatrixBatchVectorMultiplyAccumulate(const int8_t* input, const int32_t* bias,
                                          const int8_t* input_to_gate_weights, int32_t multiplier,
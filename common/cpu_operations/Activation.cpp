@@ -358,6 +358,30 @@ bool hardSwishQuant(const T* inputData, const Shape& inputShape, T* outputData,
     return true;
 }
 
+// Runs a quantized kernel through a table of its results for every input value. The table only
+// depends on the quantization parameters of the input and output, so it is cached for later
+// executions of the operation.
+template <typename T>
+bool executeWithLookupTable(IOperationExecutionContext* context,
+                            bool (*kernel)(const T*, const Shape&, T*, const Shape&)) {
+    const Shape inputShape = context->getInputShape(kInputTensor);
+    const Shape outputShape = context->getOutputShape(kOutputTensor);
+    const auto table = getQuantizedLookupTable<T>(
+            context, {inputShape, outputShape}, 1,
+            [&](uint32_t /*row*/, const T* tableInput, T* tableOutput) {
+                Shape tableInputShape = inputShape;
+                tableInputShape.dimensions = {QuantizedLookupTable<T>::kRowSize};
+                Shape tableOutputShape = outputShape;
+                tableOutputShape.dimensions = tableInputShape.dimensions;
+                return kernel(tableInput, tableInputShape, tableOutput, tableOutputShape);
+            });
+    NN_RET_CHECK(table != nullptr);
+    NNTRACE_COMP("QuantizedLookupTable::apply");
+    table->apply(context->getInputBuffer<T>(kInputTensor), getNumberOfElements(inputShape),
+                 context->getOutputBuffer<T>(kOutputTensor));
+    return true;
+}
+
 }  // namespace
 
 bool prepare(OperationType opType, IOperationExecutionContext* context) {
@@ -496,15 +520,9 @@ bool executeLogistic(IOperationExecutionContext* context) {
                                  context->getOutputBuffer<float>(kOutputTensor),
                                  context->getOutputShape(kOutputTensor));
         case OperandType::TENSOR_QUANT8_ASYMM:
-            return logisticQuant8(context->getInputBuffer<uint8_t>(kInputTensor),
-                                  context->getInputShape(kInputTensor),
-                                  context->getOutputBuffer<uint8_t>(kOutputTensor),
-                                  context->getOutputShape(kOutputTensor));
+            return executeWithLookupTable(context, logisticQuant8);
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
-            return logisticQuant8Signed(context->getInputBuffer<int8_t>(kInputTensor),
-                                        context->getInputShape(kInputTensor),
-                                        context->getOutputBuffer<int8_t>(kOutputTensor),
-                                        context->getOutputShape(kOutputTensor));
+            return executeWithLookupTable(context, logisticQuant8Signed);
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation LOGISTIC";
     }
@@ -525,15 +543,9 @@ bool executeTanh(IOperationExecutionContext* context) {
                                context->getOutputBuffer<float>(kOutputTensor),
                                context->getOutputShape(kOutputTensor));
         case OperandType::TENSOR_QUANT8_ASYMM:
-            return tanhQuant8(context->getInputBuffer<uint8_t>(kInputTensor),
-                              context->getInputShape(kInputTensor),
-                              context->getOutputBuffer<uint8_t>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return executeWithLookupTable(context, tanhQuant8);
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
-            return tanhQuant8Signed(context->getInputBuffer<int8_t>(kInputTensor),
-                                    context->getInputShape(kInputTensor),
-                                    context->getOutputBuffer<int8_t>(kOutputTensor),
-                                    context->getOutputShape(kOutputTensor));
+            return executeWithLookupTable(context, tanhQuant8Signed);
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation TANH";
     }
@@ -564,15 +576,9 @@ bool executeHardSwish(IOperationExecutionContext* context) {
             return true;
         }
         case OperandType::TENSOR_QUANT8_ASYMM:
-            return hardSwishQuant(context->getInputBuffer<uint8_t>(kInputTensor),
-                                  context->getInputShape(kInputTensor),
-                                  context->getOutputBuffer<uint8_t>(kOutputTensor),
-                                  context->getOutputShape(kOutputTensor));
+            return executeWithLookupTable(context, hardSwishQuant<uint8_t>);
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
-            return hardSwishQuant(context->getInputBuffer<int8_t>(kInputTensor),
-                                  context->getInputShape(kInputTensor),
-                                  context->getOutputBuffer<int8_t>(kOutputTensor),
-                                  context->getOutputShape(kOutputTensor));
+            return executeWithLookupTable(context, hardSwishQuant<int8_t>);
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation TANH";
     }
@@ -584,24 +590,30 @@ bool executeHardSwish(IOperationExecutionContext* context) {
 using std::placeholders::_1;
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(RELU,
                                          std::bind(activation::prepare, OperationType::RELU, _1),
-                                         activation::executeRelu, .allowZeroSizedInput = true);
+                                         activation::executeRelu, .allowZeroSizedInput = true,
+                                         .allowInPlaceExecution = true);
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(RELU1,
                                          std::bind(activation::prepare, OperationType::RELU1, _1),
-                                         activation::executeRelu1, .allowZeroSizedInput = true);
+                                         activation::executeRelu1, .allowZeroSizedInput = true,
+                                         .allowInPlaceExecution = true);
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(RELU6,
                                          std::bind(activation::prepare, OperationType::RELU6, _1),
-                                         activation::executeRelu6, .allowZeroSizedInput = true);
+                                         activation::executeRelu6, .allowZeroSizedInput = true,
+                                         .allowInPlaceExecution = true);
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(LOGISTIC,
                                          std::bind(activation::prepare, OperationType::LOGISTIC,
                                                    _1),
-                                         activation::executeLogistic, .allowZeroSizedInput = true);
+                                         activation::executeLogistic, .allowZeroSizedInput = true,
+                                         .allowInPlaceExecution = true);
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(TANH,
                                          std::bind(activation::prepare, OperationType::TANH, _1),
-                                         activation::executeTanh, .allowZeroSizedInput = true);
+                                         activation::executeTanh, .allowZeroSizedInput = true,
+                                         .allowInPlaceExecution = true);
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(HARD_SWISH,
                                          std::bind(activation::prepare, OperationType::HARD_SWISH,
                                                    _1),
-                                         activation::executeHardSwish, .allowZeroSizedInput = true);
+                                         activation::executeHardSwish, .allowZeroSizedInput = true,
+                                         .allowInPlaceExecution = true);
 
 }  // namespace nn
 }  // namespace android
@@ -20,6 +20,9 @@
 
 #include "ArgMinMax.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "CpuOperationUtils.h"
 #include "Operations.h"
 #include "Tracing.h"
@@ -27,39 +30,151 @@
 namespace android {
 namespace nn {
 
-template <typename In, typename Out>
-static void argMinMaxImpl(const In* inputData, const Shape& inputShape, int32_t axis, bool isArgMin,
-                          Out* outputData, const Shape& /*outputShape*/) {
-    const int outerSize = getNumberOfElements(inputShape, 0, axis);
-    const int axisSize = getSizeOfDimension(inputShape, axis);
-    const int innerSize =
+namespace {
+
+// Reductions over fewer elements than this run on a single thread.
+constexpr uint32_t kMinElementsPerThread = 64 * 1024;
+
+// Number of independent accumulators in findMinMax, which lets the compiler vectorize it.
+constexpr uint32_t kNumLanes = 16;
+
+// Number of inner elements reduced together when the axis is not the innermost dimension.
+constexpr uint32_t kInnerTileSize = 256;
+
+template <typename T, bool isArgMin>
+inline bool isBetter(T value, T best) {
+    return isArgMin ? value < best : value > best;
+}
+
+template <typename T>
+inline bool isNan(T value) {
+    return value != value;
+}
+
+// Returns the index of the first minimum or maximum of data[begin, end), ignoring NaN, or end if
+// all the values are NaN. The values are first reduced in kNumLanes independent lanes without
+// tracking indexes, then the index of the result is found by a second scan.
+template <typename T, bool isArgMin>
+uint32_t findMinMax(const T* data, uint32_t begin, uint32_t end) {
+    uint32_t first = begin;
+    while (first < end && isNan(data[first])) ++first;
+    if (first == end) return end;
+
+    T lanes[kNumLanes];
+    std::fill(lanes, lanes + kNumLanes, data[first]);
+    uint32_t i = first;
+    for (; i + kNumLanes <= end; i += kNumLanes) {
+        for (uint32_t lane = 0; lane < kNumLanes; ++lane) {
+            const T value = data[i + lane];
+            lanes[lane] = isBetter<T, isArgMin>(value, lanes[lane]) ? value : lanes[lane];
+        }
+    }
+    for (; i < end; ++i) {
+        lanes[0] = isBetter<T, isArgMin>(data[i], lanes[0]) ? data[i] : lanes[0];
+    }
+    T best = lanes[0];
+    for (uint32_t lane = 1; lane < kNumLanes; ++lane) {
+        best = isBetter<T, isArgMin>(lanes[lane], best) ? lanes[lane] : best;
+    }
+    i = first;
+    while (data[i] != best) ++i;
+    return i;
+}
+
+// Reduces one contiguous axis, splitting it across threads if it is long enough. The result
+// matches a sequential scan with strict comparisons, which never moves off a leading NaN and skips
+// any other NaN.
+template <typename T, bool isArgMin>
+int32_t argMinMaxContiguous(const T* data, uint32_t axisSize, bool parallel) {
+    if (isNan(data[0])) return 0;
+    if (!parallel) return findMinMax<T, isArgMin>(data, 0, axisSize);
+    const uint32_t numChunks = (axisSize + kMinElementsPerThread - 1) / kMinElementsPerThread;
+    std::vector<uint32_t> chunkResults(numChunks);
+    parallelFor(numChunks, 1, [&](uint32_t chunkBegin, uint32_t chunkEnd) {
+        for (uint32_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+            const uint32_t begin = chunk * kMinElementsPerThread;
+            const uint32_t end = std::min(axisSize, begin + kMinElementsPerThread);
+            const uint32_t index = findMinMax<T, isArgMin>(data, begin, end);
+            chunkResults[chunk] = index < end ? index : axisSize;
+        }
+    });
+    // The first chunk is never all NaN, since data[0] is not.
+    uint32_t result = chunkResults[0];
+    for (uint32_t chunk = 1; chunk < numChunks; ++chunk) {
+        const uint32_t index = chunkResults[chunk];
+        if (index < axisSize && isBetter<T, isArgMin>(data[index], data[result])) {
+            result = index;
+        }
+    }
+    return result;
+}
+
+template <typename In, typename Out, bool isArgMin>
+void argMinMaxImpl(const In* inputData, const Shape& inputShape, int32_t axis, Out* outputData) {
+    const uint32_t outerSize = getNumberOfElements(inputShape, 0, axis);
+    const uint32_t axisSize = getSizeOfDimension(inputShape, axis);
+    const uint32_t innerSize =
             getNumberOfElements(inputShape, axis + 1, getNumberOfDimensions(inputShape));
-    for (int outer = 0; outer < outerSize; ++outer) {
-        for (int inner = 0; inner < innerSize; ++inner) {
-            auto minMaxValue = inputData[outer * axisSize * innerSize + inner];
-            int minMaxIndex = 0;
-            for (int i = 1; i < axisSize; ++i) {
-                const auto& value = inputData[(outer * axisSize + i) * innerSize + inner];
-                if ((isArgMin && value < minMaxValue) || (!isArgMin && value > minMaxValue)) {
-                    minMaxValue = value;
-                    minMaxIndex = i;
+    if (outerSize == 0 || axisSize == 0 || innerSize == 0) return;
+
+    if (innerSize == 1) {
+        const bool splitAxis = outerSize == 1 && axisSize >= 2 * kMinElementsPerThread;
+        const uint32_t minRowsPerThread = std::max<uint32_t>(1, kMinElementsPerThread / axisSize);
+        parallelFor(outerSize, minRowsPerThread, [&](uint32_t outerBegin, uint32_t outerEnd) {
+            for (uint32_t outer = outerBegin; outer < outerEnd; ++outer) {
+                outputData[outer] = argMinMaxContiguous<In, isArgMin>(
+                        inputData + outer * axisSize, axisSize, splitAxis);
+            }
+        });
+        return;
+    }
+
+    // Reduces a tile of inner elements at a time, keeping the best value and index of each inner
+    // element as the axis is scanned. Updating them without branches lets the compiler vectorize
+    // across the tile.
+    const uint32_t numTiles = (innerSize + kInnerTileSize - 1) / kInnerTileSize;
+    const uint32_t elementsPerTile = axisSize * std::min(innerSize, kInnerTileSize);
+    const uint32_t minTilesPerThread =
+            std::max<uint32_t>(1, kMinElementsPerThread / elementsPerTile);
+    parallelFor(outerSize * numTiles, minTilesPerThread, [&](uint32_t taskBegin, uint32_t taskEnd) {
+        In best[kInnerTileSize];
+        for (uint32_t task = taskBegin; task < taskEnd; ++task) {
+            const uint32_t outer = task / numTiles;
+            const uint32_t innerBegin = (task % numTiles) * kInnerTileSize;
+            const uint32_t tileSize = std::min(kInnerTileSize, innerSize - innerBegin);
+            const In* input = inputData + outer * axisSize * innerSize + innerBegin;
+            Out* output = outputData + outer * innerSize + innerBegin;
+            std::copy(input, input + tileSize, best);
+            std::fill(output, output + tileSize, 0);
+            for (uint32_t i = 1; i < axisSize; ++i) {
+                const In* row = input + i * innerSize;
+                for (uint32_t inner = 0; inner < tileSize; ++inner) {
+                    const bool better = isBetter<In, isArgMin>(row[inner], best[inner]);
+                    best[inner] = better ? row[inner] : best[inner];
+                    output[inner] = better ? static_cast<Out>(i) : output[inner];
                 }
             }
-            outputData[outer * innerSize + inner] = minMaxIndex;
         }
-    }
+    });
 }
 
+}  // namespace
+
 bool argMinMaxGeneric(const uint8_t* inputData, const Shape& inputShape, int32 axis, bool isArgMin,
-                      uint8_t* outputData, const Shape& outputShape) {
+                      uint8_t* outputData, const Shape& /*outputShape*/) {
     NNTRACE_TRANS("argMinMaxGeneric");
     NN_CHECK(handleNegativeAxis(inputShape, &axis));
 
 #define NNAPI_IMPL_ARG_MIN_MAX(operandType, dataType)                                           \
     if (inputShape.type == operandType) {                                                       \
         NNTRACE_COMP_SWITCH("argMinMaxImpl::" #dataType);                                       \
-        argMinMaxImpl(reinterpret_cast<const dataType*>(inputData), inputShape, axis, isArgMin, \
-                      reinterpret_cast<int32_t*>(outputData), outputShape);                     \
+        const auto* input = reinterpret_cast<const dataType*>(inputData);                       \
+        auto* output = reinterpret_cast<int32_t*>(outputData);                                  \
+        if (isArgMin) {                                                                         \
+            argMinMaxImpl<dataType, int32_t, true>(input, inputShape, axis, output);            \
+        } else {                                                                                \
+            argMinMaxImpl<dataType, int32_t, false>(input, inputShape, axis, output);           \
+        }                                                                                       \
         return true;                                                                            \
     }
 
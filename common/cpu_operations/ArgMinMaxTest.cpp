@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "Operations.h"
+#include "OperationsExecutionUtils.h"
+
+namespace android {
+namespace nn {
+namespace {
+
+constexpr float kNan = std::numeric_limits<float>::quiet_NaN();
+
+// A sequential scan with strict comparisons, which is what ARG_MIN and ARG_MAX computed before
+// they were vectorized and split across threads.
+template <typename T>
+std::vector<int32_t> argMinMaxReference(const std::vector<T>& input,
+                                        const std::vector<uint32_t>& dimensions, uint32_t axis,
+                                        bool isArgMin) {
+    uint32_t outerSize = 1;
+    for (uint32_t i = 0; i < axis; ++i) outerSize *= dimensions[i];
+    uint32_t innerSize = 1;
+    for (uint32_t i = axis + 1; i < dimensions.size(); ++i) innerSize *= dimensions[i];
+    const uint32_t axisSize = dimensions[axis];
+
+    std::vector<int32_t> output(outerSize * innerSize);
+    for (uint32_t outer = 0; outer < outerSize; ++outer) {
+        for (uint32_t inner = 0; inner < innerSize; ++inner) {
+            const T* data = input.data() + outer * axisSize * innerSize + inner;
+            T best = data[0];
+            int32_t bestIndex = 0;
+            for (uint32_t i = 1; i < axisSize; ++i) {
+                const T value = data[i * innerSize];
+                if (isArgMin ? value < best : value > best) {
+                    best = value;
+                    bestIndex = i;
+                }
+            }
+            output[outer * innerSize + inner] = bestIndex;
+        }
+    }
+    return output;
+}
+
+template <typename T>
+std::vector<int32_t> argMinMax(const std::vector<T>& input, OperandType type,
+                               const std::vector<uint32_t>& dimensions, int32_t axis,
+                               bool isArgMin) {
+    const Shape inputShape = {.type = type, .dimensions = dimensions};
+    const int32_t outputAxis = axis < 0 ? axis + static_cast<int32_t>(dimensions.size()) : axis;
+    std::vector<uint32_t> outputDimensions = dimensions;
+    outputDimensions.erase(outputDimensions.begin() + outputAxis);
+    const Shape outputShape = {.type = OperandType::TENSOR_INT32, .dimensions = outputDimensions};
+
+    std::vector<int32_t> output(getNumberOfElements(outputShape), -1);
+    EXPECT_TRUE(argMinMaxGeneric(reinterpret_cast<const uint8_t*>(input.data()), inputShape, axis,
+                                 isArgMin, reinterpret_cast<uint8_t*>(output.data()),
+                                 outputShape));
+    return output;
+}
+
+// Draws from a few values, so that most rows have ties. Float rows also get signed zeros and NaN.
+template <typename T>
+std::vector<T> makeRandomInput(size_t size, std::mt19937* random) {
+    std::uniform_int_distribution<int> distribution(0, 6);
+    std::vector<T> input(size);
+    for (T& value : input) {
+        const int draw = distribution(*random);
+        if constexpr (std::is_floating_point_v<T>) {
+            constexpr float kValues[] = {-2.0f, -1.0f, -0.0f, 0.0f, 1.0f, 2.0f, kNan};
+            value = kValues[draw];
+        } else {
+            value = static_cast<T>(draw);
+        }
+    }
+    return input;
+}
+
+template <typename T>
+void expectMatchesReference(const std::vector<T>& input, OperandType type,
+                            const std::vector<uint32_t>& dimensions, uint32_t axis) {
+    for (const bool isArgMin : {true, false}) {
+        SCOPED_TRACE(isArgMin ? "ARG_MIN" : "ARG_MAX");
+        EXPECT_EQ(argMinMax(input, type, dimensions, axis, isArgMin),
+                  argMinMaxReference(input, dimensions, axis, isArgMin));
+    }
+}
+
+template <typename T>
+void expectRandomMatchesReference(OperandType type, const std::vector<uint32_t>& dimensions,
+                                  uint32_t axis) {
+    std::mt19937 random(1);
+    size_t size = 1;
+    for (const uint32_t dimension : dimensions) size *= dimension;
+    expectMatchesReference(makeRandomInput<T>(size, &random), type, dimensions, axis);
+}
+
+TEST(ArgMinMaxTest, InnermostAxis) {
+    // Enough rows to be split across threads, each longer than the vectorized lanes.
+    expectRandomMatchesReference<float>(OperandType::TENSOR_FLOAT32, {512, 1000}, 1);
+    expectRandomMatchesReference<float>(OperandType::TENSOR_FLOAT32, {7, 3}, 1);
+    expectRandomMatchesReference<int32_t>(OperandType::TENSOR_INT32, {512, 1000}, 1);
+    expectRandomMatchesReference<uint8_t>(OperandType::TENSOR_QUANT8_ASYMM, {64, 37}, 1);
+    expectRandomMatchesReference<int8_t>(OperandType::TENSOR_QUANT8_ASYMM_SIGNED, {64, 37}, 1);
+}
+
+TEST(ArgMinMaxTest, LongRowSplitAcrossThreads) {
+    // A single row long enough to be reduced in chunks, with a partial last chunk.
+    expectRandomMatchesReference<float>(OperandType::TENSOR_FLOAT32, {300000}, 0);
+    expectRandomMatchesReference<int32_t>(OperandType::TENSOR_INT32, {1, 300000}, 1);
+}
+
+TEST(ArgMinMaxTest, OuterAxis) {
+    // Inner sizes on both sides of a tile, with enough tiles to be split across threads.
+    expectRandomMatchesReference<float>(OperandType::TENSOR_FLOAT32, {64, 64, 300}, 1);
+    expectRandomMatchesReference<float>(OperandType::TENSOR_FLOAT32, {3, 50, 256}, 1);
+    expectRandomMatchesReference<float>(OperandType::TENSOR_FLOAT32, {9, 5, 2}, 0);
+    expectRandomMatchesReference<uint8_t>(OperandType::TENSOR_QUANT8_ASYMM, {4, 100, 513}, 1);
+}
+
+TEST(ArgMinMaxTest, NegativeAxis) {
+    std::mt19937 random(1);
+    const std::vector<float> input = makeRandomInput<float>(6 * 20 * 30, &random);
+    for (const bool isArgMin : {true, false}) {
+        EXPECT_EQ(argMinMax(input, OperandType::TENSOR_FLOAT32, {6, 20, 30}, -1, isArgMin),
+                  argMinMaxReference(input, {6, 20, 30}, 2, isArgMin));
+        EXPECT_EQ(argMinMax(input, OperandType::TENSOR_FLOAT32, {6, 20, 30}, -3, isArgMin),
+                  argMinMaxReference(input, {6, 20, 30}, 0, isArgMin));
+    }
+}
+
+TEST(ArgMinMaxTest, TiesGiveFirstIndex) {
+    const std::vector<float> input = {1.0f, 3.0f, 0.0f, 3.0f, 0.0f, -0.0f};
+    EXPECT_EQ(argMinMax(input, OperandType::TENSOR_FLOAT32, {6}, 0, false),
+              std::vector<int32_t>{1});
+    EXPECT_EQ(argMinMax(input, OperandType::TENSOR_FLOAT32, {6}, 0, true),
+              std::vector<int32_t>{2});
+    EXPECT_EQ(argMinMax(input, OperandType::TENSOR_FLOAT32, {6, 1}, 0, false),
+              std::vector<int32_t>{1});
+    EXPECT_EQ(argMinMax(input, OperandType::TENSOR_FLOAT32, {6, 1}, 0, true),
+              std::vector<int32_t>{2});
+}
+
+TEST(ArgMinMaxTest, Nan) {
+    // A leading NaN is never replaced, and any other NaN is skipped.
+    const std::vector<float> leadingNan = {kNan, 5.0f, -5.0f};
+    EXPECT_EQ(argMinMax(leadingNan, OperandType::TENSOR_FLOAT32, {3}, 0, false),
+              std::vector<int32_t>{0});
+    EXPECT_EQ(argMinMax(leadingNan, OperandType::TENSOR_FLOAT32, {3, 1}, 0, true),
+              std::vector<int32_t>{0});
+    const std::vector<float> middleNan = {1.0f, kNan, 5.0f, kNan, -5.0f};
+    EXPECT_EQ(argMinMax(middleNan, OperandType::TENSOR_FLOAT32, {5}, 0, false),
+              std::vector<int32_t>{2});
+    EXPECT_EQ(argMinMax(middleNan, OperandType::TENSOR_FLOAT32, {5, 1}, 0, true),
+              std::vector<int32_t>{4});
+    const std::vector<float> allNan(40, kNan);
+    EXPECT_EQ(argMinMax(allNan, OperandType::TENSOR_FLOAT32, {2, 20}, 1, true),
+              (std::vector<int32_t>{0, 0}));
+    EXPECT_EQ(argMinMax(allNan, OperandType::TENSOR_FLOAT32, {20, 2}, 0, false),
+              (std::vector<int32_t>{0, 0}));
+}
+
+TEST(ArgMinMaxTest, NanAcrossChunks) {
+    // A long row whose first chunk holds only NaN after its first value, and whose later chunks
+    // are all NaN except for ties of the extremes.
+    constexpr uint32_t kSize = 300000;
+    std::vector<float> input(kSize, kNan);
+    input[0] = 0.0f;
+    input[150000] = 7.0f;
+    input[150001] = -7.0f;
+    input[280000] = 7.0f;
+    input[290000] = -7.0f;
+    expectMatchesReference(input, OperandType::TENSOR_FLOAT32, {kSize}, 0);
+    EXPECT_EQ(argMinMax(input, OperandType::TENSOR_FLOAT32, {kSize}, 0, false),
+              std::vector<int32_t>{150000});
+    EXPECT_EQ(argMinMax(input, OperandType::TENSOR_FLOAT32, {kSize}, 0, true),
+              std::vector<int32_t>{150001});
+
+    input[0] = kNan;
+    expectMatchesReference(input, OperandType::TENSOR_FLOAT32, {kSize}, 0);
+}
+
+TEST(ArgMinMaxTest, ZeroSizedDimensions) {
+    const std::vector<float> input;
+    EXPECT_TRUE(argMinMax(input, OperandType::TENSOR_FLOAT32, {0, 5}, 1, true).empty());
+    EXPECT_TRUE(argMinMax(input, OperandType::TENSOR_FLOAT32, {4, 0}, 0, false).empty());
+    EXPECT_TRUE(argMinMax(input, OperandType::TENSOR_FLOAT32, {2, 3, 0}, 1, true).empty());
+    // There is no value to pick along an empty axis, so nothing is read and nothing is written.
+    EXPECT_EQ(argMinMax(input, OperandType::TENSOR_FLOAT32, {2, 0, 3}, 1, false),
+              std::vector<int32_t>(6, -1));
+}
+
+}  // namespace
+}  // namespace nn
+}  // namespace android
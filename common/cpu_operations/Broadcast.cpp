@@ -21,9 +21,9 @@
 #include "Broadcast.h"
 
 #include <algorithm>
+#include <memory>
 #include <vector>
 
-#include "IndexedShapeWrapper.h"
 #include "OperationResolver.h"
 #include "Tracing.h"
 #include "nnapi/Types.h"
@@ -34,15 +34,11 @@
 #pragma clang diagnostic ignored "-Wunused-parameter"
 #pragma clang diagnostic ignored "-Wsign-compare"
 #pragma clang diagnostic ignored "-Winvalid-partial-specialization"
-#include <tensorflow/lite/kernels/internal/optimized/integer_ops/add.h>
-#include <tensorflow/lite/kernels/internal/optimized/integer_ops/mul.h>
-#include <tensorflow/lite/kernels/internal/optimized/legacy_optimized_ops.h>
-#include <tensorflow/lite/kernels/internal/reference/integer_ops/add.h>
-#include <tensorflow/lite/kernels/internal/reference/integer_ops/mul.h>
 #include <tensorflow/lite/kernels/internal/types.h>
 #pragma clang diagnostic pop
 
 #include "CpuOperationUtils.h"
+#include "QuantUtils.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -53,87 +49,126 @@ namespace broadcast {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
-#define ANDROID_NN_MACRO_DISPATCH(macro)                                \
-    switch (activation) {                                               \
-        case static_cast<int32_t>(FusedActivationFunc::NONE):           \
-            macro(kNone);                                               \
-            break;                                                      \
-        case static_cast<int32_t>(FusedActivationFunc::RELU):           \
-            macro(kRelu);                                               \
-            break;                                                      \
-        case static_cast<int32_t>(FusedActivationFunc::RELU1):          \
-            macro(kRelu1);                                              \
-            break;                                                      \
-        case static_cast<int32_t>(FusedActivationFunc::RELU6):          \
-            macro(kRelu6);                                              \
-            break;                                                      \
-        default:                                                        \
-            LOG(ERROR) << "Unsupported fused activation function type"; \
-            return false;                                               \
+// Below this number of output elements, an operation is not split across threads.
+constexpr uint32_t kMinElementsPerThread = 16 * 1024;
+
+// One dimension of a binary operation after contiguous dimensions have been merged. A stride of 0
+// means that the input is broadcast along the dimension. The output is always dense.
+struct BroadcastDimension {
+    uint32_t size;
+    uint32_t stride1;
+    uint32_t stride2;
+};
+
+// Drops the output dimensions of size 1 and merges adjacent dimensions along which each input is
+// broadcast in both or in neither. Same-shape operands and scalars collapse to one dimension, and
+// e.g. [2, 3, 4, 5] + [4, 5] runs as 6 rows of 20 elements with the second input reused by every
+// row.
+std::vector<BroadcastDimension> compressBroadcastDimensions(const Shape& shape1,
+                                                            const Shape& shape2,
+                                                            const Shape& shapeOut) {
+    const uint32_t rank = getNumberOfDimensions(shapeOut);
+    const uint32_t rank1 = getNumberOfDimensions(shape1);
+    const uint32_t rank2 = getNumberOfDimensions(shape2);
+    std::vector<BroadcastDimension> dimensions;
+    for (uint32_t d = 0; d < rank; ++d) {
+        const uint32_t size = getSizeOfDimension(shapeOut, d);
+        if (size == 1) continue;
+        const uint32_t stride1 =
+                d + rank1 < rank || getSizeOfDimension(shape1, d + rank1 - rank) == 1 ? 0 : 1;
+        const uint32_t stride2 =
+                d + rank2 < rank || getSizeOfDimension(shape2, d + rank2 - rank) == 1 ? 0 : 1;
+        if (!dimensions.empty() && dimensions.back().stride1 == stride1 &&
+            dimensions.back().stride2 == stride2) {
+            dimensions.back().size *= size;
+        } else {
+            dimensions.push_back({size, stride1, stride2});
+        }
     }
-
-using binaryFunctionFloat32 = std::function<bool(
-        const float* in1, const Shape& shape1, const float* in2, const Shape& shape2,
-        int32_t activation, float* out, const Shape& shapeOut)>;
-
-bool binaryOperationFloat16(const _Float16* in1, const Shape& shape1, const _Float16* in2,
-                            const Shape& shape2, int32_t activation, _Float16* out,
-                            const Shape& shapeOut, binaryFunctionFloat32 operationFloat32) {
-    std::vector<float> in1_float32(getNumberOfElements(shape1));
-    convertFloat16ToFloat32(in1, &in1_float32);
-    std::vector<float> in2_float32(getNumberOfElements(shape2));
-    convertFloat16ToFloat32(in2, &in2_float32);
-    std::vector<float> out_float32(getNumberOfElements(shapeOut));
-
-    operationFloat32(in1_float32.data(), shape1, in2_float32.data(), shape2, activation,
-                     out_float32.data(), shapeOut);
-    convertFloat32ToFloat16(out_float32, out);
-
-    return true;
+    if (dimensions.empty()) {
+        dimensions.push_back({1, 1, 1});
+    }
+    // Turn the broadcast flags into element strides, starting from the innermost dimension.
+    uint32_t stride1 = 1, stride2 = 1;
+    for (auto it = dimensions.rbegin(); it != dimensions.rend(); ++it) {
+        if (it->stride1 != 0) {
+            it->stride1 = stride1;
+            stride1 *= it->size;
+        }
+        if (it->stride2 != 0) {
+            it->stride2 = stride2;
+            stride2 *= it->size;
+        }
+    }
+    return dimensions;
 }
 
-bool addFloat32(const float* in1, const Shape& shape1, const float* in2, const Shape& shape2,
-                int32_t activation, float* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("addFloat32");
-    bool needBroadcast = !SameShape(shape1, shape2);
-    if (needBroadcast) {
-        NNTRACE_COMP_SWITCH("optimized_ops::BroadcastAdd");
-#define ANDROID_NN_BROADCAST_ADD(activation)                                              \
-    tflite::optimized_ops::BroadcastAdd<tflite::FusedActivationFunctionType::activation>( \
-            in1, convertShapeToDims(shape1), in2, convertShapeToDims(shape2), out,        \
-            convertShapeToDims(shapeOut))
-
-        ANDROID_NN_MACRO_DISPATCH(ANDROID_NN_BROADCAST_ADD)
-#undef ANDROID_NN_BROADCAST_ADD
+// Applies fn along the innermost dimension, where each input is either contiguous or a single
+// broadcast value. Every case is a plain loop over contiguous memory that the compiler vectorizes.
+template <typename T, typename Fn>
+inline void binaryInnerLoop(const T* in1, uint32_t stride1, const T* in2, uint32_t stride2,
+                            uint32_t size, T* out, const Fn& fn) {
+    if (stride1 != 0 && stride2 != 0) {
+        for (uint32_t i = 0; i < size; ++i) {
+            out[i] = fn(in1[i], in2[i]);
+        }
+    } else if (stride2 != 0) {
+        const T value1 = in1[0];
+        for (uint32_t i = 0; i < size; ++i) {
+            out[i] = fn(value1, in2[i]);
+        }
+    } else if (stride1 != 0) {
+        const T value2 = in2[0];
+        for (uint32_t i = 0; i < size; ++i) {
+            out[i] = fn(in1[i], value2);
+        }
     } else {
-        NNTRACE_COMP_SWITCH("optimized_ops::Add");
-#define ANDROID_NN_ADD(activation)                                                 \
-    tflite::optimized_ops::Add<tflite::FusedActivationFunctionType::activation>(   \
-            in1, convertShapeToDims(shape1), in2, convertShapeToDims(shape2), out, \
-            convertShapeToDims(shapeOut))
-
-        ANDROID_NN_MACRO_DISPATCH(ANDROID_NN_ADD)
-#undef ANDROID_NN_ADD
+        std::fill(out, out + size, fn(in1[0], in2[0]));
     }
-
-    return true;
 }
 
-bool addFloat16(const _Float16* in1, const Shape& shape1, const _Float16* in2, const Shape& shape2,
-                int32_t activation, _Float16* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("addFloat16");
-    return binaryOperationFloat16(in1, shape1, in2, shape2, activation, out, shapeOut, &addFloat32);
+// Computes out = fn(in1, in2) with broadcasting described by dimensions. Rows of the innermost
+// dimension are distributed across threads, or the innermost dimension itself if it is the only
+// one.
+template <typename T, typename Fn>
+void binaryElementwise(const std::vector<BroadcastDimension>& dimensions, const T* in1,
+                       const T* in2, T* out, const Fn& fn) {
+    NNTRACE_COMP("binaryElementwise");
+    const BroadcastDimension& inner = dimensions.back();
+    uint32_t numRows = 1;
+    for (size_t d = 0; d + 1 < dimensions.size(); ++d) {
+        numRows *= dimensions[d].size;
+    }
+    if (numRows == 1) {
+        parallelFor(inner.size, kMinElementsPerThread, [&](uint32_t begin, uint32_t end) {
+            binaryInnerLoop(in1 + begin * inner.stride1, inner.stride1, in2 + begin * inner.stride2,
+                            inner.stride2, end - begin, out + begin, fn);
+        });
+        return;
+    }
+    const uint32_t minRowsPerThread = std::max<uint32_t>(1, kMinElementsPerThread / inner.size);
+    parallelFor(numRows, minRowsPerThread, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+            uint32_t offset1 = 0, offset2 = 0;
+            uint32_t index = row;
+            for (size_t d = dimensions.size() - 1; d > 0; --d) {
+                const BroadcastDimension& dimension = dimensions[d - 1];
+                const uint32_t i = index % dimension.size;
+                index /= dimension.size;
+                offset1 += i * dimension.stride1;
+                offset2 += i * dimension.stride2;
+            }
+            binaryInnerLoop(in1 + offset1, inner.stride1, in2 + offset2, inner.stride2, inner.size,
+                            out + row * inner.size, fn);
+        }
+    });
 }
 
+// Derives the fixed-point parameters of a quantized ADD. SUB reuses them with the multiplier of
+// the second input negated.
 template <typename T>
-bool addQuant8(const T* in1, const Shape& shape1, const T* in2, const Shape& shape2,
-               int32_t activation, T* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("addQuant8");
-    const bool needBroadcast = !SameShape(shape1, shape2);
-
-    const int32_t input1_offset = -shape1.offset;
-    const int32_t input2_offset = -shape2.offset;
-    const int32_t output_offset = shapeOut.offset;
+bool getAddQuant8Params(const Shape& shape1, const Shape& shape2, int32_t activation,
+                        const Shape& shapeOut, tflite::ArithmeticParams* op_params) {
     const int left_shift = 20;
     const double twice_max_input_scale = 2 * std::max(shape1.scale, shape2.scale);
     const double real_input1_multiplier = shape1.scale / twice_max_input_scale;
@@ -156,8 +191,7 @@ bool addQuant8(const T* in1, const Shape& shape1, const T* in2, const Shape& sha
 
     int32_t output_activation_min;
     int32_t output_activation_max;
-    constexpr bool isSignedOp = std::is_same<T, int8_t>::value;
-    if constexpr (isSignedOp) {
+    if constexpr (std::is_same_v<T, int8_t>) {
         CalculateActivationRangeInt8(activation, shapeOut, &output_activation_min,
                                      &output_activation_max);
     } else {
@@ -165,123 +199,42 @@ bool addQuant8(const T* in1, const Shape& shape1, const T* in2, const Shape& sha
                                       &output_activation_max);
     }
 
-    tflite::ArithmeticParams op_params;
-    op_params.left_shift = left_shift;
-    op_params.input1_offset = input1_offset;
-    op_params.input1_multiplier = input1_multiplier;
-    op_params.input1_shift = input1_shift;
-    op_params.input2_offset = input2_offset;
-    op_params.input2_multiplier = input2_multiplier;
-    op_params.input2_shift = input2_shift;
-    op_params.output_offset = output_offset;
-    op_params.output_multiplier = output_multiplier;
-    op_params.output_shift = output_shift;
-    tflite::SetActivationParams(output_activation_min, output_activation_max, &op_params);
-
-    if (needBroadcast) {
-        if constexpr (isSignedOp) {
-            NNTRACE_COMP_SWITCH("reference_integer_ops::BroadcastAdd4DSlow");
-            tflite::reference_integer_ops::BroadcastAdd4DSlow(
-                    op_params, convertShapeToTflshape(shape1), in1, convertShapeToTflshape(shape2),
-                    in2, convertShapeToTflshape(shapeOut), out);
-        } else {
-            NNTRACE_COMP_SWITCH("reference_ops::BroadcastAdd4DSlow");
-            tflite::reference_ops::BroadcastAdd4DSlow(op_params, convertShapeToTflshape(shape1),
-                                                      in1, convertShapeToTflshape(shape2), in2,
-                                                      convertShapeToTflshape(shapeOut), out);
-        }
-    } else {
-        if constexpr (isSignedOp) {
-            NNTRACE_COMP_SWITCH("optimized_integer_ops::Add");
-            tflite::optimized_integer_ops::Add(op_params, convertShapeToTflshape(shape1), in1,
-                                               convertShapeToTflshape(shape2), in2,
-                                               convertShapeToTflshape(shapeOut), out);
-        } else {
-            NNTRACE_COMP_SWITCH("optimized_ops::Add");
-            tflite::optimized_ops::Add(op_params, convertShapeToTflshape(shape1), in1,
-                                       convertShapeToTflshape(shape2), in2,
-                                       convertShapeToTflshape(shapeOut), out);
-        }
-    }
-
-    return true;
-}
-
-bool executeInt32(const int32_t* aData, const Shape& aShape, const int32_t* bData,
-                  const Shape& bShape, int32_t activation, int32_t* outputData,
-                  const Shape& outputShape, int32_t func(int32_t, int32_t)) {
-    NN_RET_CHECK_EQ(static_cast<FusedActivationFunc>(activation), FusedActivationFunc::NONE);
-    IndexedShapeWrapper aShapeIndexed(aShape);
-    IndexedShapeWrapper bShapeIndexed(bShape);
-    IndexedShapeWrapper outputShapeIndexed(outputShape);
-    std::vector<uint32_t> curIndex(outputShape.dimensions.size(), 0);
-    bool lastIndex = false;
-    do {
-        uint32_t outputFlatIndex;
-        NN_RET_CHECK(outputShapeIndexed.indexToFlatIndex(curIndex, &outputFlatIndex));
-        uint32_t aFlatIndex;
-        NN_RET_CHECK(aShapeIndexed.broadcastedIndexToFlatIndex(curIndex, &aFlatIndex));
-        uint32_t bFlatIndex;
-        NN_RET_CHECK(bShapeIndexed.broadcastedIndexToFlatIndex(curIndex, &bFlatIndex));
-
-        outputData[outputFlatIndex] = func(aData[aFlatIndex], bData[bFlatIndex]);
-
-        NN_RET_CHECK(outputShapeIndexed.nextIndexInplace(&curIndex, &lastIndex));
-    } while (!lastIndex);
+    op_params->left_shift = left_shift;
+    op_params->input1_offset = -shape1.offset;
+    op_params->input1_multiplier = input1_multiplier;
+    op_params->input1_shift = input1_shift;
+    op_params->input2_offset = -shape2.offset;
+    op_params->input2_multiplier = input2_multiplier;
+    op_params->input2_shift = input2_shift;
+    op_params->output_offset = shapeOut.offset;
+    op_params->output_multiplier = output_multiplier;
+    op_params->output_shift = output_shift;
+    tflite::SetActivationParams(output_activation_min, output_activation_max, op_params);
     return true;
 }
 
-bool mulFloat32(const float* in1, const Shape& shape1, const float* in2, const Shape& shape2,
-                int32_t activation, float* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("mulFloat32");
-    bool needBroadcast = !SameShape(shape1, shape2);
-
-    if (needBroadcast) {
-        NNTRACE_COMP_SWITCH("optimized_ops::BroadcastMul");
-#define ANDROID_NN_BROADCAST_MUL(activation)                                              \
-    tflite::optimized_ops::BroadcastMul<tflite::FusedActivationFunctionType::activation>( \
-            in1, convertShapeToDims(shape1), in2, convertShapeToDims(shape2), out,        \
-            convertShapeToDims(shapeOut))
-
-        ANDROID_NN_MACRO_DISPATCH(ANDROID_NN_BROADCAST_MUL)
-#undef ANDROID_NN_BROADCAST_MUL
-    } else {
-        float output_activation_min, output_activation_max;
-        CalculateActivationRangeFloat(activation, &output_activation_min, &output_activation_max);
-
-        NNTRACE_COMP_SWITCH("optimized_ops::Mul");
-        tflite::optimized_ops::Mul(in1, convertShapeToDims(shape1), in2, convertShapeToDims(shape2),
-                                   output_activation_min, output_activation_max, out,
-                                   convertShapeToDims(shapeOut));
-    }
-
+template <typename T>
+bool getSubQuant8Params(const Shape& shape1, const Shape& shape2, int32_t activation,
+                        const Shape& shapeOut, tflite::ArithmeticParams* op_params) {
+    NN_RET_CHECK(getAddQuant8Params<T>(shape1, shape2, activation, shapeOut, op_params));
+    // Negate multiplier of the second input, so that we can use Add kernels.
+    op_params->input2_multiplier *= -1;
     return true;
 }
 
-bool mulFloat16(const _Float16* in1, const Shape& shape1, const _Float16* in2, const Shape& shape2,
-                int32_t activation, _Float16* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("mulFloat16");
-    return binaryOperationFloat16(in1, shape1, in2, shape2, activation, out, shapeOut, &mulFloat32);
-}
-
 template <typename T>
-bool mulQuant8(const T* in1, const Shape& shape1, const T* in2, const Shape& shape2,
-               int32_t activation, T* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("mulQuant8");
-    const int32_t input1_offset = -shape1.offset;
-    const int32_t input2_offset = -shape2.offset;
-    const int32_t output_offset = shapeOut.offset;
+bool getMulQuant8Params(const Shape& shape1, const Shape& shape2, int32_t activation,
+                        const Shape& shapeOut, tflite::ArithmeticParams* op_params) {
     const double input_product_scale = shape1.scale * shape2.scale;
     const double real_multiplier = input_product_scale / shapeOut.scale;
-    int32 output_multiplier;
-    int output_shift;
+    int32_t output_multiplier;
+    int32_t output_shift;
     NN_RET_CHECK(QuantizeMultiplierSmallerThanOneExp(real_multiplier, &output_multiplier,
                                                      &output_shift));
 
-    constexpr bool isSignedOp = std::is_same<T, int8_t>::value;
     int32_t output_activation_min;
     int32_t output_activation_max;
-    if constexpr (isSignedOp) {
+    if constexpr (std::is_same_v<T, int8_t>) {
         CalculateActivationRangeInt8(activation, shapeOut, &output_activation_min,
                                      &output_activation_max);
     } else {
@@ -289,150 +242,151 @@ bool mulQuant8(const T* in1, const Shape& shape1, const T* in2, const Shape& sha
                                       &output_activation_max);
     }
 
-    tflite::ArithmeticParams op_params;
-    op_params.input1_offset = input1_offset;
-    op_params.input2_offset = input2_offset;
-    op_params.output_offset = output_offset;
-    op_params.output_multiplier = output_multiplier;
-    op_params.output_shift = output_shift;
-    tflite::SetActivationParams(output_activation_min, output_activation_max, &op_params);
-
-    if constexpr (isSignedOp) {
-        NNTRACE_COMP_SWITCH("reference_integer_ops::BroadcastMul4DSlow");
-        tflite::reference_integer_ops::BroadcastMul4DSlow(op_params, convertShapeToTflshape(shape1),
-                                                          in1, convertShapeToTflshape(shape2), in2,
-                                                          convertShapeToTflshape(shapeOut), out);
-    } else {
-        NNTRACE_COMP_SWITCH("reference_ops::BroadcastMul4DSlow");
-        tflite::reference_ops::BroadcastMul4DSlow(op_params, convertShapeToTflshape(shape1), in1,
-                                                  convertShapeToTflshape(shape2), in2,
-                                                  convertShapeToTflshape(shapeOut), out);
-    }
-
+    op_params->input1_offset = -shape1.offset;
+    op_params->input2_offset = -shape2.offset;
+    op_params->output_offset = shapeOut.offset;
+    op_params->output_multiplier = output_multiplier;
+    op_params->output_shift = output_shift;
+    tflite::SetActivationParams(output_activation_min, output_activation_max, op_params);
     return true;
 }
 
-bool subFloat32(const float* in1, const Shape& shape1, const float* in2, const Shape& shape2,
-                int32_t activation, float* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("subFloat32");
-    NNTRACE_COMP_SWITCH("optimized_ops::Sub");
-    tflite::optimized_ops::Sub(in1, convertShapeToDims(shape1), in2, convertShapeToDims(shape2),
-                               out, convertShapeToDims(shapeOut));
-
-    // TFLite does not apply activation to broadcast sub.
-    float output_activation_min, output_activation_max;
-    CalculateActivationRangeFloat(activation, &output_activation_min, &output_activation_max);
-    uint32_t numOutputElements = getNumberOfElements(shapeOut);
-    for (uint32_t i = 0; i < numOutputElements; i++) {
-        out[i] = std::min(std::max(out[i], output_activation_min), output_activation_max);
-    }
-    return true;
-}
+using getQuant8ParamsFn = bool (*)(const Shape& shape1, const Shape& shape2, int32_t activation,
+                                   const Shape& shapeOut, tflite::ArithmeticParams* op_params);
 
-bool subFloat16(const _Float16* in1, const Shape& shape1, const _Float16* in2, const Shape& shape2,
-                int32_t activation, _Float16* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("subFloat16");
-    return binaryOperationFloat16(in1, shape1, in2, shape2, activation, out, shapeOut, &subFloat32);
+bool sameShapeAndQuantization(const Shape& a, const Shape& b) {
+    return a.dimensions == b.dimensions && a.scale == b.scale && a.offset == b.offset;
 }
 
-template <typename T>
-bool subQuant8(const T* in1, const Shape& shape1, const T* in2, const Shape& shape2,
-               int32_t activation, T* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("subQuant8");
-
-    const int32_t input1_offset = -shape1.offset;
-    const int32_t input2_offset = -shape2.offset;
-    const int32_t output_offset = shapeOut.offset;
-    const int left_shift = 20;
-    const double twice_max_input_scale = 2 * std::max(shape1.scale, shape2.scale);
-    const double real_input1_multiplier = shape1.scale / twice_max_input_scale;
-    const double real_input2_multiplier = shape2.scale / twice_max_input_scale;
-    const double real_output_multiplier =
-            twice_max_input_scale / ((1 << left_shift) * shapeOut.scale);
-
-    int32_t input1_multiplier;
-    int32_t input1_shift;
-    NN_RET_CHECK(QuantizeMultiplierSmallerThanOneExp(real_input1_multiplier, &input1_multiplier,
-                                                     &input1_shift));
-    int32_t input2_multiplier;
-    int32_t input2_shift;
-    NN_RET_CHECK(QuantizeMultiplierSmallerThanOneExp(real_input2_multiplier, &input2_multiplier,
-                                                     &input2_shift));
-    // Negate multiplier of the second input, so that we can use Add kernels.
-    input2_multiplier *= -1;
-
-    int32_t output_multiplier;
-    int32_t output_shift;
-    NN_RET_CHECK(QuantizeMultiplierSmallerThanOneExp(real_output_multiplier, &output_multiplier,
-                                                     &output_shift));
-
-    constexpr bool isSignedOp = std::is_same<T, int8_t>::value;
-    int32_t output_activation_min;
-    int32_t output_activation_max;
-    if constexpr (isSignedOp) {
-        CalculateActivationRangeInt8(activation, shapeOut, &output_activation_min,
-                                     &output_activation_max);
-    } else {
-        CalculateActivationRangeUint8(activation, shapeOut, &output_activation_min,
-                                      &output_activation_max);
+// Compressed dimensions of a binary operation, and for quantized operands its fixed-point
+// parameters, kept on the prepared model together with the operand shapes and fused activation
+// they were derived from.
+struct BroadcastState : public OperationState {
+    Shape shape1;
+    Shape shape2;
+    Shape shapeOut;
+    int32_t activation;
+    std::vector<BroadcastDimension> dimensions;
+    tflite::ArithmeticParams quantParams;
+};
+
+// Returns the state of the operation, deriving it only if the prepared model has no matching
+// cached state. getQuantParams is nullptr for operations that are not quantized.
+std::shared_ptr<const BroadcastState> getBroadcastState(IOperationExecutionContext* context,
+                                                        getQuant8ParamsFn getQuantParams) {
+    const Shape shape1 = context->getInputShape(kInputTensor1);
+    const Shape shape2 = context->getInputShape(kInputTensor2);
+    const Shape shapeOut = context->getOutputShape(kOutputTensor);
+    const int32_t activation = context->getInputValue<int32_t>(kActivationScalar);
+    auto state = context->getCachedState<BroadcastState>();
+    if (state != nullptr && sameShapeAndQuantization(state->shape1, shape1) &&
+        sameShapeAndQuantization(state->shape2, shape2) &&
+        sameShapeAndQuantization(state->shapeOut, shapeOut) && state->activation == activation) {
+        return state;
     }
-
-    tflite::ArithmeticParams op_params;
-    op_params.left_shift = left_shift;
-    op_params.input1_offset = input1_offset;
-    op_params.input1_multiplier = input1_multiplier;
-    op_params.input1_shift = input1_shift;
-    op_params.input2_offset = input2_offset;
-    op_params.input2_multiplier = input2_multiplier;
-    op_params.input2_shift = input2_shift;
-    op_params.output_offset = output_offset;
-    op_params.output_multiplier = output_multiplier;
-    op_params.output_shift = output_shift;
-    tflite::SetActivationParams(output_activation_min, output_activation_max, &op_params);
-
-    // We are using tflite::optimized_ops::BroadcastAdd unconditionally here
-    // because tflite::optimized_ops::Add fails to pass some of the
-    // sub_quantized_different_scales tests.
-    if constexpr (isSignedOp) {
-        NNTRACE_COMP_SWITCH("reference_integer_ops::BroadcastAdd4DSlow");
-        tflite::reference_integer_ops::BroadcastAdd4DSlow(op_params, convertShapeToTflshape(shape1),
-                                                          in1, convertShapeToTflshape(shape2), in2,
-                                                          convertShapeToTflshape(shapeOut), out);
-    } else {
-        NNTRACE_COMP_SWITCH("reference_ops::BroadcastAdd4DSlow");
-        tflite::reference_ops::BroadcastAdd4DSlow(op_params, convertShapeToTflshape(shape1), in1,
-                                                  convertShapeToTflshape(shape2), in2,
-                                                  convertShapeToTflshape(shapeOut), out);
+    auto newState = std::make_shared<BroadcastState>();
+    newState->shape1 = shape1;
+    newState->shape2 = shape2;
+    newState->shapeOut = shapeOut;
+    newState->activation = activation;
+    newState->dimensions = compressBroadcastDimensions(shape1, shape2, shapeOut);
+    if (getQuantParams != nullptr &&
+        !getQuantParams(shape1, shape2, activation, shapeOut, &newState->quantParams)) {
+        return nullptr;
     }
+    context->setCachedState(newState);
+    return newState;
+}
 
+// FLOAT16 is computed in float32 per element, which matches converting whole tensors to float32.
+template <typename T, typename Op>
+bool executeFloat(IOperationExecutionContext* context, const Op& op) {
+    const auto state = getBroadcastState(context, nullptr);
+    NN_RET_CHECK(state != nullptr);
+    float outputActivationMin, outputActivationMax;
+    CalculateActivationRangeFloat(state->activation, &outputActivationMin, &outputActivationMax);
+    binaryElementwise(state->dimensions, context->getInputBuffer<T>(kInputTensor1),
+                      context->getInputBuffer<T>(kInputTensor2),
+                      context->getOutputBuffer<T>(kOutputTensor),
+                      [op, outputActivationMin, outputActivationMax](T a, T b) {
+                          const float result = op(static_cast<float>(a), static_cast<float>(b));
+                          return static_cast<T>(std::min(std::max(result, outputActivationMin),
+                                                         outputActivationMax));
+                      });
     return true;
 }
 
-bool divFloat32(const float* in1, const Shape& shape1, const float* in2, const Shape& shape2,
-                int32_t activation, float* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("divFloat32");
-    float output_activation_min, output_activation_max;
-    CalculateActivationRangeFloat(activation, &output_activation_min, &output_activation_max);
-
-    bool needBroadcast = !SameShape(shape1, shape2);
-    if (needBroadcast) {
-        NNTRACE_COMP_SWITCH("optimized_ops::BroadcastDiv");
-        tflite::optimized_ops::BroadcastDiv(
-                in1, convertShapeToDims(shape1), in2, convertShapeToDims(shape2),
-                output_activation_min, output_activation_max, out, convertShapeToDims(shapeOut));
-    } else {
-        NNTRACE_COMP_SWITCH("optimized_ops::Div");
-        tflite::optimized_ops::Div(in1, convertShapeToDims(shape1), in2, convertShapeToDims(shape2),
-                                   output_activation_min, output_activation_max, out,
-                                   convertShapeToDims(shapeOut));
-    }
+template <typename Op>
+bool executeInt32(IOperationExecutionContext* context, const Op& op) {
+    const auto state = getBroadcastState(context, nullptr);
+    NN_RET_CHECK(state != nullptr);
+    NN_RET_CHECK_EQ(static_cast<FusedActivationFunc>(state->activation), FusedActivationFunc::NONE);
+    binaryElementwise(state->dimensions, context->getInputBuffer<int32_t>(kInputTensor1),
+                      context->getInputBuffer<int32_t>(kInputTensor2),
+                      context->getOutputBuffer<int32_t>(kOutputTensor), op);
     return true;
 }
 
-bool divFloat16(const _Float16* in1, const Shape& shape1, const _Float16* in2, const Shape& shape2,
-                int32_t activation, _Float16* out, const Shape& shapeOut) {
-    NNTRACE_TRANS("divFloat16");
-    return binaryOperationFloat16(in1, shape1, in2, shape2, activation, out, shapeOut, &divFloat32);
+// Quantized ADD, and SUB through a negated second input multiplier. Bit-exact with
+// tflite::reference_ops::BroadcastAdd4DSlow.
+template <typename T>
+bool executeAddQuant8(IOperationExecutionContext* context, getQuant8ParamsFn getQuantParams) {
+    const auto state = getBroadcastState(context, getQuantParams);
+    NN_RET_CHECK(state != nullptr);
+    const tflite::ArithmeticParams& params = state->quantParams;
+    const int32_t leftShift = params.left_shift;
+    const int32_t input1Offset = params.input1_offset;
+    const int32_t input1Multiplier = params.input1_multiplier;
+    const int32_t input1RightShift = -params.input1_shift;
+    const int32_t input2Offset = params.input2_offset;
+    const int32_t input2Multiplier = params.input2_multiplier;
+    const int32_t input2RightShift = -params.input2_shift;
+    const int32_t outputOffset = params.output_offset;
+    const int32_t outputMultiplier = params.output_multiplier;
+    const int32_t outputRightShift = -params.output_shift;
+    const int32_t outputActivationMin = params.quantized_activation_min;
+    const int32_t outputActivationMax = params.quantized_activation_max;
+    binaryElementwise(state->dimensions, context->getInputBuffer<T>(kInputTensor1),
+                      context->getInputBuffer<T>(kInputTensor2),
+                      context->getOutputBuffer<T>(kOutputTensor), [=](T a, T b) {
+                          const int32_t scaled1 = MultiplyByQuantizedMultiplierSplitShift(
+                                  input1Offset + a, input1Multiplier, leftShift, input1RightShift);
+                          const int32_t scaled2 = MultiplyByQuantizedMultiplierSplitShift(
+                                  input2Offset + b, input2Multiplier, leftShift, input2RightShift);
+                          const int32_t result =
+                                  outputOffset + MultiplyByQuantizedMultiplierSplitShift(
+                                                         scaled1 + scaled2, outputMultiplier, 0,
+                                                         outputRightShift);
+                          return static_cast<T>(std::min(std::max(result, outputActivationMin),
+                                                         outputActivationMax));
+                      });
+    return true;
+}
+
+// Quantized MUL. Bit-exact with tflite::reference_ops::BroadcastMul4DSlow.
+template <typename T>
+bool executeMulQuant8(IOperationExecutionContext* context) {
+    const auto state = getBroadcastState(context, &getMulQuant8Params<T>);
+    NN_RET_CHECK(state != nullptr);
+    const tflite::ArithmeticParams& params = state->quantParams;
+    const int32_t input1Offset = params.input1_offset;
+    const int32_t input2Offset = params.input2_offset;
+    const int32_t outputOffset = params.output_offset;
+    const int32_t outputMultiplier = params.output_multiplier;
+    const int32_t outputRightShift = -params.output_shift;
+    const int32_t outputActivationMin = params.quantized_activation_min;
+    const int32_t outputActivationMax = params.quantized_activation_max;
+    binaryElementwise(state->dimensions, context->getInputBuffer<T>(kInputTensor1),
+                      context->getInputBuffer<T>(kInputTensor2),
+                      context->getOutputBuffer<T>(kOutputTensor), [=](T a, T b) {
+                          const int32_t result =
+                                  outputOffset + MultiplyByQuantizedMultiplierSplitShift(
+                                                         (input1Offset + a) * (input2Offset + b),
+                                                         outputMultiplier, 0, outputRightShift);
+                          return static_cast<T>(std::min(std::max(result, outputActivationMin),
+                                                         outputActivationMax));
+                      });
+    return true;
 }
 
 }  // namespace
@@ -450,48 +404,19 @@ bool prepare(IOperationExecutionContext* context) {
 bool executeAdd(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
     if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    NNTRACE_TRANS("executeAdd");
+    const auto add = [](auto a, auto b) { return a + b; };
     switch (context->getInputType(kInputTensor1)) {
         case OperandType::TENSOR_FLOAT16:
-            return addFloat16(context->getInputBuffer<_Float16>(kInputTensor1),
-                              context->getInputShape(kInputTensor1),
-                              context->getInputBuffer<_Float16>(kInputTensor2),
-                              context->getInputShape(kInputTensor2),
-                              context->getInputValue<int32_t>(kActivationScalar),
-                              context->getOutputBuffer<_Float16>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return executeFloat<_Float16>(context, add);
         case OperandType::TENSOR_FLOAT32:
-            return addFloat32(context->getInputBuffer<float>(kInputTensor1),
-                              context->getInputShape(kInputTensor1),
-                              context->getInputBuffer<float>(kInputTensor2),
-                              context->getInputShape(kInputTensor2),
-                              context->getInputValue<int32_t>(kActivationScalar),
-                              context->getOutputBuffer<float>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return executeFloat<float>(context, add);
         case OperandType::TENSOR_QUANT8_ASYMM:
-            return addQuant8(context->getInputBuffer<uint8_t>(kInputTensor1),
-                             context->getInputShape(kInputTensor1),
-                             context->getInputBuffer<uint8_t>(kInputTensor2),
-                             context->getInputShape(kInputTensor2),
-                             context->getInputValue<int32_t>(kActivationScalar),
-                             context->getOutputBuffer<uint8_t>(kOutputTensor),
-                             context->getOutputShape(kOutputTensor));
+            return executeAddQuant8<uint8_t>(context, &getAddQuant8Params<uint8_t>);
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
-            return addQuant8(context->getInputBuffer<int8_t>(kInputTensor1),
-                             context->getInputShape(kInputTensor1),
-                             context->getInputBuffer<int8_t>(kInputTensor2),
-                             context->getInputShape(kInputTensor2),
-                             context->getInputValue<int32_t>(kActivationScalar),
-                             context->getOutputBuffer<int8_t>(kOutputTensor),
-                             context->getOutputShape(kOutputTensor));
+            return executeAddQuant8<int8_t>(context, &getAddQuant8Params<int8_t>);
         case OperandType::TENSOR_INT32:
-            return executeInt32(context->getInputBuffer<int32_t>(kInputTensor1),
-                                context->getInputShape(kInputTensor1),
-                                context->getInputBuffer<int32_t>(kInputTensor2),
-                                context->getInputShape(kInputTensor2),
-                                context->getInputValue<int32_t>(kActivationScalar),
-                                context->getOutputBuffer<int32_t>(kOutputTensor),
-                                context->getOutputShape(kOutputTensor),
-                                [](int32_t a, int32_t b) { return a + b; });
+            return executeInt32(context, add);
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation ADD";
     }
@@ -500,48 +425,19 @@ bool executeAdd(IOperationExecutionContext* context) {
 bool executeMul(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
     if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    NNTRACE_TRANS("executeMul");
+    const auto mul = [](auto a, auto b) { return a * b; };
     switch (context->getInputType(kInputTensor1)) {
         case OperandType::TENSOR_FLOAT16:
-            return mulFloat16(context->getInputBuffer<_Float16>(kInputTensor1),
-                              context->getInputShape(kInputTensor1),
-                              context->getInputBuffer<_Float16>(kInputTensor2),
-                              context->getInputShape(kInputTensor2),
-                              context->getInputValue<int32_t>(kActivationScalar),
-                              context->getOutputBuffer<_Float16>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return executeFloat<_Float16>(context, mul);
         case OperandType::TENSOR_FLOAT32:
-            return mulFloat32(context->getInputBuffer<float>(kInputTensor1),
-                              context->getInputShape(kInputTensor1),
-                              context->getInputBuffer<float>(kInputTensor2),
-                              context->getInputShape(kInputTensor2),
-                              context->getInputValue<int32_t>(kActivationScalar),
-                              context->getOutputBuffer<float>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return executeFloat<float>(context, mul);
         case OperandType::TENSOR_QUANT8_ASYMM:
-            return mulQuant8(context->getInputBuffer<uint8_t>(kInputTensor1),
-                             context->getInputShape(kInputTensor1),
-                             context->getInputBuffer<uint8_t>(kInputTensor2),
-                             context->getInputShape(kInputTensor2),
-                             context->getInputValue<int32_t>(kActivationScalar),
-                             context->getOutputBuffer<uint8_t>(kOutputTensor),
-                             context->getOutputShape(kOutputTensor));
+            return executeMulQuant8<uint8_t>(context);
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
-            return mulQuant8(context->getInputBuffer<int8_t>(kInputTensor1),
-                             context->getInputShape(kInputTensor1),
-                             context->getInputBuffer<int8_t>(kInputTensor2),
-                             context->getInputShape(kInputTensor2),
-                             context->getInputValue<int32_t>(kActivationScalar),
-                             context->getOutputBuffer<int8_t>(kOutputTensor),
-                             context->getOutputShape(kOutputTensor));
+            return executeMulQuant8<int8_t>(context);
         case OperandType::TENSOR_INT32:
-            return executeInt32(context->getInputBuffer<int32_t>(kInputTensor1),
-                                context->getInputShape(kInputTensor1),
-                                context->getInputBuffer<int32_t>(kInputTensor2),
-                                context->getInputShape(kInputTensor2),
-                                context->getInputValue<int32_t>(kActivationScalar),
-                                context->getOutputBuffer<int32_t>(kOutputTensor),
-                                context->getOutputShape(kOutputTensor),
-                                [](int32_t a, int32_t b) { return a * b; });
+            return executeInt32(context, mul);
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation MUL";
     }
@@ -550,48 +446,19 @@ bool executeMul(IOperationExecutionContext* context) {
 bool executeSub(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
     if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    NNTRACE_TRANS("executeSub");
+    const auto sub = [](auto a, auto b) { return a - b; };
     switch (context->getInputType(kInputTensor1)) {
         case OperandType::TENSOR_FLOAT16:
-            return subFloat16(context->getInputBuffer<_Float16>(kInputTensor1),
-                              context->getInputShape(kInputTensor1),
-                              context->getInputBuffer<_Float16>(kInputTensor2),
-                              context->getInputShape(kInputTensor2),
-                              context->getInputValue<int32_t>(kActivationScalar),
-                              context->getOutputBuffer<_Float16>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return executeFloat<_Float16>(context, sub);
         case OperandType::TENSOR_FLOAT32:
-            return subFloat32(context->getInputBuffer<float>(kInputTensor1),
-                              context->getInputShape(kInputTensor1),
-                              context->getInputBuffer<float>(kInputTensor2),
-                              context->getInputShape(kInputTensor2),
-                              context->getInputValue<int32_t>(kActivationScalar),
-                              context->getOutputBuffer<float>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return executeFloat<float>(context, sub);
         case OperandType::TENSOR_QUANT8_ASYMM:
-            return subQuant8(context->getInputBuffer<uint8_t>(kInputTensor1),
-                             context->getInputShape(kInputTensor1),
-                             context->getInputBuffer<uint8_t>(kInputTensor2),
-                             context->getInputShape(kInputTensor2),
-                             context->getInputValue<int32_t>(kActivationScalar),
-                             context->getOutputBuffer<uint8_t>(kOutputTensor),
-                             context->getOutputShape(kOutputTensor));
+            return executeAddQuant8<uint8_t>(context, &getSubQuant8Params<uint8_t>);
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
-            return subQuant8(context->getInputBuffer<int8_t>(kInputTensor1),
-                             context->getInputShape(kInputTensor1),
-                             context->getInputBuffer<int8_t>(kInputTensor2),
-                             context->getInputShape(kInputTensor2),
-                             context->getInputValue<int32_t>(kActivationScalar),
-                             context->getOutputBuffer<int8_t>(kOutputTensor),
-                             context->getOutputShape(kOutputTensor));
+            return executeAddQuant8<int8_t>(context, &getSubQuant8Params<int8_t>);
         case OperandType::TENSOR_INT32:
-            return executeInt32(context->getInputBuffer<int32_t>(kInputTensor1),
-                                context->getInputShape(kInputTensor1),
-                                context->getInputBuffer<int32_t>(kInputTensor2),
-                                context->getInputShape(kInputTensor2),
-                                context->getInputValue<int32_t>(kActivationScalar),
-                                context->getOutputBuffer<int32_t>(kOutputTensor),
-                                context->getOutputShape(kOutputTensor),
-                                [](int32_t a, int32_t b) { return a - b; });
+            return executeInt32(context, sub);
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation SUB";
     }
@@ -600,40 +467,23 @@ bool executeSub(IOperationExecutionContext* context) {
 bool executeDiv(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
     if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    NNTRACE_TRANS("executeDiv");
     switch (context->getInputType(kInputTensor1)) {
         case OperandType::TENSOR_FLOAT16:
-            return divFloat16(context->getInputBuffer<_Float16>(kInputTensor1),
-                              context->getInputShape(kInputTensor1),
-                              context->getInputBuffer<_Float16>(kInputTensor2),
-                              context->getInputShape(kInputTensor2),
-                              context->getInputValue<int32_t>(kActivationScalar),
-                              context->getOutputBuffer<_Float16>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return executeFloat<_Float16>(context, [](float a, float b) { return a / b; });
         case OperandType::TENSOR_FLOAT32:
-            return divFloat32(context->getInputBuffer<float>(kInputTensor1),
-                              context->getInputShape(kInputTensor1),
-                              context->getInputBuffer<float>(kInputTensor2),
-                              context->getInputShape(kInputTensor2),
-                              context->getInputValue<int32_t>(kActivationScalar),
-                              context->getOutputBuffer<float>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return executeFloat<float>(context, [](float a, float b) { return a / b; });
         case OperandType::TENSOR_INT32:
-            return executeInt32(context->getInputBuffer<int32_t>(kInputTensor1),
-                                context->getInputShape(kInputTensor1),
-                                context->getInputBuffer<int32_t>(kInputTensor2),
-                                context->getInputShape(kInputTensor2),
-                                context->getInputValue<int32_t>(kActivationScalar),
-                                context->getOutputBuffer<int32_t>(kOutputTensor),
-                                context->getOutputShape(kOutputTensor), [](int32_t a, int32_t b) {
-                                    // In NNAPI, DIV by zero is undefined, but should not crash.
-                                    if (b == 0) return 0;
-                                    int32_t result = a / b;
-                                    if (a % b != 0 && ((a < 0) != (b < 0))) {
-                                        // Implement "floor division".
-                                        --result;
-                                    }
-                                    return result;
-                                });
+            return executeInt32(context, [](int32_t a, int32_t b) {
+                // In NNAPI, DIV by zero is undefined, but should not crash.
+                if (b == 0) return 0;
+                int32_t result = a / b;
+                if (a % b != 0 && ((a < 0) != (b < 0))) {
+                    // Implement "floor division".
+                    --result;
+                }
+                return result;
+            });
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation DIV";
     }
@@ -643,13 +493,17 @@ bool executeDiv(IOperationExecutionContext* context) {
 }  // namespace broadcast
 
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(ADD, broadcast::prepare, broadcast::executeAdd,
-                                         .allowZeroSizedInput = true);
+                                         .allowZeroSizedInput = true,
+                                         .allowInPlaceExecution = true);
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(MUL, broadcast::prepare, broadcast::executeMul,
-                                         .allowZeroSizedInput = true);
+                                         .allowZeroSizedInput = true,
+                                         .allowInPlaceExecution = true);
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(SUB, broadcast::prepare, broadcast::executeSub,
-                                         .allowZeroSizedInput = true);
+                                         .allowZeroSizedInput = true,
+                                         .allowInPlaceExecution = true);
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(DIV, broadcast::prepare, broadcast::executeDiv,
-                                         .allowZeroSizedInput = true);
+                                         .allowZeroSizedInput = true,
+                                         .allowInPlaceExecution = true);
 
 }  // namespace nn
 }  // namespace android
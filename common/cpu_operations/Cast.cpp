@@ -18,9 +18,8 @@
 
 #include "Cast.h"
 
-#include <algorithm>
-
 #include "Operations.h"
+#include "OperationsExecutionUtils.h"
 #include "Tracing.h"
 
 namespace android {
@@ -29,25 +28,14 @@ namespace cast {
 
 namespace {
 
-template <typename FromT, typename ToT>
-void copyCast(const FromT* in, ToT* out, int numElements) {
-    std::transform(in, in + numElements, out, [](FromT a) -> ToT {
-        if constexpr (std::is_same_v<ToT, uint8_t>) {
-            if (a < 0) return 0;
-            if (a > 255) return 255;
-        }
-        return static_cast<ToT>(a);
-    });
-}
-
 template <typename FromT>
 bool copyToTensor(const FromT* inputData, int numElements, uint8_t* outputData,
                   const Shape& outputShape) {
-#define ANDROID_NN_COPY_CAST(operandType, dataType)                                \
-    case operandType: {                                                            \
-        NNTRACE_COMP("cast::copyCast::" #dataType);                                \
-        copyCast(inputData, reinterpret_cast<dataType*>(outputData), numElements); \
-        return true;                                                               \
+#define ANDROID_NN_COPY_CAST(operandType, dataType)                                    \
+    case operandType: {                                                                \
+        NNTRACE_COMP("cast::castElements::" #dataType);                                \
+        castElements(inputData, numElements, reinterpret_cast<dataType*>(outputData)); \
+        return true;                                                                   \
     }
 
     switch (outputShape.type) {
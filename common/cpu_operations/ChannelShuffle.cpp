@@ -26,6 +26,8 @@ namespace android {
 namespace nn {
 namespace channel_shuffle {
 
+// The output is the input with the axis split into [numGroups, groupSize] and those two
+// dimensions transposed.
 template <typename T>
 inline bool eval(const T* inputData, const Shape& inputShape, int32_t numGroups, int32_t axis,
                  T* outputData) {
@@ -34,18 +36,11 @@ inline bool eval(const T* inputData, const Shape& inputShape, int32_t numGroups,
     const uint32_t innerSize =
             getNumberOfElements(inputShape, axis + 1, getNumberOfDimensions(inputShape));
     const uint32_t groupSize = axisSize / numGroups;
-    for (uint32_t outer = 0; outer < outerSize; ++outer) {
-        for (uint32_t inner = 0; inner < innerSize; ++inner) {
-            const T* inputBase = inputData + outer * axisSize * innerSize + inner;
-            T* outputBase = outputData + outer * axisSize * innerSize + inner;
-            for (uint32_t i = 0; i < groupSize; i++) {
-                for (uint32_t j = 0; j < static_cast<uint32_t>(numGroups);
-                     j++, outputBase += innerSize) {
-                    *outputBase = inputBase[innerSize * (i + j * groupSize)];
-                }
-            }
-        }
-    }
+    const int64_t channelStride = static_cast<int64_t>(innerSize) * sizeof(T);
+    const int64_t outerStride = axisSize * channelStride;
+    stridedCopy(inputData, {outerStride, groupSize * channelStride, channelStride, sizeof(T)},
+                outputData, {outerStride, channelStride, numGroups * channelStride, sizeof(T)},
+                {outerSize, static_cast<uint32_t>(numGroups), groupSize, innerSize}, sizeof(T));
     return true;
 }
 
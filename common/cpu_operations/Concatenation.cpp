@@ -19,7 +19,11 @@
 #include "Concatenation.h"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <vector>
 
 #include "OperationResolver.h"
@@ -68,29 +72,18 @@ bool concatenation(const std::vector<const T*>& inputDataPtrs,
     return true;
 }
 
-template <>
-bool concatenation<uint8_t>(const std::vector<const uint8_t*>& inputDataPtrs,
-                            const std::vector<Shape>& inputShapes, int32_t axis,
-                            uint8_t* outputData, const Shape& outputShape) {
-    NNTRACE_TRANS("concatenationQuant8");
-    int num_inputs = inputShapes.size();
-    std::vector<float> inputScales(num_inputs);
-    std::vector<int32> inputOffsets(num_inputs);
-    std::vector<tflite::Dims<4>*> inputDimsPtr(num_inputs);
-    std::vector<tflite::Dims<4>> inputDims(num_inputs);
-    for (int i = 0; i < num_inputs; i++) {
-        inputScales[i] = inputShapes[i].scale;
-        inputOffsets[i] = inputShapes[i].offset;
-        inputDims[i] = convertShapeToDims(inputShapes[i]);
-        inputDimsPtr[i] = &inputDims[i];
+// Whether each input already sits in its slice of the output, which is the case when the executor
+// had the producers of the inputs write straight into the output buffer.
+template <typename T>
+bool isAlreadyConcatenated(const std::vector<const T*>& inputDataPtrs,
+                           const std::vector<Shape>& inputShapes, int32_t axis, const T* outputData,
+                           const Shape& outputShape) {
+    if (getNumberOfElements(outputShape, 0, axis) != 1) return false;
+    const T* slice = outputData;
+    for (size_t i = 0; i < inputDataPtrs.size(); ++i) {
+        if (inputDataPtrs[i] != slice) return false;
+        slice += getNumberOfElements(inputShapes[i]);
     }
-
-    NNTRACE_COMP_SWITCH("reference_ops::Concatenation");
-    tflite::reference_ops::Concatenation(
-            getNumberOfDimensions(outputShape) - axis - 1, inputDataPtrs.data(),
-            inputDimsPtr.data(), inputOffsets.data(), inputScales.data(), num_inputs, outputData,
-            convertShapeToDims(outputShape), outputShape.offset, outputShape.scale);
-
     return true;
 }
 
@@ -105,38 +98,120 @@ inline bool concatenation(IOperationExecutionContext* context) {
         inputDatas.push_back(buffer);
         inputShapes.push_back(context->getInputShape(i));
     }
-    return concatenation(inputDatas, inputShapes, context->getInputValue<int32_t>(inputCount),
-                         context->getOutputBuffer<T>(kOutputTensor),
-                         context->getOutputShape(kOutputTensor));
+    const int32_t axis = context->getInputValue<int32_t>(inputCount);
+    T* outputData = context->getOutputBuffer<T>(kOutputTensor);
+    const Shape outputShape = context->getOutputShape(kOutputTensor);
+    if (isAlreadyConcatenated(inputDatas, inputShapes, axis, outputData, outputShape)) {
+        return true;
+    }
+    return concatenation(inputDatas, inputShapes, axis, outputData, outputShape);
 }
 
-template <>
-inline bool concatenation<int8_t>(IOperationExecutionContext* context) {
-    uint32_t inputCount = context->getNumInputs() - 1;
-    std::vector<std::vector<uint8_t>> inputs_uint8(inputCount);
-    for (uint32_t i = 0; i < inputCount; ++i) {
-        const auto currentSize = getNumberOfElements(context->getInputShape(i));
-        inputs_uint8[i].resize(currentSize);
-        if (currentSize != 0) {
-            convertInt8ToUInt8(context->getInputBuffer<int8_t>(i), &inputs_uint8[i]);
+// Rescaling of a quantized CONCATENATION, kept on the prepared model together with the
+// quantization it was derived from. An input that does not share the quantization of the output
+// gets a table with the rescaled value of each of its 256 possible values.
+template <typename T>
+struct ConcatenationQuant8State : public OperationState {
+    std::vector<float> scales;
+    std::vector<int32_t> offsets;
+    std::vector<bool> sameQuantization;
+    std::vector<std::array<T, 256>> rescaleTables;
+
+    bool matches(IOperationExecutionContext* context, uint32_t inputCount) const {
+        if (scales.size() != inputCount + 1) return false;
+        for (uint32_t i = 0; i <= inputCount; ++i) {
+            const Shape shape = i < inputCount ? context->getInputShape(i)
+                                               : context->getOutputShape(kOutputTensor);
+            if (scales[i] != shape.scale || offsets[i] != shape.offset) return false;
         }
+        return true;
     }
-    std::vector<const uint8_t*> inputDatas;
-    std::vector<Shape> inputShapes;
+};
+
+// Returns the index of value in a rescale table.
+template <typename T>
+uint32_t getRescaleIndex(T value) {
+    return static_cast<int32_t>(value) - std::numeric_limits<T>::min();
+}
+
+// Fills the rescale table of an input with what tflite::reference_ops::Concatenation computes,
+// round(x * scale + bias) in float, on uint8_t values: int8_t values and zero points are shifted
+// by 128 as they were before the table, so that the results do not change.
+template <typename T>
+void fillRescaleTable(const Shape& inputShape, const Shape& outputShape,
+                      std::array<T, 256>* table) {
+    const int32_t shift = -std::numeric_limits<T>::min();
+    const float scale = inputShape.scale * (1.f / outputShape.scale);
+    const float bias = -(inputShape.offset + shift) * scale;
+    for (uint32_t index = 0; index < table->size(); ++index) {
+        const int32_t value = static_cast<int32_t>(std::round(index * scale + bias)) +
+                              outputShape.offset + shift;
+        (*table)[index] = static_cast<T>(std::clamp(value, 0, 255) - shift);
+    }
+}
+
+template <typename T>
+std::shared_ptr<const ConcatenationQuant8State<T>> getConcatenationQuant8State(
+        IOperationExecutionContext* context, uint32_t inputCount) {
+    auto state = context->getCachedState<ConcatenationQuant8State<T>>();
+    if (state != nullptr && state->matches(context, inputCount)) {
+        return state;
+    }
+    const Shape outputShape = context->getOutputShape(kOutputTensor);
+    auto newState = std::make_shared<ConcatenationQuant8State<T>>();
+    newState->sameQuantization.resize(inputCount);
+    newState->rescaleTables.resize(inputCount);
     for (uint32_t i = 0; i < inputCount; ++i) {
-        inputDatas.push_back(inputs_uint8[i].data());
-        inputShapes.push_back(context->getInputShape(i));
-        inputShapes[i].offset += 128;
+        const Shape inputShape = context->getInputShape(i);
+        newState->scales.push_back(inputShape.scale);
+        newState->offsets.push_back(inputShape.offset);
+        newState->sameQuantization[i] =
+                inputShape.scale == outputShape.scale && inputShape.offset == outputShape.offset;
+        if (!newState->sameQuantization[i]) {
+            fillRescaleTable(inputShape, outputShape, &newState->rescaleTables[i]);
+        }
     }
+    newState->scales.push_back(outputShape.scale);
+    newState->offsets.push_back(outputShape.offset);
+    context->setCachedState(newState);
+    return newState;
+}
 
-    std::vector<uint8_t> output_uint8(getNumberOfElements(context->getOutputShape(kOutputTensor)));
-    Shape outputShape(context->getOutputShape(kOutputTensor));
-    outputShape.offset += 128;
-    NN_RET_CHECK(concatenation(inputDatas, inputShapes, context->getInputValue<int32_t>(inputCount),
-                               output_uint8.data(), outputShape));
+// Inputs that share the quantization of the output are copied as they are, the others are
+// rescaled through their table.
+template <typename T>
+bool concatenationQuant8(IOperationExecutionContext* context) {
+    NNTRACE_TRANS("concatenationQuant8");
+    const uint32_t inputCount = context->getNumInputs() - 1;
+    const auto state = getConcatenationQuant8State<T>(context, inputCount);
 
-    convertUInt8ToInt8(output_uint8, context->getOutputBuffer<int8_t>(kOutputTensor));
+    const Shape outputShape = context->getOutputShape(kOutputTensor);
+    const int32_t axis = context->getInputValue<int32_t>(inputCount);
+    const uint32_t outerSize = getNumberOfElements(outputShape, 0, axis);
+    const uint32_t innerSize =
+            getNumberOfElements(outputShape, axis + 1, getNumberOfDimensions(outputShape));
+    T* outputData = context->getOutputBuffer<T>(kOutputTensor);
 
+    NNTRACE_COMP_SWITCH("rescale");
+    for (uint32_t outer = 0; outer < outerSize; ++outer) {
+        for (uint32_t i = 0; i < inputCount; ++i) {
+            const uint32_t copySize =
+                    getSizeOfDimension(context->getInputShape(i), axis) * innerSize;
+            if (copySize == 0) continue;
+            const T* inputData = context->getInputBuffer<T>(i) + outer * copySize;
+            if (state->sameQuantization[i]) {
+                // The input may already have been written in place by its producer.
+                if (inputData != outputData) {
+                    std::copy(inputData, inputData + copySize, outputData);
+                }
+            } else {
+                const std::array<T, 256>& table = state->rescaleTables[i];
+                std::transform(inputData, inputData + copySize, outputData,
+                               [&table](T value) { return table[getRescaleIndex(value)]; });
+            }
+            outputData += copySize;
+        }
+    }
     return true;
 }
 
@@ -182,9 +257,9 @@ bool execute(IOperationExecutionContext* context) {
         case OperandType::TENSOR_FLOAT32:
             return concatenation<float>(context);
         case OperandType::TENSOR_QUANT8_ASYMM:
-            return concatenation<uint8_t>(context);
+            return concatenationQuant8<uint8_t>(context);
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
-            return concatenation<int8_t>(context);
+            return concatenationQuant8<int8_t>(context);
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation " << kOperationName;
     }
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "OperationTestUtils.h"
+
+namespace android {
+namespace nn {
+namespace {
+
+// What tflite::reference_ops::Concatenation computes for an element of an input whose
+// quantization differs from that of the output. It runs on uint8_t, so int8_t values and zero
+// points are shifted by 128.
+template <typename T>
+T rescaleReference(T value, float inputScale, int32_t inputZeroPoint, float outputScale,
+                   int32_t outputZeroPoint) {
+    const int32_t shift = -std::numeric_limits<T>::min();
+    const float scale = inputScale * (1.f / outputScale);
+    const float bias = -(inputZeroPoint + shift) * scale;
+    const int32_t result =
+            static_cast<int32_t>(std::round((value + shift) * scale + bias)) + outputZeroPoint +
+            shift;
+    return static_cast<T>(std::max(std::min(255, result), 0) - shift);
+}
+
+// Concatenates along axis 0 an input quantized as (inputScale, inputZeroPoint) with one that
+// shares the quantization of the output, and returns the output.
+template <typename T>
+std::vector<T> concatenate(OperandType type, const std::vector<T>& input, float inputScale,
+                           int32_t inputZeroPoint, const std::vector<T>& other, float outputScale,
+                           int32_t outputZeroPoint) {
+    std::vector<TestOperand> inputs = {makeTensor(type, input, inputZeroPoint),
+                                       makeTensor(type, other, outputZeroPoint), makeScalar(0)};
+    inputs[0].shape.scale = inputScale;
+    inputs[1].shape.scale = outputScale;
+    const Shape outputShape = {.type = type, .scale = outputScale, .offset = outputZeroPoint};
+    TestContext context(std::move(inputs), outputShape, sizeof(T), /*constantInputs=*/false,
+                        /*cache=*/nullptr);
+    EXPECT_TRUE(runOperation(OperationType::CONCATENATION, &context));
+    return context.getOutput<T>();
+}
+
+template <typename T>
+void expectMatchesReference(OperandType type, float inputScale, int32_t inputZeroPoint,
+                            float outputScale, int32_t outputZeroPoint) {
+    std::vector<T> input;
+    std::vector<T> expected;
+    for (int32_t value = std::numeric_limits<T>::min(); value <= std::numeric_limits<T>::max();
+         ++value) {
+        input.push_back(value);
+        expected.push_back(rescaleReference<T>(value, inputScale, inputZeroPoint, outputScale,
+                                               outputZeroPoint));
+    }
+    const std::vector<T> other = {std::numeric_limits<T>::min(), 0, std::numeric_limits<T>::max()};
+    expected.insert(expected.end(), other.begin(), other.end());
+    EXPECT_EQ(concatenate(type, input, inputScale, inputZeroPoint, other, outputScale,
+                          outputZeroPoint),
+              expected);
+}
+
+// Every value of the input is rescaled as the reference does, including those halfway between two
+// output values, which are rounded away from zero.
+
+TEST(ConcatenationTest, Quant8Asymm) {
+    expectMatchesReference<uint8_t>(OperandType::TENSOR_QUANT8_ASYMM, 1.0f, 10, 2.0f, 0);
+    expectMatchesReference<uint8_t>(OperandType::TENSOR_QUANT8_ASYMM, 0.5f, 128, 0.25f, 100);
+    expectMatchesReference<uint8_t>(OperandType::TENSOR_QUANT8_ASYMM, 0.3f, 3, 0.7f, 127);
+    EXPECT_EQ(concatenate<uint8_t>(OperandType::TENSOR_QUANT8_ASYMM, {9, 11, 13}, 1.0f, 10, {},
+                                   2.0f, 0),
+              (std::vector<uint8_t>{0, 1, 2}));
+}
+
+TEST(ConcatenationTest, Quant8AsymmSigned) {
+    expectMatchesReference<int8_t>(OperandType::TENSOR_QUANT8_ASYMM_SIGNED, 1.0f, 0, 2.0f, 0);
+    expectMatchesReference<int8_t>(OperandType::TENSOR_QUANT8_ASYMM_SIGNED, 0.5f, -28, 0.25f, 5);
+    expectMatchesReference<int8_t>(OperandType::TENSOR_QUANT8_ASYMM_SIGNED, 1.5f, 72, 0.7f, -1);
+    EXPECT_EQ(concatenate<int8_t>(OperandType::TENSOR_QUANT8_ASYMM_SIGNED, {-3, -1, 1, 3}, 1.0f, 0,
+                                  {}, 2.0f, 0),
+              (std::vector<int8_t>{-2, -1, 1, 2}));
+}
+
+}  // namespace
+}  // namespace nn
+}  // namespace android
@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <iterator>
 #include <memory>
+#include <type_traits>
 #include <vector>
 
 #include "LegacyUtils.h"
@@ -40,6 +41,7 @@
 #pragma clang diagnostic pop
 
 #include "CpuOperationUtils.h"
+#include "QuantUtils.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -300,32 +302,6 @@ bool convNhwc(const int8_t* inputData, Shape inputShape, const int8_t* filterDat
     return true;
 }
 
-bool convNhwc(const _Float16* inputData, const Shape& inputShape, const _Float16* filterData,
-              const Shape& filterShape, const _Float16* biasData, const Shape& biasShape,
-              int32_t padding_left, int32_t padding_right, int32_t padding_top,
-              int32_t padding_bottom, int32_t stride_width, int32_t stride_height,
-              int32_t dilation_width_factor, int32_t dilation_height_factor, int32_t activation,
-              _Float16* outputData, const Shape& outputShape) {
-    NNTRACE_TRANS("convFloat16");
-
-    std::vector<float> inputData_float32(getNumberOfElements(inputShape));
-    std::vector<float> filterData_float32(getNumberOfElements(filterShape));
-    std::vector<float> biasData_float32(getNumberOfElements(biasShape));
-    std::vector<float> outputData_float32(getNumberOfElements(outputShape));
-
-    convertFloat16ToFloat32(inputData, &inputData_float32);
-    convertFloat16ToFloat32(filterData, &filterData_float32);
-    convertFloat16ToFloat32(biasData, &biasData_float32);
-
-    convNhwc(inputData_float32.data(), inputShape, filterData_float32.data(), filterShape,
-             biasData_float32.data(), biasShape, padding_left, padding_right, padding_top,
-             padding_bottom, stride_width, stride_height, dilation_width_factor,
-             dilation_height_factor, activation, outputData_float32.data(), outputShape);
-    convertFloat32ToFloat16(outputData_float32, outputData);
-
-    return true;
-}
-
 template <typename T_Input, typename T_Filter, typename T_Bias>
 bool conv(const T_Input* inputData, const Shape& inputShape, const T_Filter* filterData,
           const Shape& filterShape, const T_Bias* biasData, const Shape& biasShape,
@@ -346,14 +322,450 @@ bool conv(const T_Input* inputData, const Shape& inputShape, const T_Filter* fil
     return true;
 }
 
+// Minimum number of multiply-accumulates assigned to one thread.
+constexpr uint32_t kMinMacsPerThread = 64 * 1024;
+
+// Float convolution algorithms.
+//
+// kIm2colGemm: tflite::optimized_ops::Conv, which expands the input patches into a matrix and
+//     multiplies it with the filter. It handles every configuration, but shares a static scratch
+//     buffer and therefore runs one convolution at a time.
+// kDirect: accumulates every filter tap straight from the input, parallelized over output rows.
+//     Used where building the patch matrix is pure overhead: 1x1 filters, and very shallow
+//     inputs such as the RGB image read by the first layer of a network.
+// kWinograd: Winograd F(2x2, 3x3), which produces each 2x2 output tile with 16 instead of 36
+//     multiplications per input and output channel pair. Used for 3x3 filters with stride 1 and
+//     no dilation once there are enough channels to amortize the input and output transforms.
+enum class ConvAlgorithm { kIm2colGemm, kDirect, kWinograd };
+
+const char* getAlgorithmName(ConvAlgorithm algorithm) {
+    switch (algorithm) {
+        case ConvAlgorithm::kIm2colGemm:
+            return "im2col-GEMM";
+        case ConvAlgorithm::kDirect:
+            return "direct";
+        case ConvAlgorithm::kWinograd:
+            return "Winograd F(2x2,3x3)";
+    }
+    return "unknown";
+}
+
+// Input depth up to which the direct algorithm is used for any filter size.
+constexpr uint32_t kMaxDirectInputDepth = 4;
+// Minimum number of input and output channels for the Winograd algorithm.
+constexpr uint32_t kMinWinogradDepth = 8;
+
+ConvAlgorithm chooseConvAlgorithm(const Shape& filterShape, const Conv2dParam& param) {
+    const uint32_t outDepth = getSizeOfDimension(filterShape, 0);
+    const uint32_t filterHeight = getSizeOfDimension(filterShape, 1);
+    const uint32_t filterWidth = getSizeOfDimension(filterShape, 2);
+    const uint32_t inDepth = getSizeOfDimension(filterShape, 3);
+    const bool unitStride = param.stride_width == 1 && param.stride_height == 1;
+    const bool unitDilation =
+            param.dilation_width_factor == 1 && param.dilation_height_factor == 1;
+    if (filterHeight == 3 && filterWidth == 3 && unitStride && unitDilation &&
+        inDepth >= kMinWinogradDepth && outDepth >= kMinWinogradDepth) {
+        return ConvAlgorithm::kWinograd;
+    }
+    if ((filterHeight == 1 && filterWidth == 1) || inDepth <= kMaxDirectInputDepth) {
+        return ConvAlgorithm::kDirect;
+    }
+    return ConvAlgorithm::kIm2colGemm;
+}
+
+// The algorithm chosen for a float convolution, and its filter in the layout that algorithm
+// reads, converted to float32:
+// - kIm2colGemm: the filter as given, [outDepth][filterHeight][filterWidth][inDepth]. Left empty
+//   for a float32 filter, which is read in place.
+// - kDirect: [filterHeight][filterWidth][inDepth][outDepth].
+// - kWinograd: the 4x4 transformed filter, [16][inDepth][outDepth].
+struct ConvFloatState : public OperationState {
+    Shape filterShape;
+    int32_t strideWidth, strideHeight;
+    int32_t dilationWidthFactor, dilationHeightFactor;
+    ConvAlgorithm algorithm;
+    std::vector<float> filter;
+
+    bool matches(const Shape& otherFilterShape, const Conv2dParam& param) const {
+        return filterShape.type == otherFilterShape.type &&
+               filterShape.dimensions == otherFilterShape.dimensions &&
+               strideWidth == param.stride_width && strideHeight == param.stride_height &&
+               dilationWidthFactor == param.dilation_width_factor &&
+               dilationHeightFactor == param.dilation_height_factor;
+    }
+};
+
+// Computes U = G g G^T for every 3x3 filter g, with
+//     G = [[1, 0, 0], [1/2, 1/2, 1/2], [1/2, -1/2, 1/2], [0, 0, 1]].
+void transformWinogradFilter(const float* filterData, uint32_t outDepth, uint32_t inDepth,
+                             float* transformedFilter) {
+    const uint32_t tileStride = inDepth * outDepth;
+    for (uint32_t oc = 0; oc < outDepth; ++oc) {
+        for (uint32_t ic = 0; ic < inDepth; ++ic) {
+            float g[3][3];
+            for (uint32_t y = 0; y < 3; ++y) {
+                for (uint32_t x = 0; x < 3; ++x) {
+                    g[y][x] = filterData[((oc * 3 + y) * 3 + x) * inDepth + ic];
+                }
+            }
+            float gg[4][3];
+            for (uint32_t x = 0; x < 3; ++x) {
+                gg[0][x] = g[0][x];
+                gg[1][x] = 0.5f * (g[0][x] + g[1][x] + g[2][x]);
+                gg[2][x] = 0.5f * (g[0][x] - g[1][x] + g[2][x]);
+                gg[3][x] = g[2][x];
+            }
+            for (uint32_t y = 0; y < 4; ++y) {
+                float* u = transformedFilter + (y * 4) * tileStride + ic * outDepth + oc;
+                u[0 * tileStride] = gg[y][0];
+                u[1 * tileStride] = 0.5f * (gg[y][0] + gg[y][1] + gg[y][2]);
+                u[2 * tileStride] = 0.5f * (gg[y][0] - gg[y][1] + gg[y][2]);
+                u[3 * tileStride] = gg[y][2];
+            }
+        }
+    }
+}
+
+// Returns the algorithm and prepared filter of a float convolution with a constant filter, cached
+// for the lifetime of the prepared model. Returns nullptr if the filter is not a constant, in which
+// case the convolution reads the filter buffer directly.
+template <typename T>
+std::shared_ptr<const ConvFloatState> getConvFloatState(IOperationExecutionContext* context,
+                                                        const Conv2dParam& param) {
+    if (!context->isConstantInput(kFilterTensor)) {
+        return nullptr;
+    }
+    const Shape filterShape = context->getInputShape(kFilterTensor);
+    auto cached = context->getCachedState<ConvFloatState>();
+    if (cached != nullptr && cached->matches(filterShape, param)) {
+        return cached;
+    }
+    auto state = std::make_shared<ConvFloatState>();
+    state->filterShape = filterShape;
+    state->strideWidth = param.stride_width;
+    state->strideHeight = param.stride_height;
+    state->dilationWidthFactor = param.dilation_width_factor;
+    state->dilationHeightFactor = param.dilation_height_factor;
+    state->algorithm = chooseConvAlgorithm(filterShape, param);
+
+    const T* filterData = context->getInputBuffer<T>(kFilterTensor);
+    std::vector<float> filterFloat32;
+    if constexpr (std::is_same_v<T, float>) {
+        filterFloat32.assign(filterData, filterData + getNumberOfElements(filterShape));
+    } else {
+        filterFloat32.resize(getNumberOfElements(filterShape));
+        convertFloat16ToFloat32(filterData, &filterFloat32);
+    }
+    const uint32_t outDepth = getSizeOfDimension(filterShape, 0);
+    const uint32_t filterSize =
+            getSizeOfDimension(filterShape, 1) * getSizeOfDimension(filterShape, 2);
+    const uint32_t inDepth = getSizeOfDimension(filterShape, 3);
+    switch (state->algorithm) {
+        case ConvAlgorithm::kIm2colGemm:
+            if constexpr (!std::is_same_v<T, float>) {
+                state->filter = std::move(filterFloat32);
+            }
+            break;
+        case ConvAlgorithm::kDirect:
+            state->filter.resize(filterFloat32.size());
+            for (uint32_t oc = 0; oc < outDepth; ++oc) {
+                for (uint32_t k = 0; k < filterSize; ++k) {
+                    for (uint32_t ic = 0; ic < inDepth; ++ic) {
+                        state->filter[(k * inDepth + ic) * outDepth + oc] =
+                                filterFloat32[(oc * filterSize + k) * inDepth + ic];
+                    }
+                }
+            }
+            break;
+        case ConvAlgorithm::kWinograd:
+            state->filter.resize(16 * inDepth * outDepth);
+            transformWinogradFilter(filterFloat32.data(), outDepth, inDepth,
+                                    state->filter.data());
+            break;
+    }
+    VLOG(CPUEXE) << kOperationName << " with filter " << toString(filterShape.dimensions)
+                 << ", stride " << param.stride_width << "x" << param.stride_height
+                 << ", dilation " << param.dilation_width_factor << "x"
+                 << param.dilation_height_factor << ": using "
+                 << getAlgorithmName(state->algorithm);
+    context->setCachedState(state);
+    return state;
+}
+
+// Direct convolution over NHWC tensors with a filter in [filterHeight][filterWidth][inDepth]
+// [outDepth] layout, so that the innermost loop updates all output channels of a pixel at once.
+void convDirectNhwc(const float* inputData, const Shape& inputShape, const float* filterData,
+                    uint32_t filterHeight, uint32_t filterWidth, const float* biasData,
+                    const Conv2dParam& param, float* outputData, const Shape& outputShape) {
+    NNTRACE_COMP("convDirectNhwc");
+    const int32_t inputHeight = getSizeOfDimension(inputShape, 1);
+    const int32_t inputWidth = getSizeOfDimension(inputShape, 2);
+    const uint32_t inDepth = getSizeOfDimension(inputShape, 3);
+    const uint32_t outputHeight = getSizeOfDimension(outputShape, 1);
+    const uint32_t outputWidth = getSizeOfDimension(outputShape, 2);
+    const uint32_t outDepth = getSizeOfDimension(outputShape, 3);
+    float activationMin, activationMax;
+    CalculateActivationRangeFloat(param.activation, &activationMin, &activationMax);
+
+    const uint32_t numRows = getSizeOfDimension(outputShape, 0) * outputHeight;
+    const uint32_t macsPerRow = std::max<uint32_t>(
+            1, outputWidth * outDepth * filterHeight * filterWidth * inDepth);
+    const uint32_t minRowsPerThread = std::max<uint32_t>(1, kMinMacsPerThread / macsPerRow);
+    parallelFor(numRows, minRowsPerThread, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+            const uint32_t batch = row / outputHeight;
+            const int32_t inYOrigin =
+                    static_cast<int32_t>(row % outputHeight) * param.stride_height -
+                    param.padding_top;
+            const float* inputBatch = inputData + batch * inputHeight * inputWidth * inDepth;
+            float* out = outputData + row * outputWidth * outDepth;
+            for (uint32_t outX = 0; outX < outputWidth; ++outX, out += outDepth) {
+                const int32_t inXOrigin =
+                        static_cast<int32_t>(outX) * param.stride_width - param.padding_left;
+                std::fill(out, out + outDepth, 0.0f);
+                for (uint32_t filterY = 0; filterY < filterHeight; ++filterY) {
+                    const int32_t inY = inYOrigin + filterY * param.dilation_height_factor;
+                    if (inY < 0 || inY >= inputHeight) continue;
+                    for (uint32_t filterX = 0; filterX < filterWidth; ++filterX) {
+                        const int32_t inX = inXOrigin + filterX * param.dilation_width_factor;
+                        if (inX < 0 || inX >= inputWidth) continue;
+                        const float* in = inputBatch + (inY * inputWidth + inX) * inDepth;
+                        const float* filter =
+                                filterData + (filterY * filterWidth + filterX) * inDepth * outDepth;
+                        for (uint32_t ic = 0; ic < inDepth; ++ic, filter += outDepth) {
+                            const float value = in[ic];
+                            for (uint32_t oc = 0; oc < outDepth; ++oc) {
+                                out[oc] += value * filter[oc];
+                            }
+                        }
+                    }
+                }
+                for (uint32_t oc = 0; oc < outDepth; ++oc) {
+                    out[oc] = std::min(std::max(out[oc] + biasData[oc], activationMin),
+                                       activationMax);
+                }
+            }
+        }
+    });
+}
+
+// Winograd F(2x2, 3x3) convolution over NHWC tensors with stride 1 and no dilation. Each row of
+// 2x2 output tiles is processed in blocks of kWinogradTileBlock tiles:
+// 1. V = B^T d B for the 4x4 input patch d of every tile, where
+//    B^T = [[1, 0, -1, 0], [0, 1, 1, 0], [0, -1, 1, 0], [0, 1, 0, -1]];
+// 2. M = V U summed over input channels, for each of the 16 positions, where U is the
+//    transformed filter, so that each row of U is reused across the tiles of the block;
+// 3. Y = A^T M A, where A^T = [[1, 1, 1, 0], [0, 1, -1, -1]].
+constexpr uint32_t kWinogradTileBlock = 8;
+
+void convWinogradNhwc(const float* inputData, const Shape& inputShape,
+                      const float* transformedFilter, const float* biasData,
+                      const Conv2dParam& param, float* outputData, const Shape& outputShape) {
+    NNTRACE_COMP("convWinogradNhwc");
+    const int32_t inputHeight = getSizeOfDimension(inputShape, 1);
+    const int32_t inputWidth = getSizeOfDimension(inputShape, 2);
+    const uint32_t inDepth = getSizeOfDimension(inputShape, 3);
+    const uint32_t outputHeight = getSizeOfDimension(outputShape, 1);
+    const uint32_t outputWidth = getSizeOfDimension(outputShape, 2);
+    const uint32_t outDepth = getSizeOfDimension(outputShape, 3);
+    const uint32_t tileRows = (outputHeight + 1) / 2;
+    const uint32_t tileCols = (outputWidth + 1) / 2;
+    float activationMin, activationMax;
+    CalculateActivationRangeFloat(param.activation, &activationMin, &activationMax);
+
+    const uint32_t numTileRows = getSizeOfDimension(outputShape, 0) * tileRows;
+    const uint32_t macsPerTileRow = std::max<uint32_t>(1, tileCols * 16 * inDepth * outDepth);
+    const uint32_t minTileRowsPerThread =
+            std::max<uint32_t>(1, kMinMacsPerThread / macsPerTileRow);
+    parallelFor(numTileRows, minTileRowsPerThread, [&](uint32_t tileRowBegin,
+                                                       uint32_t tileRowEnd) {
+        // v[position][tile][ic] and m[position][tile][oc] for one block of tiles.
+        std::vector<float> v(16 * kWinogradTileBlock * inDepth);
+        std::vector<float> m(16 * kWinogradTileBlock * outDepth);
+        for (uint32_t tileRow = tileRowBegin; tileRow < tileRowEnd; ++tileRow) {
+            const uint32_t batch = tileRow / tileRows;
+            const uint32_t outY = (tileRow % tileRows) * 2;
+            const int32_t inYOrigin = static_cast<int32_t>(outY) - param.padding_top;
+            const float* inputBatch = inputData + batch * inputHeight * inputWidth * inDepth;
+            float* outputBatch = outputData + batch * outputHeight * outputWidth * outDepth;
+            for (uint32_t tileBegin = 0; tileBegin < tileCols; tileBegin += kWinogradTileBlock) {
+                const uint32_t numTiles = std::min(kWinogradTileBlock, tileCols - tileBegin);
+
+                // Input transform.
+                for (uint32_t t = 0; t < numTiles; ++t) {
+                    const int32_t inXOrigin =
+                            static_cast<int32_t>((tileBegin + t) * 2) - param.padding_left;
+                    const float* d[4][4];
+                    for (int32_t y = 0; y < 4; ++y) {
+                        for (int32_t x = 0; x < 4; ++x) {
+                            const int32_t inY = inYOrigin + y, inX = inXOrigin + x;
+                            const bool inside = inY >= 0 && inY < inputHeight && inX >= 0 &&
+                                                inX < inputWidth;
+                            d[y][x] = inside ? inputBatch + (inY * inputWidth + inX) * inDepth
+                                             : nullptr;
+                        }
+                    }
+                    float* vt = v.data() + t * inDepth;
+                    const uint32_t positionStride = kWinogradTileBlock * inDepth;
+                    for (uint32_t ic = 0; ic < inDepth; ++ic) {
+                        float p[4][4];
+                        for (uint32_t y = 0; y < 4; ++y) {
+                            for (uint32_t x = 0; x < 4; ++x) {
+                                p[y][x] = d[y][x] != nullptr ? d[y][x][ic] : 0.0f;
+                            }
+                        }
+                        float q[4][4];
+                        for (uint32_t x = 0; x < 4; ++x) {
+                            q[0][x] = p[0][x] - p[2][x];
+                            q[1][x] = p[1][x] + p[2][x];
+                            q[2][x] = p[2][x] - p[1][x];
+                            q[3][x] = p[1][x] - p[3][x];
+                        }
+                        for (uint32_t y = 0; y < 4; ++y) {
+                            float* out = vt + (y * 4) * positionStride + ic;
+                            out[0 * positionStride] = q[y][0] - q[y][2];
+                            out[1 * positionStride] = q[y][1] + q[y][2];
+                            out[2 * positionStride] = q[y][2] - q[y][1];
+                            out[3 * positionStride] = q[y][1] - q[y][3];
+                        }
+                    }
+                }
+
+                // Element-wise product, summed over input channels.
+                std::fill(m.begin(), m.end(), 0.0f);
+                for (uint32_t position = 0; position < 16; ++position) {
+                    const float* u = transformedFilter + position * inDepth * outDepth;
+                    const float* vp = v.data() + position * kWinogradTileBlock * inDepth;
+                    float* mp = m.data() + position * kWinogradTileBlock * outDepth;
+                    for (uint32_t ic = 0; ic < inDepth; ++ic, u += outDepth) {
+                        for (uint32_t t = 0; t < numTiles; ++t) {
+                            const float value = vp[t * inDepth + ic];
+                            float* mt = mp + t * outDepth;
+                            for (uint32_t oc = 0; oc < outDepth; ++oc) {
+                                mt[oc] += value * u[oc];
+                            }
+                        }
+                    }
+                }
+
+                // Output transform.
+                const uint32_t positionStride = kWinogradTileBlock * outDepth;
+                for (uint32_t t = 0; t < numTiles; ++t) {
+                    const uint32_t outX = (tileBegin + t) * 2;
+                    const bool hasSecondRow = outY + 1 < outputHeight;
+                    const bool hasSecondCol = outX + 1 < outputWidth;
+                    float* out = outputBatch + (outY * outputWidth + outX) * outDepth;
+                    const float* mt = m.data() + t * outDepth;
+                    for (uint32_t oc = 0; oc < outDepth; ++oc) {
+                        float r[2][4];
+                        for (uint32_t x = 0; x < 4; ++x) {
+                            const float m0 = mt[(0 * 4 + x) * positionStride + oc];
+                            const float m1 = mt[(1 * 4 + x) * positionStride + oc];
+                            const float m2 = mt[(2 * 4 + x) * positionStride + oc];
+                            const float m3 = mt[(3 * 4 + x) * positionStride + oc];
+                            r[0][x] = m0 + m1 + m2;
+                            r[1][x] = m1 - m2 - m3;
+                        }
+                        for (uint32_t y = 0; y < 2; ++y) {
+                            if (y == 1 && !hasSecondRow) break;
+                            float* outRow = out + y * outputWidth * outDepth;
+                            const float y0 = r[y][0] + r[y][1] + r[y][2] + biasData[oc];
+                            outRow[oc] = std::min(std::max(y0, activationMin), activationMax);
+                            if (hasSecondCol) {
+                                const float y1 = r[y][1] - r[y][2] - r[y][3] + biasData[oc];
+                                outRow[outDepth + oc] =
+                                        std::min(std::max(y1, activationMin), activationMax);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+// Runs a float32 or float16 convolution with the algorithm chosen in state, or with im2col and GEMM
+// on filterData if state is nullptr. Float16 tensors are computed in float32.
+template <typename T>
+bool convFloat(const T* inputData, const Shape& inputShape, const T* filterData,
+               const Shape& filterShape, const T* biasData, const Shape& biasShape,
+               const Conv2dParam& param, const ConvFloatState* state, T* outputData,
+               const Shape& outputShape) {
+    NNTRACE_TRANS("convFloat");
+    InputWithLayout<T> input(param.useNchw);
+    OutputWithLayout<T> output(param.useNchw);
+    NN_RET_CHECK(input.initialize(inputData, inputShape));
+    NN_RET_CHECK(output.initialize(outputData, outputShape));
+    const Shape& nhwcInputShape = input.getNhwcShape();
+    const Shape& nhwcOutputShape = output.getNhwcShape();
+
+    const float* inputFloat32;
+    const float* biasFloat32;
+    float* outputFloat32;
+    std::vector<float> inputBuffer, biasBuffer, outputBuffer;
+    if constexpr (std::is_same_v<T, float>) {
+        inputFloat32 = input.getNhwcBuffer();
+        biasFloat32 = biasData;
+        outputFloat32 = output.getNhwcBuffer();
+    } else {
+        inputBuffer.resize(getNumberOfElements(nhwcInputShape));
+        convertFloat16ToFloat32(input.getNhwcBuffer(), &inputBuffer);
+        biasBuffer.resize(getNumberOfElements(biasShape));
+        convertFloat16ToFloat32(biasData, &biasBuffer);
+        outputBuffer.resize(getNumberOfElements(nhwcOutputShape));
+        inputFloat32 = inputBuffer.data();
+        biasFloat32 = biasBuffer.data();
+        outputFloat32 = outputBuffer.data();
+    }
+
+    const ConvAlgorithm algorithm =
+            state != nullptr ? state->algorithm : ConvAlgorithm::kIm2colGemm;
+    switch (algorithm) {
+        case ConvAlgorithm::kIm2colGemm: {
+            const float* filterFloat32 = nullptr;
+            std::vector<float> filterBuffer;
+            if constexpr (std::is_same_v<T, float>) {
+                filterFloat32 = filterData;
+            } else if (state != nullptr) {
+                filterFloat32 = state->filter.data();
+            } else {
+                filterBuffer.resize(getNumberOfElements(filterShape));
+                convertFloat16ToFloat32(filterData, &filterBuffer);
+                filterFloat32 = filterBuffer.data();
+            }
+            NN_RET_CHECK(convNhwc(inputFloat32, nhwcInputShape, filterFloat32, filterShape,
+                                  biasFloat32, biasShape, param.padding_left,
+                                  param.padding_right, param.padding_top, param.padding_bottom,
+                                  param.stride_width, param.stride_height,
+                                  param.dilation_width_factor, param.dilation_height_factor,
+                                  param.activation, outputFloat32, nhwcOutputShape));
+        } break;
+        case ConvAlgorithm::kDirect:
+            convDirectNhwc(inputFloat32, nhwcInputShape, state->filter.data(),
+                           getSizeOfDimension(filterShape, 1), getSizeOfDimension(filterShape, 2),
+                           biasFloat32, param, outputFloat32, nhwcOutputShape);
+            break;
+        case ConvAlgorithm::kWinograd:
+            convWinogradNhwc(inputFloat32, nhwcInputShape, state->filter.data(), biasFloat32, param,
+                             outputFloat32, nhwcOutputShape);
+            break;
+    }
+
+    if constexpr (!std::is_same_v<T, float>) {
+        convertFloat32ToFloat16(outputBuffer, output.getNhwcBuffer());
+    }
+    NN_RET_CHECK(output.commit());
+    return true;
+}
+
 bool convQuant8PerChannelNhwc(const uint8_t* inputData, const Shape& inputShape,
                               const int8_t* filterData, const Shape& filterShape,
-                              const float* filterScales, const int32_t* biasData,
-                              const Shape& biasShape, int32_t paddingLeft, int32_t /*paddingRight*/,
-                              int32_t paddingTop, int32_t /*paddingBottom*/, int32_t strideWidth,
-                              int32_t strideHeight, int32_t dilationWidthFactor,
-                              int32_t dilationHeightFactor, int32_t activation, uint8_t* outputData,
-                              const Shape& outputShape) {
+                              const int32_t* biasData, const Shape& /*biasShape*/,
+                              int32_t paddingLeft, int32_t /*paddingRight*/, int32_t paddingTop,
+                              int32_t /*paddingBottom*/, int32_t strideWidth, int32_t strideHeight,
+                              int32_t dilationWidthFactor, int32_t dilationHeightFactor,
+                              const PerChannelRequantizationParams& requantParams,
+                              uint8_t* outputData, const Shape& outputShape) {
     NNTRACE_TRANS("convQuant8PerChannel");
 
     uint32_t numBatches = getSizeOfDimension(inputShape, 0);
@@ -368,27 +780,10 @@ bool convQuant8PerChannelNhwc(const uint8_t* inputData, const Shape& inputShape,
     uint32_t outputDepth = getSizeOfDimension(outputShape, 3);
 
     int32_t inputOffset = -inputShape.offset;
-    int32_t outputOffset = outputShape.offset;
+    int32_t outputOffset = requantParams.outputOffset;
+    int32_t output_activation_min = requantParams.outputActivationMin;
+    int32_t output_activation_max = requantParams.outputActivationMax;
 
-    auto realMultiplier = std::vector<double>(outputDepth, .0f);
-    auto outputMultiplier = std::vector<int32_t>(outputDepth, 0);
-    auto outputShift = std::vector<int32_t>(outputDepth, .0f);
-
-    for (uint32_t i = 0; i < outputDepth; ++i) {
-        Shape filterChannelShape = filterShape;
-        filterChannelShape.scale = filterScales[i];
-        Shape biasChannelShape = biasShape;
-        biasChannelShape.scale = filterScales[i] * inputShape.scale;
-        NN_RET_CHECK(GetQuantizedConvolutionMultiplier(
-                inputShape, filterChannelShape, biasChannelShape, outputShape, &realMultiplier[i]));
-        int exponent;
-        NN_RET_CHECK(QuantizeMultiplier(realMultiplier[i], &outputMultiplier[i], &exponent));
-        outputShift[i] = -exponent;
-    }
-
-    int32_t output_activation_min = 0, output_activation_max = 0;
-    CalculateActivationRangeUint8(activation, outputShape, &output_activation_min,
-                                  &output_activation_max);
     const uint8_t* inputBase = inputData;
     uint8_t* outPtr = outputData;
     for (uint32_t b = 0; b < numBatches; b++) {
@@ -423,8 +818,8 @@ bool convQuant8PerChannelNhwc(const uint8_t* inputData, const Shape& inputShape,
                         }
                     }
                     sum += biasData[d];
-                    sum = tflite::MultiplyByQuantizedMultiplier(sum, outputMultiplier[d],
-                                                                -outputShift[d]);
+                    sum = tflite::MultiplyByQuantizedMultiplier(
+                            sum, requantParams.multipliers[d], requantParams.shifts[d]);
                     sum += outputOffset;
                     sum = std::max(std::min(sum, output_activation_max), output_activation_min);
                     outPtr[d] = static_cast<uint8_t>(sum);
@@ -441,46 +836,14 @@ bool convQuant8PerChannelNhwc(const uint8_t* inputData, const Shape& inputShape,
 
 bool convQuant8PerChannelNhwc(const int8_t* inputData, const Shape& inputShape,
                               const int8_t* filterData, const Shape& filterShape,
-                              const float* filterScales, const int32_t* biasData,
-                              const Shape& biasShape, int32_t paddingLeft, int32_t /*paddingRight*/,
-                              int32_t paddingTop, int32_t /*paddingBottom*/, int32_t strideWidth,
-                              int32_t strideHeight, int32_t dilationWidthFactor,
-                              int32_t dilationHeightFactor, int32_t activation, int8_t* outputData,
-                              const Shape& outputShape) {
+                              const int32_t* biasData, const Shape& biasShape,
+                              int32_t paddingLeft, int32_t /*paddingRight*/, int32_t paddingTop,
+                              int32_t /*paddingBottom*/, int32_t strideWidth, int32_t strideHeight,
+                              int32_t dilationWidthFactor, int32_t dilationHeightFactor,
+                              const PerChannelRequantizationParams& requantParams,
+                              int8_t* outputData, const Shape& outputShape) {
     NNTRACE_TRANS("convQuant8SignedPerChannel");
 
-    [[maybe_unused]] uint32_t numBatches = getSizeOfDimension(inputShape, 0);
-    [[maybe_unused]] uint32_t inputHeight = getSizeOfDimension(inputShape, 1);
-    [[maybe_unused]] uint32_t inputWidth = getSizeOfDimension(inputShape, 2);
-    [[maybe_unused]] uint32_t inputDepth = getSizeOfDimension(inputShape, 3);
-    [[maybe_unused]] uint32_t filterHeight = getSizeOfDimension(filterShape, 1);
-    [[maybe_unused]] uint32_t filterWidth = getSizeOfDimension(filterShape, 2);
-    [[maybe_unused]] uint32_t filterDepth = getSizeOfDimension(filterShape, 3);
-    [[maybe_unused]] uint32_t outputHeight = getSizeOfDimension(outputShape, 1);
-    [[maybe_unused]] uint32_t outputWidth = getSizeOfDimension(outputShape, 2);
-    uint32_t outputDepth = getSizeOfDimension(outputShape, 3);
-
-    [[maybe_unused]] int32_t inputOffset = -inputShape.offset;
-    [[maybe_unused]] int32_t outputOffset = outputShape.offset;
-
-    auto realMultiplier = std::vector<double>(outputDepth, .0f);
-    auto outputMultiplier = std::vector<int32_t>(outputDepth, 0);
-    auto outputShift = std::vector<int32_t>(outputDepth, .0f);
-
-    for (uint32_t i = 0; i < outputDepth; ++i) {
-        Shape filterChannelShape = filterShape;
-        filterChannelShape.scale = filterScales[i];
-        Shape biasChannelShape = biasShape;
-        biasChannelShape.scale = filterScales[i] * inputShape.scale;
-        NN_RET_CHECK(GetQuantizedConvolutionMultiplier(
-                inputShape, filterChannelShape, biasChannelShape, outputShape, &realMultiplier[i]));
-        NN_RET_CHECK(QuantizeMultiplier(realMultiplier[i], &outputMultiplier[i], &outputShift[i]));
-    }
-
-    int32_t output_activation_min = 0, output_activation_max = 0;
-    CalculateActivationRangeInt8(activation, outputShape, &output_activation_min,
-                                 &output_activation_max);
-
     tflite::ConvParams convParams;
     convParams.input_offset = -inputShape.offset;
     convParams.output_offset = outputShape.offset;
@@ -490,12 +853,12 @@ bool convQuant8PerChannelNhwc(const int8_t* inputData, const Shape& inputShape,
     convParams.dilation_width_factor = dilationWidthFactor;
     convParams.padding_values.height = paddingTop;
     convParams.padding_values.width = paddingLeft;
-    convParams.quantized_activation_min = output_activation_min;
-    convParams.quantized_activation_max = output_activation_max;
+    convParams.quantized_activation_min = requantParams.outputActivationMin;
+    convParams.quantized_activation_max = requantParams.outputActivationMax;
 
     NNTRACE_COMP_SWITCH("reference_integer_ops::ConvPerChannel");
     tflite::reference_integer_ops::ConvPerChannel(
-            convParams, outputMultiplier.data(), outputShift.data(),
+            convParams, requantParams.multipliers.data(), requantParams.shifts.data(),
             convertShapeToTflshape(inputShape), inputData, convertShapeToTflshape(filterShape),
             filterData, convertShapeToTflshape(biasShape), biasData,
             convertShapeToTflshape(outputShape), outputData);
@@ -504,20 +867,21 @@ bool convQuant8PerChannelNhwc(const int8_t* inputData, const Shape& inputShape,
 
 template <typename T>
 bool convQuant8PerChannel(const T* inputData, const Shape& inputShape, const int8_t* filterData,
-                          const Shape& filterShape, const float* filterScales,
-                          const int32_t* biasData, const Shape& biasShape, int32_t paddingLeft,
-                          int32_t paddingRight, int32_t paddingTop, int32_t paddingBottom,
-                          int32_t strideWidth, int32_t strideHeight, int32_t dilationWidthFactor,
-                          int32_t dilationHeightFactor, int32_t activation, bool useNchw,
+                          const Shape& filterShape, const int32_t* biasData,
+                          const Shape& biasShape, int32_t paddingLeft, int32_t paddingRight,
+                          int32_t paddingTop, int32_t paddingBottom, int32_t strideWidth,
+                          int32_t strideHeight, int32_t dilationWidthFactor,
+                          int32_t dilationHeightFactor,
+                          const PerChannelRequantizationParams& requantParams, bool useNchw,
                           T* outputData, const Shape& outputShape) {
     InputWithLayout<T> input(useNchw);
     OutputWithLayout<T> output(useNchw);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
     NN_RET_CHECK(convQuant8PerChannelNhwc(
-            input.getNhwcBuffer(), input.getNhwcShape(), filterData, filterShape, filterScales,
-            biasData, biasShape, paddingLeft, paddingRight, paddingTop, paddingBottom, strideWidth,
-            strideHeight, dilationWidthFactor, dilationHeightFactor, activation,
+            input.getNhwcBuffer(), input.getNhwcShape(), filterData, filterShape, biasData,
+            biasShape, paddingLeft, paddingRight, paddingTop, paddingBottom, strideWidth,
+            strideHeight, dilationWidthFactor, dilationHeightFactor, requantParams,
             output.getNhwcBuffer(), output.getNhwcShape()));
     NN_RET_CHECK(output.commit());
     return true;
@@ -596,46 +960,44 @@ bool execute(IOperationExecutionContext* context) {
     Conv2dParam param;
     NN_RET_CHECK(param.initialize(context));
     switch (context->getInputType(kInputTensor)) {
-        case OperandType::TENSOR_FLOAT32:
-            return conv(context->getInputBuffer<float>(kInputTensor),
-                        context->getInputShape(kInputTensor),
-                        context->getInputBuffer<float>(kFilterTensor),
-                        context->getInputShape(kFilterTensor),
-                        context->getInputBuffer<float>(kBiasTensor),
-                        context->getInputShape(kBiasTensor), param.padding_left,
-                        param.padding_right, param.padding_top, param.padding_bottom,
-                        param.stride_width, param.stride_height, param.dilation_width_factor,
-                        param.dilation_height_factor, param.activation, param.useNchw,
-                        context->getOutputBuffer<float>(kOutputTensor),
-                        context->getOutputShape(kOutputTensor));
-        case OperandType::TENSOR_FLOAT16:
-            return conv(context->getInputBuffer<_Float16>(kInputTensor),
-                        context->getInputShape(kInputTensor),
-                        context->getInputBuffer<_Float16>(kFilterTensor),
-                        context->getInputShape(kFilterTensor),
-                        context->getInputBuffer<_Float16>(kBiasTensor),
-                        context->getInputShape(kBiasTensor), param.padding_left,
-                        param.padding_right, param.padding_top, param.padding_bottom,
-                        param.stride_width, param.stride_height, param.dilation_width_factor,
-                        param.dilation_height_factor, param.activation, param.useNchw,
-                        context->getOutputBuffer<_Float16>(kOutputTensor),
-                        context->getOutputShape(kOutputTensor));
+        case OperandType::TENSOR_FLOAT32: {
+            const auto state = getConvFloatState<float>(context, param);
+            return convFloat(context->getInputBuffer<float>(kInputTensor),
+                             context->getInputShape(kInputTensor),
+                             context->getInputBuffer<float>(kFilterTensor),
+                             context->getInputShape(kFilterTensor),
+                             context->getInputBuffer<float>(kBiasTensor),
+                             context->getInputShape(kBiasTensor), param, state.get(),
+                             context->getOutputBuffer<float>(kOutputTensor),
+                             context->getOutputShape(kOutputTensor));
+        }
+        case OperandType::TENSOR_FLOAT16: {
+            const auto state = getConvFloatState<_Float16>(context, param);
+            return convFloat(context->getInputBuffer<_Float16>(kInputTensor),
+                             context->getInputShape(kInputTensor),
+                             context->getInputBuffer<_Float16>(kFilterTensor),
+                             context->getInputShape(kFilterTensor),
+                             context->getInputBuffer<_Float16>(kBiasTensor),
+                             context->getInputShape(kBiasTensor), param, state.get(),
+                             context->getOutputBuffer<_Float16>(kOutputTensor),
+                             context->getOutputShape(kOutputTensor));
+        }
         case OperandType::TENSOR_QUANT8_ASYMM:
             if (context->getInputType(kFilterTensor) ==
                 OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL) {
+                const auto requantState = getPerChannelRequantizationState<uint8_t>(
+                        context, kInputTensor, kFilterTensor, kOutputTensor, param.activation);
+                NN_RET_CHECK(requantState != nullptr);
                 return convQuant8PerChannel(
                         context->getInputBuffer<uint8_t>(kInputTensor),
                         context->getInputShape(kInputTensor),
                         context->getInputBuffer<int8_t>(kFilterTensor),
                         context->getInputShape(kFilterTensor),
-                        std::get<Operand::SymmPerChannelQuantParams>(
-                                context->getInputExtraParams(kFilterTensor))
-                                .scales.data(),
                         context->getInputBuffer<int32_t>(kBiasTensor),
                         context->getInputShape(kBiasTensor), param.padding_left,
                         param.padding_right, param.padding_top, param.padding_bottom,
                         param.stride_width, param.stride_height, param.dilation_width_factor,
-                        param.dilation_height_factor, param.activation, param.useNchw,
+                        param.dilation_height_factor, requantState->params, param.useNchw,
                         context->getOutputBuffer<uint8_t>(kOutputTensor),
                         context->getOutputShape(kOutputTensor));
             } else if (context->getInputType(kFilterTensor) == OperandType::TENSOR_QUANT8_ASYMM) {
@@ -656,19 +1018,19 @@ bool execute(IOperationExecutionContext* context) {
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
             if (context->getInputType(kFilterTensor) ==
                 OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL) {
+                const auto requantState = getPerChannelRequantizationState<int8_t>(
+                        context, kInputTensor, kFilterTensor, kOutputTensor, param.activation);
+                NN_RET_CHECK(requantState != nullptr);
                 return convQuant8PerChannel(
                         context->getInputBuffer<int8_t>(kInputTensor),
                         context->getInputShape(kInputTensor),
                         context->getInputBuffer<int8_t>(kFilterTensor),
                         context->getInputShape(kFilterTensor),
-                        std::get<Operand::SymmPerChannelQuantParams>(
-                                context->getInputExtraParams(kFilterTensor))
-                                .scales.data(),
                         context->getInputBuffer<int32_t>(kBiasTensor),
                         context->getInputShape(kBiasTensor), param.padding_left,
                         param.padding_right, param.padding_top, param.padding_bottom,
                         param.stride_width, param.stride_height, param.dilation_width_factor,
-                        param.dilation_height_factor, param.activation, param.useNchw,
+                        param.dilation_height_factor, requantState->params, param.useNchw,
                         context->getOutputBuffer<int8_t>(kOutputTensor),
                         context->getOutputShape(kOutputTensor));
             } else if (context->getInputType(kFilterTensor) ==
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ActivationFunctor.h"
+#include "Conv2D.h"
+#include "OperationTestUtils.h"
+
+namespace android {
+namespace nn {
+namespace {
+
+// A float CONV_2D of an NHWC input with implicit padding.
+struct ConvParams {
+    uint32_t batches = 1;
+    uint32_t height = 1, width = 1;
+    uint32_t inDepth = 1, outDepth = 1;
+    uint32_t filterHeight = 3, filterWidth = 3;
+    int32_t padding = kPaddingSame;
+    int32_t strideWidth = 1, strideHeight = 1;
+    int32_t dilation = 1;
+    int32_t activation = kActivationNone;
+};
+
+struct OutputGeometry {
+    uint32_t height, width;
+    int32_t paddingTop, paddingLeft;
+};
+
+OutputGeometry getOutputGeometry(const ConvParams& params) {
+    int32_t paddingTop, paddingBottom, paddingLeft, paddingRight;
+    calculateExplicitPadding(params.height, params.strideHeight, params.dilation,
+                             params.filterHeight, params.padding, &paddingTop, &paddingBottom);
+    calculateExplicitPadding(params.width, params.strideWidth, params.dilation, params.filterWidth,
+                             params.padding, &paddingLeft, &paddingRight);
+    return {.height = static_cast<uint32_t>(computeOutSize(
+                    params.height, params.filterHeight, params.strideHeight, params.dilation,
+                    paddingTop, paddingBottom)),
+            .width = static_cast<uint32_t>(computeOutSize(params.width, params.filterWidth,
+                                                          params.strideWidth, params.dilation,
+                                                          paddingLeft, paddingRight)),
+            .paddingTop = paddingTop,
+            .paddingLeft = paddingLeft};
+}
+
+double applyActivation(double value, int32_t activation) {
+    switch (activation) {
+        case kActivationRelu:
+            return std::max(value, 0.0);
+        case kActivationRelu1:
+            return std::min(std::max(value, -1.0), 1.0);
+        case kActivationRelu6:
+            return std::min(std::max(value, 0.0), 6.0);
+        default:
+            return value;
+    }
+}
+
+// The loop over every output element and filter tap that the float convolution algorithms must
+// agree with, accumulated in double.
+std::vector<float> convReference(const ConvParams& params, const std::vector<float>& input,
+                                 const std::vector<float>& filter,
+                                 const std::vector<float>& bias) {
+    const OutputGeometry output = getOutputGeometry(params);
+    auto inputAt = [&](uint32_t b, int32_t y, int32_t x, uint32_t c) -> double {
+        return input[((b * params.height + y) * params.width + x) * params.inDepth + c];
+    };
+    auto filterAt = [&](uint32_t oc, uint32_t y, uint32_t x, uint32_t ic) -> double {
+        return filter[((oc * params.filterHeight + y) * params.filterWidth + x) * params.inDepth +
+                      ic];
+    };
+    std::vector<float> result;
+    for (uint32_t b = 0; b < params.batches; ++b) {
+        for (uint32_t outY = 0; outY < output.height; ++outY) {
+            for (uint32_t outX = 0; outX < output.width; ++outX) {
+                for (uint32_t oc = 0; oc < params.outDepth; ++oc) {
+                    double sum = bias[oc];
+                    for (uint32_t filterY = 0; filterY < params.filterHeight; ++filterY) {
+                        const int32_t inY = static_cast<int32_t>(outY) * params.strideHeight -
+                                            output.paddingTop + filterY * params.dilation;
+                        if (inY < 0 || inY >= static_cast<int32_t>(params.height)) continue;
+                        for (uint32_t filterX = 0; filterX < params.filterWidth; ++filterX) {
+                            const int32_t inX = static_cast<int32_t>(outX) * params.strideWidth -
+                                                output.paddingLeft + filterX * params.dilation;
+                            if (inX < 0 || inX >= static_cast<int32_t>(params.width)) continue;
+                            for (uint32_t ic = 0; ic < params.inDepth; ++ic) {
+                                sum += inputAt(b, inY, inX, ic) *
+                                       filterAt(oc, filterY, filterX, ic);
+                            }
+                        }
+                    }
+                    result.push_back(static_cast<float>(applyActivation(sum, params.activation)));
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// Runs CONV_2D. A constant filter lets the operation choose its algorithm and prepare the filter
+// for it, while a filter that is not constant always runs im2col and GEMM.
+std::vector<float> runConv(const ConvParams& params, const std::vector<float>& input,
+                           const std::vector<float>& filter, const std::vector<float>& bias,
+                           bool constantFilter, OperationStateCache* cache = nullptr) {
+    std::vector<TestOperand> inputs = {makeTensor(OperandType::TENSOR_FLOAT32, input),
+                                       makeTensor(OperandType::TENSOR_FLOAT32, filter),
+                                       makeTensor(OperandType::TENSOR_FLOAT32, bias),
+                                       makeScalar(params.padding),
+                                       makeScalar(params.strideWidth),
+                                       makeScalar(params.strideHeight),
+                                       makeScalar(params.activation),
+                                       makeBoolScalar(false),
+                                       makeScalar(params.dilation),
+                                       makeScalar(params.dilation)};
+    inputs[conv_2d::kInputTensor].shape.dimensions = {params.batches, params.height, params.width,
+                                                      params.inDepth};
+    inputs[conv_2d::kFilterTensor].shape.dimensions = {params.outDepth, params.filterHeight,
+                                                       params.filterWidth, params.inDepth};
+    TestContext context(std::move(inputs), {.type = OperandType::TENSOR_FLOAT32}, sizeof(float),
+                        constantFilter, cache);
+    EXPECT_TRUE(runOperation(OperationType::CONV_2D, &context));
+    const OutputGeometry output = getOutputGeometry(params);
+    EXPECT_EQ(context.getOutputShape(conv_2d::kOutputTensor).dimensions,
+              (std::vector<uint32_t>{params.batches, output.height, output.width,
+                                     params.outDepth}));
+    return context.getOutput<float>();
+}
+
+std::vector<float> makeRandomFloats(size_t size, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<float> values(size);
+    for (float& value : values) value = distribution(generator);
+    return values;
+}
+
+void expectNear(const std::vector<float>& actual, const std::vector<float>& expected) {
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+        ASSERT_NEAR(actual[i], expected[i], 1e-4f * std::max(1.0f, std::abs(expected[i])))
+                << "element " << i;
+    }
+}
+
+// Expects CONV_2D to compute the reference result with a constant filter, which runs the
+// algorithm chosen for params, and with a filter that is not constant.
+void expectMatchesReference(const ConvParams& params) {
+    const std::vector<float> input = makeRandomFloats(
+            params.batches * params.height * params.width * params.inDepth, 1);
+    const std::vector<float> filter = makeRandomFloats(
+            params.outDepth * params.filterHeight * params.filterWidth * params.inDepth, 2);
+    const std::vector<float> bias = makeRandomFloats(params.outDepth, 3);
+    const std::vector<float> expected = convReference(params, input, filter, bias);
+    for (const bool constantFilter : {true, false}) {
+        SCOPED_TRACE(constantFilter ? "constant filter" : "filter not constant");
+        expectNear(runConv(params, input, filter, bias, constantFilter), expected);
+    }
+}
+
+// Winograd: 3x3 filters with stride 1, no dilation and at least 8 input and output channels. A row
+// of 2x2 output tiles is computed in blocks of 8 tiles.
+
+TEST(Conv2DTest, WinogradSamePadding) {
+    // Odd sizes leave partial tiles at the bottom and right, and 19 tiles per row leave a partial
+    // block.
+    expectMatchesReference(
+            {.batches = 2, .height = 13, .width = 37, .inDepth = 16, .outDepth = 24});
+}
+
+TEST(Conv2DTest, WinogradValidPadding) {
+    // 8 and 9 tiles per row: one full block, and a full block and one more tile.
+    expectMatchesReference({.height = 12,
+                            .width = 18,
+                            .inDepth = 8,
+                            .outDepth = 8,
+                            .padding = kPaddingValid,
+                            .activation = kActivationRelu});
+    expectMatchesReference({.height = 11,
+                            .width = 20,
+                            .inDepth = 9,
+                            .outDepth = 12,
+                            .padding = kPaddingValid,
+                            .activation = kActivationRelu6});
+}
+
+TEST(Conv2DTest, WinogradSinglePixel) {
+    expectMatchesReference({.height = 1,
+                            .width = 1,
+                            .inDepth = 8,
+                            .outDepth = 8,
+                            .activation = kActivationRelu1});
+    expectMatchesReference({.height = 2, .width = 3, .inDepth = 8, .outDepth = 10});
+}
+
+TEST(Conv2DTest, WinogradRunsInParallel) {
+    expectMatchesReference(
+            {.batches = 2, .height = 33, .width = 45, .inDepth = 32, .outDepth = 32});
+}
+
+// Direct: 1x1 filters, and inputs of at most 4 channels with any filter.
+
+TEST(Conv2DTest, DirectPointwise) {
+    expectMatchesReference({.height = 9, .width = 7, .inDepth = 32, .outDepth = 16,
+                            .filterHeight = 1, .filterWidth = 1});
+    expectMatchesReference({.batches = 2,
+                            .height = 15,
+                            .width = 11,
+                            .inDepth = 24,
+                            .outDepth = 8,
+                            .filterHeight = 1,
+                            .filterWidth = 1,
+                            .padding = kPaddingValid,
+                            .strideWidth = 2,
+                            .strideHeight = 2,
+                            .activation = kActivationRelu});
+}
+
+TEST(Conv2DTest, DirectShallowInput) {
+    // The first layer of a network reading an RGB image.
+    expectMatchesReference({.batches = 2,
+                            .height = 33,
+                            .width = 31,
+                            .inDepth = 3,
+                            .outDepth = 16,
+                            .strideWidth = 2,
+                            .strideHeight = 2,
+                            .activation = kActivationRelu6});
+    expectMatchesReference({.height = 10,
+                            .width = 13,
+                            .inDepth = 4,
+                            .outDepth = 5,
+                            .filterHeight = 5,
+                            .filterWidth = 3,
+                            .padding = kPaddingValid,
+                            .strideWidth = 1,
+                            .strideHeight = 2});
+}
+
+TEST(Conv2DTest, DirectDilated) {
+    expectMatchesReference(
+            {.height = 14, .width = 15, .inDepth = 2, .outDepth = 6, .dilation = 2});
+    expectMatchesReference({.height = 14,
+                            .width = 15,
+                            .inDepth = 1,
+                            .outDepth = 6,
+                            .padding = kPaddingValid,
+                            .dilation = 3});
+}
+
+// im2col and GEMM: everything else.
+
+TEST(Conv2DTest, Im2colGemm) {
+    // Strided, and just below the channel counts of Winograd.
+    expectMatchesReference({.height = 17,
+                            .width = 12,
+                            .inDepth = 8,
+                            .outDepth = 8,
+                            .strideWidth = 2,
+                            .strideHeight = 2,
+                            .activation = kActivationRelu});
+    expectMatchesReference({.height = 9, .width = 9, .inDepth = 8, .outDepth = 7});
+    expectMatchesReference({.height = 9, .width = 9, .inDepth = 7, .outDepth = 8});
+    expectMatchesReference({.height = 11,
+                            .width = 10,
+                            .inDepth = 6,
+                            .outDepth = 9,
+                            .filterHeight = 5,
+                            .filterWidth = 5,
+                            .padding = kPaddingValid,
+                            .dilation = 2});
+}
+
+TEST(Conv2DTest, PreparedFilterIsCached) {
+    const ConvParams params = {.height = 7, .width = 9, .inDepth = 8, .outDepth = 8};
+    const std::vector<float> input = makeRandomFloats(7 * 9 * 8, 1);
+    const std::vector<float> filter = makeRandomFloats(8 * 3 * 3 * 8, 2);
+    const std::vector<float> bias = makeRandomFloats(8, 3);
+    OperationStateCache cache;
+    const std::vector<float> expected = convReference(params, input, filter, bias);
+    expectNear(runConv(params, input, filter, bias, /*constantFilter=*/true, &cache), expected);
+    const auto state = cache.get({0, 0});
+    ASSERT_NE(state, nullptr);
+    expectNear(runConv(params, input, filter, bias, /*constantFilter=*/true, &cache), expected);
+    EXPECT_EQ(cache.get({0, 0}), state);
+
+    // Another stride needs another algorithm, so the filter is prepared again.
+    ConvParams strided = params;
+    strided.strideWidth = 2;
+    expectNear(runConv(strided, input, filter, bias, /*constantFilter=*/true, &cache),
+               convReference(strided, input, filter, bias));
+    EXPECT_NE(cache.get({0, 0}), state);
+}
+
+}  // namespace
+}  // namespace nn
+}  // namespace android
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "OperationsExecutionUtils.h"
+
+// Measures the element conversions behind QUANTIZE, DEQUANTIZE and CAST for every type pair they
+// support, on tensors of state.range(0) elements. Each benchmark reports the bytes read and
+// written per second.
+
+namespace android {
+namespace nn {
+namespace {
+
+constexpr float kScale = 0.05f;
+constexpr int32_t kZeroPoint = 3;
+constexpr uint32_t kNumChannels = 64;
+
+// Returns values spanning the range of every benchmarked type, including some that saturate.
+template <typename T>
+std::vector<T> makeInput(uint32_t size) {
+    std::vector<T> input(size);
+    for (uint32_t i = 0; i < size; ++i) {
+        input[i] = static_cast<T>(static_cast<int32_t>(i % 300) - 20);
+    }
+    return input;
+}
+
+template <typename FromT, typename ToT>
+void setBytesProcessed(benchmark::State& state) {
+    state.SetBytesProcessed(state.iterations() * state.range(0) * (sizeof(FromT) + sizeof(ToT)));
+}
+
+template <typename FloatT, typename QuantT>
+void BM_Quantize(benchmark::State& state) {
+    const std::vector<FloatT> input = makeInput<FloatT>(state.range(0));
+    std::vector<QuantT> output(input.size());
+    for (auto _ : state) {
+        quantizeElements(input.data(), input.size(), kScale, kZeroPoint, output.data());
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+    setBytesProcessed<FloatT, QuantT>(state);
+}
+
+template <typename QuantT, typename FloatT>
+void BM_Dequantize(benchmark::State& state) {
+    const std::vector<QuantT> input = makeInput<QuantT>(state.range(0));
+    std::vector<FloatT> output(input.size());
+    for (auto _ : state) {
+        dequantizeElements(input.data(), input.size(), kScale, kZeroPoint, output.data());
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+    setBytesProcessed<QuantT, FloatT>(state);
+}
+
+// Per-channel dequantization of a filter whose innermost dimension holds the channels.
+template <typename FloatT>
+void BM_DequantizePerChannel(benchmark::State& state) {
+    const std::vector<int8_t> input = makeInput<int8_t>(state.range(0));
+    std::vector<float> scales(kNumChannels);
+    for (uint32_t c = 0; c < kNumChannels; ++c) {
+        scales[c] = kScale * (c + 1);
+    }
+    std::vector<FloatT> output(input.size());
+    for (auto _ : state) {
+        dequantizePerChannelElements(input.data(), input.size() / kNumChannels, kNumChannels, 1,
+                                     scales.data(), 0, output.data());
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+    setBytesProcessed<int8_t, FloatT>(state);
+}
+
+template <typename FromT, typename ToT>
+void BM_Cast(benchmark::State& state) {
+    const std::vector<FromT> input = makeInput<FromT>(state.range(0));
+    std::vector<ToT> output(input.size());
+    for (auto _ : state) {
+        castElements(input.data(), input.size(), output.data());
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+    setBytesProcessed<FromT, ToT>(state);
+}
+
+#define NN_CONVERSION_BENCHMARK(...) \
+    BENCHMARK_TEMPLATE(__VA_ARGS__)->Arg(4 * 1024)->Arg(256 * 1024)->Arg(4 * 1024 * 1024)
+
+NN_CONVERSION_BENCHMARK(BM_Quantize, float, uint8_t);
+NN_CONVERSION_BENCHMARK(BM_Quantize, float, int8_t);
+NN_CONVERSION_BENCHMARK(BM_Quantize, _Float16, uint8_t);
+NN_CONVERSION_BENCHMARK(BM_Quantize, _Float16, int8_t);
+
+NN_CONVERSION_BENCHMARK(BM_Dequantize, uint8_t, float);
+NN_CONVERSION_BENCHMARK(BM_Dequantize, uint8_t, _Float16);
+NN_CONVERSION_BENCHMARK(BM_Dequantize, int8_t, float);
+NN_CONVERSION_BENCHMARK(BM_Dequantize, int8_t, _Float16);
+NN_CONVERSION_BENCHMARK(BM_DequantizePerChannel, float);
+NN_CONVERSION_BENCHMARK(BM_DequantizePerChannel, _Float16);
+
+NN_CONVERSION_BENCHMARK(BM_Cast, _Float16, float);
+NN_CONVERSION_BENCHMARK(BM_Cast, _Float16, int32_t);
+NN_CONVERSION_BENCHMARK(BM_Cast, _Float16, uint8_t);
+NN_CONVERSION_BENCHMARK(BM_Cast, float, _Float16);
+NN_CONVERSION_BENCHMARK(BM_Cast, float, int32_t);
+NN_CONVERSION_BENCHMARK(BM_Cast, float, uint8_t);
+NN_CONVERSION_BENCHMARK(BM_Cast, int32_t, _Float16);
+NN_CONVERSION_BENCHMARK(BM_Cast, int32_t, float);
+NN_CONVERSION_BENCHMARK(BM_Cast, int32_t, uint8_t);
+NN_CONVERSION_BENCHMARK(BM_Cast, uint8_t, _Float16);
+NN_CONVERSION_BENCHMARK(BM_Cast, uint8_t, float);
+NN_CONVERSION_BENCHMARK(BM_Cast, uint8_t, int32_t);
+
+#undef NN_CONVERSION_BENCHMARK
+
+}  // namespace
+}  // namespace nn
+}  // namespace android
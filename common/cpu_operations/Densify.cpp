@@ -18,11 +18,12 @@
 
 #include "Densify.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
-#include <functional>
-#include <iostream>
-#include <numeric>
+#include <cstring>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include "OperationResolver.h"
@@ -33,212 +34,396 @@
 #include "nnapi/TypeUtils.h"
 #include "nnapi/Validation.h"
 
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+#include "CpuOperationUtils.h"
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+
 #define LOG_TAG "Operations"
 
 namespace android {
 namespace nn {
 namespace densify_op {
 
-/**
- * getFlattenedIndex:
- * Gets the index of destData where indices points to. Uses shape and origRank
- * for calculations.
- */
-uint64_t getFlattenedIndex(const std::vector<int32_t>& indices, const std::vector<uint32_t>& shape,
-                           const int origRank) {
-    uint64_t index = 0;
-    int subElems = 1;
-    // origRank = size of destDims
-    for (int i = origRank - 1; i >= 0; i--) {
-        index += uint64_t(indices[i] * subElems);
-        subElems *= shape[i];
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+namespace {
+
+// Sparse inputs with fewer values than this are decoded on a single thread.
+constexpr uint64_t kMinValuesPerThread = 16 * 1024;
+
+// Describes how the values of the sparse tensor land in the dense output. Each level of the
+// traversal order moves the destination by levelStrides[level] elements per index: a dense
+// dimension that is split into blocks steps over a whole block, and a block dimension steps over
+// one element of the dimension it maps to.
+//
+// The levels from firstBlockLevel on are all DENSE. Each position reached at the level before them
+// therefore owns blockCount consecutive source values, which are written as one strided block
+// described by blockSizes and blockStrides, with dimensions that are contiguous in the destination
+// merged. The levels before firstBlockLevel are walked iteratively to find those positions.
+struct DensifyPlan {
+    std::vector<int32_t> dimFormat;
+    std::vector<uint32_t> denseSizes;
+    std::vector<const int32_t*> arraySegments;
+    std::vector<const int32_t*> arrayIndices;
+    std::vector<uint64_t> levelStrides;
+    uint32_t firstBlockLevel;
+    uint64_t blockCount;
+    std::vector<uint32_t> blockSizes;
+    std::vector<uint64_t> blockStrides;
+};
+
+DensifyPlan makePlan(const std::vector<const void*>& inputBuffers, uint32_t numLevels,
+                     const std::vector<uint32_t>& destDims) {
+    const auto* traversalOrder = static_cast<const int32_t*>(inputBuffers[kInputTravOrder]);
+    const auto* blockMap = static_cast<const int32_t*>(inputBuffers[kInputBlockMap]);
+    const auto* dimFormat = static_cast<const int32_t*>(inputBuffers[kInputDimFormat]);
+    const auto* dimensions = static_cast<const int32_t*>(inputBuffers[kInputDimensions]);
+    const uint32_t origRank = destDims.size();
+
+    std::vector<uint64_t> destStrides(origRank);
+    uint64_t stride = 1;
+    for (uint32_t i = origRank; i-- > 0;) {
+        destStrides[i] = stride;
+        stride *= destDims[i];
+    }
+    // The index of a block level is the least significant part of the index into the dimension it
+    // maps to, so the levels before it on that dimension step over the whole block.
+    std::vector<uint64_t> levelStrides(numLevels);
+    std::vector<uint64_t> blockedStrides = destStrides;
+    for (uint32_t level = numLevels; level-- > origRank;) {
+        const int32_t block = traversalOrder[level] - origRank;
+        const int32_t dim = blockMap[block];
+        levelStrides[level] = blockedStrides[dim];
+        blockedStrides[dim] *= dimensions[traversalOrder[origRank + block]];
+    }
+    for (uint32_t level = 0; level < origRank; ++level) {
+        levelStrides[level] = blockedStrides[traversalOrder[level]];
     }
-    return index;
-}
 
-/**
- * populate (Recursive Function):
- * Used to populate the destData with elements from srcData one value at a time.
- * Inputs:
- * * srcData = input data of non-zero values.
- * * indices = used to determine the index in destData where we write srcData to. Uses block
- *   dimension.
- * * level = used to keep track of recursion level. Each recursive instance exits when level == size
- *   of traversal order.
- * * prevIdx = used to keep placement in array segments and srcData.
- * * destData = dense output data. Input being written to.
- * * destDims = shape of the output tensor. Used to calculate the flattened idx.
- * * dimFormat = dimension format for each entry in traversal order. The format is either DENSE
- *   (dimFormat[i] == 0) or SPARSE_CSR (dimFormat[i] == 1). Format is significant to determine how
- *   recursive iterations will occur and what metadata is stored in dimMetadata.
- * * traversalOrder = contains n+k elements. The first n elements are a permutation of the dense
- *   tensor shape. The last k elements are a permutation of the block dimensions. Used to determine
- *   order of traversal paths.
- * * blockSize = dense size of blocks. The last k elements of dimensions.
- * * blockMap = Used to determine how the block dimension maps to the original tensor dimension.
- * * dimMetadata = metadata varies depending on dimFormat values. If format is DENSE,
- *   dimMetadata[i*2][0] is the total number of elements in the dense tensor on the ith traversal
- *   path, and recursive iterations are through a standard for loop from 0 to dimMetadata[i*2][0].
- *   If format is SPARSE_CSR, dimMetadata[i*2] is a vector of array segments and
- *   dimMetadata[i*2+1] is a vector of array indices. The next recursive iterations will be
- *   looping through the array segments vector (since array segments are the same as row pointers in
- *   CSR format, the ith entry should never be greater than the ith+1 entry) and modifying the input
- *   indices with elements from the array indices vector.
- * * origRank = the size of destDims. Used for calculating flattened index of indices.
- */
-template <typename T>
-void populate(const T* srcData, std::vector<int32_t>* indices, uint32_t level, uint32_t prevIdx,
-              T* destData, const std::vector<uint32_t>& destDims,
-              const std::vector<int32_t>& dimFormat, const int32_t* traversalOrder,
-              const std::vector<int32_t>& blockSize, const int32_t* blockMap,
-              const std::vector<std::vector<int32_t>>& dimMetadata, const int origRank) {
-    if (level == (*indices).size()) {  // level == size of traversal order
-        std::vector<int> origIdx(origRank);
-        size_t i = 0;
-        // Calculating origIdx using dense tensor dimensions
-        for (; i < origIdx.size(); i++) {
-            int origDim = traversalOrder[i];
-            origIdx[origDim] = (*indices)[i];
-        }
-        // Modifying origIdx using block dimensions
-        for (; i < (*indices).size(); i++) {
-            const int blockIdx = traversalOrder[i] - origRank;
-            const int origDim = blockMap[blockIdx];
-            origIdx[origDim] = origIdx[origDim] * blockSize[blockIdx] + (*indices)[i];
+    DensifyPlan plan;
+    plan.dimFormat.assign(dimFormat, dimFormat + numLevels);
+    plan.denseSizes.resize(numLevels);
+    plan.arraySegments.resize(numLevels);
+    plan.arrayIndices.resize(numLevels);
+    plan.levelStrides = std::move(levelStrides);
+    for (uint32_t level = 0; level < numLevels; ++level) {
+        if (plan.dimFormat[level] == DENSE) {
+            plan.denseSizes[level] = dimensions[level];
+        } else {
+            plan.arraySegments[level] =
+                    static_cast<const int32_t*>(inputBuffers[kInputArrSeg + 2 * level]);
+            plan.arrayIndices[level] =
+                    static_cast<const int32_t*>(inputBuffers[kInputArrIdx + 2 * level]);
         }
-        // Writing srcData to destData
-        destData[getFlattenedIndex(origIdx, destDims, origRank)] = srcData[prevIdx];
-        return;
     }
-    const int metadataIdx = 2 * level;
-    if (dimFormat[level] == DENSE) {  // DENSE dimension format
-        const int shapeOfLevel = dimMetadata[metadataIdx].front();
-        for (int i = 0; i < shapeOfLevel; i++) {
-            (*indices)[level] = i;
-            populate(srcData, indices, level + 1, prevIdx * shapeOfLevel + i, destData, destDims,
-                     dimFormat, traversalOrder, blockSize, blockMap, dimMetadata, origRank);
+
+    plan.firstBlockLevel = numLevels;
+    while (plan.firstBlockLevel > 0 && plan.dimFormat[plan.firstBlockLevel - 1] == DENSE) {
+        --plan.firstBlockLevel;
+    }
+    plan.blockCount = 1;
+    for (uint32_t level = plan.firstBlockLevel; level < numLevels; ++level) {
+        const uint32_t size = plan.denseSizes[level];
+        plan.blockCount *= size;
+        if (size == 1) continue;
+        if (!plan.blockSizes.empty() &&
+            plan.blockStrides.back() == plan.levelStrides[level] * size) {
+            plan.blockSizes.back() *= size;
+            plan.blockStrides.back() = plan.levelStrides[level];
+            continue;
         }
-    } else {  // SPARSE_CSR dimension format
-        const auto& arraySegments = dimMetadata[metadataIdx];
-        const auto& arrayIndices = dimMetadata[metadataIdx + 1];
-        for (int i = arraySegments[prevIdx]; i < arraySegments[prevIdx + 1]; i++) {
-            (*indices)[level] = arrayIndices[i];
-            populate(srcData, indices, level + 1, i, destData, destDims, dimFormat, traversalOrder,
-                     blockSize, blockMap, dimMetadata, origRank);
+        plan.blockSizes.push_back(size);
+        plan.blockStrides.push_back(plan.levelStrides[level]);
+    }
+    if (plan.blockSizes.empty()) {
+        plan.blockSizes.push_back(1);
+        plan.blockStrides.push_back(1);
+    }
+    return plan;
+}
+
+// Calls fn(row, offset) for each row of the innermost dimension of the block of the plan, where
+// row counts the rows in source order, and offset is the destination of the row relative to the
+// block. index is scratch space for the position within the block.
+template <typename Fn>
+void forEachBlockRow(const DensifyPlan& plan, std::vector<uint32_t>* index, const Fn& fn) {
+    const size_t numDims = plan.blockSizes.size();
+    index->assign(numDims - 1, 0);
+    const uint64_t numRows = plan.blockCount / plan.blockSizes.back();
+    uint64_t offset = 0;
+    for (uint64_t row = 0; row < numRows; ++row) {
+        fn(row, offset);
+        for (size_t d = numDims - 1; d-- > 0;) {
+            offset += plan.blockStrides[d];
+            if (++(*index)[d] < plan.blockSizes[d]) break;
+            offset -= plan.blockStrides[d] * plan.blockSizes[d];
+            (*index)[d] = 0;
         }
     }
 }
 
-/**
- * arrToVector:
- * Converts a T array into an T vector.
- */
+// Writes the blockCount consecutive values at src as the strided block of the plan at dest.
 template <typename T>
-std::vector<T> arrToVector(const T* arr, uint32_t size) {
-    return arr == nullptr ? std::vector<T>() : std::vector<T>(arr, arr + size);
+void copyBlock(const DensifyPlan& plan, const T* src, T* dest, std::vector<uint32_t>* index) {
+    const uint32_t innerSize = plan.blockSizes.back();
+    const uint64_t innerStride = plan.blockStrides.back();
+    forEachBlockRow(plan, index, [&](uint64_t row, uint64_t offset) {
+        const T* rowSrc = src + row * innerSize;
+        if (innerStride == 1) {
+            std::copy(rowSrc, rowSrc + innerSize, dest + offset);
+        } else {
+            for (uint32_t i = 0; i < innerSize; ++i) {
+                dest[offset + i * innerStride] = rowSrc[i];
+            }
+        }
+    });
 }
 
-template <typename T>
-inline bool densify(IOperationExecutionContext* context) {
-    // Getting all inputs
-    std::vector<Shape> inputShapes;
-    const uint32_t inputCount = context->getNumInputs();
-    inputShapes.reserve(inputCount);
-    const T* srcData = context->getInputBuffer<T>(kInputTensor);
-    inputShapes.push_back(context->getInputShape(kInputTensor));
-    const int32_t* traversalOrder = context->getInputBuffer<int32_t>(kInputTravOrder);
-    inputShapes.push_back(context->getInputShape(kInputTravOrder));
-    const int32_t* blockMap = context->getInputBuffer<int32_t>(kInputBlockMap);
-    inputShapes.push_back(context->getInputShape(kInputBlockMap));
-    const int32_t* dimFormatPtr = context->getInputBuffer<int32_t>(kInputDimFormat);
-    inputShapes.push_back(context->getInputShape(kInputDimFormat));
-    const int32_t* dimensionsPtr = context->getInputBuffer<int32_t>(kInputDimensions);
-    inputShapes.push_back(context->getInputShape(kInputDimensions));
-
-    std::vector<const int32_t*> dimMetadataPtrs;
-    for (uint32_t i = kInputArrSeg; i < inputCount; i++) {
-        inputShapes.push_back(context->getInputShape(i));
-        const int32_t* metadata = context->getInputBuffer<int32_t>(i);
-        dimMetadataPtrs.push_back(metadata);
+// Walks the levels before the blocks depth first, without recursion, for the iterations
+// [begin, end) of the first level, and calls visitBlock(position, offset) for the block reached at
+// each leaf, where the block holds the source values from position * blockCount on and offset is
+// its destination. At a DENSE level, the iteration is the index and the source position is
+// parentPosition * size + index. At a SPARSE_CSR level, the iteration is the source position,
+// which ranges over the array segment of the parent position, and the index is read from the
+// array indices.
+template <typename Fn>
+void forEachBlock(const DensifyPlan& plan, uint32_t begin, uint32_t end, const Fn& visitBlock) {
+    const uint32_t numLevels = plan.firstBlockLevel;
+    if (numLevels == 0) {
+        // The whole tensor is dense, only in a different order.
+        visitBlock(0, 0);
+        return;
     }
-    Shape destShape = context->getOutputShape(kOutputTensor);
-
-    // Organizing dimFormat, dimensions, dimMetadata into vectors
-    std::vector<int32_t> dimFormat(
-            inputShapes[kInputDimFormat].dimensions.front());  // size of dimFormatPtr
-    std::vector<int32_t> dimensions(dimFormat.size());
-    std::vector<std::vector<int32_t>> dimMetadata(2 * dimFormat.size());
-    for (size_t i = 0; i < dimFormat.size(); i++) {
-        dimFormat[i] = dimFormatPtr[i];
-        dimensions[i] = dimensionsPtr[i];
-        if (dimFormat[i] == 0) {
-            dimMetadata[i * 2] = {dimensions[i]};
+    std::vector<uint32_t> iteration(numLevels);
+    std::vector<uint32_t> iterationEnd(numLevels);
+    std::vector<uint64_t> parentPosition(numLevels, 0);
+    std::vector<uint64_t> baseOffset(numLevels, 0);
+    iteration[0] = begin;
+    iterationEnd[0] = end;
+    uint32_t level = 0;
+    while (true) {
+        if (iteration[level] == iterationEnd[level]) {
+            if (level == 0) break;
+            --level;
+            ++iteration[level];
+            continue;
+        }
+        const uint32_t i = iteration[level];
+        uint64_t position;
+        uint32_t index;
+        if (plan.dimFormat[level] == DENSE) {
+            index = i;
+            position = parentPosition[level] * plan.denseSizes[level] + i;
+        } else {
+            index = plan.arrayIndices[level][i];
+            position = i;
+        }
+        const uint64_t offset = baseOffset[level] + index * plan.levelStrides[level];
+        if (level + 1 == numLevels) {
+            visitBlock(position, offset);
+            ++iteration[level];
+            continue;
+        }
+        ++level;
+        parentPosition[level] = position;
+        baseOffset[level] = offset;
+        if (plan.dimFormat[level] == DENSE) {
+            iteration[level] = 0;
+            iterationEnd[level] = plan.denseSizes[level];
         } else {
-            dimMetadata[i * 2] =  // array segments
-                    arrToVector(dimMetadataPtrs[i * 2],
-                                inputShapes[i * 2 + kInputArrSeg].dimensions.front());
-            dimMetadata[i * 2 + 1] =  // array indices
-                    arrToVector(dimMetadataPtrs[i * 2 + 1],
-                                inputShapes[i * 2 + kInputArrIdx].dimensions.front());
+            iteration[level] = plan.arraySegments[level][position];
+            iterationEnd[level] = plan.arraySegments[level][position + 1];
         }
     }
+}
 
-    // Creating blockSize vector
-    const int origRank = destShape.dimensions.size();
-    std::vector<int32_t> blockSize(
-            inputShapes[kInputBlockMap].dimensions.front());  // size of block map
-    for (uint32_t i = 0; i < inputShapes[kInputBlockMap].dimensions.front(); i++) {
-        const int32_t origDim = traversalOrder[origRank + i];
-        blockSize[i] = dimensions[origDim];
-    }
+// Returns the range of iterations of the first level of the plan.
+std::pair<uint32_t, uint32_t> getFirstLevelRange(const DensifyPlan& plan) {
+    if (plan.firstBlockLevel == 0) return {0, 1};
+    if (plan.dimFormat[0] == DENSE) return {0, plan.denseSizes[0]};
+    return {plan.arraySegments[0][0], plan.arraySegments[0][1]};
+}
 
-    // Calculating the number of output entries
-    const size_t denseTotal =
-            std::accumulate(destShape.dimensions.begin(), destShape.dimensions.end(),
-                            static_cast<size_t>(1), std::multiplies<>{});
-    T zeroPoint = T();
-    if (const OperandType type = inputShapes.front().type;
-        type == OperandType::TENSOR_QUANT8_ASYMM ||
-        type == OperandType::TENSOR_QUANT8_ASYMM_SIGNED ||
-        type == OperandType::TENSOR_QUANT16_ASYMM) {
-        zeroPoint = static_cast<T>(inputShapes.front().offset);
-    }
+template <typename T>
+void decode(const DensifyPlan& plan, const T* srcData, uint64_t numValues, T* destData) {
+    const auto [begin, end] = getFirstLevelRange(plan);
+    const uint32_t count = end - begin;
+    // Assumes the values are spread evenly over the first level.
+    const uint64_t valuesPerIteration = std::max<uint64_t>(1, numValues / std::max(1u, count));
+    const uint32_t minChunkSize = static_cast<uint32_t>(
+            std::min<uint64_t>(count, kMinValuesPerThread / valuesPerIteration + 1));
+    parallelFor(count, minChunkSize, [&](uint32_t chunkBegin, uint32_t chunkEnd) {
+        std::vector<uint32_t> blockIndex;
+        forEachBlock(plan, begin + chunkBegin, begin + chunkEnd,
+                     [&](uint64_t position, uint64_t offset) {
+                         copyBlock(plan, srcData + position * plan.blockCount, destData + offset,
+                                   &blockIndex);
+                     });
+    });
+}
 
-    T* destData = context->getOutputBuffer<T>(kOutputTensor);
-    for (size_t i = 0; i < denseTotal; i++) {
-        destData[i] = zeroPoint;
-    }
+// The dense tensor decoded from constant inputs, kept on the prepared model so that later
+// executions only copy it.
+struct DensifyState : public OperationState {
+    OperandType type;
+    std::vector<uint32_t> dimensions;
+    std::vector<uint8_t> denseData;
+};
 
-    std::vector<int32_t> indices(
-            inputShapes[kInputTravOrder].dimensions.front());  // size of traversal order
-    populate(srcData, &indices, 0u, 0u, destData, destShape.dimensions, dimFormat, traversalOrder,
-             blockSize, blockMap, dimMetadata, origRank);
+bool hasConstantInputs(IOperationExecutionContext* context) {
+    for (uint32_t i = 0; i < context->getNumInputs(); ++i) {
+        if (!context->isConstantInput(i) && !context->isOmittedInput(i)) return false;
+    }
     return true;
 }
 
-bool prepare(IOperationExecutionContext* context) {
-    // Setting OutputShape
-    Shape destShape = context->getInputShape(kInputTensor);
+}  // namespace
 
-    const int32_t* traversalOrder = context->getInputBuffer<int32_t>(kInputTravOrder);
-    const int32_t* blockMap = context->getInputBuffer<int32_t>(kInputBlockMap);
-    const int32_t* dimensions = context->getInputBuffer<int32_t>(kInputDimensions);
-    Shape dimensionsShape = context->getInputShape(kInputDimensions);
-    Shape blockMapShape = context->getInputShape(kInputBlockMap);
-    const uint32_t origRank = dimensionsShape.dimensions.front() - blockMapShape.dimensions.front();
+std::vector<uint32_t> getDenseDimensions(const int32_t* traversalOrder, const int32_t* blockMap,
+                                         const int32_t* dimensions, uint32_t numLevels,
+                                         uint32_t numBlocks) {
+    const uint32_t origRank = numLevels - numBlocks;
     std::vector<uint32_t> destDims(origRank);
-
-    size_t i = 0;
-    for (; i < destDims.size(); i++) {
+    uint32_t i = 0;
+    for (; i < origRank; i++) {
         const int32_t origDim = traversalOrder[i];
         destDims[origDim] = dimensions[i];
     }
-    for (; i < dimensionsShape.dimensions.front(); i++) {
+    for (; i < numLevels; i++) {
         const int32_t traversalIdx = traversalOrder[i] - origRank;
         const int32_t origDim = blockMap[traversalIdx];
         destDims[origDim] *= dimensions[i];
     }
-    destShape.dimensions = destDims;
+    return destDims;
+}
+
+bool getCompressedRows(const std::vector<Shape>& inputShapes,
+                       const std::vector<const void*>& inputBuffers, CompressedRows* rows) {
+    NN_RET_CHECK_EQ(inputShapes[kInputTensor].type, OperandType::TENSOR_FLOAT32);
+    const uint32_t numLevels = getSizeOfDimension(inputShapes[kInputDimFormat], 0);
+    const std::vector<uint32_t> destDims = getDenseDimensions(
+            static_cast<const int32_t*>(inputBuffers[kInputTravOrder]),
+            static_cast<const int32_t*>(inputBuffers[kInputBlockMap]),
+            static_cast<const int32_t*>(inputBuffers[kInputDimensions]), numLevels,
+            getSizeOfDimension(inputShapes[kInputBlockMap], 0));
+    NN_RET_CHECK_EQ(destDims.size(), 2u);
+    const uint32_t numRows = destDims[0];
+    const uint32_t numColumns = destDims[1];
+    const DensifyPlan plan = makePlan(inputBuffers, numLevels, destDims);
+    const auto* srcData = static_cast<const float*>(inputBuffers[kInputTensor]);
+
+    // Collects the runs in source order, splitting those that wrap around to the next row.
+    struct Run {
+        uint32_t row;
+        uint32_t column;
+        uint32_t length;
+        uint64_t srcOffset;
+    };
+    std::vector<Run> runs;
+    const uint32_t innerSize = plan.blockSizes.back();
+    const uint64_t innerStride = plan.blockStrides.back();
+    const auto addRun = [&](uint64_t destOffset, uint32_t length, uint64_t srcOffset) {
+        while (length > 0) {
+            const uint32_t row = destOffset / numColumns;
+            const uint32_t column = destOffset % numColumns;
+            const uint32_t rowLength = std::min(length, numColumns - column);
+            runs.push_back({row, column, rowLength, srcOffset});
+            destOffset += rowLength;
+            srcOffset += rowLength;
+            length -= rowLength;
+        }
+    };
+    std::vector<uint32_t> blockIndex;
+    const auto [begin, end] = getFirstLevelRange(plan);
+    forEachBlock(plan, begin, end, [&](uint64_t position, uint64_t blockOffset) {
+        forEachBlockRow(plan, &blockIndex, [&](uint64_t row, uint64_t offset) {
+            const uint64_t srcOffset = position * plan.blockCount + row * innerSize;
+            if (innerStride == 1) {
+                addRun(blockOffset + offset, innerSize, srcOffset);
+            } else {
+                for (uint32_t i = 0; i < innerSize; ++i) {
+                    addRun(blockOffset + offset + i * innerStride, 1, srcOffset + i);
+                }
+            }
+        });
+    });
+    std::sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) {
+        return a.row != b.row ? a.row < b.row : a.column < b.column;
+    });
+
+    // Lays out the values in row-major order, merging runs of adjacent columns.
+    *rows = CompressedRows();
+    rows->rowRuns.assign(numRows + 1, 0);
+    for (const Run& run : runs) {
+        rows->values.insert(rows->values.end(), srcData + run.srcOffset,
+                            srcData + run.srcOffset + run.length);
+        if (!rows->runColumns.empty() && rows->rowRuns[run.row + 1] > 0 &&
+            rows->runColumns.back() + rows->runLengths.back() == run.column) {
+            rows->runLengths.back() += run.length;
+            continue;
+        }
+        rows->runColumns.push_back(run.column);
+        rows->runLengths.push_back(run.length);
+        rows->runOffsets.push_back(rows->values.size() - run.length);
+        rows->rowRuns[run.row + 1]++;
+    }
+    for (uint32_t row = 0; row < numRows; ++row) {
+        rows->rowRuns[row + 1] += rows->rowRuns[row];
+    }
+    return true;
+}
+
+template <typename T>
+inline bool densify(IOperationExecutionContext* context) {
+    const Shape srcShape = context->getInputShape(kInputTensor);
+    const Shape destShape = context->getOutputShape(kOutputTensor);
+    T* destData = context->getOutputBuffer<T>(kOutputTensor);
+    const size_t denseBytes = getNumberOfElements(destShape) * sizeof(T);
+
+    const bool isConstant = hasConstantInputs(context);
+    if (isConstant) {
+        auto cached = context->getCachedState<DensifyState>();
+        if (cached != nullptr && cached->type == destShape.type &&
+            cached->dimensions == destShape.dimensions) {
+            memcpy(destData, cached->denseData.data(), denseBytes);
+            return true;
+        }
+    }
+
+    T zeroPoint = T();
+    if (srcShape.type == OperandType::TENSOR_QUANT8_ASYMM ||
+        srcShape.type == OperandType::TENSOR_QUANT8_ASYMM_SIGNED ||
+        srcShape.type == OperandType::TENSOR_QUANT16_ASYMM) {
+        zeroPoint = static_cast<T>(srcShape.offset);
+    }
+    std::fill(destData, destData + getNumberOfElements(destShape), zeroPoint);
+    std::vector<const void*> inputBuffers(context->getNumInputs());
+    for (uint32_t i = 0; i < inputBuffers.size(); ++i) {
+        inputBuffers[i] = context->getInputBuffer(i);
+    }
+    const uint32_t numLevels = getSizeOfDimension(context->getInputShape(kInputDimFormat), 0);
+    decode(makePlan(inputBuffers, numLevels, destShape.dimensions),
+           context->getInputBuffer<T>(kInputTensor), getNumberOfElements(srcShape), destData);
+
+    if (isConstant) {
+        auto state = std::make_shared<DensifyState>();
+        state->type = destShape.type;
+        state->dimensions = destShape.dimensions;
+        const uint8_t* denseData = reinterpret_cast<const uint8_t*>(destData);
+        state->denseData.assign(denseData, denseData + denseBytes);
+        context->setCachedState(state);
+    }
+    return true;
+}
+
+bool prepare(IOperationExecutionContext* context) {
+    // Setting OutputShape
+    Shape destShape = context->getInputShape(kInputTensor);
+    destShape.dimensions = getDenseDimensions(
+            context->getInputBuffer<int32_t>(kInputTravOrder),
+            context->getInputBuffer<int32_t>(kInputBlockMap),
+            context->getInputBuffer<int32_t>(kInputDimensions),
+            getSizeOfDimension(context->getInputShape(kInputDimensions), 0),
+            getSizeOfDimension(context->getInputShape(kInputBlockMap), 0));
     return context->setOutputShape(kOutputTensor, destShape);
 }
 
@@ -266,6 +451,8 @@ bool execute(IOperationExecutionContext* context) {
     }
 }
 
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+
 }  // namespace densify_op
 
 NN_REGISTER_OPERATION_DEFAULT_VALIDATION(DENSIFY, densify_op::prepare, densify_op::execute,
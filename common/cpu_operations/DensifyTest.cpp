@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef NN_EXPERIMENTAL_FEATURE
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ActivationFunctor.h"
+#include "Densify.h"
+#include "FullyConnected.h"
+#include "OperationTestUtils.h"
+
+namespace android {
+namespace nn {
+namespace {
+
+using densify_op::DENSE;
+using densify_op::SPARSE_CSR;
+
+// The inputs of a DENSIFY operation, other than the values tensor, for a dense tensor encoded by
+// encode().
+struct SparseFormat {
+    std::vector<int32_t> traversalOrder;
+    std::vector<int32_t> blockMap;
+    std::vector<int32_t> dimFormat;
+    std::vector<int32_t> dimensions;
+    // Indexed by level. Empty for a DENSE level.
+    std::vector<std::vector<int32_t>> arraySegments;
+    std::vector<std::vector<int32_t>> arrayIndices;
+};
+
+// Encodes dense, of dimensions denseDims, the way DENSIFY decodes it. Each of the first
+// denseDims.size() levels walks dimension traversalOrder[l] in units of blocks. Each following
+// level walks block b = traversalOrder[l] - denseDims.size() of dimension blockMap[b], whose size
+// is blockSizes[b]. A SPARSE_CSR level only keeps the indexes under which some value differs from
+// zero. Returns the stored values.
+template <typename T>
+std::vector<T> encode(const std::vector<T>& dense, const std::vector<uint32_t>& denseDims,
+                      const std::vector<int32_t>& traversalOrder,
+                      const std::vector<int32_t>& blockMap, const std::vector<int32_t>& blockSizes,
+                      const std::vector<int32_t>& dimFormat, T zero, SparseFormat* format) {
+    const uint32_t origRank = denseDims.size();
+    const uint32_t numLevels = traversalOrder.size();
+    *format = {.traversalOrder = traversalOrder,
+               .blockMap = blockMap,
+               .dimFormat = dimFormat,
+               .dimensions = std::vector<int32_t>(numLevels),
+               .arraySegments = std::vector<std::vector<int32_t>>(numLevels),
+               .arrayIndices = std::vector<std::vector<int32_t>>(numLevels)};
+    std::vector<uint32_t> blockedDims = denseDims;
+    for (uint32_t b = 0; b < blockMap.size(); ++b) {
+        blockedDims[blockMap[b]] /= blockSizes[b];
+    }
+    for (uint32_t level = 0; level < numLevels; ++level) {
+        format->dimensions[level] = level < origRank ? blockedDims[traversalOrder[level]]
+                                                     : blockSizes[traversalOrder[level] - origRank];
+        if (dimFormat[level] == SPARSE_CSR) {
+            format->arraySegments[level] = {0};
+        }
+    }
+
+    std::vector<int32_t> index(numLevels);
+    auto denseValue = [&]() {
+        std::vector<uint32_t> origIndex(origRank);
+        for (uint32_t level = 0; level < origRank; ++level) {
+            origIndex[traversalOrder[level]] = index[level];
+        }
+        for (uint32_t level = origRank; level < numLevels; ++level) {
+            const int32_t b = traversalOrder[level] - origRank;
+            origIndex[blockMap[b]] = origIndex[blockMap[b]] * blockSizes[b] + index[level];
+        }
+        uint64_t offset = 0;
+        for (uint32_t d = 0; d < origRank; ++d) {
+            offset = offset * denseDims[d] + origIndex[d];
+        }
+        return dense[offset];
+    };
+    std::function<bool(uint32_t)> hasValues = [&](uint32_t level) {
+        if (level == numLevels) return denseValue() != zero;
+        for (index[level] = 0; index[level] < format->dimensions[level]; ++index[level]) {
+            if (hasValues(level + 1)) return true;
+        }
+        return false;
+    };
+    std::vector<T> values;
+    std::function<void(uint32_t)> store = [&](uint32_t level) {
+        if (level == numLevels) {
+            values.push_back(denseValue());
+            return;
+        }
+        for (int32_t i = 0; i < format->dimensions[level]; ++i) {
+            index[level] = i;
+            if (dimFormat[level] == SPARSE_CSR) {
+                if (!hasValues(level + 1)) continue;
+                index[level] = i;
+                format->arrayIndices[level].push_back(i);
+            }
+            store(level + 1);
+        }
+        if (dimFormat[level] == SPARSE_CSR) {
+            format->arraySegments[level].push_back(format->arrayIndices[level].size());
+        }
+    };
+    store(0);
+    return values;
+}
+
+// The inputs of a DENSIFY operation.
+template <typename T>
+std::vector<TestOperand> makeDensifyInputs(OperandType type, const std::vector<T>& values,
+                                           const SparseFormat& format, int32_t zeroPoint = 0) {
+    std::vector<TestOperand> inputs = {
+            makeTensor(type, values, zeroPoint),
+            makeTensor(OperandType::TENSOR_INT32, format.traversalOrder),
+            makeTensor(OperandType::TENSOR_INT32, format.blockMap),
+            makeTensor(OperandType::TENSOR_INT32, format.dimFormat),
+            makeTensor(OperandType::TENSOR_INT32, format.dimensions)};
+    for (uint32_t level = 0; level < format.dimFormat.size(); ++level) {
+        if (format.dimFormat[level] == DENSE) {
+            inputs.push_back({.omitted = true});
+            inputs.push_back({.omitted = true});
+        } else {
+            inputs.push_back(makeTensor(OperandType::TENSOR_INT32, format.arraySegments[level]));
+            inputs.push_back(makeTensor(OperandType::TENSOR_INT32, format.arrayIndices[level]));
+        }
+    }
+    return inputs;
+}
+
+// Returns a tensor of the given size where each element is zero with probability 1 - density and
+// otherwise a random value that differs from zero.
+template <typename T>
+std::vector<T> makeRandomTensor(uint64_t size, double density, T zero, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::bernoulli_distribution isStored(density);
+    std::uniform_int_distribution<int32_t> valueDistribution(1, 100);
+    std::vector<T> tensor(size, zero);
+    for (T& value : tensor) {
+        if (isStored(generator)) {
+            value = static_cast<T>(zero + valueDistribution(generator));
+        }
+    }
+    return tensor;
+}
+
+// Encodes dense in the given format, decodes it with DENSIFY, and expects dense back.
+template <typename T>
+void expectRoundTrip(OperandType type, const std::vector<T>& dense,
+                     const std::vector<uint32_t>& denseDims,
+                     const std::vector<int32_t>& traversalOrder,
+                     const std::vector<int32_t>& blockMap, const std::vector<int32_t>& blockSizes,
+                     const std::vector<int32_t>& dimFormat, T zero = T()) {
+    SparseFormat format;
+    const std::vector<T> values = encode(dense, denseDims, traversalOrder, blockMap, blockSizes,
+                                         dimFormat, zero, &format);
+    TestContext context(makeDensifyInputs(type, values, format, static_cast<int32_t>(zero)),
+                        {.type = type}, sizeof(T), /*constantInputs=*/false, /*cache=*/nullptr);
+    ASSERT_TRUE(runOperation(OperationType::DENSIFY, &context));
+    EXPECT_EQ(context.getOutputShape(0).dimensions, denseDims);
+    EXPECT_EQ(context.getOutput<T>(), dense);
+}
+
+TEST(DensifyTest, Csr) {
+    const std::vector<uint32_t> dims = {6, 9};
+    const auto dense = makeRandomTensor<float>(6 * 9, 0.3, 0.0f, 1);
+    expectRoundTrip(OperandType::TENSOR_FLOAT32, dense, dims, {0, 1}, {}, {}, {DENSE, SPARSE_CSR});
+}
+
+TEST(DensifyTest, Bsr) {
+    // 2x3 blocks, of which whole blocks are zero.
+    const std::vector<uint32_t> dims = {8, 12};
+    std::vector<float> dense = makeRandomTensor<float>(8 * 12, 0.9, 0.0f, 2);
+    for (uint32_t row = 0; row < 8; ++row) {
+        for (uint32_t column = 0; column < 12; ++column) {
+            if ((row / 2 + column / 3) % 3 == 0) dense[row * 12 + column] = 0.0f;
+        }
+    }
+    expectRoundTrip(OperandType::TENSOR_FLOAT32, dense, dims, {0, 1, 2, 3}, {0, 1}, {2, 3},
+                    {DENSE, SPARSE_CSR, DENSE, DENSE});
+}
+
+TEST(DensifyTest, PermutedTraversalOrder) {
+    const std::vector<uint32_t> dims = {3, 4, 5};
+    const auto dense = makeRandomTensor<int32_t>(3 * 4 * 5, 0.4, 0, 3);
+    expectRoundTrip(OperandType::TENSOR_INT32, dense, dims, {2, 0, 1}, {}, {},
+                    {SPARSE_CSR, DENSE, SPARSE_CSR});
+}
+
+TEST(DensifyTest, SparseBlockLevels) {
+    // 4x2 blocks, with the block levels themselves sparse.
+    const std::vector<uint32_t> dims = {8, 6};
+    const auto dense = makeRandomTensor<float>(8 * 6, 0.3, 0.0f, 4);
+    expectRoundTrip(OperandType::TENSOR_FLOAT32, dense, dims, {1, 0, 2, 3}, {0, 1}, {4, 2},
+                    {DENSE, DENSE, SPARSE_CSR, SPARSE_CSR});
+}
+
+TEST(DensifyTest, QuantizedZeroPoint) {
+    // The elements that are not stored take the zero point.
+    const std::vector<uint32_t> dims = {5, 7};
+    const auto dense = makeRandomTensor<uint8_t>(5 * 7, 0.3, 128, 5);
+    expectRoundTrip<uint8_t>(OperandType::TENSOR_QUANT8_ASYMM, dense, dims, {0, 1}, {}, {},
+                             {DENSE, SPARSE_CSR}, 128);
+}
+
+TEST(DensifyTest, LargeTensorDecodedInParallel) {
+    const std::vector<uint32_t> dims = {512, 1024};
+    const auto dense = makeRandomTensor<float>(512 * 1024, 0.1, 0.0f, 6);
+    expectRoundTrip(OperandType::TENSOR_FLOAT32, dense, dims, {0, 1}, {}, {}, {DENSE, SPARSE_CSR});
+}
+
+TEST(DensifyTest, NoStoredValues) {
+    const std::vector<uint32_t> dims = {4, 5};
+    const std::vector<float> dense(4 * 5, 0.0f);
+    expectRoundTrip(OperandType::TENSOR_FLOAT32, dense, dims, {0, 1}, {}, {}, {DENSE, SPARSE_CSR});
+    expectRoundTrip(OperandType::TENSOR_FLOAT32, dense, dims, {0, 1}, {}, {},
+                    {SPARSE_CSR, SPARSE_CSR});
+}
+
+TEST(DensifyTest, ZeroSizedDimension) {
+    const std::vector<uint32_t> dims = {0, 5};
+    const std::vector<float> dense;
+    expectRoundTrip(OperandType::TENSOR_FLOAT32, dense, dims, {0, 1}, {}, {}, {DENSE, SPARSE_CSR});
+}
+
+TEST(DensifyTest, ConstantInputsAreDecodedOnce) {
+    const std::vector<uint32_t> dims = {6, 9};
+    const auto dense = makeRandomTensor<float>(6 * 9, 0.3, 0.0f, 7);
+    SparseFormat format;
+    const std::vector<float> values =
+            encode(dense, dims, {0, 1}, {}, {}, {DENSE, SPARSE_CSR}, 0.0f, &format);
+    OperationStateCache cache;
+    TestContext context(makeDensifyInputs(OperandType::TENSOR_FLOAT32, values, format),
+                        {.type = OperandType::TENSOR_FLOAT32}, sizeof(float),
+                        /*constantInputs=*/true, &cache);
+    ASSERT_TRUE(runOperation(OperationType::DENSIFY, &context));
+    EXPECT_EQ(context.getOutput<float>(), dense);
+    ASSERT_NE(context.getCachedState(), nullptr);
+
+    // Later executions copy the cached tensor rather than decode the values again.
+    memset(context.getInput(densify_op::kInputTensor)->data.data(), 0,
+           context.getInput(densify_op::kInputTensor)->data.size());
+    ASSERT_TRUE(runOperation(OperationType::DENSIFY, &context));
+    EXPECT_EQ(context.getOutput<float>(), dense);
+}
+
+TEST(DensifyTest, NonConstantInputsAreNotCached) {
+    const std::vector<uint32_t> dims = {6, 9};
+    const auto dense = makeRandomTensor<float>(6 * 9, 0.3, 0.0f, 8);
+    SparseFormat format;
+    const std::vector<float> values =
+            encode(dense, dims, {0, 1}, {}, {}, {DENSE, SPARSE_CSR}, 0.0f, &format);
+    OperationStateCache cache;
+    TestContext context(makeDensifyInputs(OperandType::TENSOR_FLOAT32, values, format),
+                        {.type = OperandType::TENSOR_FLOAT32}, sizeof(float),
+                        /*constantInputs=*/false, &cache);
+    ASSERT_TRUE(runOperation(OperationType::DENSIFY, &context));
+    EXPECT_EQ(context.getOutput<float>(), dense);
+    EXPECT_EQ(context.getCachedState(), nullptr);
+}
+
+// Weights of a FULLY_CONNECTED with numUnits rows of inputSize values, as the DENSIFY operands
+// that the executor hands to it in place of the dense weights.
+class SparseWeights {
+   public:
+    SparseWeights(const std::vector<float>& dense, uint32_t numUnits, uint32_t inputSize,
+                  const std::vector<int32_t>& blockSizes) {
+        const bool blocked = !blockSizes.empty();
+        const std::vector<int32_t> traversalOrder =
+                blocked ? std::vector<int32_t>{0, 1, 2, 3} : std::vector<int32_t>{0, 1};
+        const std::vector<int32_t> blockMap = blocked ? std::vector<int32_t>{0, 1}
+                                                      : std::vector<int32_t>{};
+        const std::vector<int32_t> dimFormat =
+                blocked ? std::vector<int32_t>{DENSE, SPARSE_CSR, DENSE, DENSE}
+                        : std::vector<int32_t>{DENSE, SPARSE_CSR};
+        SparseFormat format;
+        const std::vector<float> values = encode(dense, {numUnits, inputSize}, traversalOrder,
+                                                 blockMap, blockSizes, dimFormat, 0.0f, &format);
+        mOperands = makeDensifyInputs(OperandType::TENSOR_FLOAT32, values, format);
+        for (const TestOperand& operand : mOperands) {
+            mSparse.shapes.push_back(operand.shape);
+            mSparse.buffers.push_back(operand.omitted ? nullptr : operand.data.data());
+        }
+    }
+
+    const SparseTensor& get() const { return mSparse; }
+    TestOperand* getValues() { return &mOperands[densify_op::kInputTensor]; }
+
+   private:
+    std::vector<TestOperand> mOperands;
+    SparseTensor mSparse;
+};
+
+std::vector<float> makeRandomFloats(uint64_t size, double density, uint32_t seed) {
+    std::vector<float> values = makeRandomTensor<float>(size, density, 0.0f, seed);
+    for (float& value : values) {
+        if (value != 0.0f) value = (value - 50.5f) / 50.0f;
+    }
+    return values;
+}
+
+// Runs a float FULLY_CONNECTED, with the weights given either as a dense tensor or as the operands
+// of a DENSIFY, and returns its output.
+std::vector<float> runFullyConnected(const std::vector<float>& input, uint32_t batchSize,
+                                     const std::vector<float>& denseWeights,
+                                     const SparseWeights* sparseWeights, uint32_t numUnits,
+                                     const std::vector<float>& bias, int32_t activation,
+                                     OperationStateCache* cache = nullptr) {
+    const uint32_t inputSize = input.size() / batchSize;
+    std::vector<TestOperand> inputs = {
+            makeTensor(OperandType::TENSOR_FLOAT32, input),
+            makeTensor(OperandType::TENSOR_FLOAT32,
+                       sparseWeights != nullptr ? std::vector<float>() : denseWeights),
+            makeTensor(OperandType::TENSOR_FLOAT32, bias), makeScalar(activation)};
+    inputs[fully_connected::kInputTensor].shape.dimensions = {batchSize, inputSize};
+    inputs[fully_connected::kWeightsTensor].shape.dimensions = {numUnits, inputSize};
+    inputs[fully_connected::kWeightsTensor].sparse =
+            sparseWeights != nullptr ? &sparseWeights->get() : nullptr;
+    // Weights that are not constant run the unpacked float kernel, which serves as the reference.
+    TestContext context(std::move(inputs), {.type = OperandType::TENSOR_FLOAT32}, sizeof(float),
+                        /*constantInputs=*/sparseWeights != nullptr, cache);
+    EXPECT_TRUE(runOperation(OperationType::FULLY_CONNECTED, &context));
+    EXPECT_EQ(context.getOutputShape(0).dimensions,
+              (std::vector<uint32_t>{batchSize, numUnits}));
+    return context.getOutput<float>();
+}
+
+void expectNear(const std::vector<float>& actual, const std::vector<float>& expected) {
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+        EXPECT_NEAR(actual[i], expected[i], 1e-5f * std::max(1.0f, std::abs(expected[i])))
+                << "element " << i;
+    }
+}
+
+// Expects sparse FULLY_CONNECTED to compute what the dense kernel computes on the same weights.
+void expectSparseMatchesDense(uint32_t batchSize, uint32_t numUnits, uint32_t inputSize,
+                              double density, const std::vector<int32_t>& blockSizes,
+                              int32_t activation) {
+    std::vector<float> weights = makeRandomFloats(numUnits * inputSize, density, 1);
+    // A unit without any stored weight only gets its bias.
+    std::fill(weights.begin(), weights.begin() + inputSize, 0.0f);
+    const std::vector<float> input = makeRandomFloats(batchSize * inputSize, 1.0, 2);
+    const std::vector<float> bias = makeRandomFloats(numUnits, 1.0, 3);
+    const SparseWeights sparseWeights(weights, numUnits, inputSize, blockSizes);
+    const std::vector<float> expected = runFullyConnected(input, batchSize, weights, nullptr,
+                                                          numUnits, bias, activation);
+    expectNear(runFullyConnected(input, batchSize, weights, &sparseWeights, numUnits, bias,
+                                 activation),
+               expected);
+}
+
+TEST(SparseFullyConnectedTest, CompressedRowsMatchDense) {
+    constexpr uint32_t kNumUnits = 16;
+    constexpr uint32_t kInputSize = 32;
+    const std::vector<float> weights = makeRandomFloats(kNumUnits * kInputSize, 0.3, 4);
+    for (const std::vector<int32_t>& blockSizes :
+         {std::vector<int32_t>{}, std::vector<int32_t>{1, 4}, std::vector<int32_t>{4, 4}}) {
+        SCOPED_TRACE(testing::Message() << "blocks of " << blockSizes.size() << " dimensions");
+        const SparseWeights sparseWeights(weights, kNumUnits, kInputSize, blockSizes);
+        densify_op::CompressedRows rows;
+        ASSERT_TRUE(densify_op::getCompressedRows(sparseWeights.get().shapes,
+                                                  sparseWeights.get().buffers, &rows));
+        ASSERT_EQ(rows.rowRuns.size(), kNumUnits + 1);
+        std::vector<float> dense(kNumUnits * kInputSize, 0.0f);
+        for (uint32_t row = 0; row < kNumUnits; ++row) {
+            for (uint32_t run = rows.rowRuns[row]; run < rows.rowRuns[row + 1]; ++run) {
+                if (run > rows.rowRuns[row]) {
+                    // Runs are in increasing column order, and adjacent runs are merged.
+                    EXPECT_GT(rows.runColumns[run],
+                              rows.runColumns[run - 1] + rows.runLengths[run - 1]);
+                }
+                for (uint32_t i = 0; i < rows.runLengths[run]; ++i) {
+                    dense[row * kInputSize + rows.runColumns[run] + i] =
+                            rows.values[rows.runOffsets[run] + i];
+                }
+            }
+        }
+        EXPECT_EQ(dense, weights);
+    }
+}
+
+TEST(SparseFullyConnectedTest, Csr) {
+    expectSparseMatchesDense(3, 16, 32, 0.3, {}, kActivationNone);
+}
+
+TEST(SparseFullyConnectedTest, Bsr) {
+    expectSparseMatchesDense(3, 16, 32, 0.3, {1, 4}, kActivationRelu);
+    expectSparseMatchesDense(3, 16, 32, 0.3, {4, 4}, kActivationRelu6);
+}
+
+TEST(SparseFullyConnectedTest, LargeWeightsRunInParallel) {
+    expectSparseMatchesDense(4, 1024, 512, 0.1, {}, kActivationNone);
+}
+
+TEST(SparseFullyConnectedTest, NoStoredWeights) {
+    expectSparseMatchesDense(2, 8, 16, 0.0, {}, kActivationNone);
+}
+
+TEST(SparseFullyConnectedTest, CompressedRowsAreCached) {
+    constexpr uint32_t kBatchSize = 2;
+    constexpr uint32_t kNumUnits = 8;
+    constexpr uint32_t kInputSize = 16;
+    const std::vector<float> weights = makeRandomFloats(kNumUnits * kInputSize, 0.5, 5);
+    const std::vector<float> input = makeRandomFloats(kBatchSize * kInputSize, 1.0, 6);
+    const std::vector<float> bias = makeRandomFloats(kNumUnits, 1.0, 7);
+    SparseWeights sparseWeights(weights, kNumUnits, kInputSize, {});
+    OperationStateCache cache;
+    const std::vector<float> first =
+            runFullyConnected(input, kBatchSize, weights, &sparseWeights, kNumUnits, bias,
+                              kActivationNone, &cache);
+    ASSERT_NE(cache.get({0, 0}), nullptr);
+
+    // Later executions use the cached rows rather than read the DENSIFY operands again.
+    TestOperand* values = sparseWeights.getValues();
+    memset(values->data.data(), 0, values->data.size());
+    EXPECT_EQ(runFullyConnected(input, kBatchSize, weights, &sparseWeights, kNumUnits, bias,
+                                kActivationNone, &cache),
+              first);
+}
+
+}  // namespace
+}  // namespace nn
+}  // namespace android
+
+#endif  // NN_EXPERIMENTAL_FEATURE
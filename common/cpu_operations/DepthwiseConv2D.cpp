@@ -29,10 +29,10 @@
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-parameter"
 #include <tensorflow/lite/kernels/internal/optimized/depthwiseconv_uint8.h>
-#include <tensorflow/lite/kernels/internal/reference/depthwiseconv_float.h>
 #pragma clang diagnostic pop
 
 #include "CpuOperationUtils.h"
+#include "QuantUtils.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -126,37 +126,218 @@ struct DepthwiseConv2dParam {
     uint32_t paddingHeight = (uint32_t)paddingTop;                               \
     uint32_t paddingWidth = (uint32_t)paddingLeft;
 
+// Minimum number of multiply-accumulates assigned to one thread.
+constexpr uint32_t kMinMacsPerThread = 64 * 1024;
+
+// Float depthwise convolution over NHWC tensors. Output rows are independent and are split across
+// threads. Every filter tap is applied to all channels of an input pixel at once, so the inner
+// loops walk contiguous memory. For the common 3x3 and 5x5 filters with stride 1 or 2, no
+// dilation and a depth multiplier of 1, output pixels whose window lies fully inside the input are
+// computed by a kernel with the filter size and stride known at compile time, which keeps a block
+// of channel accumulators in registers across all taps.
+class DepthwiseConvFloatKernel {
+   public:
+    DepthwiseConvFloatKernel(const float* inputData, const Shape& inputShape,
+                             const float* filterData, const Shape& filterShape,
+                             const float* biasData, int32_t paddingLeft, int32_t paddingTop,
+                             int32_t strideWidth, int32_t strideHeight,
+                             int32_t dilationWidthFactor, int32_t dilationHeightFactor,
+                             int32_t depthMultiplier, int32_t activation, float* outputData,
+                             const Shape& outputShape)
+        : mInput(inputData),
+          mFilter(filterData),
+          mBias(biasData),
+          mOutput(outputData),
+          mInputHeight(getSizeOfDimension(inputShape, 1)),
+          mInputWidth(getSizeOfDimension(inputShape, 2)),
+          mInputDepth(getSizeOfDimension(inputShape, 3)),
+          mFilterHeight(getSizeOfDimension(filterShape, 1)),
+          mFilterWidth(getSizeOfDimension(filterShape, 2)),
+          mOutputHeight(getSizeOfDimension(outputShape, 1)),
+          mOutputWidth(getSizeOfDimension(outputShape, 2)),
+          mOutputDepth(getSizeOfDimension(outputShape, 3)),
+          mPaddingLeft(paddingLeft),
+          mPaddingTop(paddingTop),
+          mStrideWidth(strideWidth),
+          mStrideHeight(strideHeight),
+          mDilationWidth(dilationWidthFactor),
+          mDilationHeight(dilationHeightFactor),
+          mDepthMultiplier(depthMultiplier) {
+        CalculateActivationRangeFloat(activation, &mActivationMin, &mActivationMax);
+    }
+
+    void run(uint32_t numBatches) const {
+        const uint32_t numRows = numBatches * mOutputHeight;
+        const uint32_t macsPerRow = std::max<uint32_t>(
+                1, mOutputWidth * mOutputDepth * mFilterHeight * mFilterWidth);
+        const uint32_t minRowsPerThread = std::max<uint32_t>(1, kMinMacsPerThread / macsPerRow);
+        const RowFn interiorRowFn = getInteriorRowFn();
+        parallelFor(numRows, minRowsPerThread, [&](uint32_t rowBegin, uint32_t rowEnd) {
+            for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+                computeRow(row / mOutputHeight, row % mOutputHeight, interiorRowFn);
+            }
+        });
+    }
+
+   private:
+    using RowFn = void (DepthwiseConvFloatKernel::*)(const float* input, int32_t outXBegin,
+                                                      int32_t outXEnd, float* output) const;
+
+    // Returns the specialized kernel for output pixels whose window lies fully inside the input,
+    // or nullptr if this configuration has none.
+    RowFn getInteriorRowFn() const {
+        if (mDepthMultiplier != 1 || mDilationWidth != 1 || mDilationHeight != 1 ||
+            mFilterWidth != mFilterHeight || mStrideWidth != mStrideHeight) {
+            return nullptr;
+        }
+        if (mFilterWidth == 3 && mStrideWidth == 1) {
+            return &DepthwiseConvFloatKernel::computeInteriorRow<3, 1>;
+        }
+        if (mFilterWidth == 3 && mStrideWidth == 2) {
+            return &DepthwiseConvFloatKernel::computeInteriorRow<3, 2>;
+        }
+        if (mFilterWidth == 5 && mStrideWidth == 1) {
+            return &DepthwiseConvFloatKernel::computeInteriorRow<5, 1>;
+        }
+        if (mFilterWidth == 5 && mStrideWidth == 2) {
+            return &DepthwiseConvFloatKernel::computeInteriorRow<5, 2>;
+        }
+        return nullptr;
+    }
+
+    void computeRow(int32_t batch, int32_t outY, RowFn interiorRowFn) const {
+        float* outputRow = mOutput + (batch * mOutputHeight + outY) * mOutputWidth * mOutputDepth;
+        const int32_t inYOrigin = outY * mStrideHeight - mPaddingTop;
+        int32_t outXBegin = 0, outXEnd = 0;
+        if (interiorRowFn != nullptr && inYOrigin >= 0 &&
+            inYOrigin + mFilterHeight <= mInputHeight) {
+            // Output columns [outXBegin, outXEnd) read no padding.
+            outXBegin = std::min(mOutputWidth,
+                                 (mPaddingLeft + mStrideWidth - 1) / mStrideWidth);
+            const int32_t lastInteriorX = mInputWidth - mFilterWidth + mPaddingLeft;
+            outXEnd = lastInteriorX < 0 ? 0 : lastInteriorX / mStrideWidth + 1;
+            outXEnd = std::max(outXBegin, std::min(mOutputWidth, outXEnd));
+        }
+        for (int32_t outX = 0; outX < outXBegin; ++outX) {
+            computePixel(batch, outY, outX, outputRow + outX * mOutputDepth);
+        }
+        if (outXBegin < outXEnd) {
+            const float* input =
+                    mInput + ((batch * mInputHeight + inYOrigin) * mInputWidth +
+                              (outXBegin * mStrideWidth - mPaddingLeft)) *
+                                     mInputDepth;
+            (this->*interiorRowFn)(input, outXBegin, outXEnd, outputRow + outXBegin * mOutputDepth);
+        }
+        for (int32_t outX = outXEnd; outX < mOutputWidth; ++outX) {
+            computePixel(batch, outY, outX, outputRow + outX * mOutputDepth);
+        }
+    }
+
+    // Handles any filter size, stride, dilation and depth multiplier, skipping the taps that
+    // fall into the padding.
+    void computePixel(int32_t batch, int32_t outY, int32_t outX, float* output) const {
+        std::fill(output, output + mOutputDepth, 0.0f);
+        const int32_t inYOrigin = outY * mStrideHeight - mPaddingTop;
+        const int32_t inXOrigin = outX * mStrideWidth - mPaddingLeft;
+        for (int32_t filterY = 0; filterY < mFilterHeight; ++filterY) {
+            const int32_t inY = inYOrigin + filterY * mDilationHeight;
+            if (inY < 0 || inY >= mInputHeight) continue;
+            for (int32_t filterX = 0; filterX < mFilterWidth; ++filterX) {
+                const int32_t inX = inXOrigin + filterX * mDilationWidth;
+                if (inX < 0 || inX >= mInputWidth) continue;
+                const float* input =
+                        mInput + ((batch * mInputHeight + inY) * mInputWidth + inX) * mInputDepth;
+                const float* filter = mFilter + (filterY * mFilterWidth + filterX) * mOutputDepth;
+                if (mDepthMultiplier == 1) {
+                    for (int32_t c = 0; c < mOutputDepth; ++c) {
+                        output[c] += input[c] * filter[c];
+                    }
+                } else {
+                    for (int32_t ic = 0; ic < mInputDepth; ++ic) {
+                        const float value = input[ic];
+                        float* out = output + ic * mDepthMultiplier;
+                        const float* f = filter + ic * mDepthMultiplier;
+                        for (int32_t m = 0; m < mDepthMultiplier; ++m) {
+                            out[m] += value * f[m];
+                        }
+                    }
+                }
+            }
+        }
+        for (int32_t c = 0; c < mOutputDepth; ++c) {
+            output[c] = std::min(std::max(output[c] + mBias[c], mActivationMin), mActivationMax);
+        }
+    }
+
+    // Computes output pixels [outXBegin, outXEnd) of a row, where input points at the top-left
+    // corner of the window of the first of them. Requires a depth multiplier of 1.
+    template <int32_t kFilterSize, int32_t kStride>
+    void computeInteriorRow(const float* input, int32_t outXBegin, int32_t outXEnd,
+                            float* output) const {
+        constexpr int32_t kBlockSize = 8;
+        const int32_t depth = mOutputDepth;
+        const int32_t inputRowStride = mInputWidth * depth;
+        for (int32_t outX = outXBegin; outX < outXEnd; ++outX) {
+            int32_t c = 0;
+            for (; c + kBlockSize <= depth; c += kBlockSize) {
+                float acc[kBlockSize] = {};
+                for (int32_t filterY = 0; filterY < kFilterSize; ++filterY) {
+                    for (int32_t filterX = 0; filterX < kFilterSize; ++filterX) {
+                        const float* in = input + filterY * inputRowStride + filterX * depth + c;
+                        const float* f = mFilter + (filterY * kFilterSize + filterX) * depth + c;
+                        for (int32_t i = 0; i < kBlockSize; ++i) {
+                            acc[i] += in[i] * f[i];
+                        }
+                    }
+                }
+                for (int32_t i = 0; i < kBlockSize; ++i) {
+                    output[c + i] = std::min(std::max(acc[i] + mBias[c + i], mActivationMin),
+                                             mActivationMax);
+                }
+            }
+            for (; c < depth; ++c) {
+                float acc = 0.0f;
+                for (int32_t filterY = 0; filterY < kFilterSize; ++filterY) {
+                    for (int32_t filterX = 0; filterX < kFilterSize; ++filterX) {
+                        acc += input[filterY * inputRowStride + filterX * depth + c] *
+                               mFilter[(filterY * kFilterSize + filterX) * depth + c];
+                    }
+                }
+                output[c] = std::min(std::max(acc + mBias[c], mActivationMin), mActivationMax);
+            }
+            input += kStride * depth;
+            output += depth;
+        }
+    }
+
+    const float* mInput;
+    const float* mFilter;
+    const float* mBias;
+    float* mOutput;
+    int32_t mInputHeight, mInputWidth, mInputDepth;
+    int32_t mFilterHeight, mFilterWidth;
+    int32_t mOutputHeight, mOutputWidth, mOutputDepth;
+    int32_t mPaddingLeft, mPaddingTop;
+    int32_t mStrideWidth, mStrideHeight;
+    int32_t mDilationWidth, mDilationHeight;
+    int32_t mDepthMultiplier;
+    float mActivationMin, mActivationMax;
+};
+
 bool depthwiseConvNhwc(const float* inputData, const Shape& inputShape, const float* filterData,
-                       const Shape& filterShape, const float* biasData, const Shape& biasShape,
+                       const Shape& filterShape, const float* biasData, const Shape& /*biasShape*/,
                        int32_t paddingLeft, int32_t /*paddingRight*/, int32_t paddingTop,
                        int32_t /*paddingBottom*/, int32_t strideWidth, int32_t strideHeight,
                        int32_t dilationWidthFactor, int32_t dilationHeightFactor,
                        int32_t depthMultiplier, int32_t activation, float* outputData,
                        const Shape& outputShape) {
     NNTRACE_TRANS("depthwiseConvFloat32");
-
-    ANDROID_NN_DEPTHWISE_CONV_PARAMETERS
-
-    float output_activation_min, output_activation_max;
-    CalculateActivationRangeFloat(activation, &output_activation_min, &output_activation_max);
-
-    tflite::DepthwiseParams params{
-            .padding_values = {static_cast<int16>(paddingWidth), static_cast<int16>(paddingHeight),
-                               0 /*width_offset*/, 0 /*height_offset*/},
-            .stride_width = static_cast<int16>(strideWidth),
-            .stride_height = static_cast<int16>(strideHeight),
-            .dilation_width_factor = static_cast<int16>(dilationWidthFactor),
-            .dilation_height_factor = static_cast<int16>(dilationHeightFactor),
-            .depth_multiplier = static_cast<int16>(depthMultiplier),
-            .float_activation_min = output_activation_min,
-            .float_activation_max = output_activation_max,
-    };
-    NNTRACE_COMP_SWITCH("optimized_ops::DepthwiseConv");
-    tflite::reference_ops::DepthwiseConv(params, convertShapeToTflshape(inputShape), inputData,
-                                         convertShapeToTflshape(filterShape), filterData,
-                                         convertShapeToTflshape(biasShape), biasData,
-                                         convertShapeToTflshape(outputShape), outputData);
-
+    NNTRACE_COMP_SWITCH("DepthwiseConvFloatKernel::run");
+    DepthwiseConvFloatKernel(inputData, inputShape, filterData, filterShape, biasData, paddingLeft,
+                             paddingTop, strideWidth, strideHeight, dilationWidthFactor,
+                             dilationHeightFactor, depthMultiplier, activation, outputData,
+                             outputShape)
+            .run(getSizeOfDimension(inputShape, 0));
     return true;
 }
 
@@ -271,12 +452,12 @@ bool depthwiseConvNhwc(const int8_t* inputData, Shape inputShape, const int8_t*
 template <typename T>
 bool depthwiseConvQuant8PerChannelNhwc(
         const T* inputData, const Shape& inputShape, const int8_t* filterData,
-        const Shape& filterShape, const float* filterScales, const int32_t* biasData,
-        const Shape& biasShape, int32_t paddingLeft, int32_t /*paddingRight*/, int32_t paddingTop,
+        const Shape& filterShape, const int32_t* biasData, const Shape& /*biasShape*/,
+        int32_t paddingLeft, int32_t /*paddingRight*/, int32_t paddingTop,
         int32_t /*paddingBottom*/, int32_t strideWidth, int32_t strideHeight,
-        int32_t dilationWidthFactor, int32_t dilationHeightFactor,
-
-        int32_t depthMultiplier, int32_t activation, T* outputData, const Shape& outputShape) {
+        int32_t dilationWidthFactor, int32_t dilationHeightFactor, int32_t depthMultiplier,
+        const PerChannelRequantizationParams& requantParams, T* outputData,
+        const Shape& outputShape) {
     NNTRACE_TRANS("depthwiseConvQuant8");
 
     [[maybe_unused]] uint32_t paddingHeight = (uint32_t)paddingTop;
@@ -294,27 +475,9 @@ bool depthwiseConvQuant8PerChannelNhwc(
     uint32_t outputDepth = getSizeOfDimension(outputShape, 3);
 
     int32_t inputOffset = -inputShape.offset;
-    int32_t outputOffset = outputShape.offset;
-
-    auto realMultiplier = std::vector<double>(outputDepth, .0f);
-    auto outputMultiplier = std::vector<int32_t>(outputDepth, 0);
-    auto outputShift = std::vector<int32_t>(outputDepth, .0f);
-
-    for (uint32_t i = 0; i < outputDepth; ++i) {
-        Shape filterChannelShape = filterShape;
-        filterChannelShape.scale = filterScales[i];
-        Shape biasChannelShape = biasShape;
-        biasChannelShape.scale = filterScales[i] * inputShape.scale;
-        NN_RET_CHECK(GetQuantizedConvolutionMultiplier(
-                inputShape, filterChannelShape, biasChannelShape, outputShape, &realMultiplier[i]));
-        int exponent;
-        NN_RET_CHECK(QuantizeMultiplier(realMultiplier[i], &outputMultiplier[i], &exponent));
-        outputShift[i] = -exponent;
-    }
-
-    int32_t output_activation_min = 0, output_activation_max = 0;
-    CalculateActivationRange<T>(activation, outputShape, &output_activation_min,
-                                &output_activation_max);
+    int32_t outputOffset = requantParams.outputOffset;
+    int32_t output_activation_min = requantParams.outputActivationMin;
+    int32_t output_activation_max = requantParams.outputActivationMax;
 
     const T* inputBase = inputData;
     T* outPtr = outputData;
@@ -349,8 +512,8 @@ bool depthwiseConvQuant8PerChannelNhwc(
                         }
 
                         sum += biasData[oc];
-                        sum = tflite::MultiplyByQuantizedMultiplier(sum, outputMultiplier[oc],
-                                                                    -outputShift[oc]);
+                        sum = tflite::MultiplyByQuantizedMultiplier(
+                                sum, requantParams.multipliers[oc], requantParams.shifts[oc]);
                         sum += outputOffset;
                         sum = std::max(std::min(sum, output_activation_max), output_activation_min);
                         outPtr[m] = static_cast<T>(sum);
@@ -389,22 +552,22 @@ bool depthwiseConv(const T_Input* inputData, const Shape& inputShape, const T_Fi
 template <typename T>
 bool depthwiseConvQuant8PerChannel(const T* inputData, const Shape& inputShape,
                                    const int8_t* filterData, const Shape& filterShape,
-                                   const float* filterScales, const int32_t* biasData,
-                                   const Shape& biasShape, int32_t paddingLeft,
-                                   int32_t paddingRight, int32_t paddingTop, int32_t paddingBottom,
-                                   int32_t strideWidth, int32_t strideHeight,
-                                   int32_t dilationWidthFactor, int32_t dilationHeightFactor,
-                                   int32_t depthMultiplier, int32_t activation, bool useNchw,
-                                   T* outputData, const Shape& outputShape) {
+                                   const int32_t* biasData, const Shape& biasShape,
+                                   int32_t paddingLeft, int32_t paddingRight, int32_t paddingTop,
+                                   int32_t paddingBottom, int32_t strideWidth,
+                                   int32_t strideHeight, int32_t dilationWidthFactor,
+                                   int32_t dilationHeightFactor, int32_t depthMultiplier,
+                                   const PerChannelRequantizationParams& requantParams,
+                                   bool useNchw, T* outputData, const Shape& outputShape) {
     InputWithLayout<T> input(useNchw);
     OutputWithLayout<T> output(useNchw);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
     NN_RET_CHECK(depthwiseConvQuant8PerChannelNhwc(
-            input.getNhwcBuffer(), input.getNhwcShape(), filterData, filterShape, filterScales,
-            biasData, biasShape, paddingLeft, paddingRight, paddingTop, paddingBottom, strideWidth,
-            strideHeight, dilationWidthFactor, dilationHeightFactor, depthMultiplier, activation,
-            output.getNhwcBuffer(), output.getNhwcShape()));
+            input.getNhwcBuffer(), input.getNhwcShape(), filterData, filterShape, biasData,
+            biasShape, paddingLeft, paddingRight, paddingTop, paddingBottom, strideWidth,
+            strideHeight, dilationWidthFactor, dilationHeightFactor, depthMultiplier,
+            requantParams, output.getNhwcBuffer(), output.getNhwcShape()));
     NN_RET_CHECK(output.commit());
     return true;
 }
@@ -507,20 +670,21 @@ bool execute(IOperationExecutionContext* context) {
         case OperandType::TENSOR_QUANT8_ASYMM:
             if (context->getInputType(kFilterTensor) ==
                 OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL) {
+                const auto requantState = getPerChannelRequantizationState<uint8_t>(
+                        context, kInputTensor, kFilterTensor, kOutputTensor, param.activation);
+                NN_RET_CHECK(requantState != nullptr);
                 return depthwiseConvQuant8PerChannel(
                         context->getInputBuffer<uint8_t>(kInputTensor),
                         context->getInputShape(kInputTensor),
                         context->getInputBuffer<int8_t>(kFilterTensor),
                         context->getInputShape(kFilterTensor),
-                        std::get<Operand::SymmPerChannelQuantParams>(
-                                context->getInputExtraParams(kFilterTensor))
-                                .scales.data(),
                         context->getInputBuffer<int32_t>(kBiasTensor),
                         context->getInputShape(kBiasTensor), param.padding_left,
                         param.padding_right, param.padding_top, param.padding_bottom,
                         param.stride_width, param.stride_height, param.dilation_width_factor,
-                        param.dilation_height_factor, param.depth_multiplier, param.activation,
-                        param.useNchw, context->getOutputBuffer<uint8_t>(kOutputTensor),
+                        param.dilation_height_factor, param.depth_multiplier,
+                        requantState->params, param.useNchw,
+                        context->getOutputBuffer<uint8_t>(kOutputTensor),
                         context->getOutputShape(kOutputTensor));
             } else if (context->getInputType(kFilterTensor) == OperandType::TENSOR_QUANT8_ASYMM) {
                 return depthwiseConv(context->getInputBuffer<uint8_t>(kInputTensor),
@@ -541,20 +705,21 @@ bool execute(IOperationExecutionContext* context) {
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
             if (context->getInputType(kFilterTensor) ==
                 OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL) {
+                const auto requantState = getPerChannelRequantizationState<int8_t>(
+                        context, kInputTensor, kFilterTensor, kOutputTensor, param.activation);
+                NN_RET_CHECK(requantState != nullptr);
                 return depthwiseConvQuant8PerChannel(
                         context->getInputBuffer<int8_t>(kInputTensor),
                         context->getInputShape(kInputTensor),
                         context->getInputBuffer<int8_t>(kFilterTensor),
                         context->getInputShape(kFilterTensor),
-                        std::get<Operand::SymmPerChannelQuantParams>(
-                                context->getInputExtraParams(kFilterTensor))
-                                .scales.data(),
                         context->getInputBuffer<int32_t>(kBiasTensor),
                         context->getInputShape(kBiasTensor), param.padding_left,
                         param.padding_right, param.padding_top, param.padding_bottom,
                         param.stride_width, param.stride_height, param.dilation_width_factor,
-                        param.dilation_height_factor, param.depth_multiplier, param.activation,
-                        param.useNchw, context->getOutputBuffer<int8_t>(kOutputTensor),
+                        param.dilation_height_factor, param.depth_multiplier,
+                        requantState->params, param.useNchw,
+                        context->getOutputBuffer<int8_t>(kOutputTensor),
                         context->getOutputShape(kOutputTensor));
             } else if (context->getInputType(kFilterTensor) ==
                        OperandType::TENSOR_QUANT8_ASYMM_SIGNED) {
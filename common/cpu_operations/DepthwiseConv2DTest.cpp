@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ActivationFunctor.h"
+#include "DepthwiseConv2D.h"
+#include "OperationTestUtils.h"
+
+namespace android {
+namespace nn {
+namespace {
+
+// A float DEPTHWISE_CONV_2D of an NHWC input with implicit padding.
+struct DepthwiseConvParams {
+    uint32_t batches = 1;
+    uint32_t height = 1, width = 1;
+    uint32_t inDepth = 1;
+    uint32_t depthMultiplier = 1;
+    uint32_t filterSize = 3;
+    int32_t padding = kPaddingSame;
+    int32_t strideWidth = 1, strideHeight = 1;
+    int32_t dilation = 1;
+    int32_t activation = kActivationNone;
+
+    uint32_t outDepth() const { return inDepth * depthMultiplier; }
+};
+
+double applyActivation(double value, int32_t activation) {
+    switch (activation) {
+        case kActivationRelu:
+            return std::max(value, 0.0);
+        case kActivationRelu1:
+            return std::min(std::max(value, -1.0), 1.0);
+        case kActivationRelu6:
+            return std::min(std::max(value, 0.0), 6.0);
+        default:
+            return value;
+    }
+}
+
+// The loop over every output element and filter tap of the reference DEPTHWISE_CONV_2D,
+// accumulated in double. Returns the output and sets its height and width.
+std::vector<float> depthwiseConvReference(const DepthwiseConvParams& params,
+                                          const std::vector<float>& input,
+                                          const std::vector<float>& filter,
+                                          const std::vector<float>& bias, uint32_t* outHeight,
+                                          uint32_t* outWidth) {
+    int32_t paddingTop, paddingBottom, paddingLeft, paddingRight;
+    calculateExplicitPadding(params.height, params.strideHeight, params.dilation, params.filterSize,
+                             params.padding, &paddingTop, &paddingBottom);
+    calculateExplicitPadding(params.width, params.strideWidth, params.dilation, params.filterSize,
+                             params.padding, &paddingLeft, &paddingRight);
+    *outHeight = computeOutSize(params.height, params.filterSize, params.strideHeight,
+                                params.dilation, paddingTop, paddingBottom);
+    *outWidth = computeOutSize(params.width, params.filterSize, params.strideWidth,
+                               params.dilation, paddingLeft, paddingRight);
+    const uint32_t outDepth = params.outDepth();
+    auto inputAt = [&](uint32_t b, int32_t y, int32_t x, uint32_t c) -> double {
+        return input[((b * params.height + y) * params.width + x) * params.inDepth + c];
+    };
+    auto filterAt = [&](uint32_t y, uint32_t x, uint32_t c) -> double {
+        return filter[(y * params.filterSize + x) * outDepth + c];
+    };
+    std::vector<float> result;
+    for (uint32_t b = 0; b < params.batches; ++b) {
+        for (uint32_t outY = 0; outY < *outHeight; ++outY) {
+            for (uint32_t outX = 0; outX < *outWidth; ++outX) {
+                for (uint32_t oc = 0; oc < outDepth; ++oc) {
+                    double sum = bias[oc];
+                    for (uint32_t filterY = 0; filterY < params.filterSize; ++filterY) {
+                        const int32_t inY = static_cast<int32_t>(outY) * params.strideHeight -
+                                            paddingTop + filterY * params.dilation;
+                        if (inY < 0 || inY >= static_cast<int32_t>(params.height)) continue;
+                        for (uint32_t filterX = 0; filterX < params.filterSize; ++filterX) {
+                            const int32_t inX = static_cast<int32_t>(outX) * params.strideWidth -
+                                                paddingLeft + filterX * params.dilation;
+                            if (inX < 0 || inX >= static_cast<int32_t>(params.width)) continue;
+                            sum += inputAt(b, inY, inX, oc / params.depthMultiplier) *
+                                   filterAt(filterY, filterX, oc);
+                        }
+                    }
+                    result.push_back(static_cast<float>(applyActivation(sum, params.activation)));
+                }
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<float> makeRandomFloats(size_t size, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<float> values(size);
+    for (float& value : values) value = distribution(generator);
+    return values;
+}
+
+// Expects DEPTHWISE_CONV_2D to compute what the reference loop computes. The output pixels whose
+// window lies inside the input may run a kernel specialized for the filter size and stride, and
+// the other pixels run the generic path, so both meet along the borders of the output.
+void expectMatchesReference(const DepthwiseConvParams& params) {
+    const uint32_t outDepth = params.outDepth();
+    const std::vector<float> input = makeRandomFloats(
+            params.batches * params.height * params.width * params.inDepth, 1);
+    const std::vector<float> filter =
+            makeRandomFloats(params.filterSize * params.filterSize * outDepth, 2);
+    const std::vector<float> bias = makeRandomFloats(outDepth, 3);
+    uint32_t outHeight = 0, outWidth = 0;
+    const std::vector<float> expected =
+            depthwiseConvReference(params, input, filter, bias, &outHeight, &outWidth);
+
+    std::vector<TestOperand> inputs = {makeTensor(OperandType::TENSOR_FLOAT32, input),
+                                       makeTensor(OperandType::TENSOR_FLOAT32, filter),
+                                       makeTensor(OperandType::TENSOR_FLOAT32, bias),
+                                       makeScalar(params.padding),
+                                       makeScalar(params.strideWidth),
+                                       makeScalar(params.strideHeight),
+                                       makeScalar(params.depthMultiplier),
+                                       makeScalar(params.activation),
+                                       makeBoolScalar(false),
+                                       makeScalar(params.dilation),
+                                       makeScalar(params.dilation)};
+    inputs[depthwise_conv_2d::kInputTensor].shape.dimensions = {params.batches, params.height,
+                                                                params.width, params.inDepth};
+    inputs[depthwise_conv_2d::kFilterTensor].shape.dimensions = {1, params.filterSize,
+                                                                 params.filterSize, outDepth};
+    TestContext context(std::move(inputs), {.type = OperandType::TENSOR_FLOAT32}, sizeof(float),
+                        /*constantInputs=*/true, /*cache=*/nullptr);
+    ASSERT_TRUE(runOperation(OperationType::DEPTHWISE_CONV_2D, &context));
+    ASSERT_EQ(context.getOutputShape(depthwise_conv_2d::kOutputTensor).dimensions,
+              (std::vector<uint32_t>{params.batches, outHeight, outWidth, outDepth}));
+    const std::vector<float> actual = context.getOutput<float>();
+    for (size_t i = 0; i < actual.size(); ++i) {
+        ASSERT_NEAR(actual[i], expected[i], 1e-5f * std::max(1.0f, std::abs(expected[i])))
+                << "element " << i;
+    }
+}
+
+// Specialized kernels: 3x3 and 5x5 filters, stride 1 or 2 in both dimensions, no dilation and a
+// depth multiplier of 1. Channels are accumulated in blocks of 8, then one at a time.
+
+TEST(DepthwiseConv2DTest, Filter3x3Stride1) {
+    expectMatchesReference({.height = 9, .width = 11, .inDepth = 19});
+    expectMatchesReference({.batches = 2,
+                            .height = 8,
+                            .width = 7,
+                            .inDepth = 16,
+                            .padding = kPaddingValid,
+                            .activation = kActivationRelu6});
+}
+
+TEST(DepthwiseConv2DTest, Filter3x3Stride2) {
+    // With stride 2, SAME padding is the same on both sides of odd sizes, and only pads the
+    // bottom and right of even sizes.
+    expectMatchesReference({.height = 15,
+                            .width = 13,
+                            .inDepth = 16,
+                            .strideWidth = 2,
+                            .strideHeight = 2,
+                            .activation = kActivationRelu});
+    expectMatchesReference({.height = 14,
+                            .width = 12,
+                            .inDepth = 11,
+                            .strideWidth = 2,
+                            .strideHeight = 2});
+    expectMatchesReference({.height = 15,
+                            .width = 17,
+                            .inDepth = 9,
+                            .padding = kPaddingValid,
+                            .strideWidth = 2,
+                            .strideHeight = 2});
+}
+
+TEST(DepthwiseConv2DTest, Filter5x5) {
+    expectMatchesReference({.height = 12, .width = 7, .inDepth = 8, .filterSize = 5});
+    expectMatchesReference({.height = 17,
+                            .width = 17,
+                            .inDepth = 10,
+                            .filterSize = 5,
+                            .padding = kPaddingValid,
+                            .strideWidth = 2,
+                            .strideHeight = 2,
+                            .activation = kActivationRelu1});
+    expectMatchesReference({.height = 16,
+                            .width = 9,
+                            .inDepth = 3,
+                            .filterSize = 5,
+                            .strideWidth = 2,
+                            .strideHeight = 2});
+}
+
+TEST(DepthwiseConv2DTest, InputSmallerThanFilter) {
+    // No output pixel has its whole window inside the input.
+    expectMatchesReference({.height = 3, .width = 4, .inDepth = 8, .filterSize = 5});
+    expectMatchesReference({.height = 1, .width = 1, .inDepth = 9});
+    expectMatchesReference({.height = 2, .width = 9, .inDepth = 8, .strideWidth = 2,
+                            .strideHeight = 2});
+}
+
+TEST(DepthwiseConv2DTest, RunsInParallel) {
+    expectMatchesReference({.batches = 2, .height = 64, .width = 63, .inDepth = 32});
+}
+
+// Generic path: every other configuration.
+
+TEST(DepthwiseConv2DTest, DepthMultiplier) {
+    expectMatchesReference({.height = 9, .width = 8, .inDepth = 5, .depthMultiplier = 2});
+    expectMatchesReference({.height = 11,
+                            .width = 7,
+                            .inDepth = 3,
+                            .depthMultiplier = 3,
+                            .filterSize = 5,
+                            .strideWidth = 2,
+                            .strideHeight = 2,
+                            .activation = kActivationRelu});
+}
+
+TEST(DepthwiseConv2DTest, Dilation) {
+    expectMatchesReference({.height = 13, .width = 12, .inDepth = 8, .dilation = 2});
+    expectMatchesReference(
+            {.height = 13, .width = 12, .inDepth = 8, .padding = kPaddingValid, .dilation = 3});
+}
+
+TEST(DepthwiseConv2DTest, UnequalStrides) {
+    expectMatchesReference(
+            {.height = 13, .width = 12, .inDepth = 8, .strideWidth = 1, .strideHeight = 2});
+    expectMatchesReference({.height = 10, .width = 15, .inDepth = 8, .filterSize = 5,
+                            .strideWidth = 2, .strideHeight = 1});
+}
+
+TEST(DepthwiseConv2DTest, OtherFilterSizes) {
+    expectMatchesReference({.height = 6, .width = 7, .inDepth = 8, .filterSize = 1});
+    expectMatchesReference(
+            {.height = 10, .width = 9, .inDepth = 8, .filterSize = 4, .padding = kPaddingValid});
+}
+
+}  // namespace
+}  // namespace nn
+}  // namespace android
@@ -29,43 +29,25 @@ namespace {
 
 template <typename InputType, typename OutputType>
 bool compute(const InputType* inputData, const Shape& inputShape, OutputType* outputData) {
-    const int numElements = getNumberOfElements(inputShape);
-    const int32_t zeroPoint = inputShape.offset;
-    const float scale = inputShape.scale;
-    for (int i = 0; i < numElements; ++i) {
-        const int32_t value = inputData[i];
-        // This dequantization formula also appears in Elementwise.cpp.
-        outputData[i] = static_cast<OutputType>(scale * (value - zeroPoint));
-    }
+    // This dequantization formula also appears in Elementwise.cpp.
+    dequantizeElements(inputData, getNumberOfElements(inputShape), inputShape.scale,
+                       inputShape.offset, outputData);
     return true;
 }
 
 template <typename OutputType>
 bool computePerChannel(const int8_t* inputData, const Shape& inputShape, OutputType* outputData) {
-    // First we calculate a stride which is the number of elements we need to
-    // skip to change an index along a dimension with different quantization
-    // scales.
-    const int channelDim =
-            std::get<Operand::SymmPerChannelQuantParams>(inputShape.extraParams).channelDim;
-    int stride = 1;
-    for (int i = getNumberOfDimensions(inputShape) - 1; i > channelDim; --i) {
-        stride *= getSizeOfDimension(inputShape, i);
-    }
-
-    const int numElements = getNumberOfElements(inputShape);
-    const int32_t zeroPoint = inputShape.offset;
-
-    for (int i = 0; i < numElements; ++i) {
-        // To get current index along the quantized dimension we calculate how
-        // many even |strides| we looped through and take this number modulo the
-        // size of the dimension (so that we don't have an overflow if the
-        // channelDim is not 0).
-        const int scaleIndex = (i / stride) % getSizeOfDimension(inputShape, channelDim);
-        const float scale = std::get<Operand::SymmPerChannelQuantParams>(inputShape.extraParams)
-                                    .scales[scaleIndex];
-        const int32_t value = inputData[i];
-        outputData[i] = static_cast<OutputType>(scale * (value - zeroPoint));
-    }
+    // The tensor is viewed as [outerSize, numChannels, innerSize], so that each row of innerSize
+    // elements has a single scale.
+    const auto& params = std::get<Operand::SymmPerChannelQuantParams>(inputShape.extraParams);
+    const uint32_t channelDim = params.channelDim;
+    const uint32_t numChannels = getSizeOfDimension(inputShape, channelDim);
+    const uint32_t outerSize = getNumberOfElements(inputShape, 0, channelDim);
+    const uint32_t innerSize = getNumberOfElements(inputShape, channelDim + 1,
+                                                   getNumberOfDimensions(inputShape));
+    NN_RET_CHECK_EQ(params.scales.size(), numChannels);
+    dequantizePerChannelElements(inputData, outerSize, numChannels, innerSize,
+                                 params.scales.data(), inputShape.offset, outputData);
     return true;
 }
 
@@ -39,6 +39,10 @@ bool prepare(const Shape& input, int32_t axis, Shape* output) {
 
 bool eval(const uint8_t* inputData, const Shape& inputShape, int32_t /*axis*/, uint8_t* outputData,
           const Shape& /*outputShape*/) {
+    // The executor may have made the output a view of the input.
+    if (outputData == inputData) {
+        return true;
+    }
     memcpy(outputData, inputData,
            nonExtensionOperandSizeOfData(inputShape.type, inputShape.dimensions));
     return true;
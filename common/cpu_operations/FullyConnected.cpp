@@ -18,6 +18,9 @@
 
 #include "FullyConnected.h"
 
+#include <algorithm>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 #include "OperationResolver.h"
@@ -35,6 +38,11 @@
 #pragma clang diagnostic pop
 
 #include "CpuOperationUtils.h"
+#include "QuantUtils.h"
+
+#ifdef NN_EXPERIMENTAL_FEATURE
+#include "Densify.h"
+#endif  // NN_EXPERIMENTAL_FEATURE
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -177,6 +185,289 @@ bool fullyConnectedQuant8(const int8_t* inputData, const Shape& inputShape,
     return true;
 }
 
+// Minimum number of multiply-accumulates assigned to one thread.
+constexpr uint32_t kMinMacsPerThread = 64 * 1024;
+
+// Number of output units in one panel of packed weights.
+constexpr uint32_t kPanelSize = 8;
+
+// Packs weights of shape [numUnits, inputSize] into panels of kPanelSize units laid out as
+// [numPanels][inputSize][kPanelSize], so that fullyConnectedPanels reads them sequentially and
+// updates kPanelSize accumulators per input element. The last panel is padded with zeros. The
+// offset is added to every weight.
+template <typename WeightT, typename PackedT>
+std::vector<PackedT> packWeights(const WeightT* weights, uint32_t numUnits, uint32_t inputSize,
+                                 int32_t offset) {
+    const uint32_t numPanels = (numUnits + kPanelSize - 1) / kPanelSize;
+    std::vector<PackedT> packed(numPanels * inputSize * kPanelSize, 0);
+    for (uint32_t unit = 0; unit < numUnits; ++unit) {
+        PackedT* panel = packed.data() + (unit / kPanelSize) * inputSize * kPanelSize;
+        for (uint32_t i = 0; i < inputSize; ++i) {
+            panel[i * kPanelSize + unit % kPanelSize] =
+                    static_cast<PackedT>(weights[unit * inputSize + i] + offset);
+        }
+    }
+    return packed;
+}
+
+// Computes output[b][unit] = initial[unit] + sum_i input[b][i] * weights[unit][i] for weights
+// packed by packWeights, splitting the panels across threads.
+template <typename InputT, typename PackedT, typename AccT>
+void fullyConnectedPanels(const InputT* input, uint32_t batchSize, uint32_t inputSize,
+                          const PackedT* packedWeights, uint32_t numUnits, const AccT* initial,
+                          AccT* output) {
+    const uint32_t numPanels = (numUnits + kPanelSize - 1) / kPanelSize;
+    const uint32_t macsPerPanel = std::max<uint32_t>(1, batchSize * inputSize * kPanelSize);
+    const uint32_t minPanelsPerThread = std::max<uint32_t>(1, kMinMacsPerThread / macsPerPanel);
+    parallelFor(numPanels, minPanelsPerThread, [&](uint32_t panelBegin, uint32_t panelEnd) {
+        for (uint32_t panel = panelBegin; panel < panelEnd; ++panel) {
+            const PackedT* weights = packedWeights + panel * inputSize * kPanelSize;
+            const uint32_t unitBegin = panel * kPanelSize;
+            const uint32_t numPanelUnits = std::min(kPanelSize, numUnits - unitBegin);
+            for (uint32_t b = 0; b < batchSize; ++b) {
+                const InputT* x = input + b * inputSize;
+                AccT acc[kPanelSize] = {};
+                for (uint32_t i = 0; i < inputSize; ++i) {
+                    const AccT value = static_cast<AccT>(x[i]);
+                    const PackedT* w = weights + i * kPanelSize;
+                    for (uint32_t u = 0; u < kPanelSize; ++u) {
+                        acc[u] += value * static_cast<AccT>(w[u]);
+                    }
+                }
+                AccT* out = output + b * numUnits + unitBegin;
+                for (uint32_t u = 0; u < numPanelUnits; ++u) {
+                    out[u] = acc[u] + initial[unitBegin + u];
+                }
+            }
+        }
+    });
+}
+
+// Constant float weights packed by packWeights, converted to float32, kept on the prepared model.
+struct FullyConnectedFloatState : public OperationState {
+    OperandType weightsType;
+    std::vector<uint32_t> weightsDimensions;
+    std::vector<float> packedWeights;
+};
+
+// Constant quantized weights packed by packWeights with their zero point removed, the sum of each
+// unit's weights, which folds the input zero point into the bias, and the requantization of the
+// accumulators, kept on the prepared model.
+struct FullyConnectedQuant8State : public OperationState {
+    Shape weightsShape;
+    float inputScale;
+    float outputScale;
+    int32_t outputOffset;
+    int32_t activation;
+    std::vector<int16_t> packedWeights;
+    std::vector<int32_t> weightSums;
+    RequantizationParams requantParams;
+};
+
+// Returns the packed weights of a float FULLY_CONNECTED, or nullptr if the weights are not a
+// constant, in which case they are used as given.
+template <typename T>
+std::shared_ptr<const FullyConnectedFloatState> getFloatState(IOperationExecutionContext* context) {
+    if (!context->isConstantInput(kWeightsTensor)) {
+        return nullptr;
+    }
+    const Shape weightsShape = context->getInputShape(kWeightsTensor);
+    auto cached = context->getCachedState<FullyConnectedFloatState>();
+    if (cached != nullptr && cached->weightsType == weightsShape.type &&
+        cached->weightsDimensions == weightsShape.dimensions) {
+        return cached;
+    }
+    const uint32_t numUnits = getSizeOfDimension(weightsShape, 0);
+    const uint32_t inputSize = getSizeOfDimension(weightsShape, 1);
+    auto state = std::make_shared<FullyConnectedFloatState>();
+    state->weightsType = weightsShape.type;
+    state->weightsDimensions = weightsShape.dimensions;
+    state->packedWeights = packWeights<T, float>(context->getInputBuffer<T>(kWeightsTensor),
+                                                 numUnits, inputSize, 0);
+    context->setCachedState(state);
+    return state;
+}
+
+// Returns the packed weights and requantization of a quantized FULLY_CONNECTED, or nullptr if the
+// weights are not a constant or the requantization cannot be computed.
+template <typename T>
+std::shared_ptr<const FullyConnectedQuant8State> getQuant8State(
+        IOperationExecutionContext* context) {
+    if (!context->isConstantInput(kWeightsTensor)) {
+        return nullptr;
+    }
+    const Shape inputShape = context->getInputShape(kInputTensor);
+    const Shape weightsShape = context->getInputShape(kWeightsTensor);
+    const Shape biasShape = context->getInputShape(kBiasTensor);
+    const Shape outputShape = context->getOutputShape(kOutputTensor);
+    const int32_t activation = context->getInputValue<int32_t>(kActivationScalar);
+    auto cached = context->getCachedState<FullyConnectedQuant8State>();
+    if (cached != nullptr && cached->weightsShape.type == weightsShape.type &&
+        cached->weightsShape.dimensions == weightsShape.dimensions &&
+        cached->weightsShape.offset == weightsShape.offset &&
+        cached->weightsShape.scale == weightsShape.scale &&
+        cached->inputScale == inputShape.scale && cached->outputScale == outputShape.scale &&
+        cached->outputOffset == outputShape.offset && cached->activation == activation) {
+        return cached;
+    }
+    auto state = std::make_shared<FullyConnectedQuant8State>();
+    state->weightsShape = weightsShape;
+    state->inputScale = inputShape.scale;
+    state->outputScale = outputShape.scale;
+    state->outputOffset = outputShape.offset;
+    state->activation = activation;
+    double realMultiplier = 0.0;
+    if (!GetQuantizedConvolutionMultiplier(inputShape, weightsShape, biasShape, outputShape,
+                                           &realMultiplier) ||
+        !getRequantizationParams<T>(realMultiplier, 0, outputShape, activation,
+                                    &state->requantParams)) {
+        return nullptr;
+    }
+    const uint32_t numUnits = getSizeOfDimension(weightsShape, 0);
+    const uint32_t inputSize = getSizeOfDimension(weightsShape, 1);
+    const T* weights = context->getInputBuffer<T>(kWeightsTensor);
+    state->packedWeights =
+            packWeights<T, int16_t>(weights, numUnits, inputSize, -weightsShape.offset);
+    state->weightSums.resize(numUnits);
+    for (uint32_t unit = 0; unit < numUnits; ++unit) {
+        int32_t sum = 0;
+        for (uint32_t i = 0; i < inputSize; ++i) {
+            sum += static_cast<int32_t>(weights[unit * inputSize + i]) - weightsShape.offset;
+        }
+        state->weightSums[unit] = sum;
+    }
+    context->setCachedState(state);
+    return state;
+}
+
+template <typename T>
+bool fullyConnectedFloatPacked(const T* inputData, const Shape& inputShape,
+                               const FullyConnectedFloatState& state, const T* biasData,
+                               int32_t activation, T* outputData, const Shape& outputShape) {
+    NNTRACE_TRANS("fullyConnectedFloatPacked");
+    const uint32_t numUnits = state.weightsDimensions[0];
+    const uint32_t inputSize = state.weightsDimensions[1];
+    const uint32_t batchSize = getNumberOfElements(inputShape) / inputSize;
+    float activationMin, activationMax;
+    CalculateActivationRangeFloat(activation, &activationMin, &activationMax);
+
+    std::vector<float> inputBuffer, biasBuffer, outputBuffer;
+    const float* input;
+    const float* bias;
+    float* output;
+    if constexpr (std::is_same_v<T, float>) {
+        input = inputData;
+        bias = biasData;
+        output = outputData;
+    } else {
+        inputBuffer.resize(getNumberOfElements(inputShape));
+        convertFloat16ToFloat32(inputData, &inputBuffer);
+        biasBuffer.resize(numUnits);
+        convertFloat16ToFloat32(biasData, &biasBuffer);
+        outputBuffer.resize(getNumberOfElements(outputShape));
+        input = inputBuffer.data();
+        bias = biasBuffer.data();
+        output = outputBuffer.data();
+    }
+    NNTRACE_COMP_SWITCH("fullyConnectedPanels");
+    fullyConnectedPanels(input, batchSize, inputSize, state.packedWeights.data(), numUnits, bias,
+                         output);
+    for (uint32_t i = 0; i < batchSize * numUnits; ++i) {
+        output[i] = std::min(std::max(output[i], activationMin), activationMax);
+    }
+    if constexpr (!std::is_same_v<T, float>) {
+        convertFloat32ToFloat16(outputBuffer, outputData);
+    }
+    return true;
+}
+
+template <typename T>
+bool fullyConnectedQuant8Packed(const T* inputData, const Shape& inputShape,
+                                const FullyConnectedQuant8State& state, const int32_t* biasData,
+                                T* outputData, const Shape& /*outputShape*/) {
+    NNTRACE_TRANS("fullyConnectedQuant8Packed");
+    const uint32_t numUnits = getSizeOfDimension(state.weightsShape, 0);
+    const uint32_t inputSize = getSizeOfDimension(state.weightsShape, 1);
+    const uint32_t batchSize = getNumberOfElements(inputShape) / inputSize;
+    // sum_i (w_i - weightsZeroPoint) * (x_i - inputZeroPoint)
+    //     = sum_i (w_i - weightsZeroPoint) * x_i - inputZeroPoint * weightSum
+    std::vector<int32_t> initial(numUnits);
+    for (uint32_t unit = 0; unit < numUnits; ++unit) {
+        initial[unit] = biasData[unit] - inputShape.offset * state.weightSums[unit];
+    }
+    std::vector<int32_t> accumulators(batchSize * numUnits);
+    NNTRACE_COMP_SWITCH("fullyConnectedPanels");
+    fullyConnectedPanels(inputData, batchSize, inputSize, state.packedWeights.data(), numUnits,
+                         initial.data(), accumulators.data());
+    requantize(accumulators.data(), batchSize * numUnits, state.requantParams, outputData);
+    return true;
+}
+
+#ifdef NN_EXPERIMENTAL_FEATURE
+// Weights read from the operands of the DENSIFY operation that produces them, kept on the prepared
+// model.
+struct FullyConnectedSparseState : public OperationState {
+    std::vector<uint32_t> weightsDimensions;
+    densify_op::CompressedRows weights;
+};
+
+std::shared_ptr<const FullyConnectedSparseState> getSparseState(
+        IOperationExecutionContext* context, const SparseTensor& sparse) {
+    const Shape weightsShape = context->getInputShape(kWeightsTensor);
+    auto cached = context->getCachedState<FullyConnectedSparseState>();
+    if (cached != nullptr && cached->weightsDimensions == weightsShape.dimensions) {
+        return cached;
+    }
+    auto state = std::make_shared<FullyConnectedSparseState>();
+    state->weightsDimensions = weightsShape.dimensions;
+    if (!densify_op::getCompressedRows(sparse.shapes, sparse.buffers, &state->weights) ||
+        state->weights.rowRuns.size() != getSizeOfDimension(weightsShape, 0) + 1) {
+        return nullptr;
+    }
+    context->setCachedState(state);
+    return state;
+}
+
+// Computes output[b][unit] = bias[unit] + sum_i input[b][i] * weights[unit][i] over the stored
+// runs of each unit's weights only, splitting the units across threads.
+bool fullyConnectedSparse(const float* inputData, const Shape& inputShape,
+                          const FullyConnectedSparseState& state, const float* biasData,
+                          int32_t activation, float* outputData) {
+    NNTRACE_TRANS("fullyConnectedSparse");
+    const densify_op::CompressedRows& weights = state.weights;
+    const uint32_t numUnits = state.weightsDimensions[0];
+    const uint32_t inputSize = state.weightsDimensions[1];
+    const uint32_t batchSize = getNumberOfElements(inputShape) / inputSize;
+    float activationMin, activationMax;
+    CalculateActivationRangeFloat(activation, &activationMin, &activationMax);
+
+    const uint64_t macsPerUnit = std::max<uint64_t>(
+            1, uint64_t{batchSize} * weights.values.size() / std::max(1u, numUnits));
+    const uint32_t minUnitsPerThread =
+            static_cast<uint32_t>(std::max<uint64_t>(1, kMinMacsPerThread / macsPerUnit));
+    NNTRACE_COMP_SWITCH("fullyConnectedSparse");
+    parallelFor(numUnits, minUnitsPerThread, [&](uint32_t unitBegin, uint32_t unitEnd) {
+        for (uint32_t b = 0; b < batchSize; ++b) {
+            const float* x = inputData + b * inputSize;
+            float* out = outputData + b * numUnits;
+            for (uint32_t unit = unitBegin; unit < unitEnd; ++unit) {
+                float acc = biasData[unit];
+                for (uint32_t run = weights.rowRuns[unit]; run < weights.rowRuns[unit + 1];
+                     ++run) {
+                    const float* w = weights.values.data() + weights.runOffsets[run];
+                    const float* xRun = x + weights.runColumns[run];
+                    for (uint32_t i = 0; i < weights.runLengths[run]; ++i) {
+                        acc += xRun[i] * w[i];
+                    }
+                }
+                out[unit] = std::min(std::max(acc, activationMin), activationMax);
+            }
+        }
+    });
+    return true;
+}
+#endif  // NN_EXPERIMENTAL_FEATURE
+
 }  // namespace
 
 bool prepare(IOperationExecutionContext* context) {
@@ -193,6 +484,26 @@ bool execute(IOperationExecutionContext* context) {
     if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT32:
+#ifdef NN_EXPERIMENTAL_FEATURE
+            if (const SparseTensor* sparse = context->getSparseInput(kWeightsTensor)) {
+                const auto state = getSparseState(context, *sparse);
+                NN_RET_CHECK(state != nullptr) << "Unsupported sparse weights";
+                return fullyConnectedSparse(context->getInputBuffer<float>(kInputTensor),
+                                            context->getInputShape(kInputTensor), *state,
+                                            context->getInputBuffer<float>(kBiasTensor),
+                                            context->getInputValue<int32_t>(kActivationScalar),
+                                            context->getOutputBuffer<float>(kOutputTensor));
+            }
+#endif  // NN_EXPERIMENTAL_FEATURE
+            if (const auto state = getFloatState<float>(context)) {
+                return fullyConnectedFloatPacked(
+                        context->getInputBuffer<float>(kInputTensor),
+                        context->getInputShape(kInputTensor), *state,
+                        context->getInputBuffer<float>(kBiasTensor),
+                        context->getInputValue<int32_t>(kActivationScalar),
+                        context->getOutputBuffer<float>(kOutputTensor),
+                        context->getOutputShape(kOutputTensor));
+            }
             return fullyConnectedFloat32(context->getInputBuffer<float>(kInputTensor),
                                          context->getInputShape(kInputTensor),
                                          context->getInputBuffer<float>(kWeightsTensor),
@@ -203,6 +514,15 @@ bool execute(IOperationExecutionContext* context) {
                                          context->getOutputBuffer<float>(kOutputTensor),
                                          context->getOutputShape(kOutputTensor));
         case OperandType::TENSOR_FLOAT16:
+            if (const auto state = getFloatState<_Float16>(context)) {
+                return fullyConnectedFloatPacked(
+                        context->getInputBuffer<_Float16>(kInputTensor),
+                        context->getInputShape(kInputTensor), *state,
+                        context->getInputBuffer<_Float16>(kBiasTensor),
+                        context->getInputValue<int32_t>(kActivationScalar),
+                        context->getOutputBuffer<_Float16>(kOutputTensor),
+                        context->getOutputShape(kOutputTensor));
+            }
             return fullyConnectedFloat16(context->getInputBuffer<_Float16>(kInputTensor),
                                          context->getInputShape(kInputTensor),
                                          context->getInputBuffer<_Float16>(kWeightsTensor),
@@ -213,6 +533,14 @@ bool execute(IOperationExecutionContext* context) {
                                          context->getOutputBuffer<_Float16>(kOutputTensor),
                                          context->getOutputShape(kOutputTensor));
         case OperandType::TENSOR_QUANT8_ASYMM:
+            if (const auto state = getQuant8State<uint8_t>(context)) {
+                return fullyConnectedQuant8Packed(
+                        context->getInputBuffer<uint8_t>(kInputTensor),
+                        context->getInputShape(kInputTensor), *state,
+                        context->getInputBuffer<int32_t>(kBiasTensor),
+                        context->getOutputBuffer<uint8_t>(kOutputTensor),
+                        context->getOutputShape(kOutputTensor));
+            }
             return fullyConnectedQuant8(context->getInputBuffer<uint8_t>(kInputTensor),
                                         context->getInputShape(kInputTensor),
                                         context->getInputBuffer<uint8_t>(kWeightsTensor),
@@ -223,6 +551,14 @@ bool execute(IOperationExecutionContext* context) {
                                         context->getOutputBuffer<uint8_t>(kOutputTensor),
                                         context->getOutputShape(kOutputTensor));
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
+            if (const auto state = getQuant8State<int8_t>(context)) {
+                return fullyConnectedQuant8Packed(
+                        context->getInputBuffer<int8_t>(kInputTensor),
+                        context->getInputShape(kInputTensor), *state,
+                        context->getInputBuffer<int32_t>(kBiasTensor),
+                        context->getOutputBuffer<int8_t>(kOutputTensor),
+                        context->getOutputShape(kOutputTensor));
+            }
             return fullyConnectedQuant8(context->getInputBuffer<int8_t>(kInputTensor),
                                         context->getInputShape(kInputTensor),
                                         context->getInputBuffer<int8_t>(kWeightsTensor),
@@ -24,11 +24,14 @@
 #include <algorithm>
 #include <cfloat>
 #include <cmath>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 #include "CpuOperationUtils.h"
 #include "GroupedConv2D.h"
 #include "Operations.h"
+#include "QuantUtils.h"
 #include "Tracing.h"
 
 namespace android {
@@ -327,6 +330,278 @@ template bool groupedConvQuant8PerChannel<int8_t>(
         int32_t padding_bottom, int32_t stride_width, int32_t stride_height, int32_t numGroups,
         int32_t activation, int8_t* outputData, const Shape& outputShape);
 
+namespace {
+
+// Minimum number of multiply-accumulates assigned to one thread.
+constexpr uint32_t kMinMacsPerThread = 64 * 1024;
+
+// A GROUPED_CONV_2D filter packed as [numGroups][filterHeight][filterWidth][filterDepth]
+// [outputGroupDepth], so that each input element updates all output channels of its group with one
+// contiguous loop. Float filters are converted to float32. Quantized filters are widened to int16
+// with their zero point removed, and come with the per-channel requantization of the output.
+struct GroupedConvPackedFilter : public OperationState {
+    // What the filter was packed from.
+    Shape filterShape;
+    std::vector<float> filterScales;
+    float inputScale = 0.0f;
+    float outputScale = 0.0f;
+    int32_t outputOffset = 0;
+    int32_t numGroups = 0;
+    int32_t activation = 0;
+
+    std::vector<float> floatFilter;
+    std::vector<int16_t> quantFilter;
+    PerChannelRequantizationParams requantParams;
+
+    bool matches(const Shape& otherInputShape, const Shape& otherFilterShape,
+                 const std::vector<float>& otherFilterScales, const Shape& otherOutputShape,
+                 int32_t otherNumGroups, int32_t otherActivation) const {
+        return filterShape.type == otherFilterShape.type &&
+               filterShape.dimensions == otherFilterShape.dimensions &&
+               filterShape.offset == otherFilterShape.offset &&
+               filterScales == otherFilterScales && inputScale == otherInputShape.scale &&
+               outputScale == otherOutputShape.scale && outputOffset == otherOutputShape.offset &&
+               numGroups == otherNumGroups && activation == otherActivation;
+    }
+};
+
+template <typename FilterT, typename PackedT>
+std::vector<PackedT> packFilter(const FilterT* filterData, const Shape& filterShape,
+                                int32_t numGroups, int32_t offset) {
+    const uint32_t outputDepth = getSizeOfDimension(filterShape, 0);
+    const uint32_t outputGroupDepth = outputDepth / numGroups;
+    const uint32_t filterSize = getNumberOfElements(filterShape) / outputDepth;
+    std::vector<PackedT> packed(getNumberOfElements(filterShape));
+    for (uint32_t c = 0; c < outputDepth; ++c) {
+        const uint32_t g = c / outputGroupDepth, d = c % outputGroupDepth;
+        for (uint32_t k = 0; k < filterSize; ++k) {
+            packed[(g * filterSize + k) * outputGroupDepth + d] =
+                    static_cast<PackedT>(filterData[c * filterSize + k] + offset);
+        }
+    }
+    return packed;
+}
+
+// Accumulates the grouped convolution of every output pixel over a packed filter, adding
+// inputOffset to each input element, and hands the accumulators of each pixel to
+// epilogue(accumulators, outputPixel). Output rows are split across threads.
+template <typename T, typename PackedT, typename AccT, typename OutputT, typename Epilogue>
+void groupedConvAccumulate(const T* inputData, const Shape& inputShape, const PackedT* filter,
+                           const Shape& filterShape, int32_t numGroups, AccT inputOffset,
+                           int32_t paddingLeft, int32_t paddingTop, int32_t strideWidth,
+                           int32_t strideHeight, OutputT* outputData, const Shape& outputShape,
+                           const Epilogue& epilogue) {
+    const int32_t inputHeight = getSizeOfDimension(inputShape, 1);
+    const int32_t inputWidth = getSizeOfDimension(inputShape, 2);
+    const uint32_t inputDepth = getSizeOfDimension(inputShape, 3);
+    const uint32_t filterHeight = getSizeOfDimension(filterShape, 1);
+    const uint32_t filterWidth = getSizeOfDimension(filterShape, 2);
+    const uint32_t filterDepth = getSizeOfDimension(filterShape, 3);
+    const uint32_t outputHeight = getSizeOfDimension(outputShape, 1);
+    const uint32_t outputWidth = getSizeOfDimension(outputShape, 2);
+    const uint32_t outputDepth = getSizeOfDimension(outputShape, 3);
+    const uint32_t outputGroupDepth = outputDepth / numGroups;
+
+    const uint32_t numRows = getSizeOfDimension(outputShape, 0) * outputHeight;
+    const uint32_t macsPerRow = std::max<uint32_t>(
+            1, outputWidth * outputDepth * filterHeight * filterWidth * filterDepth);
+    const uint32_t minRowsPerThread = std::max<uint32_t>(1, kMinMacsPerThread / macsPerRow);
+    parallelFor(numRows, minRowsPerThread, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        std::vector<AccT> accumulators(outputDepth);
+        for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+            const uint32_t batch = row / outputHeight;
+            const int32_t inYOrigin =
+                    static_cast<int32_t>(row % outputHeight) * strideHeight - paddingTop;
+            const T* inputBatch = inputData + batch * inputHeight * inputWidth * inputDepth;
+            OutputT* out = outputData + row * outputWidth * outputDepth;
+            for (uint32_t outX = 0; outX < outputWidth; ++outX, out += outputDepth) {
+                const int32_t inXOrigin = static_cast<int32_t>(outX) * strideWidth - paddingLeft;
+                std::fill(accumulators.begin(), accumulators.end(), AccT(0));
+                for (int32_t g = 0; g < numGroups; ++g) {
+                    AccT* acc = accumulators.data() + g * outputGroupDepth;
+                    for (uint32_t filterY = 0; filterY < filterHeight; ++filterY) {
+                        const int32_t inY = inYOrigin + static_cast<int32_t>(filterY);
+                        if (inY < 0 || inY >= inputHeight) continue;
+                        for (uint32_t filterX = 0; filterX < filterWidth; ++filterX) {
+                            const int32_t inX = inXOrigin + static_cast<int32_t>(filterX);
+                            if (inX < 0 || inX >= inputWidth) continue;
+                            const T* in = inputBatch + (inY * inputWidth + inX) * inputDepth +
+                                          g * filterDepth;
+                            const uint32_t tap =
+                                    (g * filterHeight + filterY) * filterWidth + filterX;
+                            const PackedT* w = filter + tap * filterDepth * outputGroupDepth;
+                            for (uint32_t k = 0; k < filterDepth; ++k, w += outputGroupDepth) {
+                                const AccT value = static_cast<AccT>(in[k]) + inputOffset;
+                                for (uint32_t d = 0; d < outputGroupDepth; ++d) {
+                                    acc[d] += value * static_cast<AccT>(w[d]);
+                                }
+                            }
+                        }
+                    }
+                }
+                epilogue(accumulators.data(), out);
+            }
+        }
+    });
+}
+
+void groupedConvFloat32Packed(const float* inputData, const Shape& inputShape,
+                              const GroupedConvPackedFilter& packed, const float* biasData,
+                              int32_t paddingLeft, int32_t paddingTop, int32_t strideWidth,
+                              int32_t strideHeight, float* outputData, const Shape& outputShape) {
+    const uint32_t outputDepth = getSizeOfDimension(outputShape, 3);
+    float activationMin = 0.0f, activationMax = 0.0f;
+    CalculateActivationRangeFloat(packed.activation, &activationMin, &activationMax);
+    groupedConvAccumulate(inputData, inputShape, packed.floatFilter.data(), packed.filterShape,
+                          packed.numGroups, 0.0f, paddingLeft, paddingTop, strideWidth,
+                          strideHeight, outputData, outputShape,
+                          [&](const float* acc, float* out) {
+                              for (uint32_t c = 0; c < outputDepth; ++c) {
+                                  out[c] = std::min(std::max(acc[c] + biasData[c], activationMin),
+                                                    activationMax);
+                              }
+                          });
+}
+
+}  // namespace
+
+std::shared_ptr<const OperationState> packGroupedConvFilter(
+        std::shared_ptr<const OperationState> cachedState, const Shape& inputShape,
+        const void* filterData, const Shape& filterShape, const float* filterScales,
+        const Shape& outputShape, int32_t numGroups, int32_t activation) {
+    const bool isQuantized = inputShape.type == OperandType::TENSOR_QUANT8_ASYMM ||
+                             inputShape.type == OperandType::TENSOR_QUANT8_ASYMM_SIGNED;
+    const uint32_t outputDepth = getSizeOfDimension(filterShape, 0);
+    std::vector<float> scales;
+    if (filterShape.type == OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL) {
+        scales.assign(filterScales, filterScales + outputDepth);
+    } else if (isQuantized) {
+        scales.assign(outputDepth, filterShape.scale);
+    }
+    if (cachedState != nullptr) {
+        const auto cached = std::static_pointer_cast<const GroupedConvPackedFilter>(cachedState);
+        if (cached->matches(inputShape, filterShape, scales, outputShape, numGroups, activation)) {
+            return cachedState;
+        }
+    }
+
+    auto packed = std::make_shared<GroupedConvPackedFilter>();
+    packed->filterShape = filterShape;
+    packed->filterScales = scales;
+    packed->inputScale = inputShape.scale;
+    packed->outputScale = outputShape.scale;
+    packed->outputOffset = outputShape.offset;
+    packed->numGroups = numGroups;
+    packed->activation = activation;
+    switch (filterShape.type) {
+        case OperandType::TENSOR_FLOAT32:
+            packed->floatFilter = packFilter<float, float>(static_cast<const float*>(filterData),
+                                                           filterShape, numGroups, 0);
+            break;
+        case OperandType::TENSOR_FLOAT16:
+            packed->floatFilter = packFilter<_Float16, float>(
+                    static_cast<const _Float16*>(filterData), filterShape, numGroups, 0);
+            break;
+        case OperandType::TENSOR_QUANT8_ASYMM:
+            packed->quantFilter = packFilter<uint8_t, int16_t>(
+                    static_cast<const uint8_t*>(filterData), filterShape, numGroups,
+                    -filterShape.offset);
+            break;
+        case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
+        case OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL:
+            packed->quantFilter = packFilter<int8_t, int16_t>(
+                    static_cast<const int8_t*>(filterData), filterShape, numGroups,
+                    -filterShape.offset);
+            break;
+        default:
+            LOG(ERROR) << "Unsupported filter type for GROUPED_CONV_2D: " << filterShape.type;
+            return nullptr;
+    }
+    bool success = true;
+    if (inputShape.type == OperandType::TENSOR_QUANT8_ASYMM) {
+        success = getPerChannelRequantizationParams<uint8_t>(inputShape, scales, outputShape,
+                                                             activation, &packed->requantParams);
+    } else if (inputShape.type == OperandType::TENSOR_QUANT8_ASYMM_SIGNED) {
+        success = getPerChannelRequantizationParams<int8_t>(inputShape, scales, outputShape,
+                                                            activation, &packed->requantParams);
+    }
+    if (!success) {
+        LOG(ERROR) << "Failed to compute the requantization of GROUPED_CONV_2D";
+        return nullptr;
+    }
+    return packed;
+}
+
+template <typename T, typename BiasT>
+bool groupedConvPacked(const T* inputData, const Shape& inputShape,
+                       const OperationState& packedFilter, const BiasT* biasData,
+                       int32_t padding_left, int32_t padding_top, int32_t stride_width,
+                       int32_t stride_height, T* outputData, const Shape& outputShape) {
+    NNTRACE_TRANS("groupConvPacked");
+    const auto& packed = static_cast<const GroupedConvPackedFilter&>(packedFilter);
+    if constexpr (std::is_same_v<T, float>) {
+        groupedConvFloat32Packed(inputData, inputShape, packed, biasData, padding_left,
+                                 padding_top, stride_width, stride_height, outputData,
+                                 outputShape);
+    } else if constexpr (std::is_same_v<T, _Float16>) {
+        std::vector<float> inputFloat32(getNumberOfElements(inputShape));
+        convertFloat16ToFloat32(inputData, &inputFloat32);
+        std::vector<float> biasFloat32(getSizeOfDimension(outputShape, 3));
+        convertFloat16ToFloat32(biasData, &biasFloat32);
+        std::vector<float> outputFloat32(getNumberOfElements(outputShape));
+        groupedConvFloat32Packed(inputFloat32.data(), inputShape, packed, biasFloat32.data(),
+                                 padding_left, padding_top, stride_width, stride_height,
+                                 outputFloat32.data(), outputShape);
+        convertFloat32ToFloat16(outputFloat32, outputData);
+    } else {
+        const PerChannelRequantizationParams& params = packed.requantParams;
+        const uint32_t outputDepth = getSizeOfDimension(outputShape, 3);
+        std::vector<int32_t> leftShifts(outputDepth), rightShifts(outputDepth);
+        for (uint32_t c = 0; c < outputDepth; ++c) {
+            leftShifts[c] = std::max(params.shifts[c], 0);
+            rightShifts[c] = std::max(-params.shifts[c], 0);
+        }
+        groupedConvAccumulate(
+                inputData, inputShape, packed.quantFilter.data(), packed.filterShape,
+                packed.numGroups, -inputShape.offset, padding_left, padding_top, stride_width,
+                stride_height, outputData, outputShape, [&](const int32_t* acc, T* out) {
+                    for (uint32_t c = 0; c < outputDepth; ++c) {
+                        const int32_t value =
+                                params.outputOffset +
+                                MultiplyByQuantizedMultiplierSplitShift(
+                                        acc[c] + biasData[c], params.multipliers[c],
+                                        leftShifts[c], rightShifts[c]);
+                        out[c] = static_cast<T>(
+                                std::min(std::max(value, params.outputActivationMin),
+                                         params.outputActivationMax));
+                    }
+                });
+    }
+    return true;
+}
+
+template bool groupedConvPacked<float, float>(const float* inputData, const Shape& inputShape,
+                                              const OperationState& packedFilter,
+                                              const float* biasData, int32_t padding_left,
+                                              int32_t padding_top, int32_t stride_width,
+                                              int32_t stride_height, float* outputData,
+                                              const Shape& outputShape);
+
+template bool groupedConvPacked<_Float16, _Float16>(
+        const _Float16* inputData, const Shape& inputShape, const OperationState& packedFilter,
+        const _Float16* biasData, int32_t padding_left, int32_t padding_top, int32_t stride_width,
+        int32_t stride_height, _Float16* outputData, const Shape& outputShape);
+
+template bool groupedConvPacked<uint8_t, int32_t>(
+        const uint8_t* inputData, const Shape& inputShape, const OperationState& packedFilter,
+        const int32_t* biasData, int32_t padding_left, int32_t padding_top, int32_t stride_width,
+        int32_t stride_height, uint8_t* outputData, const Shape& outputShape);
+
+template bool groupedConvPacked<int8_t, int32_t>(
+        const int8_t* inputData, const Shape& inputShape, const OperationState& packedFilter,
+        const int32_t* biasData, int32_t padding_left, int32_t padding_top, int32_t stride_width,
+        int32_t stride_height, int8_t* outputData, const Shape& outputShape);
+
 #undef ANDROID_NN_GROUPED_CONV_PARAMETERS
 }  // namespace nn
 }  // namespace android
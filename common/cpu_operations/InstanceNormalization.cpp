@@ -18,6 +18,7 @@
 
 #include "InstanceNormalization.h"
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -35,46 +36,79 @@ namespace instance_normalization {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
+// Number of channels normalized together by one task. The statistics of a tile are accumulated
+// in a single pass over the spatial positions, with the inner loop running over contiguous
+// channels so that it vectorizes.
+constexpr uint32_t kChannelTileSize = 64;
+
+// Minimum number of input elements assigned to one thread.
+constexpr uint32_t kMinElementsPerThread = 16 * 1024;
+
 template <typename T>
 inline bool instanceNormNhwc(const T* inputData, const Shape& inputShape, T gamma, T beta,
                              T epsilon, T* outputData, const Shape& /*outputShape*/) {
     NNTRACE_TRANS("InstanceNormalizationNhwc");
-    uint32_t numBatches = getSizeOfDimension(inputShape, 0);
-    uint32_t height = getSizeOfDimension(inputShape, 1);
-    uint32_t width = getSizeOfDimension(inputShape, 2);
-    uint32_t depth = getSizeOfDimension(inputShape, 3);
-    for (uint32_t b = 0; b < numBatches; b++) {
-        for (uint32_t d = 0; d < depth; d++) {
-            uint32_t indexBase = b * height * width * depth + d;
-            T mean = 0, sigma = 0;
-
-            // Compute the mean of a single layer.
-            for (uint32_t h = 0; h < height; h++) {
-                for (uint32_t w = 0; w < width; w++) {
-                    T val = inputData[indexBase + (h * width + w) * depth];
-                    mean += val;
+    const uint32_t numBatches = getSizeOfDimension(inputShape, 0);
+    const uint32_t height = getSizeOfDimension(inputShape, 1);
+    const uint32_t width = getSizeOfDimension(inputShape, 2);
+    const uint32_t depth = getSizeOfDimension(inputShape, 3);
+    const uint32_t spatialSize = height * width;
+    const uint32_t numChannelTiles = (depth + kChannelTileSize - 1) / kChannelTileSize;
+    const uint32_t numTiles = numBatches * numChannelTiles;
+    const uint32_t elementsPerTile = spatialSize * std::min(depth, kChannelTileSize);
+    const uint32_t minTilesPerThread =
+            std::max<uint32_t>(1, kMinElementsPerThread / std::max<uint32_t>(1, elementsPerTile));
+
+    // Accumulation is always done in float, so that the FP16 path reads the input directly
+    // without losing precision in the running statistics.
+    const float gammaF = static_cast<float>(gamma);
+    const float betaF = static_cast<float>(beta);
+    const float epsilonF = static_cast<float>(epsilon);
+
+    parallelFor(numTiles, minTilesPerThread, [&](uint32_t tileBegin, uint32_t tileEnd) {
+        float mean[kChannelTileSize];
+        float m2[kChannelTileSize];
+        float scale[kChannelTileSize];
+        float shift[kChannelTileSize];
+        for (uint32_t tile = tileBegin; tile < tileEnd; ++tile) {
+            const uint32_t b = tile / numChannelTiles;
+            const uint32_t channelBegin = (tile % numChannelTiles) * kChannelTileSize;
+            const uint32_t numChannels = std::min(kChannelTileSize, depth - channelBegin);
+            const T* input = inputData + b * spatialSize * depth + channelBegin;
+            T* output = outputData + b * spatialSize * depth + channelBegin;
+
+            // Compute the mean and variance of every channel in a single pass (Welford).
+            std::fill(mean, mean + numChannels, 0.0f);
+            std::fill(m2, m2 + numChannels, 0.0f);
+            for (uint32_t i = 0; i < spatialSize; ++i) {
+                const T* row = input + i * depth;
+                const float invCount = 1.0f / static_cast<float>(i + 1);
+                for (uint32_t c = 0; c < numChannels; ++c) {
+                    const float val = static_cast<float>(row[c]);
+                    const float delta = val - mean[c];
+                    mean[c] += delta * invCount;
+                    m2[c] += delta * (val - mean[c]);
                 }
             }
-            mean /= static_cast<T>(height * width);
 
-            // Compute the standard deviation (sigma) of a single layer.
-            for (uint32_t h = 0; h < height; h++) {
-                for (uint32_t w = 0; w < width; w++) {
-                    T val = inputData[indexBase + (h * width + w) * depth] - mean;
-                    sigma += val * val;
-                }
+            // Fold gamma, beta and the statistics into a single multiply-add per element.
+            const float invSpatialSize = 1.0f / static_cast<float>(spatialSize);
+            for (uint32_t c = 0; c < numChannels; ++c) {
+                const float sigma = std::sqrt(m2[c] * invSpatialSize + epsilonF);
+                scale[c] = gammaF / sigma;
+                shift[c] = betaF - mean[c] * scale[c];
             }
-            sigma = std::sqrt(static_cast<float>(sigma / static_cast<T>(height * width)) + epsilon);
 
             // Apply instance normalization.
-            for (uint32_t h = 0; h < height; h++) {
-                for (uint32_t w = 0; w < width; w++) {
-                    uint32_t ind = indexBase + (h * width + w) * depth;
-                    outputData[ind] = (inputData[ind] - mean) * gamma / sigma + beta;
+            for (uint32_t i = 0; i < spatialSize; ++i) {
+                const T* inRow = input + i * depth;
+                T* outRow = output + i * depth;
+                for (uint32_t c = 0; c < numChannels; ++c) {
+                    outRow[c] = static_cast<T>(static_cast<float>(inRow[c]) * scale[c] + shift[c]);
                 }
             }
         }
-    }
+    });
     return true;
 }
 
@@ -19,6 +19,8 @@
 #include "L2Normalization.h"
 
 #include <algorithm>
+#include <limits>
+#include <type_traits>
 #include <vector>
 
 #include "OperationResolver.h"
@@ -43,94 +45,103 @@ namespace l2_norm {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
-inline bool l2normFloat32Impl(const float* inputData, const Shape& inputShape, int32_t axis,
-                              float* outputData, const Shape& /*outputShape*/) {
-    NNTRACE_TRANS("l2normFloat32");
+// Minimum number of input elements assigned to one thread.
+constexpr uint32_t kMinElementsPerThread = 16 * 1024;
+
+// Normalizes along a non-innermost axis, or along the innermost axis for types that have no
+// optimized TFLite kernel. The sums of squares for all inner positions are accumulated together,
+// so that every loop walks contiguous memory. Accumulation is done in float for FP16 inputs.
+template <typename T>
+inline bool l2normFloatImpl(const T* inputData, const Shape& inputShape, int32_t axis,
+                            T* outputData, const Shape& /*outputShape*/) {
+    NNTRACE_TRANS("l2normFloat");
     constexpr float kEpsilon = 1e-6f;
     const uint32_t outerSize = getNumberOfElements(inputShape, 0, axis);
     const uint32_t axisSize = getSizeOfDimension(inputShape, axis);
     const uint32_t innerSize =
             getNumberOfElements(inputShape, axis + 1, getNumberOfDimensions(inputShape));
-    for (uint32_t outer = 0; outer < outerSize; ++outer) {
-        const float* inputBeg = inputData + outer * axisSize * innerSize;
-        const float* inputEnd = inputBeg + axisSize * innerSize;
-        float* outputBeg = outputData + outer * axisSize * innerSize;
-        for (uint32_t inner = 0; inner < innerSize; ++inner, ++inputBeg, ++inputEnd, ++outputBeg) {
-            float sum = 0.0f;
-            for (const float* p = inputBeg; p < inputEnd; p += innerSize) {
-                float val = *p;
-                sum += val * val;
+    const uint32_t blockSize = axisSize * innerSize;
+    const uint32_t minOuterPerThread =
+            std::max<uint32_t>(1, kMinElementsPerThread / std::max<uint32_t>(1, blockSize));
+    parallelFor(outerSize, minOuterPerThread, [&](uint32_t outerBegin, uint32_t outerEnd) {
+        std::vector<float> invNorm(innerSize);
+        for (uint32_t outer = outerBegin; outer < outerEnd; ++outer) {
+            const T* inputBase = inputData + outer * blockSize;
+            T* outputBase = outputData + outer * blockSize;
+            std::fill(invNorm.begin(), invNorm.end(), 0.0f);
+            for (uint32_t a = 0; a < axisSize; ++a) {
+                const T* row = inputBase + a * innerSize;
+                for (uint32_t inner = 0; inner < innerSize; ++inner) {
+                    const float val = static_cast<float>(row[inner]);
+                    invNorm[inner] += val * val;
+                }
+            }
+            for (uint32_t inner = 0; inner < innerSize; ++inner) {
+                invNorm[inner] = 1.0f / std::max(std::sqrt(invNorm[inner]), kEpsilon);
             }
-            float l2_norm = std::max(std::sqrt(sum), kEpsilon);
-            float* pOut = outputBeg;
-            for (const float* p = inputBeg; p < inputEnd; p += innerSize, pOut += innerSize) {
-                *pOut = *p / l2_norm;
+            for (uint32_t a = 0; a < axisSize; ++a) {
+                const T* inRow = inputBase + a * innerSize;
+                T* outRow = outputBase + a * innerSize;
+                for (uint32_t inner = 0; inner < innerSize; ++inner) {
+                    outRow[inner] =
+                            static_cast<T>(static_cast<float>(inRow[inner]) * invNorm[inner]);
+                }
             }
         }
-    }
+    });
     return true;
 }
 
-inline bool l2normQuant8Impl(const uint8_t* inputData, const Shape& inputShape, int32_t axis,
-                             uint8_t* outputData, const Shape& /*outputShape*/) {
+// Quantized counterpart of l2normFloatImpl. The output has a scale of 1/128, with a zero point of
+// 128 for TENSOR_QUANT8_ASYMM and 0 for TENSOR_QUANT8_ASYMM_SIGNED.
+template <typename T>
+inline bool l2normQuant8Impl(const T* inputData, const Shape& inputShape, int32_t axis,
+                             T* outputData, const Shape& /*outputShape*/) {
     NNTRACE_TRANS("l2normQuant8");
+    constexpr int32_t kOutputOffset = std::is_same_v<T, uint8_t> ? 128 : 0;
+    constexpr int32_t kOutputMin = std::numeric_limits<T>::min();
+    constexpr int32_t kOutputMax = std::numeric_limits<T>::max();
     const uint32_t outerSize = getNumberOfElements(inputShape, 0, axis);
     const uint32_t axisSize = getSizeOfDimension(inputShape, axis);
     const uint32_t innerSize =
             getNumberOfElements(inputShape, axis + 1, getNumberOfDimensions(inputShape));
-    for (uint32_t outer = 0; outer < outerSize; ++outer) {
-        const uint8_t* inputBeg = inputData + outer * axisSize * innerSize;
-        const uint8_t* inputEnd = inputBeg + axisSize * innerSize;
-        uint8_t* outputBeg = outputData + outer * axisSize * innerSize;
-        for (uint32_t inner = 0; inner < innerSize; ++inner, ++inputBeg, ++inputEnd, ++outputBeg) {
-            int32_t sum = 0;
-            for (const uint8_t* p = inputBeg; p < inputEnd; p += innerSize) {
-                int32_t val = static_cast<int32_t>(*p) - inputShape.offset;
-                sum += val * val;
+    const uint32_t blockSize = axisSize * innerSize;
+    const uint32_t minOuterPerThread =
+            std::max<uint32_t>(1, kMinElementsPerThread / std::max<uint32_t>(1, blockSize));
+    parallelFor(outerSize, minOuterPerThread, [&](uint32_t outerBegin, uint32_t outerEnd) {
+        std::vector<int32_t> sum(innerSize);
+        std::vector<int32_t> invMultiplier(innerSize);
+        std::vector<int32_t> invShift(innerSize);
+        for (uint32_t outer = outerBegin; outer < outerEnd; ++outer) {
+            const T* inputBase = inputData + outer * blockSize;
+            T* outputBase = outputData + outer * blockSize;
+            std::fill(sum.begin(), sum.end(), 0);
+            for (uint32_t a = 0; a < axisSize; ++a) {
+                const T* row = inputBase + a * innerSize;
+                for (uint32_t inner = 0; inner < innerSize; ++inner) {
+                    const int32_t val = static_cast<int32_t>(row[inner]) - inputShape.offset;
+                    sum[inner] += val * val;
+                }
             }
-            int32_t invMultiplier, invShift;
-            tflite::GetInvSqrtQuantizedMultiplierExp(sum, -1, &invMultiplier, &invShift);
-            uint8_t* pOut = outputBeg;
-            for (const uint8_t* p = inputBeg; p < inputEnd; p += innerSize, pOut += innerSize) {
-                int32_t val = static_cast<int32_t>(*p) - inputShape.offset;
-                int32_t scaledVal = tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp(
-                                            val * 128, invMultiplier, invShift) +
-                                    128;
-                *pOut = static_cast<uint8_t>(std::min(std::max(scaledVal, 0), 255));
+            for (uint32_t inner = 0; inner < innerSize; ++inner) {
+                tflite::GetInvSqrtQuantizedMultiplierExp(sum[inner], -1, &invMultiplier[inner],
+                                                         &invShift[inner]);
             }
-        }
-    }
-    return true;
-}
-
-inline bool l2normQuant8SignedImpl(const int8_t* inputData, const Shape& inputShape, int32_t axis,
-                                   int8_t* outputData, const Shape& /*outputShape*/) {
-    NNTRACE_TRANS("l2normQuant8Signed");
-    const uint32_t outerSize = getNumberOfElements(inputShape, 0, axis);
-    const uint32_t axisSize = getSizeOfDimension(inputShape, axis);
-    const uint32_t innerSize =
-            getNumberOfElements(inputShape, axis + 1, getNumberOfDimensions(inputShape));
-    for (uint32_t outer = 0; outer < outerSize; ++outer) {
-        const int8_t* inputBeg = inputData + outer * axisSize * innerSize;
-        const int8_t* inputEnd = inputBeg + axisSize * innerSize;
-        int8_t* outputBeg = outputData + outer * axisSize * innerSize;
-        for (uint32_t inner = 0; inner < innerSize; ++inner, ++inputBeg, ++inputEnd, ++outputBeg) {
-            int32_t sum = 0;
-            for (const int8_t* p = inputBeg; p < inputEnd; p += innerSize) {
-                int32_t val = static_cast<int32_t>(*p) - inputShape.offset;
-                sum += val * val;
-            }
-            int32_t invMultiplier, invShift;
-            tflite::GetInvSqrtQuantizedMultiplierExp(sum, -1, &invMultiplier, &invShift);
-            int8_t* pOut = outputBeg;
-            for (const int8_t* p = inputBeg; p < inputEnd; p += innerSize, pOut += innerSize) {
-                int32_t val = static_cast<int32_t>(*p) - inputShape.offset;
-                int32_t scaledVal = tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp(
-                        val * 128, invMultiplier, invShift);
-                *pOut = static_cast<int8_t>(std::min(std::max(scaledVal, -128), 127));
+            for (uint32_t a = 0; a < axisSize; ++a) {
+                const T* inRow = inputBase + a * innerSize;
+                T* outRow = outputBase + a * innerSize;
+                for (uint32_t inner = 0; inner < innerSize; ++inner) {
+                    const int32_t val = static_cast<int32_t>(inRow[inner]) - inputShape.offset;
+                    const int32_t scaledVal =
+                            tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp(
+                                    val * 128, invMultiplier[inner], invShift[inner]) +
+                            kOutputOffset;
+                    outRow[inner] =
+                            static_cast<T>(std::min(std::max(scaledVal, kOutputMin), kOutputMax));
+                }
             }
         }
-    }
+    });
     return true;
 }
 
@@ -146,21 +157,14 @@ bool l2normFloat32(const float* inputData, const Shape& inputShape, int32_t axis
                                                convertShapeToTflshape(outputShape), outputData);
         return true;
     } else {
-        return l2normFloat32Impl(inputData, inputShape, axis, outputData, outputShape);
+        return l2normFloatImpl(inputData, inputShape, axis, outputData, outputShape);
     }
 }
 
 bool l2normFloat16(const _Float16* inputData, const Shape& inputShape, int32_t axis,
                    _Float16* outputData, const Shape& outputShape) {
-    NNTRACE_TRANS("l2normFloat16");
-    std::vector<float> inputDataFloat32(getNumberOfElements(inputShape));
-    convertFloat16ToFloat32(inputData, &inputDataFloat32);
-    std::vector<float> outputDataFloat32(getNumberOfElements(outputShape));
-
-    l2normFloat32(inputDataFloat32.data(), inputShape, axis, outputDataFloat32.data(), outputShape);
-    convertFloat32ToFloat16(outputDataFloat32, outputData);
-
-    return true;
+    NN_CHECK(handleNegativeAxis(inputShape, &axis));
+    return l2normFloatImpl(inputData, inputShape, axis, outputData, outputShape);
 }
 
 bool l2normQuant8(const uint8_t* inputData, const Shape& inputShape, int32_t axis,
@@ -192,7 +196,7 @@ bool l2normQuant8Signed(const int8_t* inputData, const Shape& inputShape, int32_
                                                        inputData, outputData);
         return true;
     } else {
-        return l2normQuant8SignedImpl(inputData, inputShape, axis, outputData, outputShape);
+        return l2normQuant8Impl(inputData, inputShape, axis, outputData, outputShape);
     }
 }
 
@@ -19,6 +19,7 @@
 #include "LocalResponseNormalization.h"
 
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "OperationResolver.h"
@@ -42,33 +43,50 @@ namespace local_response_norm {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
-inline bool localResponseNormFloat32Impl(const float* inputData, const Shape& inputShape,
-                                         int32_t radius, float bias, float alpha, float beta,
-                                         int32_t axis, float* outputData,
-                                         const Shape& /*outputShape*/) {
-    NNTRACE_TRANS("localResponseNormFloat32");
+// Minimum number of input elements assigned to one thread.
+constexpr uint32_t kMinElementsPerThread = 16 * 1024;
+
+// Normalizes along a non-innermost axis, or along any axis for FP16 inputs. The window sums for
+// all inner positions are accumulated together, so that every loop walks contiguous memory.
+// Accumulation is done in float for FP16 inputs.
+template <typename T>
+inline bool localResponseNormImpl(const T* inputData, const Shape& inputShape, int32_t radius,
+                                  float bias, float alpha, float beta, int32_t axis, T* outputData,
+                                  const Shape& /*outputShape*/) {
+    NNTRACE_TRANS("localResponseNorm");
     const uint32_t outerSize = getNumberOfElements(inputShape, 0, axis);
     const uint32_t axisSize = getSizeOfDimension(inputShape, axis);
     const uint32_t innerSize =
             getNumberOfElements(inputShape, axis + 1, getNumberOfDimensions(inputShape));
-    for (uint32_t outer = 0; outer < outerSize; ++outer) {
-        const float* inputBase = inputData + outer * axisSize * innerSize;
-        float* outputBase = outputData + outer * axisSize * innerSize;
-        for (uint32_t inner = 0; inner < innerSize; ++inner, ++inputBase, ++outputBase) {
+    const uint32_t blockSize = axisSize * innerSize;
+    const uint32_t minOuterPerThread =
+            std::max<uint32_t>(1, kMinElementsPerThread / std::max<uint32_t>(1, blockSize));
+    parallelFor(outerSize, minOuterPerThread, [&](uint32_t outerBegin, uint32_t outerEnd) {
+        std::vector<float> sum(innerSize);
+        for (uint32_t outer = outerBegin; outer < outerEnd; ++outer) {
+            const T* inputBase = inputData + outer * blockSize;
+            T* outputBase = outputData + outer * blockSize;
             for (int32_t i = 0; i < static_cast<int32_t>(axisSize); i++) {
                 const int32_t dBegin = std::max(0, i - radius);
                 // Add 1 on dEnd to comply with optimized_ops in TFLite
                 const int32_t dEnd = std::min(static_cast<int32_t>(axisSize), i + radius + 1);
-                float sum = 0.0f;
+                std::fill(sum.begin(), sum.end(), 0.0f);
                 for (int32_t d = dBegin; d < dEnd; d++) {
-                    float val = inputBase[d * innerSize];
-                    sum += val * val;
+                    const T* row = inputBase + d * innerSize;
+                    for (uint32_t inner = 0; inner < innerSize; ++inner) {
+                        const float val = static_cast<float>(row[inner]);
+                        sum[inner] += val * val;
+                    }
+                }
+                const T* inRow = inputBase + i * innerSize;
+                T* outRow = outputBase + i * innerSize;
+                for (uint32_t inner = 0; inner < innerSize; ++inner) {
+                    const float multiplier = std::pow(bias + alpha * sum[inner], -beta);
+                    outRow[inner] = static_cast<T>(static_cast<float>(inRow[inner]) * multiplier);
                 }
-                float multiplier = std::pow(bias + alpha * sum, -beta);
-                outputBase[i * innerSize] = inputBase[i * innerSize] * multiplier;
             }
         }
-    }
+    });
     return true;
 }
 
@@ -93,8 +111,8 @@ bool localResponseNorm<float>(const float* inputData, const Shape& inputShape, i
                 convertShapeToTflshape(outputShape), outputData);
         return true;
     } else {
-        return localResponseNormFloat32Impl(inputData, inputShape, radius, bias, alpha, beta, axis,
-                                            outputData, outputShape);
+        return localResponseNormImpl(inputData, inputShape, radius, bias, alpha, beta, axis,
+                                     outputData, outputShape);
     }
 }
 
@@ -102,16 +120,11 @@ template <>
 bool localResponseNorm<_Float16>(const _Float16* inputData, const Shape& inputShape, int32_t radius,
                                  _Float16 bias, _Float16 alpha, _Float16 beta, int32_t axis,
                                  _Float16* outputData, const Shape& outputShape) {
-    NNTRACE_TRANS("localResponseNormFloat16");
-    std::vector<float> inputDataFloat32(getNumberOfElements(inputShape));
-    convertFloat16ToFloat32(inputData, &inputDataFloat32);
-    std::vector<float> outputDataFloat32(getNumberOfElements(outputShape));
-
-    localResponseNorm<float>(inputDataFloat32.data(), inputShape, radius, bias, alpha, beta, axis,
-                             outputDataFloat32.data(), outputShape);
-    convertFloat32ToFloat16(outputDataFloat32, outputData);
-
-    return true;
+    NN_CHECK(handleNegativeAxis(inputShape, &axis));
+    radius = std::min(radius, static_cast<int32_t>(inputShape.dimensions[axis]));
+    return localResponseNormImpl(inputData, inputShape, radius, static_cast<float>(bias),
+                                 static_cast<float>(alpha), static_cast<float>(beta), axis,
+                                 outputData, outputShape);
 }
 
 template <typename T>
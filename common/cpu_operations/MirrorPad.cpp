@@ -25,7 +25,6 @@
 #include "OperationsExecutionUtils.h"
 
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
-#include <limits>
 #include <vector>
 
 #include "CpuOperationUtils.h"
@@ -71,116 +70,56 @@ bool prepare(IOperationExecutionContext* context) {
 
 /*-- begin execution ------------------------------------------------------------------*/
 
-// Based on
-// http://cs/android/external/tensorflow/tensorflow/lite/kernels/mirror_pad.cc;l=163;rcl=84f01780a69b5900cfddf2b44d696f92e0aac331
-
-// The structure of that code is largely preserved, for simplicity of comparison.
-
-// The TFLite implementation is multithreaded.  The NNAPI implementation is not.
-
 namespace {
 
-// In adapting the TFLite implementation to NNAPI, we introduce conversions from
-// conventional NNAPI types (typically uint32_t) to int, which is the
-// conventional TFLite type.  This function checks that such a conversion is
-// value-preserving.
-template <typename T>
-bool checkAsInt(T) {
-    // Making the assertion expression dependent on the template type (via
-    // incorportation of "&& sizeof(T)") ensures that the static_assert will
-    // only be evaluated if this function body is instantiated (we expect only
-    // the explicit specializations to be used).  Alternatively, we could omit
-    // the body entirely, in which case an unexpected choice of T would result
-    // in a link-time failure rather than a compile-time failure.
-    static_assert(false && sizeof(T), "Unimplemented");
-    return false;
-}
-template <>
-bool checkAsInt(uint32_t val) {
-    static_assert(sizeof(int) <= sizeof(uint32_t));
-    NN_RET_CHECK_LE(val, uint32_t(std::numeric_limits<int>::max()))
-            << kOperationName << " cannot represent value as int";
-    return true;
-}
-
-// Wrapper for data computed by the eval function.
+// The input is copied into the middle of the output, and the padding is then filled one dimension
+// at a time, innermost first, by mirroring the part of the output already written. Along dimension
+// d, this covers the rows where every outer dimension holds input data and the full extent of every
+// inner dimension, which the previous steps have filled.
 template <typename T>
-struct EvalData {
-    EvalData(const int* thePaddingTensor, Shape theInputTensorShape,
-             std::vector<int> theOutputDimsNumElements, std::vector<int> theInputDimsNumElements,
-             const T* theInputData, int theOffset, T* theOutputData, int theNumDims)
-        : paddingTensor(thePaddingTensor),
-          inputTensorShape(std::move(theInputTensorShape)),
-          outputDimsNumElements(std::move(theOutputDimsNumElements)),
-          inputDimsNumElements(std::move(theInputDimsNumElements)),
-          inputData(theInputData),
-          offset(theOffset),
-          outputData(theOutputData),
-          numDims(theNumDims) {}
-    const int32_t* paddingTensor = nullptr;
-    Shape inputTensorShape;
-    // Holds number of elements at the nth dimension.
-    // value at last dimension = 1, at second to last = sizeof last dimension.
-    std::vector<int> outputDimsNumElements;
-    std::vector<int> inputDimsNumElements;
-    const T* inputData = nullptr;
-
-    int offset = -1;
-    T* outputData = nullptr;
-    int numDims = 0;
-};
-
-// Helper function that obtains the left and right padding amounts.
-void getPadding(const int32_t* paddingTensor, int dimension, int32_t* leftPad, int32_t* rightPad) {
-    *leftPad = *(paddingTensor + dimension * 2);
-    *rightPad = *(paddingTensor + dimension * 2 + 1);
-}
-
-// Given dimension index and the left/right padding amounts.
-// Returns the corresponding dimension in the input array.
-int getInputDimension(int paddedDimension, const int leftPad, const int /* rightPad */,
-                      const int inputDimSize, const int offset) {
-    if (paddedDimension < leftPad) {
-        const int originalInd = leftPad + offset - 1;
-        return originalInd - (std::min(paddedDimension, originalInd - offset));
+void mirrorPad(const T* inputData, const Shape& inputShape, const int32_t* padding, int32_t offset,
+               T* outputData, const Shape& outputShape) {
+    const uint32_t numDims = getNumberOfDimensions(inputShape);
+    const std::vector<int64_t> outputStrides = getPackedStrides(outputShape.dimensions, sizeof(T));
+    uint8_t* outputBytes = reinterpret_cast<uint8_t*>(outputData);
+
+    uint8_t* interior = outputBytes;
+    for (uint32_t d = 0; d < numDims; ++d) {
+        interior += padding[2 * d] * outputStrides[d];
     }
-    paddedDimension -= leftPad;
-    if (paddedDimension >= inputDimSize) {
-        paddedDimension -= inputDimSize;
-        const int originalInd = inputDimSize - (1 + offset);
-        return originalInd - std::min(paddedDimension, originalInd);
-    }
-    return paddedDimension;
-}
-
-// Given an index in output array, returns the index of the value in input
-// array.
-template <typename T>
-int getFlatIndex(int index, const EvalData<T>& evalData) {
-    int flatIndex = 0;
-    for (int i = 0, nD = evalData.numDims; i < nD; ++i) {
-        int32_t leftPad, rightPad;
-        getPadding(evalData.paddingTensor, i, &leftPad, &rightPad);
-        const int dimensionIndex = index / evalData.outputDimsNumElements[i];
-        // getSizeOfDimension() undergoes checkAsInt() in eval().
-        const int indexInInput = getInputDimension(
-                dimensionIndex, leftPad, rightPad,
-                int(getSizeOfDimension(evalData.inputTensorShape, i)), evalData.offset);
-        flatIndex += indexInInput * evalData.inputDimsNumElements[i];
-        index %= evalData.outputDimsNumElements[i];
+    stridedCopy(inputData, getPackedStrides(inputShape.dimensions, sizeof(T)), interior,
+                outputStrides, inputShape.dimensions, sizeof(T));
+
+    std::vector<uint32_t> regionDims = inputShape.dimensions;
+    for (uint32_t d = numDims; d-- > 0;) {
+        uint8_t* regionData = outputBytes;
+        for (uint32_t k = 0; k < d; ++k) {
+            regionData += padding[2 * k] * outputStrides[k];
+        }
+        const int64_t stride = outputStrides[d];
+        std::vector<int64_t> mirroredStrides = outputStrides;
+        mirroredStrides[d] = -stride;
+        const int32_t before = padding[2 * d];
+        const int32_t after = padding[2 * d + 1];
+        const int32_t inputSize = getSizeOfDimension(inputShape, d);
+        // Index j of the leading padding mirrors index 2 * before + offset - 1 - j.
+        if (before > 0) {
+            regionDims[d] = before;
+            stridedCopy(regionData + (2 * before + offset - 1) * stride, mirroredStrides,
+                        regionData, outputStrides, regionDims, sizeof(T));
+        }
+        // Index before + inputSize + j of the trailing padding mirrors index
+        // before + inputSize - 1 - offset - j.
+        if (after > 0) {
+            regionDims[d] = after;
+            stridedCopy(regionData + (before + inputSize - 1 - offset) * stride, mirroredStrides,
+                        regionData + (before + inputSize) * stride, outputStrides, regionDims,
+                        sizeof(T));
+        }
+        regionDims[d] = getSizeOfDimension(outputShape, d);
     }
-    return flatIndex;
 }
 
-template <typename T>
-void run(const EvalData<T>& evalData, const int outputSize) {
-    // See MirrorPadWorkerTask::Run().
-    const auto* inputData = evalData.inputData;
-    auto* outputData = evalData.outputData;
-    for (int i = 0; i < outputSize; ++i) {
-        outputData[i] = inputData[getFlatIndex(i, evalData)];
-    }
-}
 }  // namespace
 
 bool eval(IOperationExecutionContext* context) {
@@ -188,45 +127,15 @@ bool eval(IOperationExecutionContext* context) {
     const int32_t* padding = context->getInputBuffer<int32_t>(kInputPaddingTensor);
     const int32_t mode = context->getInputValue<int32_t>(kInputModeScalar);
     const Shape outputShape = context->getOutputShape(kOutputTensor);
-    const auto tensorType = context->getInputType(kInputTensor);
-
-    const uint32_t inputDims = getNumberOfDimensions(inputShape);
-    NN_RET_CHECK(checkAsInt(inputDims));
-    const int numDims = int(inputDims);
-
-    // checkAsInt() the individual dimensions here so we do not need to do so
-    // elsewhere.
-    for (int i = 0; i < numDims; ++i) {
-        const auto inputDim = getSizeOfDimension(inputShape, i);
-        NN_RET_CHECK(checkAsInt(inputDim));
-        const auto outputDim = getSizeOfDimension(outputShape, i);
-        NN_RET_CHECK(checkAsInt(outputDim));
-    }
-
-    std::vector<int> outputDimsNumElements(inputDims, 1);
-    std::vector<int> inputDimsNumElements(inputDims, 1);
-    for (int i = numDims - 2; i >= 0; i--) {
-        outputDimsNumElements[i] =
-                outputDimsNumElements[i + 1] * int(getSizeOfDimension(outputShape, i + 1));
-        inputDimsNumElements[i] =
-                inputDimsNumElements[i + 1] * int(getSizeOfDimension(inputShape, i + 1));
-    }
-
     const int32_t offset = mode != kModeReflect ? 0 : 1;
 
-    const auto outputSize = getNumberOfElements(outputShape);
-
-#define MIRROR_PAD_CASE(operandType, dataType)                                               \
-    case OperandType::operandType: {                                                         \
-        const EvalData evalData(padding, inputShape, std::move(outputDimsNumElements),       \
-                                std::move(inputDimsNumElements),                             \
-                                context->getInputBuffer<dataType>(kInputTensor), offset,     \
-                                context->getOutputBuffer<dataType>(kOutputTensor), numDims); \
-        NN_RET_CHECK(checkAsInt(outputSize));                                                \
-        run(evalData, int(outputSize));                                                      \
-        return true;                                                                         \
+#define MIRROR_PAD_CASE(operandType, dataType)                                                    \
+    case OperandType::operandType: {                                                              \
+        mirrorPad(context->getInputBuffer<dataType>(kInputTensor), inputShape, padding, offset,   \
+                  context->getOutputBuffer<dataType>(kOutputTensor), outputShape);                \
+        return true;                                                                              \
     }
-    switch (tensorType) {
+    switch (context->getInputType(kInputTensor)) {
         MIRROR_PAD_CASE(TENSOR_FLOAT16, _Float16)
         MIRROR_PAD_CASE(TENSOR_FLOAT32, float)
         MIRROR_PAD_CASE(TENSOR_QUANT8_ASYMM, uint8_t)
@@ -55,6 +55,9 @@ inline const T* GetBuffer(const RunTimeOperandInfo* operand) {
     return reinterpret_cast<const T*>(operand->buffer);
 }
 
+// Batches with less work than this, counted in classes plus samples, run on a single thread.
+constexpr uint64_t kMinWorkPerThread = 16 * 1024;
+
 }  // namespace
 
 Multinomial::Multinomial(const Operation& operation, RunTimeOperandInfo* operands) {
@@ -120,36 +123,52 @@ void Multinomial::EvalFloat32(const float* inputData) {
     int sample_count_aligned = (sample_count_ + 3) / 4 * 4;
     // The CPU operation uses 64-bit double values, so two results per sample.
     sample_count_aligned *= 2;
-    auto random_generator_reserved =
+    const tensorflow::random::PhiloxRandom random_generator_reserved =
             random_generator.ReserveRandomOutputs(batch_size * sample_count_aligned, 256);
-    tensorflow::random::SimplePhilox simple_philox(&random_generator_reserved);
-
-    for (uint64_t b = 0; b < batch_size; ++b) {
-        const float* input_ptr_batch = inputData + b * class_size;
-        float max = std::numeric_limits<float>::lowest();
-        for (uint64_t j = 0; j < class_size; ++j) {
-            if (Eigen::numext::isfinite(input_ptr_batch[j])) {
-                max = std::max(max, input_ptr_batch[j]);
+
+    // The batches draw consecutive samples from one stream, so each batch skips ahead to its own
+    // samples and the result does not depend on how the batches are split across threads.
+    constexpr uint64_t kResultsPerSample = 2;
+    constexpr uint64_t kResultsPerCall = tensorflow::random::PhiloxRandom::kResultElementCount;
+    const uint64_t results_per_batch = kResultsPerSample * sample_count_;
+    const uint64_t work_per_batch = std::max<uint64_t>(1, class_size + sample_count_);
+    const uint32_t min_batches_per_thread =
+            static_cast<uint32_t>(std::max<uint64_t>(1, kMinWorkPerThread / work_per_batch));
+    parallelFor(batch_size, min_batches_per_thread, [&](uint32_t batch_begin, uint32_t batch_end) {
+        std::vector<double> cdf(class_size);
+        for (uint64_t b = batch_begin; b < batch_end; ++b) {
+            const uint64_t first_result = b * results_per_batch;
+            tensorflow::random::PhiloxRandom generator = random_generator_reserved;
+            generator.Skip(first_result / kResultsPerCall);
+            tensorflow::random::SimplePhilox simple_philox(&generator);
+            for (uint64_t j = 0; j < first_result % kResultsPerCall; ++j) {
+                simple_philox.Rand32();
             }
-        }
-        const double batch_max = static_cast<double>(max);
-        double total = 0;
-        std::vector<double> cdf;
-        cdf.resize(class_size);
-        for (uint64_t j = 0; j < class_size; ++j) {
-            if (Eigen::numext::isfinite(static_cast<float>(input_ptr_batch[j]))) {
-                total += exp(static_cast<double>(input_ptr_batch[j]) - batch_max);
+
+            const float* input_ptr_batch = inputData + b * class_size;
+            float max = std::numeric_limits<float>::lowest();
+            for (uint64_t j = 0; j < class_size; ++j) {
+                if (Eigen::numext::isfinite(input_ptr_batch[j])) {
+                    max = std::max(max, input_ptr_batch[j]);
+                }
+            }
+            const double batch_max = static_cast<double>(max);
+            double total = 0;
+            for (uint64_t j = 0; j < class_size; ++j) {
+                if (Eigen::numext::isfinite(static_cast<float>(input_ptr_batch[j]))) {
+                    total += exp(static_cast<double>(input_ptr_batch[j]) - batch_max);
+                }
+                cdf[j] = total;
             }
-            cdf[j] = total;
-        }
 
-        auto* output_ptr_batch = GetBuffer<int32_t>(output_) + b * sample_count_;
-        for (uint64_t j = 0; j < static_cast<uint64_t>(sample_count_); ++j) {
-            const double target = simple_philox.RandDouble() * total;
-            auto found_iter = std::upper_bound(cdf.begin(), cdf.end(), target);
-            output_ptr_batch[j] = std::distance(cdf.begin(), found_iter);
+            auto* output_ptr_batch = GetBuffer<int32_t>(output_) + b * sample_count_;
+            for (uint64_t j = 0; j < static_cast<uint64_t>(sample_count_); ++j) {
+                const double target = simple_philox.RandDouble() * total;
+                auto found_iter = std::upper_bound(cdf.begin(), cdf.end(), target);
+                output_ptr_batch[j] = std::distance(cdf.begin(), found_iter);
+            }
         }
-    }
+    });
 }
 
 }  // namespace nn
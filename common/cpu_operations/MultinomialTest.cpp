@@ -23,10 +23,15 @@
 #include <unsupported/Eigen/CXX11/Tensor>
 #pragma clang diagnostic pop
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
 #include <vector>
 
 #include "Multinomial.h"
 #include "NeuralNetworksWrapper.h"
+#include "guarded_philox_random.h"
 #include "philox_random.h"
 #include "simple_philox.h"
 
@@ -107,6 +112,58 @@ class MultinomialOpModel {
     std::vector<uint32_t> output_;
 };
 
+// Samples the batches one after another from a single stream, as the operation did before it
+// sampled the batches in parallel.
+std::vector<uint32_t> SampleSerially(const std::vector<float>& input, uint32_t batch_size,
+                                     uint32_t class_size, uint32_t sample_size) {
+    tensorflow::GuardedPhiloxRandom random_generator;
+    random_generator.Init(kFixedRandomSeed1, kFixedRandomSeed2);
+    const int sample_count_aligned = (sample_size + 3) / 4 * 4 * 2;
+    tensorflow::random::PhiloxRandom random_generator_reserved =
+            random_generator.ReserveRandomOutputs(batch_size * sample_count_aligned, 256);
+    tensorflow::random::SimplePhilox simple_philox(&random_generator_reserved);
+
+    std::vector<uint32_t> output;
+    std::vector<double> cdf(class_size);
+    for (uint32_t b = 0; b < batch_size; ++b) {
+        const float* input_ptr_batch = input.data() + b * class_size;
+        float max = std::numeric_limits<float>::lowest();
+        for (uint32_t j = 0; j < class_size; ++j) {
+            if (std::isfinite(input_ptr_batch[j])) {
+                max = std::max(max, input_ptr_batch[j]);
+            }
+        }
+        double total = 0;
+        for (uint32_t j = 0; j < class_size; ++j) {
+            if (std::isfinite(input_ptr_batch[j])) {
+                total += exp(static_cast<double>(input_ptr_batch[j]) - static_cast<double>(max));
+            }
+            cdf[j] = total;
+        }
+        for (uint32_t j = 0; j < sample_size; ++j) {
+            const double target = simple_philox.RandDouble() * total;
+            output.push_back(std::distance(cdf.begin(),
+                                           std::upper_bound(cdf.begin(), cdf.end(), target)));
+        }
+    }
+    return output;
+}
+
+TEST(MultinomialOpTest, ParallelBatchesMatchSerialSampling) {
+    // Enough work to be split across threads. With an odd number of samples, most batches start
+    // in the middle of a block of random values.
+    for (const auto [batch_size, class_size, sample_size] :
+         {std::make_tuple(64u, 1000u, 100u), std::make_tuple(1024u, 10u, 91u),
+          std::make_tuple(3u, 5u, 1u)}) {
+        SCOPED_TRACE(testing::Message() << batch_size << "x" << class_size << ", " << sample_size
+                                        << " samples");
+        MultinomialOpModel multinomial(batch_size, class_size, sample_size);
+        multinomial.Invoke();
+        EXPECT_EQ(multinomial.GetOutput(),
+                  SampleSerially(multinomial.GetInput(), batch_size, class_size, sample_size));
+    }
+}
+
 TEST(MultinomialOpTest, ProbabilityDeltaWithinTolerance) {
     constexpr int kBatchSize = 8;
     constexpr int kNumClasses = 10000;
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_OPERATIONS_OPERATION_TEST_UTILS_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_OPERATIONS_OPERATION_TEST_UTILS_H
+
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "CpuExecutor.h"
+#include "OperationResolver.h"
+#include "OperationsExecutionUtils.h"
+
+// Runs a single operation of the CPU executor on operands held by a test, without a model.
+
+namespace android {
+namespace nn {
+
+struct TestOperand {
+    Shape shape;
+    std::vector<uint8_t> data;
+    bool omitted = false;
+    // The DENSIFY operands standing in for data, if set.
+    const SparseTensor* sparse = nullptr;
+};
+
+// Returns a tensor of one dimension holding values.
+template <typename T>
+TestOperand makeTensor(OperandType type, const std::vector<T>& values, int32_t zeroPoint = 0) {
+    TestOperand operand = {.shape = {.type = type,
+                                     .dimensions = {static_cast<uint32_t>(values.size())},
+                                     .scale = 1.0f,
+                                     .offset = zeroPoint}};
+    operand.data.resize(values.size() * sizeof(T));
+    if (!values.empty()) {
+        memcpy(operand.data.data(), values.data(), operand.data.size());
+    }
+    return operand;
+}
+
+inline TestOperand makeScalar(int32_t value) {
+    TestOperand operand = makeTensor(OperandType::INT32, std::vector<int32_t>{value});
+    operand.shape.dimensions = {};
+    return operand;
+}
+
+inline TestOperand makeBoolScalar(bool value) {
+    TestOperand operand = makeTensor(OperandType::BOOL, std::vector<uint8_t>{value});
+    operand.shape.dimensions = {};
+    return operand;
+}
+
+// Execution context of an operation with one output whose inputs are held by the test. The
+// cached state lives in an OperationStateCache, as it does for CpuExecutor.
+class TestContext : public IOperationExecutionContext {
+   public:
+    TestContext(std::vector<TestOperand> inputs, Shape outputShape, size_t outputElementSize,
+                bool constantInputs, OperationStateCache* cache)
+        : mInputs(std::move(inputs)),
+          mOutputShape(std::move(outputShape)),
+          mOutputElementSize(outputElementSize),
+          mConstantInputs(constantInputs),
+          mCache(cache) {
+        mOutput.resize(getNumberOfElements(mOutputShape) * mOutputElementSize);
+    }
+
+    uint32_t getNumInputs() const override { return mInputs.size(); }
+    OperandType getInputType(uint32_t index) const override { return mInputs[index].shape.type; }
+    Shape getInputShape(uint32_t index) const override { return mInputs[index].shape; }
+    const void* getInputBuffer(uint32_t index) const override {
+        return mInputs[index].omitted ? nullptr : mInputs[index].data.data();
+    }
+    const Operand::ExtraParams& getInputExtraParams(uint32_t index) const override {
+        return mInputs[index].shape.extraParams;
+    }
+
+    uint32_t getNumOutputs() const override { return 1; }
+    OperandType getOutputType(uint32_t /*index*/) const override { return mOutputShape.type; }
+    Shape getOutputShape(uint32_t /*index*/) const override { return mOutputShape; }
+    void* getOutputBuffer(uint32_t /*index*/) override { return mOutput.data(); }
+    bool setOutputShape(uint32_t /*index*/, const Shape& shape) override {
+        mOutputShape = shape;
+        mOutput.resize(getNumberOfElements(mOutputShape) * mOutputElementSize);
+        return true;
+    }
+
+    bool isOmittedInput(uint32_t index) const override { return mInputs[index].omitted; }
+    bool isOmittedOutput(uint32_t /*index*/) const override { return false; }
+    bool isConstantInput(uint32_t /*index*/) const override { return mConstantInputs; }
+    const SparseTensor* getSparseInput(uint32_t index) const override {
+        return mInputs[index].sparse;
+    }
+
+    std::shared_ptr<const OperationState> getCachedState() const override {
+        return mCache != nullptr ? mCache->get(kKey) : nullptr;
+    }
+    void setCachedState(std::shared_ptr<const OperationState> state) override {
+        if (mCache != nullptr) {
+            mCache->set(kKey, std::move(state));
+        }
+    }
+
+    using IOperationExecutionContext::getCachedState;
+
+    TestOperand* getInput(uint32_t index) { return &mInputs[index]; }
+
+    template <typename T>
+    std::vector<T> getOutput() const {
+        std::vector<T> output(getNumberOfElements(mOutputShape));
+        if (!output.empty()) {
+            memcpy(output.data(), mOutput.data(), output.size() * sizeof(T));
+        }
+        return output;
+    }
+
+   private:
+    static constexpr OperationStateCache::Key kKey = {0, 0};
+
+    std::vector<TestOperand> mInputs;
+    Shape mOutputShape;
+    size_t mOutputElementSize;
+    std::vector<uint8_t> mOutput;
+    bool mConstantInputs;
+    OperationStateCache* mCache;
+};
+
+// Prepares and executes the operation of the given type on context.
+inline bool runOperation(OperationType type, TestContext* context) {
+    const OperationRegistration* registration =
+            BuiltinOperationResolver::get()->findOperation(type);
+    return registration != nullptr && registration->prepare(context) &&
+           registration->execute(context);
+}
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_OPERATIONS_OPERATION_TEST_UTILS_H
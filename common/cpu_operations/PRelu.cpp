@@ -33,6 +33,8 @@
 #pragma clang diagnostic ignored "-Winvalid-partial-specialization"
 #include <tensorflow/lite/kernels/internal/optimized/legacy_optimized_ops.h>
 #pragma clang diagnostic pop
+
+#include "CpuOperationUtils.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -64,9 +66,11 @@ inline bool eval(const std::function<T(const T&, const T&)>& func, const T* aDat
     return true;
 }
 
+// Returns the function computing a quantized PRELU output element from an input element and an
+// alpha element.
 template <typename T>
-bool evalQuant8(const T* aData, const Shape& aShape, const T* bData, const Shape& bShape,
-                T* outputData, const Shape& outputShape) {
+std::function<T(const T&, const T&)> getQuant8Function(const Shape& aShape, const Shape& bShape,
+                                                       const Shape& outputShape) {
     const int32_t input_offset = -aShape.offset;
     const int32_t alpha_offset = -bShape.offset;
     const int32_t output_offset = outputShape.offset;
@@ -77,23 +81,115 @@ bool evalQuant8(const T* aData, const Shape& aShape, const T* bData, const Shape
     int32_t output_multiplier_neg, output_shift_neg;
     tflite::QuantizeMultiplier(real_multiplier_pos, &output_multiplier_pos, &output_shift_pos);
     tflite::QuantizeMultiplier(real_multiplier_neg, &output_multiplier_neg, &output_shift_neg);
-    return eval<T>(
-            [&](const T& val1, const T& val2) -> uint8_t {
-                const int32_t input = input_offset + static_cast<int32_t>(val1);
-                int32_t output_val;
-                if (input >= 0) {
-                    output_val =
-                            output_offset + tflite::MultiplyByQuantizedMultiplier(
-                                                    input, output_multiplier_pos, output_shift_pos);
-                } else {
-                    const int32_t alpha = alpha_offset + static_cast<int32_t>(val2);
-                    output_val = output_offset +
-                                 tflite::MultiplyByQuantizedMultiplier(
-                                         input * alpha, output_multiplier_neg, output_shift_neg);
-                }
-                return saturateCast<T>(output_val);
-            },
-            aData, aShape, bData, bShape, outputData, outputShape);
+    return [=](const T& val1, const T& val2) -> T {
+        const int32_t input = input_offset + static_cast<int32_t>(val1);
+        int32_t output_val;
+        if (input >= 0) {
+            output_val = output_offset + tflite::MultiplyByQuantizedMultiplier(
+                                                 input, output_multiplier_pos, output_shift_pos);
+        } else {
+            const int32_t alpha = alpha_offset + static_cast<int32_t>(val2);
+            output_val = output_offset +
+                         tflite::MultiplyByQuantizedMultiplier(input * alpha, output_multiplier_neg,
+                                                               output_shift_neg);
+        }
+        return saturateCast<T>(output_val);
+    };
+}
+
+// Returns the number of elements of the alpha tensor if it broadcasts against the input by
+// repeating along the leading dimensions only, so that element i of the output takes alpha element
+// i % size, or 0 otherwise.
+uint32_t getRepeatedAlphaSize(const Shape& input, const Shape& alpha, const Shape& output) {
+    if (input.dimensions != output.dimensions) return 0;
+    const uint32_t inputRank = input.dimensions.size();
+    const uint32_t alphaRank = alpha.dimensions.size();
+    uint32_t alphaSize = 1;
+    bool isLeading = true;
+    for (uint32_t i = 0; i < alphaRank; ++i) {
+        const uint32_t dimension = alpha.dimensions[i];
+        if (isLeading && dimension == 1) continue;
+        isLeading = false;
+        if (dimension != input.dimensions[inputRank - alphaRank + i]) return 0;
+        alphaSize *= dimension;
+    }
+    return alphaSize;
+}
+
+// Quantized PRELU through a table with one row per alpha value, holding the output for every input
+// value. Only the rows of the alpha values present are built, on the first execution that needs
+// them, and the table is cached for later executions of the operation. An execution that would
+// spend more building rows than evaluating its elements uses the kernel directly instead.
+template <typename T>
+bool evalQuant8(IOperationExecutionContext* context) {
+    using Table = QuantizedLookupTable<T>;
+    const Shape inputShape = context->getInputShape(kInputTensor);
+    const Shape alphaShape = context->getInputShape(kAlphaTensor);
+    const Shape outputShape = context->getOutputShape(kOutputTensor);
+    const auto func = getQuant8Function<T>(inputShape, alphaShape, outputShape);
+    const T* alphaData = context->getInputBuffer<T>(kAlphaTensor);
+
+    const uint32_t alphaNumElements = getNumberOfElements(alphaShape);
+    std::vector<bool> rows(Table::kRowSize, false);
+    uint32_t numRows = 0;
+    for (uint32_t i = 0; i < alphaNumElements; ++i) {
+        const uint32_t row = Table::getIndex(alphaData[i]);
+        numRows += !rows[row];
+        rows[row] = true;
+    }
+    const std::vector<Shape> shapes = {inputShape, alphaShape, outputShape};
+    auto table = context->getCachedState<Table>();
+    if (table == nullptr || !table->isFor(shapes) || !table->hasRows(rows)) {
+        if (numRows * Table::kRowSize > getNumberOfElements(outputShape)) {
+            NNTRACE_COMP("preluQuant8Direct");
+            return eval<T>(func, context->getInputBuffer<T>(kInputTensor), inputShape, alphaData,
+                           alphaShape, context->getOutputBuffer<T>(kOutputTensor), outputShape);
+        }
+        if (table != nullptr && table->isFor(shapes)) {
+            // Keep the rows built for other alpha values, as alpha may change between executions.
+            const std::vector<bool>& cachedRows = table->getRows();
+            for (uint32_t row = 0; row < cachedRows.size(); ++row) {
+                rows[row] = rows[row] || cachedRows[row];
+            }
+        }
+        table = Table::create(shapes, std::move(rows),
+                              [&func](uint32_t row, const T* tableInput, T* tableOutput) {
+                                  const T alpha = static_cast<T>(row);
+                                  for (uint32_t i = 0; i < Table::kRowSize; ++i) {
+                                      tableOutput[i] = func(tableInput[i], alpha);
+                                  }
+                                  return true;
+                              });
+        NN_RET_CHECK(table != nullptr);
+        context->setCachedState(table);
+    }
+
+    const T* inputData = context->getInputBuffer<T>(kInputTensor);
+    T* outputData = context->getOutputBuffer<T>(kOutputTensor);
+    const uint32_t alphaSize = getRepeatedAlphaSize(inputShape, alphaShape, outputShape);
+    if (alphaSize == 0) {
+        return eval<T>(
+                [&table](const T& val1, const T& val2) -> T {
+                    return table->getRow(Table::getIndex(val2))[Table::getIndex(val1)];
+                },
+                inputData, inputShape, alphaData, alphaShape, outputData, outputShape);
+    }
+    NNTRACE_COMP("preluQuant8Repeated");
+    const uint32_t numRepeats = getNumberOfElements(outputShape) / alphaSize;
+    // Repeats below this many elements are not worth splitting across threads.
+    constexpr uint32_t kMinElementsPerThread = 64 * 1024;
+    parallelFor(numRepeats, std::max<uint32_t>(1, kMinElementsPerThread / alphaSize),
+                [&](uint32_t begin, uint32_t end) {
+                    for (uint32_t repeat = begin; repeat < end; ++repeat) {
+                        const T* input = inputData + repeat * alphaSize;
+                        T* output = outputData + repeat * alphaSize;
+                        for (uint32_t i = 0; i < alphaSize; ++i) {
+                            output[i] = table->getRow(Table::getIndex(alphaData[i]))
+                                                     [Table::getIndex(input[i])];
+                        }
+                    }
+                });
+    return true;
 }
 
 bool prepare(IOperationExecutionContext* context) {
@@ -130,20 +226,10 @@ bool execute(IOperationExecutionContext* context) {
                     context->getOutputBuffer<float>(kOutputTensor),
                     context->getOutputShape(kOutputTensor));
         case OperandType::TENSOR_QUANT8_ASYMM: {
-            return evalQuant8(context->getInputBuffer<uint8_t>(kInputTensor),
-                              context->getInputShape(kInputTensor),
-                              context->getInputBuffer<uint8_t>(kAlphaTensor),
-                              context->getInputShape(kAlphaTensor),
-                              context->getOutputBuffer<uint8_t>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return evalQuant8<uint8_t>(context);
         }
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED: {
-            return evalQuant8(context->getInputBuffer<int8_t>(kInputTensor),
-                              context->getInputShape(kInputTensor),
-                              context->getInputBuffer<int8_t>(kAlphaTensor),
-                              context->getInputShape(kAlphaTensor),
-                              context->getOutputBuffer<int8_t>(kOutputTensor),
-                              context->getOutputShape(kOutputTensor));
+            return evalQuant8<int8_t>(context);
         }
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation " << kOperationName;
@@ -22,15 +22,6 @@
 #include "OperationsExecutionUtils.h"
 
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
-#include <limits>
-#include <vector>
-
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunused-parameter"
-#pragma clang diagnostic ignored "-Wsign-compare"
-#include <tensorflow/lite/kernels/internal/reference/reference_ops.h>
-#pragma clang diagnostic pop
-
 #include "CpuOperationUtils.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
@@ -79,53 +70,26 @@ bool prepare(IOperationExecutionContext* context) {
     return context->setOutputShape(kOutputTensor, outputShape);
 }
 
-bool packParams(IOperationExecutionContext* context, tflite::PackParams* params) {
-    const int32_t axis = context->getInputValue<int32_t>(kInputAxisScalar);
-    NN_RET_CHECK_LE(axis, std::numeric_limits<typeof(params->axis)>().max())
-            << "axis value out of range";
-    params->axis = axis;
-
-    const uint32_t inputTensorCount = context->getNumInputs() - 1;
-    NN_RET_CHECK_LE(inputTensorCount, std::numeric_limits<typeof(params->inputs_count)>().max())
-            << "input count out of range";
-    params->inputs_count = inputTensorCount;
-
-    // Note that the NNAPI PACK operation specification requires all input
-    // tensors and the output tensor to have the same zeroPoint and scale.
-    const Shape tensorShape = context->getInputShape(kInputFirstTensor);
-
-    const std::vector<int32_t> paramsInputZeroPoint(inputTensorCount, tensorShape.offset);
-    params->input_zeropoint = paramsInputZeroPoint.data();
-    const std::vector<float> paramsInputScale(inputTensorCount, tensorShape.scale);
-    params->input_scale = paramsInputScale.data();
-    params->output_zeropoint = tensorShape.offset;
-    params->output_scale = tensorShape.scale;
-
-    return true;
-}
-
+// The output is viewed as [outer, inputTensorCount, inner], where outer covers the input dimensions
+// before the axis and inner those from it. Each input fills one index of the middle dimension.
+// Note that the NNAPI PACK operation specification requires all input tensors to have the same
+// dimensions, and all input tensors and the output tensor to have the same zeroPoint and scale.
 template <typename T>
 bool pack(IOperationExecutionContext* context) {
-    tflite::PackParams params;
-    NN_RET_CHECK(packParams(context, &params));
-
     const uint32_t inputTensorCount = context->getNumInputs() - 1;
-
-    // Note that the NNAPI PACK operation specification requires all input
-    // tensors to have the same dimensions.
-    const tflite::RuntimeShape inputTensorShapes =
-            convertShapeToTflshape(context->getInputShape(kInputFirstTensor));
-    const std::vector<const tflite::RuntimeShape*> inputShapesPtrs(inputTensorCount,
-                                                                   &inputTensorShapes);
-
-    std::vector<const T*> inputData(inputTensorCount);
+    const int32_t axis = context->getInputValue<int32_t>(kInputAxisScalar);
+    const Shape inputShape = context->getInputShape(kInputFirstTensor);
+    const uint32_t outerSize = getNumberOfElements(inputShape, 0, axis);
+    const uint32_t innerSize =
+            getNumberOfElements(inputShape, axis, getNumberOfDimensions(inputShape));
+    const int64_t innerStride = static_cast<int64_t>(innerSize) * sizeof(T);
+    T* outputData = context->getOutputBuffer<T>(kOutputTensor);
     for (uint32_t inputTensorNum = 0; inputTensorNum < inputTensorCount; ++inputTensorNum) {
-        inputData[inputTensorNum] = context->getInputBuffer<T>(kInputFirstTensor + inputTensorNum);
+        stridedCopy(context->getInputBuffer<T>(kInputFirstTensor + inputTensorNum),
+                    {innerStride, sizeof(T)}, outputData + inputTensorNum * innerSize,
+                    {inputTensorCount * innerStride, sizeof(T)}, {outerSize, innerSize},
+                    sizeof(T));
     }
-
-    tflite::reference_ops::Pack(params, inputShapesPtrs.data(), inputData.data(),
-                                convertShapeToTflshape(context->getOutputShape(kOutputTensor)),
-                                context->getOutputBuffer<T>(kOutputTensor));
     return true;
 }
 
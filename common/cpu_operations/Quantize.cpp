@@ -18,9 +18,6 @@
 
 #include "Quantize.h"
 
-#include <algorithm>
-#include <cmath>
-
 #include "IndexedShapeWrapper.h"
 #include "OperationResolver.h"
 #include "OperationsExecutionUtils.h"
@@ -32,29 +29,11 @@ namespace quantize {
 namespace {
 
 // The quantization formula also appears in Elementwise.cpp.
-template <typename T>
-bool quantizeToQuant8(const T* inputData, uint8_t* outputData, const Shape& outputShape) {
-    NNTRACE_COMP("quantizeToQuant8");
-    uint32_t size = getNumberOfElements(outputShape);
-    for (uint32_t i = 0; i < size; ++i) {
-        outputData[i] = static_cast<uint8_t>(std::max<float>(
-                0.0f, std::min<float>(255.0f, outputShape.offset + std::round(inputData[i] /
-                                                                              outputShape.scale))));
-    }
-    return true;
-}
-
-// The quantization formula also appears in Elementwise.cpp.
-template <typename T>
-bool quantizeToQuant8Signed(const T* inputData, int8_t* outputData, const Shape& outputShape) {
-    NNTRACE_COMP("quantizeToQuant8Signed");
-    uint32_t size = getNumberOfElements(outputShape);
-    for (uint32_t i = 0; i < size; ++i) {
-        outputData[i] = static_cast<int8_t>(std::max<float>(
-                -128.0f,
-                std::min<float>(127.0f, outputShape.offset +
-                                                std::round(inputData[i] / outputShape.scale))));
-    }
+template <typename InputT, typename OutputT>
+bool quantizeTo(const InputT* inputData, OutputT* outputData, const Shape& outputShape) {
+    NNTRACE_COMP("quantizeElements");
+    quantizeElements(inputData, getNumberOfElements(outputShape), outputShape.scale,
+                     outputShape.offset, outputData);
     return true;
 }
 
@@ -75,23 +54,23 @@ bool execute(IOperationExecutionContext* context) {
     const OperandType outputType = context->getOutputType(kOutputTensor);
     if (inputType == OperandType::TENSOR_FLOAT32) {
         if (outputType == OperandType::TENSOR_QUANT8_ASYMM) {
-            return quantizeToQuant8<float>(context->getInputBuffer<float>(kInputTensor),
-                                           context->getOutputBuffer<uint8_t>(kOutputTensor),
-                                           context->getOutputShape(kOutputTensor));
+            return quantizeTo(context->getInputBuffer<float>(kInputTensor),
+                              context->getOutputBuffer<uint8_t>(kOutputTensor),
+                              context->getOutputShape(kOutputTensor));
         } else if (outputType == OperandType::TENSOR_QUANT8_ASYMM_SIGNED) {
-            return quantizeToQuant8Signed<float>(context->getInputBuffer<float>(kInputTensor),
-                                                 context->getOutputBuffer<int8_t>(kOutputTensor),
-                                                 context->getOutputShape(kOutputTensor));
+            return quantizeTo(context->getInputBuffer<float>(kInputTensor),
+                              context->getOutputBuffer<int8_t>(kOutputTensor),
+                              context->getOutputShape(kOutputTensor));
         }
     } else if (inputType == OperandType::TENSOR_FLOAT16) {
         if (outputType == OperandType::TENSOR_QUANT8_ASYMM) {
-            return quantizeToQuant8<_Float16>(context->getInputBuffer<_Float16>(kInputTensor),
-                                              context->getOutputBuffer<uint8_t>(kOutputTensor),
-                                              context->getOutputShape(kOutputTensor));
+            return quantizeTo(context->getInputBuffer<_Float16>(kInputTensor),
+                              context->getOutputBuffer<uint8_t>(kOutputTensor),
+                              context->getOutputShape(kOutputTensor));
         } else if (outputType == OperandType::TENSOR_QUANT8_ASYMM_SIGNED) {
-            return quantizeToQuant8Signed<_Float16>(context->getInputBuffer<_Float16>(kInputTensor),
-                                                    context->getOutputBuffer<int8_t>(kOutputTensor),
-                                                    context->getOutputShape(kOutputTensor));
+            return quantizeTo(context->getInputBuffer<_Float16>(kInputTensor),
+                              context->getOutputBuffer<int8_t>(kOutputTensor),
+                              context->getOutputShape(kOutputTensor));
         }
     }
     NN_RET_CHECK_FAIL() << "Unsupported tensor types combination for QUANTIZE op. (input type: "
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "CpuExecutor.h"
+#include "OperationTestUtils.h"
+#include "QuantUtils.h"
+
+namespace android {
+namespace nn {
+namespace {
+
+constexpr uint32_t kInputTensor = 0;
+constexpr uint32_t kFilterTensor = 1;
+constexpr uint32_t kOutputTensor = 0;
+
+// Execution context of a per-channel CONV_2D that only holds the quantization of its operands.
+TestContext makeContext(float inputScale, std::vector<float> filterScales, float outputScale,
+                        OperationStateCache* cache) {
+    const TestOperand input = {
+            .shape = {.type = OperandType::TENSOR_QUANT8_ASYMM, .scale = inputScale}};
+    const TestOperand filter = {
+            .shape = {.type = OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL,
+                      .extraParams = Operand::SymmPerChannelQuantParams{
+                              .scales = std::move(filterScales), .channelDim = 0}}};
+    const TestOperand bias = {.shape = {.type = OperandType::TENSOR_INT32}};
+    return TestContext({input, filter, bias},
+                       {.type = OperandType::TENSOR_QUANT8_ASYMM, .scale = outputScale},
+                       sizeof(uint8_t), /*constantInputs=*/false, cache);
+}
+
+std::shared_ptr<const PerChannelRequantizationState> getState(TestContext* context) {
+    return getPerChannelRequantizationState<uint8_t>(context, kInputTensor, kFilterTensor,
+                                                     kOutputTensor, kActivationNone);
+}
+
+TEST(RequantizationTest, PerChannelStateIsReusedFromCache) {
+    OperationStateCache cache;
+    TestContext context = makeContext(0.5f, {0.25f, 0.125f}, 0.75f, &cache);
+
+    const auto first = getState(&context);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(context.getCachedState(), first);
+
+    const auto second = getState(&context);
+    EXPECT_EQ(second, first);
+}
+
+TEST(RequantizationTest, PerChannelStateIsRecomputedWhenQuantizationChanges) {
+    OperationStateCache cache;
+    TestContext context = makeContext(0.5f, {0.25f, 0.125f}, 0.75f, &cache);
+    const auto first = getState(&context);
+    ASSERT_NE(first, nullptr);
+
+    // Same operation, as seen by an execution with another output scale.
+    TestContext otherContext = makeContext(0.5f, {0.25f, 0.125f}, 1.5f, &cache);
+    const auto second = getState(&otherContext);
+    ASSERT_NE(second, nullptr);
+    EXPECT_NE(second, first);
+    EXPECT_EQ(otherContext.getCachedState(), second);
+    EXPECT_NE(second->params.shifts, first->params.shifts);
+}
+
+TEST(RequantizationTest, PerChannelStateWithoutCache) {
+    TestContext context = makeContext(0.5f, {0.25f, 0.125f}, 0.75f, /*cache=*/nullptr);
+    const auto first = getState(&context);
+    const auto second = getState(&context);
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    EXPECT_NE(second, first);
+    EXPECT_EQ(second->params.multipliers, first->params.multipliers);
+    EXPECT_EQ(second->params.shifts, first->params.shifts);
+}
+
+TEST(RequantizationTest, PerChannelMatchesPerTensorMultipliers) {
+    // Scales whose product rounds differently in float and in double.
+    const Shape inputShape = {.type = OperandType::TENSOR_QUANT8_ASYMM, .scale = 0.0078125f * 3};
+    const std::vector<float> filterScales = {0.1f, 0.3f, 0.7f};
+    const Shape outputShape = {.type = OperandType::TENSOR_QUANT8_ASYMM, .scale = 0.05f};
+    PerChannelRequantizationParams params;
+    ASSERT_TRUE(getPerChannelRequantizationParams<uint8_t>(inputShape, filterScales, outputShape,
+                                                           kActivationNone, &params));
+    for (uint32_t c = 0; c < filterScales.size(); ++c) {
+        const Shape filterShape = {.type = OperandType::TENSOR_QUANT8_ASYMM,
+                                   .scale = filterScales[c]};
+        double realMultiplier = 0.0;
+        ASSERT_TRUE(GetQuantizedConvolutionMultiplier(inputShape, filterShape, outputShape,
+                                                      &realMultiplier));
+        int32_t multiplier = 0;
+        int32_t shift = 0;
+        ASSERT_TRUE(QuantizeMultiplier(realMultiplier, &multiplier, &shift));
+        EXPECT_EQ(params.multipliers[c], multiplier) << "channel " << c;
+        EXPECT_EQ(params.shifts[c], shift) << "channel " << c;
+    }
+}
+
+TEST(RequantizationTest, PerChannelRejectsNegativeScale) {
+    OperationStateCache cache;
+    TestContext context = makeContext(0.5f, {0.25f, -0.125f}, 0.75f, &cache);
+    EXPECT_EQ(getState(&context), nullptr);
+    EXPECT_EQ(context.getCachedState(), nullptr);
+}
+
+}  // namespace
+}  // namespace nn
+}  // namespace android
@@ -40,6 +40,10 @@ namespace nn {
 bool copyData(const void* inputData, const Shape& inputShape, void* outputData,
               const Shape& /*outputShape*/) {
     NNTRACE_COMP("copyData");
+    // The executor may have made the output a view of the input.
+    if (outputData == inputData) {
+        return true;
+    }
     size_t count = nonExtensionOperandSizeOfData(inputShape.type, inputShape.dimensions);
     memcpy(outputData, inputData, count);
     return true;
@@ -87,104 +91,42 @@ template bool spaceToDepthGeneric<int8_t>(const int8_t* inputData, const Shape&
                                           int32_t blockSize, int8_t* outputData,
                                           const Shape& outputShape);
 
+// The input is copied into the view of the output that starts after the leading padding of every
+// dimension. The padding is then filled one dimension at a time from padValue, read with strides
+// of 0: along dimension d, this covers the rows where every outer dimension holds input data and
+// the full extent of every inner dimension.
 template <typename T>
 bool padGeneric(const T* inputData, const Shape& inputShape, const int32_t* paddings, T padValue,
                 T* outputData, const Shape& outputShape) {
     NNTRACE_TRANS("padGeneric");
-
-    // Based on
-    // http://google3/third_party/tensorflow/contrib/lite/kernels/internal/optimized/optimized_ops.h?l=6194&rcl=213557260
-
-    // TFLite runtime calls are currently fixed at 4 dimensions. Copy inputs so
-    // we can pad them to 4 dims (yes, we are "padding the padding").
-    int32_t numInputDims = static_cast<int32_t>(getNumberOfDimensions(inputShape));
-    NN_OPS_CHECK(numInputDims <= 4);
-    std::vector<int> leftPaddings(4 - numInputDims, 0);
-    std::vector<int> rightPaddings(4 - numInputDims, 0);
-    for (int32_t i = 0; i < numInputDims; ++i) {
-        leftPaddings.push_back(paddings[i * 2]);
-        rightPaddings.push_back(paddings[i * 2 + 1]);
+    const uint32_t numDims = getNumberOfDimensions(inputShape);
+    const std::vector<int64_t> outputStrides = getPackedStrides(outputShape.dimensions, sizeof(T));
+    uint8_t* outputBytes = reinterpret_cast<uint8_t*>(outputData);
+
+    NNTRACE_COMP_SWITCH("stridedCopy");
+    uint8_t* interior = outputBytes;
+    for (uint32_t d = 0; d < numDims; ++d) {
+        interior += paddings[d * 2] * outputStrides[d];
     }
-    const int leftBPadding = leftPaddings[0];
-    const int leftHPadding = leftPaddings[1];
-    const int leftWPadding = leftPaddings[2];
-    const int leftDPadding = leftPaddings[3];
-    const int rightBPadding = rightPaddings[0];
-    const int rightHPadding = rightPaddings[1];
-    const int rightWPadding = rightPaddings[2];
-    const int rightDPadding = rightPaddings[3];
-
-    const auto extInputShape =
-            tflite::RuntimeShape::ExtendedShape(4, convertShapeToTflshape(inputShape));
-    const auto extOutputShape =
-            tflite::RuntimeShape::ExtendedShape(4, convertShapeToTflshape(outputShape));
-
-    const int outputBatch = extOutputShape.Dims(0);
-    const int outputHeight = extOutputShape.Dims(1);
-    const int outputWidth = extOutputShape.Dims(2);
-    const int outputDepth = extOutputShape.Dims(3);
-
-    const int inputDepth = extInputShape.Dims(3);
-
-    NNTRACE_COMP_SWITCH("padGeneric");
-
-    if (leftBPadding != 0) {
-        tflite::optimized_ops::TypedMemset<T>(
-                outputData, padValue, leftBPadding * outputHeight * outputWidth * outputDepth);
-    }
-    for (int outB = leftBPadding; outB < outputBatch - rightBPadding; ++outB) {
-        if (leftHPadding != 0) {
-            tflite::optimized_ops::TypedMemset<T>(
-                    outputData + tflite::Offset(extOutputShape, outB, 0, 0, 0), padValue,
-                    leftHPadding * outputWidth * outputDepth);
-        }
-        for (int outH = leftHPadding; outH < outputHeight - rightHPadding; ++outH) {
-            if (leftWPadding != 0) {
-                tflite::optimized_ops::TypedMemset<T>(
-                        outputData + tflite::Offset(extOutputShape, outB, outH, 0, 0), padValue,
-                        leftWPadding * outputDepth);
-            }
-            for (int outW = leftWPadding; outW < outputWidth - rightWPadding; ++outW) {
-                if (leftDPadding != 0) {
-                    tflite::optimized_ops::TypedMemset<T>(
-                            outputData + tflite::Offset(extOutputShape, outB, outH, outW, 0),
-                            padValue, leftDPadding);
-                }
-
-                T* out =
-                        outputData + tflite::Offset(extOutputShape, outB, outH, outW, leftDPadding);
-                const T* in =
-                        inputData + tflite::Offset(extInputShape, outB - leftBPadding,
-                                                   outH - leftHPadding, outW - leftWPadding, 0);
-                memcpy(out, in, inputDepth * sizeof(T));
-
-                if (rightDPadding != 0) {
-                    tflite::optimized_ops::TypedMemset<T>(
-                            outputData + tflite::Offset(extOutputShape, outB, outH, outW,
-                                                        outputDepth - rightDPadding),
-                            padValue, rightDPadding);
-                }
-            }
-            if (rightWPadding != 0) {
-                tflite::optimized_ops::TypedMemset<T>(
-                        outputData + tflite::Offset(extOutputShape, outB, outH,
-                                                    outputWidth - rightWPadding, 0),
-                        padValue, rightWPadding * outputDepth);
-            }
-        }
-        if (rightHPadding != 0) {
-            tflite::optimized_ops::TypedMemset<T>(
-                    outputData + tflite::Offset(extOutputShape, outB, outputHeight - rightHPadding,
-                                                0, 0),
-                    padValue, rightHPadding * outputWidth * outputDepth);
-        }
-    }
-    if (rightBPadding != 0) {
-        tflite::optimized_ops::TypedMemset<T>(
-                outputData + tflite::Offset(extOutputShape, outputBatch - rightBPadding, 0, 0, 0),
-                padValue, rightBPadding * outputHeight * outputWidth * outputDepth);
+    stridedCopy(inputData, getPackedStrides(inputShape.dimensions, sizeof(T)), interior,
+                outputStrides, inputShape.dimensions, sizeof(T));
+
+    const std::vector<int64_t> padValueStrides(numDims, 0);
+    std::vector<uint32_t> regionDims = outputShape.dimensions;
+    uint8_t* regionData = outputBytes;
+    for (uint32_t d = 0; d < numDims; ++d) {
+        const int32_t before = paddings[d * 2];
+        const int32_t after = paddings[d * 2 + 1];
+        const uint32_t inputSize = getSizeOfDimension(inputShape, d);
+        regionDims[d] = before;
+        stridedCopy(&padValue, padValueStrides, regionData, outputStrides, regionDims, sizeof(T));
+        regionDims[d] = after;
+        stridedCopy(&padValue, padValueStrides,
+                    regionData + (before + inputSize) * outputStrides[d], outputStrides,
+                    regionDims, sizeof(T));
+        regionDims[d] = inputSize;
+        regionData += before * outputStrides[d];
     }
-
     return true;
 }
 template bool padGeneric<float>(const float* inputData, const Shape& inputShape,
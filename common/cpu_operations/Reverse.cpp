@@ -22,12 +22,7 @@
 #include "OperationsExecutionUtils.h"
 
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
-
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunused-parameter"
-#pragma clang diagnostic ignored "-Wsign-compare"
-#include <tensorflow/lite/kernels/internal/reference/reference_ops.h>
-#pragma clang diagnostic pop
+#include <vector>
 
 #include "CpuOperationUtils.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
@@ -58,16 +53,23 @@ bool prepare(IOperationExecutionContext* context) {
     return context->setOutputShape(kOutputTensor, outputShape);
 }
 
+// The output is a view of the input that walks the reversed axis backwards.
 template <typename T>
 bool reverse(IOperationExecutionContext* context) {
     // Note that the NNAPI REVERSE operation requires input and output tensor to
     // have the same dimensions.
-    const tflite::RuntimeShape tensorShape =
-            convertShapeToTflshape(context->getInputShape(kInputTensor));
-
-    tflite::reference_ops::Reverse((context->getInputBuffer<int32_t>(kInputAxisTensor))[0],
-                                   tensorShape, context->getInputBuffer<T>(kInputTensor),
-                                   tensorShape, context->getOutputBuffer<T>(kOutputTensor));
+    const Shape shape = context->getInputShape(kInputTensor);
+    const int32_t axis = (context->getInputBuffer<int32_t>(kInputAxisTensor))[0];
+    std::vector<int64_t> srcStrides = getPackedStrides(shape.dimensions, sizeof(T));
+    const uint8_t* srcData =
+            reinterpret_cast<const uint8_t*>(context->getInputBuffer<T>(kInputTensor));
+    const uint32_t axisSize = getSizeOfDimension(shape, axis);
+    if (axisSize > 0) {
+        srcData += (axisSize - 1) * srcStrides[axis];
+    }
+    srcStrides[axis] = -srcStrides[axis];
+    stridedCopy(srcData, srcStrides, context->getOutputBuffer<T>(kOutputTensor),
+                getPackedStrides(shape.dimensions, sizeof(T)), shape.dimensions, sizeof(T));
     return true;
 }
 
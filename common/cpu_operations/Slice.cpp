@@ -20,8 +20,8 @@
 
 #include <vector>
 
-#include "IndexedShapeWrapper.h"
 #include "OperationResolver.h"
+#include "Operations.h"
 
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 #include "CpuOperationUtils.h"
@@ -34,41 +34,19 @@ namespace slice {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
-template <typename T>
-void addVectors(const std::vector<T>& a, const std::vector<T>& b, std::vector<T>* res) {
-    for (size_t i = 0; i < res->size(); ++i) {
-        res->at(i) = a[i] + b[i];
-    }
-}
-
+// The slice is a view of the input that starts at beginData and keeps the strides of the input.
 template <typename T>
 bool evalGeneric(const T* inputData, const Shape& inputShape, const int32_t* beginData,
                  const Shape& beginShape, const int32_t* /*sizeData*/, const Shape& /*sizeShape*/,
                  T* outputData, const Shape& outputShape) {
-    [[maybe_unused]] const int outputSize = getNumberOfElements(outputShape);
-    const IndexedShapeWrapper indexedOutput = IndexedShapeWrapper(outputShape);
-    const IndexedShapeWrapper indexedInput = IndexedShapeWrapper(inputShape);
-    std::vector<uint32_t> outputIndex(getNumberOfDimensions(outputShape), 0);
-    std::vector<uint32_t> beginIndex(getSizeOfDimension(beginShape, 0));
-    std::vector<uint32_t> inputIndex(getNumberOfDimensions(inputShape));
-
-    for (size_t i = 0; i < beginIndex.size(); ++i) {
-        beginIndex[i] = static_cast<uint32_t>(beginData[i]);
+    const std::vector<int64_t> inputStrides = getPackedStrides(inputShape.dimensions, sizeof(T));
+    const uint8_t* sliceData = reinterpret_cast<const uint8_t*>(inputData);
+    for (uint32_t i = 0; i < getSizeOfDimension(beginShape, 0); ++i) {
+        sliceData += beginData[i] * inputStrides[i];
     }
-
-    bool lastIndex = false;
-    uint32_t outputOffset;
-    uint32_t inputOffset;
-
-    do {
-        addVectors(outputIndex, beginIndex, &inputIndex);
-
-        NN_RET_CHECK(indexedOutput.indexToFlatIndex(outputIndex, &outputOffset));
-        NN_RET_CHECK(indexedInput.indexToFlatIndex(inputIndex, &inputOffset));
-
-        outputData[outputOffset] = inputData[inputOffset];
-        NN_RET_CHECK(indexedOutput.nextIndexInplace(&outputIndex, &lastIndex));
-    } while (!lastIndex);
+    stridedCopy(sliceData, inputStrides, outputData,
+                getPackedStrides(outputShape.dimensions, sizeof(T)), outputShape.dimensions,
+                sizeof(T));
     return true;
 }
 
@@ -104,12 +82,23 @@ bool prepare(IOperationExecutionContext* context) {
                         getSizeOfDimension(inputShape, i));
         outputShape.dimensions[i] = sliceSize;
     }
+    // A slice that covers the whole input is a view of it.
+    if (outputShape.dimensions == inputShape.dimensions) {
+        return context->setViewOutputShape(kOutputTensor, kInputTensor, outputShape);
+    }
     return context->setOutputShape(kOutputTensor, outputShape);
 }
 
 bool execute(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
     if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (context->getOutputShape(kOutputTensor).dimensions ==
+        context->getInputShape(kInputTensor).dimensions) {
+        return copyData(context->getInputBuffer(kInputTensor),
+                        context->getInputShape(kInputTensor),
+                        context->getOutputBuffer(kOutputTensor),
+                        context->getOutputShape(kOutputTensor));
+    }
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16:
             return evalGeneric(context->getInputBuffer<_Float16>(kInputTensor),
@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <cfloat>
 #include <limits>
+#include <memory>
 #include <vector>
 
 #include "OperationResolver.h"
@@ -196,9 +197,45 @@ bool softmaxQuant8Impl(const T* inputData, const Shape& inputShape, const float
     return true;
 }
 
+// Fixed-point parameters of a quantized SOFTMAX, kept on the prepared model together with the beta
+// and input scale they were derived from.
+struct SoftmaxQuant8State : public OperationState {
+    float beta;
+    float inputScale;
+    int32_t inputMultiplier;
+    int32_t inputLeftShift;
+    int32_t diffMin;
+};
+
+std::shared_ptr<const SoftmaxQuant8State> getSoftmaxQuant8State(
+        IOperationExecutionContext* context) {
+    const float beta = context->getInputValue<float>(kBetaScalar);
+    const float inputScale = context->getInputShape(kInputTensor).scale;
+    auto state = context->getCachedState<SoftmaxQuant8State>();
+    if (state != nullptr && state->beta == beta && state->inputScale == inputScale) {
+        return state;
+    }
+
+    static const int32_t kScaledDiffIntegerBits = 5;
+    const double input_beta_real_multiplier =
+            std::min(1.0 * beta * inputScale * (1 << (31 - kScaledDiffIntegerBits)),
+                     (1LL << 31) - 1.0);
+
+    auto newState = std::make_shared<SoftmaxQuant8State>();
+    newState->beta = beta;
+    newState->inputScale = inputScale;
+    if (!QuantizeMultiplierGreaterThanOne(input_beta_real_multiplier, &newState->inputMultiplier,
+                                          &newState->inputLeftShift)) {
+        return nullptr;
+    }
+    newState->diffMin = -CalculateInputRadius(kScaledDiffIntegerBits, newState->inputLeftShift);
+    context->setCachedState(newState);
+    return newState;
+}
+
 template <typename T>
-bool softmaxQuant8(const T* inputData, const Shape& inputShape, const float beta, int32_t axis,
-                   T* outputData, const Shape& outputShape) {
+bool softmaxQuant8(const T* inputData, const Shape& inputShape, const SoftmaxQuant8State& state,
+                   int32_t axis, T* outputData, const Shape& outputShape) {
     [[maybe_unused]] int32_t ndim = getNumberOfDimensions(inputShape);
     NN_CHECK(handleNegativeAxis(inputShape, &axis));
 
@@ -210,20 +247,8 @@ bool softmaxQuant8(const T* inputData, const Shape& inputShape, const float beta
         return false;
     }
 
-    static const int32_t kScaledDiffIntegerBits = 5;
-    const double input_beta_real_multiplier =
-            std::min(1.0 * beta * inputShape.scale * (1 << (31 - kScaledDiffIntegerBits)),
-                     (1LL << 31) - 1.0);
-
-    int32_t inputMultiplier = 0, inputLeftShift = 0;
-    if (!QuantizeMultiplierGreaterThanOne(input_beta_real_multiplier, &inputMultiplier,
-                                          &inputLeftShift)) {
-        return false;
-    }
-    int32_t diffMin = -CalculateInputRadius(kScaledDiffIntegerBits, inputLeftShift);
-
-    return softmaxQuant8Impl(inputData, inputShape, beta, axis, inputMultiplier, inputLeftShift,
-                             diffMin, outputData, outputShape);
+    return softmaxQuant8Impl(inputData, inputShape, state.beta, axis, state.inputMultiplier,
+                             state.inputLeftShift, state.diffMin, outputData, outputShape);
 }
 
 }  // namespace
@@ -259,18 +284,22 @@ bool execute(IOperationExecutionContext* context) {
                                   context->getInputValue<float>(kBetaScalar), axis,
                                   context->getOutputBuffer<float>(kOutputTensor),
                                   context->getOutputShape(kOutputTensor));
-        case OperandType::TENSOR_QUANT8_ASYMM:
+        case OperandType::TENSOR_QUANT8_ASYMM: {
+            const auto state = getSoftmaxQuant8State(context);
+            NN_RET_CHECK(state != nullptr);
             return softmaxQuant8(context->getInputBuffer<uint8_t>(kInputTensor),
-                                 context->getInputShape(kInputTensor),
-                                 context->getInputValue<float>(kBetaScalar), axis,
+                                 context->getInputShape(kInputTensor), *state, axis,
                                  context->getOutputBuffer<uint8_t>(kOutputTensor),
                                  context->getOutputShape(kOutputTensor));
-        case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
+        }
+        case OperandType::TENSOR_QUANT8_ASYMM_SIGNED: {
+            const auto state = getSoftmaxQuant8State(context);
+            NN_RET_CHECK(state != nullptr);
             return softmaxQuant8(context->getInputBuffer<int8_t>(kInputTensor),
-                                 context->getInputShape(kInputTensor),
-                                 context->getInputValue<float>(kBetaScalar), axis,
+                                 context->getInputShape(kInputTensor), *state, axis,
                                  context->getOutputBuffer<int8_t>(kOutputTensor),
                                  context->getOutputShape(kOutputTensor));
+        }
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation " << kOperationName;
     }
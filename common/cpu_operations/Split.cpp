@@ -46,7 +46,11 @@ bool splitGeneric(const Scalar* inputData, const Shape& inputShape, int32_t axis
     for (int k = 0; k < outerSize; k++) {
         for (size_t i = 0; i < outputDataPtrs->size(); ++i) {
             const int copySize = outputShapes[i].dimensions[axis] * baseInnerSize;
-            memcpy(outputDataPtrs->at(i) + k * copySize, inputPtr, copySize * sizeof(Scalar));
+            Scalar* outputPtr = outputDataPtrs->at(i) + k * copySize;
+            // The output may be a view of its slice of the input, set up by the executor.
+            if (outputPtr != inputPtr) {
+                memcpy(outputPtr, inputPtr, copySize * sizeof(Scalar));
+            }
             inputPtr += copySize;
         }
     }
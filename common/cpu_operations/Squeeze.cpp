@@ -85,7 +85,7 @@ bool prepare(IOperationExecutionContext* context) {
     Shape outputShape(inputShape);
     outputShape.dimensions = outDims;
 
-    return context->setOutputShape(kOutputTensor, outputShape);
+    return context->setViewOutputShape(kOutputTensor, kInputTensor, outputShape);
 }
 
 bool execute(IOperationExecutionContext* context) {
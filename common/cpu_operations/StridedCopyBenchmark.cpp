@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "OperationsExecutionUtils.h"
+
+// Measures stridedCopy on the views that slicing, tiling, padding and shuffling operations lower
+// to, on an NHWC float tensor of shape [1, size, size, 32]. Each benchmark reports the bytes
+// written per second.
+
+namespace android {
+namespace nn {
+namespace {
+
+constexpr uint32_t kDepth = 32;
+constexpr uint32_t kElementSize = sizeof(float);
+
+std::vector<uint32_t> getInputDimensions(const benchmark::State& state) {
+    const uint32_t size = state.range(0);
+    return {1, size, size, kDepth};
+}
+
+void runCopy(benchmark::State& state, const uint8_t* src, const std::vector<int64_t>& srcStrides,
+             const std::vector<uint32_t>& dimensions) {
+    uint64_t numElements = 1;
+    for (uint32_t dimension : dimensions) {
+        numElements *= dimension;
+    }
+    std::vector<float> output(numElements);
+    const std::vector<int64_t> dstStrides = getPackedStrides(dimensions, kElementSize);
+    for (auto _ : state) {
+        stridedCopy(src, srcStrides, output.data(), dstStrides, dimensions, kElementSize);
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * numElements * kElementSize);
+}
+
+// SLICE of the central half of each spatial dimension.
+void BM_Slice(benchmark::State& state) {
+    const std::vector<uint32_t> dims = getInputDimensions(state);
+    const std::vector<float> input(dims[1] * dims[2] * kDepth);
+    const std::vector<int64_t> strides = getPackedStrides(dims, kElementSize);
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(input.data()) +
+                           dims[1] / 4 * strides[1] + dims[2] / 4 * strides[2];
+    runCopy(state, begin, strides, {1, dims[1] / 2, dims[2] / 2, kDepth});
+}
+
+// STRIDED_SLICE taking every other row and column.
+void BM_StridedSlice(benchmark::State& state) {
+    const std::vector<uint32_t> dims = getInputDimensions(state);
+    const std::vector<float> input(dims[1] * dims[2] * kDepth);
+    const std::vector<int64_t> strides = getPackedStrides(dims, kElementSize);
+    runCopy(state, reinterpret_cast<const uint8_t*>(input.data()),
+            {strides[0], 2 * strides[1], 2 * strides[2], strides[3]},
+            {1, dims[1] / 2, dims[2] / 2, kDepth});
+}
+
+// TILE with multiples [1, 2, 2, 1].
+void BM_Tile(benchmark::State& state) {
+    const std::vector<uint32_t> dims = getInputDimensions(state);
+    const std::vector<float> input(dims[1] * dims[2] * kDepth);
+    const std::vector<int64_t> strides = getPackedStrides(dims, kElementSize);
+    runCopy(state, reinterpret_cast<const uint8_t*>(input.data()),
+            {0, strides[1], 0, strides[2], strides[3]}, {2, dims[1], 2, dims[2], kDepth});
+}
+
+// PAD and MIRROR_PAD both copy the input into the interior of the output, and fill the borders
+// with copies along single dimensions. This measures the interior copy, with 1 element of padding
+// on each side of the spatial dimensions.
+void BM_PadInterior(benchmark::State& state) {
+    const std::vector<uint32_t> dims = getInputDimensions(state);
+    const std::vector<float> input(dims[1] * dims[2] * kDepth);
+    const std::vector<uint32_t> outputDims = {1, dims[1] + 2, dims[2] + 2, kDepth};
+    std::vector<float> output(outputDims[1] * outputDims[2] * kDepth);
+    const std::vector<int64_t> srcStrides = getPackedStrides(dims, kElementSize);
+    const std::vector<int64_t> dstStrides = getPackedStrides(outputDims, kElementSize);
+    uint8_t* interior =
+            reinterpret_cast<uint8_t*>(output.data()) + dstStrides[1] + dstStrides[2];
+    for (auto _ : state) {
+        stridedCopy(input.data(), srcStrides, interior, dstStrides, dims, kElementSize);
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * input.size() * kElementSize);
+}
+
+// MIRROR_PAD filling the leading padding of the width dimension from the columns after it.
+void BM_MirrorPadBorder(benchmark::State& state) {
+    const std::vector<uint32_t> dims = getInputDimensions(state);
+    const std::vector<float> input(dims[1] * dims[2] * kDepth);
+    std::vector<int64_t> strides = getPackedStrides(dims, kElementSize);
+    const uint32_t padding = 4;
+    const uint8_t* mirrored =
+            reinterpret_cast<const uint8_t*>(input.data()) + (2 * padding - 1) * strides[2];
+    strides[2] = -strides[2];
+    runCopy(state, mirrored, strides, {1, dims[1], padding, kDepth});
+}
+
+// CHANNEL_SHUFFLE with 4 groups along the depth.
+void BM_ChannelShuffle(benchmark::State& state) {
+    const std::vector<uint32_t> dims = getInputDimensions(state);
+    const std::vector<float> input(dims[1] * dims[2] * kDepth);
+    const uint32_t numGroups = 4;
+    const uint32_t groupSize = kDepth / numGroups;
+    // Walks the input in output order: [pixel, channel within group, group].
+    runCopy(state, reinterpret_cast<const uint8_t*>(input.data()),
+            {kDepth * kElementSize, kElementSize, groupSize * kElementSize},
+            {dims[1] * dims[2], groupSize, numGroups});
+}
+
+// REVERSE along the width dimension.
+void BM_Reverse(benchmark::State& state) {
+    const std::vector<uint32_t> dims = getInputDimensions(state);
+    const std::vector<float> input(dims[1] * dims[2] * kDepth);
+    std::vector<int64_t> strides = getPackedStrides(dims, kElementSize);
+    const uint8_t* last =
+            reinterpret_cast<const uint8_t*>(input.data()) + (dims[2] - 1) * strides[2];
+    strides[2] = -strides[2];
+    runCopy(state, last, strides, dims);
+}
+
+// PACK of 4 inputs along the depth, measuring the copy of one input into its strided slots.
+void BM_Pack(benchmark::State& state) {
+    const std::vector<uint32_t> dims = getInputDimensions(state);
+    const uint32_t inputCount = 4;
+    const uint32_t outerSize = dims[1] * dims[2];
+    const std::vector<float> input(outerSize * kDepth);
+    std::vector<float> output(outerSize * inputCount * kDepth);
+    const int64_t innerStride = kDepth * kElementSize;
+    for (auto _ : state) {
+        stridedCopy(input.data(), {innerStride, kElementSize}, output.data(),
+                    {inputCount * innerStride, kElementSize}, {outerSize, kDepth}, kElementSize);
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * input.size() * kElementSize);
+}
+
+BENCHMARK(BM_Slice)->Arg(32)->Arg(128)->Arg(512);
+BENCHMARK(BM_StridedSlice)->Arg(32)->Arg(128)->Arg(512);
+BENCHMARK(BM_Tile)->Arg(32)->Arg(128)->Arg(512);
+BENCHMARK(BM_PadInterior)->Arg(32)->Arg(128)->Arg(512);
+BENCHMARK(BM_MirrorPadBorder)->Arg(32)->Arg(128)->Arg(512);
+BENCHMARK(BM_ChannelShuffle)->Arg(32)->Arg(128)->Arg(512);
+BENCHMARK(BM_Reverse)->Arg(32)->Arg(128)->Arg(512);
+BENCHMARK(BM_Pack)->Arg(32)->Arg(128)->Arg(512);
+
+}  // namespace
+}  // namespace nn
+}  // namespace android
+
+BENCHMARK_MAIN();
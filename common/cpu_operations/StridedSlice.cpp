@@ -27,11 +27,7 @@
 #include "Tracing.h"
 
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunused-parameter"
-#pragma clang diagnostic ignored "-Wsign-compare"
-#include <tensorflow/lite/kernels/internal/reference/legacy_reference_ops.h>
-#pragma clang diagnostic pop
+#include <cmath>
 
 #include "CpuOperationUtils.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
@@ -43,41 +39,55 @@ namespace strided_slice {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
+// Returns the first index of the input taken along dimension idx, and sets *size to the number of
+// indices taken. This is valid for both positive and negative strides.
+int32_t getSliceBegin(const Shape& inputShape, int32_t idx, const int32_t* beginData,
+                      const int32_t* endData, const int32_t* stridesData, int32_t beginMask,
+                      int32_t endMask, uint32_t* size) {
+    const int32_t dim = static_cast<int32_t>(getSizeOfDimension(inputShape, idx));
+    const int32_t stride = stridesData[idx];
+    const bool positiveStride = stride > 0;
+    const int32_t begin = beginMask & (1 << idx)
+                                  ? positiveStride ? 0 : dim - 1
+                                  : ClampedIndex(beginData[idx], dim, positiveStride);
+    const int32_t end = endMask & (1 << idx) ? positiveStride ? dim : -1
+                                             : ClampedIndex(endData[idx], dim, positiveStride);
+    const int32_t outDim = ceil((end - begin) / static_cast<float>(stride));
+    *size = outDim < 0 ? 0 : static_cast<uint32_t>(outDim);
+    return begin;
+}
+
+// The slice is a view of the input whose strides are those of the input scaled by the strides of
+// the op. Shrunk axes take a single index and are dimensions of size 1 of that view.
 template <typename T>
 bool compute(const T* inputData, const Shape& inputShape, const int32_t* beginData,
              const int32_t* endData, const int32_t* stridesData, int32_t beginMask, int32_t endMask,
-             int32_t shrinkAxisMask, T* outputData, const Shape& outputShape) {
+             T* outputData) {
     NNTRACE_TRANS("stridedSlice");
-    // This Op only supports 1-4D cases and since we use the reference 4D
-    // implementation, the 1-3D tensors are mapped to 4D.
-    const int kMaxDim = 4;
-
-    std::vector<int> starts;
-    std::vector<int> stops;
-    std::vector<int> strides;
-
-    int32_t numInputDims = static_cast<int32_t>(getNumberOfDimensions(inputShape));
-    for (int32_t idx = numInputDims - 1; idx >= 0; --idx) {
-        starts.emplace_back(beginData[idx]);
-        stops.emplace_back(endData[idx]);
-        strides.emplace_back(stridesData[idx]);
+    const int32_t numInputDims = static_cast<int32_t>(getNumberOfDimensions(inputShape));
+    const std::vector<int64_t> inputStrides = getPackedStrides(inputShape.dimensions, sizeof(T));
+    std::vector<uint32_t> sliceDims(numInputDims);
+    std::vector<int64_t> sliceStrides(numInputDims);
+    const uint8_t* sliceData = reinterpret_cast<const uint8_t*>(inputData);
+    for (int32_t idx = 0; idx < numInputDims; ++idx) {
+        const int32_t begin = getSliceBegin(inputShape, idx, beginData, endData, stridesData,
+                                            beginMask, endMask, &sliceDims[idx]);
+        sliceData += begin * inputStrides[idx];
+        sliceStrides[idx] = inputStrides[idx] * stridesData[idx];
     }
+    stridedCopy(sliceData, sliceStrides, outputData, getPackedStrides(sliceDims, sizeof(T)),
+                sliceDims, sizeof(T));
+    return true;
+}
 
-    for (int i = numInputDims; i < kMaxDim; i++) {
-        starts.emplace_back(0);
-        stops.emplace_back(1);
-        strides.emplace_back(1);
+// Returns true if the slice selects every element of the input in order, in which case the output
+// holds exactly the bytes of the input. With positive strides, each output dimension is at most as
+// large as the input one, so equal element counts mean that every dimension is taken in full.
+bool isWholeInput(const Shape& inputShape, const int32_t* stridesData, const Shape& outputShape) {
+    for (uint32_t i = 0; i < getNumberOfDimensions(inputShape); ++i) {
+        if (stridesData[i] < 0) return false;
     }
-
-    beginMask = ReverseMaskBits(beginMask, numInputDims);
-    endMask = ReverseMaskBits(endMask, numInputDims);
-    shrinkAxisMask = ReverseMaskBits(shrinkAxisMask, numInputDims);
-
-    tflite::reference_ops::StridedSlice(inputData, convertShapeToDims(inputShape), beginMask,
-                                        endMask, shrinkAxisMask, starts, stops, strides, outputData,
-                                        convertShapeToDims(outputShape));
-
-    return true;
+    return getNumberOfElements(inputShape) == getNumberOfElements(outputShape);
 }
 
 template <typename T>
@@ -88,8 +98,7 @@ bool executeTyped(IOperationExecutionContext* context) {
             context->getInputBuffer<int32_t>(kEndTensor),
             context->getInputBuffer<int32_t>(kStridesTensor),
             context->getInputValue<int32_t>(kBeginMask), context->getInputValue<int32_t>(kEndMask),
-            context->getInputValue<int32_t>(kShrinkAxisMask),
-            context->getOutputBuffer<T>(kOutputTensor), context->getOutputShape(kOutputTensor));
+            context->getOutputBuffer<T>(kOutputTensor));
 }
 
 }  // namespace
@@ -127,26 +136,19 @@ bool prepare(IOperationExecutionContext* context) {
     // Determine size of output tensor and map indices
     std::vector<uint32_t> outDims;
     for (int32_t idx = 0; idx < static_cast<int32_t>(numInputDims); idx++) {
-        int32_t dim = static_cast<int32_t>(getSizeOfDimension(inputShape, idx));
         int32_t stride = stridesData[idx];
         // stride value has to be non-zero
         NN_OPS_CHECK(stride != 0);
-        bool positiveStride = stride > 0;
-
-        int32_t begin = beginMask & (1 << idx) ? positiveStride ? 0 : dim - 1
-                                               : ClampedIndex(beginData[idx], dim, positiveStride);
-        int32_t end = endMask & (1 << idx) ? positiveStride ? dim : -1
-                                           : ClampedIndex(endData[idx], dim, positiveStride);
 
-        // This is valid for both positive and negative strides
-        int32_t outDim = ceil((end - begin) / static_cast<float>(stride));
-        outDim = outDim < 0 ? 0 : static_cast<uint32_t>(outDim);
+        uint32_t outDim;
+        getSliceBegin(inputShape, idx, beginData, endData, stridesData, beginMask, endMask,
+                      &outDim);
         if (!(shrinkAxisMask & (1 << idx))) {
             outDims.push_back(outDim);
         } else {
             // Only positive stride is allowed on non-range indexing (i.e. shrinkMask is set).
             NN_RET_CHECK_GT(stride, 0) << "index = " << idx;
-            NN_RET_CHECK_EQ(outDim, 1) << "index = " << idx;
+            NN_RET_CHECK_EQ(outDim, 1u) << "index = " << idx;
         }
     }
 
@@ -158,10 +160,21 @@ bool prepare(IOperationExecutionContext* context) {
     Shape outputShape = context->getOutputShape(kOutputTensor);
     NN_RET_CHECK(SetShape(inputShape, &outputShape));
     outputShape.dimensions = outDims;
+    if (isWholeInput(inputShape, stridesData, outputShape)) {
+        return context->setViewOutputShape(kOutputTensor, kInputTensor, outputShape);
+    }
     return context->setOutputShape(kOutputTensor, outputShape);
 }
 
 bool execute(IOperationExecutionContext* context) {
+    if (isWholeInput(context->getInputShape(kInputTensor),
+                     context->getInputBuffer<int32_t>(kStridesTensor),
+                     context->getOutputShape(kOutputTensor))) {
+        return copyData(context->getInputBuffer(kInputTensor),
+                        context->getInputShape(kInputTensor),
+                        context->getOutputBuffer(kOutputTensor),
+                        context->getOutputShape(kOutputTensor));
+    }
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16:
             return executeTyped<_Float16>(context);
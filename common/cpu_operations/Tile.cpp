@@ -18,9 +18,9 @@
 
 #include "Tile.h"
 
-#include <algorithm>
-#include <utility>
+#include <vector>
 
+#include "OperationsExecutionUtils.h"
 #include "Tracing.h"
 
 namespace android {
@@ -29,46 +29,26 @@ namespace tile {
 
 namespace {
 
-template <typename T>
-void CopyMultipleTimes(const T* in_data, int32_t in_size, int32_t multiplier, T* out_data) {
-    for (int i = 0; i < multiplier; ++i) {
-        const T* in_end = in_data + in_size;
-        T* new_out_data = std::copy(in_data, in_end, out_data);
-        in_data = out_data;
-        out_data = new_out_data;
-    }
-}
-
-template <typename T, typename M>
-std::pair<int, int> TileOneDimension(const Shape& input_shape, const T* in_data,
-                                     const M* multipliers, T* out_data, int dimension) {
-    const int dimension_size = input_shape.dimensions[dimension];
-    if (static_cast<size_t>(dimension) == input_shape.dimensions.size() - 1) {
-        CopyMultipleTimes(in_data, dimension_size, multipliers[dimension], out_data);
-        return std::make_pair(dimension_size,
-                              dimension_size * static_cast<int>(multipliers[dimension]));
-    }
-    int total_stride_size = 0, total_tiled_stride_size = 0;
-    const T* copy_from_data = in_data;
-    T* copy_to_data = out_data;
-    for (int i = 0; i < dimension_size; ++i) {
-        int stride_size = 0, tiled_stride_size = 0;
-        std::tie(stride_size, tiled_stride_size) = TileOneDimension(
-                input_shape, copy_from_data, multipliers, copy_to_data, dimension + 1);
-        copy_from_data += stride_size;
-        copy_to_data += tiled_stride_size;
-        total_stride_size += stride_size;
-        total_tiled_stride_size += tiled_stride_size;
-    }
-    CopyMultipleTimes(out_data, total_tiled_stride_size, multipliers[dimension] - 1,
-                      out_data + total_tiled_stride_size);
-    return std::make_pair(total_stride_size, total_tiled_stride_size * multipliers[dimension]);
-}
-
+// Each dimension of the output is split into (multiple, input dimension). The input is read with
+// a stride of 0 along the multiples, so that every tile is a copy of the whole input.
 template <typename T>
 void tileImpl(const T* inputData, const Shape& inputShape, const int32_t* multiples, T* outputData,
-              const Shape& /*outputShape*/) {
-    TileOneDimension(inputShape, inputData, multiples, outputData, 0);
+              const Shape& outputShape) {
+    const size_t numDims = inputShape.dimensions.size();
+    const std::vector<int64_t> inputStrides = getPackedStrides(inputShape.dimensions, sizeof(T));
+    const std::vector<int64_t> outputStrides = getPackedStrides(outputShape.dimensions, sizeof(T));
+    std::vector<uint32_t> tiledDims(2 * numDims);
+    std::vector<int64_t> srcStrides(2 * numDims);
+    std::vector<int64_t> dstStrides(2 * numDims);
+    for (size_t i = 0; i < numDims; ++i) {
+        tiledDims[2 * i] = multiples[i];
+        srcStrides[2 * i] = 0;
+        dstStrides[2 * i] = outputStrides[i] * inputShape.dimensions[i];
+        tiledDims[2 * i + 1] = inputShape.dimensions[i];
+        srcStrides[2 * i + 1] = inputStrides[i];
+        dstStrides[2 * i + 1] = outputStrides[i];
+    }
+    stridedCopy(inputData, srcStrides, outputData, dstStrides, tiledDims, sizeof(T));
 }
 
 }  // namespace
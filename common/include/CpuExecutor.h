@@ -18,11 +18,15 @@
 #define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_EXECUTOR_H
 
 #include <android-base/macros.h>
+#include <android-base/thread_annotations.h>
 #include <nnapi/Types.h>
 
 #include <algorithm>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <utility>
 #include <vector>
 
 #include "ControlFlow.h"
@@ -33,6 +37,25 @@
 namespace android {
 namespace nn {
 
+// A block of memory shared by several temporaries, such as the inputs and the output of a
+// CONCATENATION. It is allocated when the first of them is written.
+class SharedBlock {
+   public:
+    explicit SharedBlock(uint32_t length) : mLength(length) {}
+
+    // Returns the block, allocating it on first use.
+    uint8_t* get() {
+        if (mData == nullptr) {
+            mData.reset(new uint8_t[mLength]);
+        }
+        return mData.get();
+    }
+
+   private:
+    const uint32_t mLength;
+    std::unique_ptr<uint8_t[]> mData;
+};
+
 // Information we maintain about each operand during execution that
 // may change during execution.
 struct RunTimeOperandInfo {
@@ -70,6 +93,16 @@ struct RunTimeOperandInfo {
     // we free the buffer.  For non-temporary variables, this count is
     // always 0.
     uint32_t numberOfUsesLeft;
+    // Set when the operand is the slice of a block shared with other temporaries that starts at
+    // sharedBlockOffset, such as an input of CONCATENATION that its producer writes straight into
+    // the output. buffer points into the block once the operation producing the operand is about
+    // to run. The block is freed when the last operand referencing it releases it, never along
+    // with the operand alone.
+    std::shared_ptr<SharedBlock> sharedBlock;
+    uint32_t sharedBlockOffset;
+    // Set instead of buffer for the output of a DENSIFY of constants whose every consumer reads
+    // the sparse operands directly. The DENSIFY operation is then skipped.
+    std::shared_ptr<const SparseTensor> sparse;
 
     Operand::ExtraParams extraParams;
 
@@ -126,6 +159,23 @@ bool setRunTimePoolInfosFromCanonicalMemories(std::vector<RunTimePoolInfo>* pool
 bool setRunTimePoolInfosFromMemoryPools(std::vector<RunTimePoolInfo>* poolInfos,
                                         const std::vector<Request::MemoryPool>& pools);
 
+// Holds the OperationState of every operation of one model, so that it survives across
+// executions. A cache must only be used with the model it was first used with, and is typically
+// owned by the prepared model. It may be shared by concurrent executions.
+class OperationStateCache {
+   public:
+    // Identifies an operation by the index of its subgraph (0 for the main subgraph, i + 1 for
+    // Model::referenced[i]) and its index within that subgraph.
+    using Key = std::pair<uint32_t, uint32_t>;
+
+    std::shared_ptr<const OperationState> get(const Key& key) const;
+    void set(const Key& key, std::shared_ptr<const OperationState> state);
+
+   private:
+    mutable std::mutex mMutex;
+    std::map<Key, std::shared_ptr<const OperationState>> mStates GUARDED_BY(mMutex);
+};
+
 // This class is used to execute a model on the CPU.
 class CpuExecutor {
    public:
@@ -158,6 +208,10 @@ class CpuExecutor {
     void setDeadline(const TimePoint& deadline) { mDeadline = deadline; }
     void setLoopTimeout(uint64_t duration) { mLoopTimeoutDuration = duration; }
 
+    // Lets operations reuse state computed by earlier executions of the same model. The cache
+    // must outlive the executor.
+    void setOperationStateCache(OperationStateCache* cache) { mOperationStateCache = cache; }
+
    private:
     // Creates runtime info from what's in the model.
     std::vector<RunTimeOperandInfo> initializeRunTimeInfo(const Model::Subgraph& subgraph);
@@ -170,7 +224,8 @@ class CpuExecutor {
     // Runs one subgraph.
     int executeSubgraph(const Model::Subgraph& subgraph, RunTimeOperandInfo* operands);
     // Runs one operation of the graph.
-    int executeOperation(const Operation& operation, RunTimeOperandInfo* operands);
+    int executeOperation(const Operation& operation, RunTimeOperandInfo* operands,
+                         const OperationStateCache::Key& operationKey);
     int executeIfOperation(const Operation& operation, RunTimeOperandInfo* operands);
     int executeWhileOperation(const Operation& operation, RunTimeOperandInfo* operands);
 
@@ -198,6 +253,9 @@ class CpuExecutor {
     // WHILE loop.
     uint64_t mLoopTimeoutDuration = operation_while::kTimeoutNsDefault;
 
+    // Optional cache of operation state, not owned.
+    OperationStateCache* mOperationStateCache = nullptr;
+
     [[maybe_unused]] const IOperationResolver* mOperationResolver;
 };
 
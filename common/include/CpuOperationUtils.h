@@ -19,10 +19,13 @@
 
 #include <android-base/logging.h>
 #include <tensorflow/lite/kernels/internal/types.h>
+#include <unsupported/Eigen/CXX11/ThreadPool>
 
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <memory>
+#include <thread>
 #include <vector>
 
 #include "OperationsExecutionUtils.h"
@@ -211,6 +214,152 @@ class OutputWithLayout {
     bool mUseNchw;
 };
 
+// Returns the process-wide thread pool used to split CPU operations across cores. The calling
+// thread also takes part in every parallelFor, so the pool holds one thread less than the number
+// of cores.
+inline Eigen::ThreadPool* getCpuOperationThreadPool() {
+    static Eigen::ThreadPool* const pool = [] {
+        const int numCores = static_cast<int>(std::thread::hardware_concurrency());
+        return new Eigen::ThreadPool(std::max(1, numCores - 1));
+    }();
+    return pool;
+}
+
+// Splits [0, size) into contiguous chunks of at least minChunkSize iterations and calls
+// fn(begin, end) for each chunk, one chunk per available thread. The range is processed inline on
+// the calling thread if it is too small to be worth splitting, or if parallelFor is called from a
+// pool thread. Returns once every chunk has completed.
+template <typename Fn>
+inline void parallelFor(uint32_t size, uint32_t minChunkSize, const Fn& fn) {
+    if (size == 0) return;
+    Eigen::ThreadPool* pool = getCpuOperationThreadPool();
+    const uint32_t maxChunks = std::max<uint32_t>(1, size / std::max<uint32_t>(1, minChunkSize));
+    const uint32_t numChunks =
+            std::min<uint32_t>(maxChunks, static_cast<uint32_t>(pool->NumThreads()) + 1);
+    if (numChunks <= 1 || pool->CurrentThreadId() != -1) {
+        fn(0u, size);
+        return;
+    }
+    const uint32_t chunkSize = (size + numChunks - 1) / numChunks;
+    Eigen::Barrier barrier(numChunks - 1);
+    for (uint32_t chunk = 1; chunk < numChunks; ++chunk) {
+        const uint32_t begin = std::min(size, chunk * chunkSize);
+        const uint32_t end = std::min(size, begin + chunkSize);
+        pool->Schedule([&fn, &barrier, begin, end] {
+            if (begin < end) fn(begin, end);
+            barrier.Notify();
+        });
+    }
+    fn(0u, std::min(size, chunkSize));
+    barrier.Wait();
+}
+
+// Maps every value of an 8-bit quantized type T to the result of an element-wise operation, for
+// operations whose quantized result only depends on the element and on the quantization
+// parameters of the operands. The table is computed once by running the operation's own kernel on
+// all 256 values, so applying it gives exactly the kernel's results with one load per element.
+//
+// A table has one row of 256 entries per value of an optional second 8-bit operand, such as the
+// alpha of PRELU, and a single row otherwise. Rows are indexed by the bit pattern of that value.
+template <typename T>
+class QuantizedLookupTable : public OperationState {
+    static_assert(sizeof(T) == 1, "QuantizedLookupTable requires an 8-bit type");
+
+   public:
+    static constexpr uint32_t kRowSize = 256;
+
+    // Builds a table for operands with the given shapes, of which only the type and quantization
+    // parameters matter. fillRow(row, input, output) must compute the operation on the kRowSize
+    // values in input, which hold every value of T in bit pattern order, for the second operand
+    // value with bit pattern row. Returns nullptr if fillRow fails.
+    template <typename FillRow>
+    static std::shared_ptr<const QuantizedLookupTable> create(std::vector<Shape> shapes,
+                                                              uint32_t numRows,
+                                                              const FillRow& fillRow) {
+        return create(std::move(shapes), std::vector<bool>(numRows, true), fillRow);
+    }
+
+    // Same as above, but only fills the rows for which rows[row] is true. The other rows must not
+    // be read.
+    template <typename FillRow>
+    static std::shared_ptr<const QuantizedLookupTable> create(std::vector<Shape> shapes,
+                                                              std::vector<bool> rows,
+                                                              const FillRow& fillRow) {
+        auto table = std::make_shared<QuantizedLookupTable>();
+        table->mShapes = std::move(shapes);
+        table->mTable.resize(rows.size() * kRowSize);
+        std::vector<T> input(kRowSize);
+        for (uint32_t i = 0; i < kRowSize; ++i) {
+            input[i] = static_cast<T>(i);
+        }
+        for (uint32_t row = 0; row < rows.size(); ++row) {
+            if (rows[row] && !fillRow(row, input.data(), table->mTable.data() + row * kRowSize)) {
+                return nullptr;
+            }
+        }
+        table->mRows = std::move(rows);
+        return table;
+    }
+
+    // Returns true if the table was built for operands with these types and quantization
+    // parameters.
+    bool isFor(const std::vector<Shape>& shapes) const {
+        return std::equal(shapes.begin(), shapes.end(), mShapes.begin(), mShapes.end(),
+                          [](const Shape& a, const Shape& b) {
+                              return a.type == b.type && a.scale == b.scale && a.offset == b.offset;
+                          });
+    }
+
+    // Returns true if every row for which rows[row] is true has been filled.
+    bool hasRows(const std::vector<bool>& rows) const {
+        for (uint32_t row = 0; row < rows.size(); ++row) {
+            if (rows[row] && (row >= mRows.size() || !mRows[row])) return false;
+        }
+        return true;
+    }
+
+    const std::vector<bool>& getRows() const { return mRows; }
+
+    const T* getRow(uint32_t row) const { return mTable.data() + row * kRowSize; }
+
+    static uint32_t getIndex(T value) { return static_cast<uint8_t>(value); }
+
+    // Applies the first row of the table to size elements. output may alias input.
+    void apply(const T* input, uint32_t size, T* output) const {
+        // Lookups below this many elements are not worth splitting across threads.
+        constexpr uint32_t kMinElementsPerThread = 64 * 1024;
+        const T* table = mTable.data();
+        parallelFor(size, kMinElementsPerThread, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                output[i] = table[getIndex(input[i])];
+            }
+        });
+    }
+
+   private:
+    std::vector<Shape> mShapes;
+    std::vector<bool> mRows;
+    std::vector<T> mTable;
+};
+
+// Returns the lookup table cached for the operation of context if it was built for operands with
+// the given shapes, or else builds one with QuantizedLookupTable<T>::create and caches it.
+// Returns nullptr if the table cannot be built.
+template <typename T, typename FillRow>
+inline std::shared_ptr<const QuantizedLookupTable<T>> getQuantizedLookupTable(
+        IOperationExecutionContext* context, std::vector<Shape> shapes, uint32_t numRows,
+        const FillRow& fillRow) {
+    auto table = context->getCachedState<QuantizedLookupTable<T>>();
+    if (table != nullptr && table->isFor(shapes)) {
+        return table;
+    }
+    table = QuantizedLookupTable<T>::create(std::move(shapes), numRows, fillRow);
+    if (table != nullptr) {
+        context->setCachedState(table);
+    }
+    return table;
+}
+
 template <typename T>
 inline void CalculateActivationRange(int32_t activation, const Shape& outputShape,
                                      int32_t* outputActivationMin, int32_t* outputActivationMax);
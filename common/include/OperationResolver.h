@@ -49,6 +49,11 @@ struct OperationRegistration {
         bool allowOmittedOperand = false;
         // Whether the operation allows at least one input operand to be a zero-sized tensor.
         bool allowZeroSizedInput = false;
+        // Whether output 0 may reuse the buffer of an input of the same type and dimensions
+        // that is a temporary consumed for the last time by this operation. Only set this for
+        // operations that compute each output element solely from the input elements at the
+        // same position, reading them before the output element is written.
+        bool allowInPlaceExecution = false;
     } flags;
 
     OperationRegistration(
@@ -20,6 +20,7 @@
 #include <stddef.h>
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "ActivationFunctor.h"
@@ -28,6 +29,7 @@ namespace android {
 namespace nn {
 
 struct Shape;
+class OperationState;
 
 bool floorFloat16(const _Float16* inputData, _Float16* outputData, const Shape& shape);
 bool floorFloat32(const float* inputData, float* outputData, const Shape& shape);
@@ -159,6 +161,23 @@ bool groupedConvQuant8PerChannel(const T* inputData, const Shape& inputShape,
                                  int32_t stride_width, int32_t stride_height, int32_t numGroups,
                                  int32_t activation, T* outputData, const Shape& outputShape);
 
+// Packs a constant GROUPED_CONV_2D filter for groupedConvPacked, with the weights of each group
+// made contiguous, and computes the requantization of quantized outputs. filterScales is only
+// used for TENSOR_QUANT8_SYMM_PER_CHANNEL filters. Returns cachedState if it was packed for the
+// same filter and quantization, or nullptr on failure.
+std::shared_ptr<const OperationState> packGroupedConvFilter(
+        std::shared_ptr<const OperationState> cachedState, const Shape& inputShape,
+        const void* filterData, const Shape& filterShape, const float* filterScales,
+        const Shape& outputShape, int32_t numGroups, int32_t activation);
+
+// Grouped convolution with a filter packed by packGroupedConvFilter. BiasT is T for float tensors
+// and int32_t for quantized ones.
+template <typename T, typename BiasT>
+bool groupedConvPacked(const T* inputData, const Shape& inputShape,
+                       const OperationState& packedFilter, const BiasT* biasData,
+                       int32_t padding_left, int32_t padding_top, int32_t stride_width,
+                       int32_t stride_height, T* outputData, const Shape& outputShape);
+
 bool channelShuffleGeneric(const uint8_t* inputData, const Shape& inputShape, int32_t numGroups,
                            int32_t axis, uint8_t* outputData, const Shape& outputShape);
 }  // namespace nn
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -35,6 +36,21 @@ enum PaddingScheme {
     kPaddingValid = 2,
 };
 
+// Base class for state that an operation derives from its operand parameters and constant inputs,
+// such as requantization multipliers or repacked weights. The executor may keep this state for the
+// lifetime of a prepared model so that later executions can reuse it instead of recomputing it.
+class OperationState {
+   public:
+    virtual ~OperationState() = default;
+};
+
+// The inputs of a DENSIFY operation, indexed as its inputs are, which stand in for its output when
+// the executor leaves that output unmaterialized. They are all constants of the model.
+struct SparseTensor {
+    std::vector<Shape> shapes;
+    std::vector<const void*> buffers;
+};
+
 // Provides inputs and outputs during operation execution.
 class IOperationExecutionContext {
    public:
@@ -54,9 +70,41 @@ class IOperationExecutionContext {
     // Updates the output shape, allocating the buffer if necessary.
     virtual bool setOutputShape(uint32_t index, const Shape& shape) = 0;
 
+    // Same as setOutputShape for an output that holds exactly the bytes of an input, such as the
+    // output of RESHAPE. The executor may let the output share the buffer of the input instead of
+    // allocating one, in which case getOutputBuffer(outputIndex) == getInputBuffer(inputIndex) and
+    // the operation has nothing left to copy.
+    virtual bool setViewOutputShape(uint32_t outputIndex, uint32_t inputIndex, const Shape& shape) {
+        return setOutputShape(outputIndex, shape);
+    }
+
     virtual bool isOmittedInput(uint32_t index) const = 0;
     virtual bool isOmittedOutput(uint32_t index) const = 0;
 
+    // Returns true if the input holds a constant of the model, whose value is the same in every
+    // execution of the prepared model. State derived from such an input may be cached.
+    virtual bool isConstantInput(uint32_t /*index*/) const { return false; }
+
+    // Returns the sparse form of an input whose dense data the executor has not materialized, or
+    // nullptr if the input holds its data. getInputBuffer returns nullptr for such an input, which
+    // the executor only hands to operations that can read the sparse form.
+    virtual const SparseTensor* getSparseInput(uint32_t /*index*/) const { return nullptr; }
+
+    // Returns the state stored by a previous execution of this operation with setCachedState, or
+    // nullptr if there is none or the executor does not cache operation state.
+    virtual std::shared_ptr<const OperationState> getCachedState() const { return nullptr; }
+
+    // Stores state to be returned by getCachedState in later executions of this operation. The
+    // state may be shared by concurrent executions, so it must not be modified once stored.
+    virtual void setCachedState(std::shared_ptr<const OperationState> /*state*/) {}
+
+    // Returns the cached state of this operation as type T. An operation must always store the
+    // same type of state for a given set of operand types.
+    template <typename T>
+    std::shared_ptr<const T> getCachedState() const {
+        return std::static_pointer_cast<const T>(getCachedState());
+    }
+
     template <typename T>
     const T* getInputBuffer(uint32_t index) const {
         return reinterpret_cast<const T*>(getInputBuffer(index));
@@ -263,6 +311,48 @@ bool groupedConvPrepare(const Shape& input, const Shape& filter, const Shape& bi
                         int32_t padding_bottom, int32_t stride_width, int32_t stride_height,
                         int32_t numGroups, Shape* output);
 
+// Returns the byte strides of a densely packed tensor with the given dimensions.
+std::vector<int64_t> getPackedStrides(const std::vector<uint32_t>& dimensions,
+                                      uint32_t elementSize);
+
+// Copies an N-D view of src into an N-D view of dst with the same dimensions. The element at index
+// (i0, ..., iN-1) is read at byte offset i0 * srcStrides[0] + ... + iN-1 * srcStrides[N-1] from src
+// and written at the matching offset from dst. Strides may be zero or negative, which lets slicing,
+// tiling, padding, reversing and shuffling ops all be expressed as one such copy. Dimensions that
+// both views traverse contiguously are merged first, contiguous runs are copied with memcpy, and
+// large copies are split across threads. The elements written must not overlap those read.
+void stridedCopy(const void* src, const std::vector<int64_t>& srcStrides, void* dst,
+                 const std::vector<int64_t>& dstStrides, const std::vector<uint32_t>& dimensions,
+                 uint32_t elementSize);
+
+// Element-wise conversions between tensor types, used by QUANTIZE, DEQUANTIZE and CAST. Each one is
+// a branch-free loop over contiguous data that the compiler vectorizes, and large tensors are split
+// across threads. They are instantiated for every type pair the operations support.
+
+// Computes output[i] = clamp(zeroPoint + round(input[i] / scale)) to the range of QuantT, rounding
+// half away from zero. FloatT is float or _Float16, QuantT is uint8_t or int8_t.
+template <typename FloatT, typename QuantT>
+void quantizeElements(const FloatT* input, uint32_t size, float scale, int32_t zeroPoint,
+                      QuantT* output);
+
+// Computes output[i] = scale * (input[i] - zeroPoint). QuantT is uint8_t or int8_t, FloatT is
+// float or _Float16.
+template <typename QuantT, typename FloatT>
+void dequantizeElements(const QuantT* input, uint32_t size, float scale, int32_t zeroPoint,
+                        FloatT* output);
+
+// Same as dequantizeElements for a tensor of shape [outerSize, numChannels, innerSize] where
+// channel c has the scale scales[c].
+template <typename FloatT>
+void dequantizePerChannelElements(const int8_t* input, uint32_t outerSize, uint32_t numChannels,
+                                  uint32_t innerSize, const float* scales, int32_t zeroPoint,
+                                  FloatT* output);
+
+// Computes output[i] = static_cast<ToT>(input[i]), saturating to [0, 255] when ToT is uint8_t.
+// FromT and ToT are each one of _Float16, float, int32_t and uint8_t.
+template <typename FromT, typename ToT>
+void castElements(const FromT* input, uint32_t size, ToT* output);
+
 // Transposes the first two dimensions.
 template <typename T>
 inline bool transposeFirstTwoDimensions(const T* buffer, const Shape& shape, T* transposedBuffer) {
@@ -39,6 +39,30 @@ constexpr uint32_t kOutputTensor = 0;
 constexpr int32_t DENSE = 0;
 constexpr int32_t SPARSE_CSR = 1;
 
+// Returns the dimensions of the dense tensor described by the traversal order, block map and
+// dimensions inputs, where numLevels is the size of the traversal order and numBlocks the size of
+// the block map.
+std::vector<uint32_t> getDenseDimensions(const int32_t* traversalOrder, const int32_t* blockMap,
+                                         const int32_t* dimensions, uint32_t numLevels,
+                                         uint32_t numBlocks);
+
+// The stored values of a sparse 2-D float tensor, grouped by row as runs of consecutive columns.
+// The runs of row r are [rowRuns[r], rowRuns[r + 1]), in increasing column order. Run i covers the
+// columns [runColumns[i], runColumns[i] + runLengths[i]), and its values start at
+// values[runOffsets[i]].
+struct CompressedRows {
+    std::vector<uint32_t> rowRuns;
+    std::vector<uint32_t> runColumns;
+    std::vector<uint32_t> runLengths;
+    std::vector<uint32_t> runOffsets;
+    std::vector<float> values;
+};
+
+// Reads the inputs of a DENSIFY operation producing a 2-D TENSOR_FLOAT32 into compressed rows,
+// without materializing the dense tensor.
+bool getCompressedRows(const std::vector<Shape>& inputShapes,
+                       const std::vector<const void*>& inputBuffers, CompressedRows* rows);
+
 }  // namespace densify_op
 }  // namespace nn
 }  // namespace android
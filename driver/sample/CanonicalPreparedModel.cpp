@@ -151,6 +151,7 @@ ExecutionResult<std::pair<std::vector<OutputShape>, Timing>> PreparedModel::exec
 
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION, "sample::Device::execute");
     auto executor = CpuExecutor(&kOperationResolver);
+    executor.setOperationStateCache(&mOperationStateCache);
     if (loopTimeoutDuration.has_value()) {
         executor.setLoopTimeout(loopTimeoutDuration->count());
     }
@@ -240,6 +241,7 @@ GeneralResult<std::pair<SyncFence, ExecuteFencedInfoCallback>> PreparedModel::ex
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "sample::PreparedModel::executeFenced");
     auto executor = CpuExecutor(&kOperationResolver);
+    executor.setOperationStateCache(&mOperationStateCache);
     if (loopTimeoutDuration.has_value()) {
         executor.setLoopTimeout(loopTimeoutDuration->count());
     }
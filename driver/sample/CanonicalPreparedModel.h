@@ -67,6 +67,7 @@ class PreparedModel final : public IPreparedModel,
     const IOperationResolver& kOperationResolver;
     const std::shared_ptr<BufferTracker> kBufferTracker;
     const std::vector<RunTimePoolInfo> kPoolInfos;
+    mutable OperationStateCache mOperationStateCache;
 };
 
 }  // namespace android::nn::sample
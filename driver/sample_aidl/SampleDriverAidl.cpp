@@ -441,6 +441,7 @@ ndk::ScopedAStatus SamplePreparedModel::executeSynchronously(
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "SampleDriver::executeSynchronouslyBase");
     CpuExecutor executor = mDriver->getExecutor();
+    executor.setOperationStateCache(&mOperationStateCache);
     if (loopTimeoutDurationNs >= 0) {
         executor.setLoopTimeout(loopTimeoutDurationNs);
     }
@@ -556,6 +557,7 @@ ndk::ScopedAStatus SamplePreparedModel::executeFenced(
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "SamplePreparedModel::executeFenced");
     CpuExecutor executor = mDriver->getExecutor();
+    executor.setOperationStateCache(&mOperationStateCache);
     if (loopTimeoutDurationNs >= 0) {
         executor.setLoopTimeout(loopTimeoutDurationNs);
     }
@@ -140,6 +140,7 @@ class SamplePreparedModel : public aidl_hal::BnPreparedModel {
     aidl_hal::Model mModel;
     const SampleDriver* mDriver;
     std::vector<RunTimePoolInfo> mPoolInfos;
+    OperationStateCache mOperationStateCache;
     const aidl_hal::ExecutionPreference kPreference;
     const uid_t kUserId;
     const aidl_hal::Priority kPriority;
@@ -465,6 +465,7 @@ void asyncExecute(const V1_3::Request& request, V1_2::MeasureTiming measure, Tim
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "SampleDriver::asyncExecute");
     CpuExecutor executor = driver.getExecutor();
+    executor.setOperationStateCache(preparedModel->getOperationStateCache().get());
     if (loopTimeoutDuration.getDiscriminator() !=
         V1_3::OptionalTimeoutDuration::hidl_discriminator::none) {
         executor.setLoopTimeout(loopTimeoutDuration.nanoseconds());
@@ -598,6 +599,7 @@ executeSynchronouslyBase(const V1_3::Request& request, V1_2::MeasureTiming measu
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "SampleDriver::executeSynchronouslyBase");
     CpuExecutor executor = driver.getExecutor();
+    executor.setOperationStateCache(preparedModel->getOperationStateCache().get());
     if (loopTimeoutDuration.getDiscriminator() !=
         V1_3::OptionalTimeoutDuration::hidl_discriminator::none) {
         executor.setLoopTimeout(loopTimeoutDuration.nanoseconds());
@@ -711,6 +713,7 @@ hardware::Return<void> SamplePreparedModel::executeFenced(
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "SamplePreparedModel::executeFenced");
     CpuExecutor executor = mDriver->getExecutor();
+    executor.setOperationStateCache(mOperationStateCache.get());
     if (loopTimeoutDuration.getDiscriminator() !=
         V1_3::OptionalTimeoutDuration::hidl_discriminator::none) {
         executor.setLoopTimeout(loopTimeoutDuration.nanoseconds());
@@ -767,8 +770,12 @@ hardware::Return<void> SamplePreparedModel::executeFenced(
 class BurstExecutorWithCache : public ExecutionBurstServer::IBurstExecutorWithCache {
    public:
     BurstExecutorWithCache(const V1_3::Model& model, const SampleDriver* driver,
-                           const std::vector<RunTimePoolInfo>& poolInfos)
-        : mModel(model), mDriver(driver), mModelPoolInfos(poolInfos) {}
+                           const std::vector<RunTimePoolInfo>& poolInfos,
+                           std::shared_ptr<OperationStateCache> operationStateCache)
+        : mModel(model),
+          mDriver(driver),
+          mModelPoolInfos(poolInfos),
+          mOperationStateCache(std::move(operationStateCache)) {}
 
     bool isCacheEntryPresent(int32_t slot) const override {
         const auto it = mMemoryCache.find(slot);
@@ -822,6 +829,7 @@ class BurstExecutorWithCache : public ExecutionBurstServer::IBurstExecutorWithCa
         // because burst does not support HAL 1.3 and hence does not support
         // WHILE loops.
         CpuExecutor executor = mDriver->getExecutor();
+        executor.setOperationStateCache(mOperationStateCache.get());
         if (measure == V1_2::MeasureTiming::YES) deviceStart = Clock::now();
         int n = executor.run(uncheckedConvert(mModel), uncheckedConvert(fullRequest),
                              mModelPoolInfos, requestPoolInfos);
@@ -846,6 +854,7 @@ class BurstExecutorWithCache : public ExecutionBurstServer::IBurstExecutorWithCa
     const V1_3::Model mModel;
     const SampleDriver* const mDriver;
     const std::vector<RunTimePoolInfo> mModelPoolInfos;
+    const std::shared_ptr<OperationStateCache> mOperationStateCache;
     std::map<int32_t, std::optional<RunTimePoolInfo>> mMemoryCache;  // cached requestPoolInfos
 };
 
@@ -886,7 +895,8 @@ hardware::Return<void> SamplePreparedModel::configureExecutionBurst(
     // However, this alternative representation does not include a memory map
     // caching optimization, and adds overhead.
     const std::shared_ptr<BurstExecutorWithCache> executorWithCache =
-            std::make_shared<BurstExecutorWithCache>(mModel, mDriver, mPoolInfos);
+            std::make_shared<BurstExecutorWithCache>(mModel, mDriver, mPoolInfos,
+                                                     mOperationStateCache);
     const sp<V1_2::IBurstContext> burst = ExecutionBurstServer::create(
             callback, requestChannel, resultChannel, executorWithCache, pollingTimeWindow);
 
@@ -168,11 +168,17 @@ class SamplePreparedModel : public V1_3::IPreparedModel {
                                          const V1_3::OptionalTimeoutDuration& duration,
                                          executeFenced_cb callback) override;
     const V1_3::Model* getModel() const { return &mModel; }
+    const std::shared_ptr<OperationStateCache>& getOperationStateCache() const {
+        return mOperationStateCache;
+    }
 
    protected:
     V1_3::Model mModel;
     const SampleDriver* mDriver;
     std::vector<RunTimePoolInfo> mPoolInfos;
+    // Shared with the bursts of this prepared model.
+    const std::shared_ptr<OperationStateCache> mOperationStateCache =
+            std::make_shared<OperationStateCache>();
     const V1_1::ExecutionPreference kPreference;
     const uid_t kUserId;
     const V1_3::Priority kPriority;
@@ -35,6 +35,8 @@
 #include "ExecutionPlan.h"
 #include "Manager.h"
 #include "ModelBuilder.h"
+#include "PerformanceProfile.h"
+#include "StreamingPipeline.h"
 #include "TypeManager.h"
 
 namespace android {
@@ -44,6 +46,8 @@ CompilationBuilder::CompilationBuilder(const ModelBuilder* model,
                                        const std::vector<std::shared_ptr<Device>>& devices,
                                        bool explicitDeviceList)
     : mModel(model),
+      mStreaming(DeviceManager::get()->streaming()),
+      mProfileDir(DeviceManager::get()->getProfileDir()),
       mPartitioning(explicitDeviceList ? DeviceManager::kPartitioningWithoutFallback
                                        : DeviceManager::get()->getPartitioning()),
       mDevices(devices),
@@ -68,11 +72,25 @@ int CompilationBuilder::finish() {
     if (mIsCacheInfoProvided) {
         mPlan.setCaching(&mCacheInfo, mToken);
     }
+    if (!mProfileDir.empty()) {
+        mPerformanceProfile = PerformanceProfile::load(mProfileDir, mModel->getModelArchHash(),
+                                                       mModel->operationCount());
+    }
     if (mPartitioning) {
+        // The profile measures time, so it cannot guide a partitioning for low power.
+        PerformanceProfile* profile = mPreference != ANEURALNETWORKS_PREFER_LOW_POWER
+                                              ? mPerformanceProfile.get()
+                                              : nullptr;
         int n = mModel->partitionTheWork(mDevices, mPreference, mPriority, deadline, &mPlan,
-                                         mMetadata, mFailPartitioning);
+                                         mMetadata, mFailPartitioning, profile,
+                                         DeviceManager::partitioningMinimizesCost(mPartitioning),
+                                         mCachePerformance);
         switch (n) {
             case ANEURALNETWORKS_NO_ERROR:
+                if (mStreaming && mPlan.hasStepDependencies()) {
+                    mStreamingPipeline = std::make_unique<StreamingPipeline>(
+                            mPlan.getStepDependencies().size());
+                }
                 return n;
             case ANEURALNETWORKS_UNEXPECTED_NULL:
             case ANEURALNETWORKS_BAD_DATA:
@@ -222,6 +240,16 @@ int CompilationBuilder::setTimeoutDuration(uint64_t duration) {
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+int CompilationBuilder::setStreaming(bool streaming) {
+    if (mFinished) {
+        LOG(ERROR) << "CompilationBuilder::setStreaming can't modify after compilation finished";
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+
+    mStreaming = streaming;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
 int CompilationBuilder::addExtensionAttribute(const char* extensionName,
                                               uint16_t attributeCodeWithinExtension,
                                               const void* data, size_t length) {
@@ -275,6 +303,28 @@ int CompilationBuilder::forTest_failPartitioning(int fail) {
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+int CompilationBuilder::forTest_setProfileGuidedPartitioning(const std::string& profileDir) {
+    if (mFinished) {
+        LOG(ERROR) << "CompilationBuilder::forTest_setProfileGuidedPartitioning can't modify "
+                      "after compilation finished";
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+
+    mProfileDir = profileDir;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int CompilationBuilder::forTest_setPerformanceCaching(bool cachePerformance) {
+    if (mFinished) {
+        LOG(ERROR) << "CompilationBuilder::forTest_setPerformanceCaching can't modify after "
+                      "compilation finished";
+        return ANEURALNETWORKS_BAD_STATE;
+    }
+
+    mCachePerformance = cachePerformance;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
 int CompilationBuilder::getPreferredMemoryAlignmentForInput(uint32_t index,
                                                             uint32_t* alignment) const {
     CHECK(alignment != nullptr);
@@ -31,6 +31,8 @@
 #include "ExecutionPlan.h"
 #include "Manager.h"
 #include "NeuralNetworks.h"
+#include "PerformanceProfile.h"
+#include "StreamingPipeline.h"
 
 namespace android {
 namespace nn {
@@ -63,6 +65,10 @@ class CompilationBuilder {
 
     int setTimeoutDuration(uint64_t duration);
 
+    // Pipelines the steps of the plan across executions; see StreamingPipeline. Defaults to
+    // DeviceManager::streaming().
+    int setStreaming(bool streaming);
+
     int addExtensionAttribute(const char* extensionName, uint16_t attributeCodeWithinExtension,
                               const void* data, size_t length);
 
@@ -89,12 +95,21 @@ class CompilationBuilder {
     bool isCacheInfoProvided() const { return mIsCacheInfoProvided; }
     bool isFinished() const { return mFinished; }
 
+    // Returns nullptr unless the steps of the plan are pipelined; see DeviceManager::streaming().
+    StreamingPipeline* getStreamingPipeline() const { return mStreamingPipeline.get(); }
+
+    // Returns nullptr unless in profile-guided partitioning mode; see
+    // DeviceManager::getProfileDir().
+    PerformanceProfile* getPerformanceProfile() const { return mPerformanceProfile.get(); }
+
     // These functions are solely intended for use by unit tests of the
     // partitioning algorithm.
     const ExecutionPlan& forTest_getExecutionPlan() const { return mPlan; }
     int forTest_setPartitioning(uint32_t partitioning);
     int forTest_failPartitioning(
             int resultCode);  // If not ANEURALNETWORKS_NO_ERROR, then simulate partitioning failure
+    int forTest_setProfileGuidedPartitioning(const std::string& profileDir);
+    int forTest_setPerformanceCaching(bool cachePerformance);
 
     struct TelemetryInfo {
         uint64_t compilationTimeNanos = std::numeric_limits<uint64_t>::max();
@@ -107,6 +122,14 @@ class CompilationBuilder {
 
     ExecutionPlan mPlan;
 
+    // See setStreaming(). The pipeline is created by finish(), and is destroyed before mPlan.
+    bool mStreaming = false;
+    std::unique_ptr<StreamingPipeline> mStreamingPipeline;
+
+    // See DeviceManager::getProfileDir(). The profile is loaded by finish().
+    std::string mProfileDir;
+    std::shared_ptr<PerformanceProfile> mPerformanceProfile;
+
     // Whether the application prefers to go fast or use low power for this execution.
     int32_t mPreference = ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER;
 
@@ -118,6 +141,9 @@ class CompilationBuilder {
     // For testing purposes, simulate partitioning failure.
     int mFailPartitioning = ANEURALNETWORKS_NO_ERROR;
 
+    // For benchmarking purposes, partition without memoizing static performance estimates.
+    bool mCachePerformance = true;
+
     // Once the compilation has been finished, we should not allow further
     // modifications to the compilation.
     bool mFinished = false;
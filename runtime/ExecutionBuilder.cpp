@@ -28,6 +28,8 @@
 #include <nnapi/Types.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <limits>
 #include <map>
 #include <memory>
@@ -44,6 +46,8 @@
 #include "Manager.h"
 #include "ModelArgumentInfo.h"
 #include "ModelBuilder.h"
+#include "PerformanceProfile.h"
+#include "StreamingPipeline.h"
 #include "Telemetry.h"
 #include "TypeManager.h"
 
@@ -373,7 +377,11 @@ int ExecutionBuilder::getDuration(int32_t durationCode, uint64_t* duration) cons
         return ANEURALNETWORKS_BAD_STATE;
     }
 
-    Timing timingLaunched = mTimingWithoutFencedExecutionCallback;
+    Timing timingLaunched;
+    {
+        std::lock_guard<std::mutex> lock(mTimingMutex);
+        timingLaunched = mTimingWithoutFencedExecutionCallback;
+    }
     Timing timingFenced = timingLaunched;
     if (mFencedExecutionCallback != nullptr) {
         auto result = mFencedExecutionCallback();
@@ -720,7 +728,14 @@ std::tuple<int, std::vector<OutputShape>, Timing> CompoundExecutionBuilder::comp
     NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "CompoundExecutionBuilder::computeInternal");
     VLOG(EXECUTION) << "CompoundExecutionBuilder::computeInternal (from plan, iteratively)";
 
-    auto controller = mPlan->makeController(this, burstBuilder);
+    if (StreamingPipeline* pipeline = mCompilation->getStreamingPipeline()) {
+        return computeStreaming(pipeline, deadline, burstBuilder);
+    }
+    if (mPlan->canRunStepsConcurrently()) {
+        return computeStepsConcurrently(deadline, burstBuilder);
+    }
+
+    auto controller = mPlan->makeController(this, burstBuilder, /*recycleTemporaries=*/true);
     std::vector<OutputShape> outputShapes = getInitialOutputShapes();
 
     // On this iteration, do I need to repeat the previous step because it
@@ -869,6 +884,319 @@ std::tuple<int, std::vector<OutputShape>, Timing> CompoundExecutionBuilder::comp
     return cpuFallbackFull(this);
 }
 
+std::tuple<int, std::vector<OutputShape>, Timing>
+CompoundExecutionBuilder::computeStepsConcurrently(const OptionalTimePoint& deadline,
+                                                   BurstBuilder* burstBuilder) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "CompoundExecutionBuilder::computeStepsConcurrently");
+    VLOG(EXECUTION) << "CompoundExecutionBuilder::computeStepsConcurrently";
+
+    auto controller = mPlan->makeController(this, burstBuilder, /*recycleTemporaries=*/true);
+    std::vector<OutputShape> outputShapes = getInitialOutputShapes();
+
+    // For each step, the steps waiting on it, and the number of steps it is still waiting on.
+    const std::vector<std::vector<uint32_t>>& stepDependencies = mPlan->getStepDependencies();
+    const uint32_t stepCount = stepDependencies.size();
+    std::vector<std::vector<uint32_t>> dependentSteps(stepCount);
+    std::vector<uint32_t> pendingDependencyCounts(stepCount);
+    for (uint32_t stepIndex = 0; stepIndex < stepCount; ++stepIndex) {
+        pendingDependencyCounts[stepIndex] = stepDependencies[stepIndex].size();
+        for (uint32_t dependency : stepDependencies[stepIndex]) {
+            dependentSteps[dependency].push_back(stepIndex);
+        }
+    }
+
+    // Launched steps are queued for a pool of at most kMaxConcurrentSteps threads, started as
+    // needed. Each thread runs queued steps and queues their results for this thread, which alone
+    // creates executors and updates outputShapes.
+    constexpr size_t kMaxConcurrentSteps = 4;
+    struct StepWork {
+        uint32_t stepIndex;
+        bool isCpuFallback;
+        std::shared_ptr<StepExecutor> executor;
+        SharedBurst burstController;
+    };
+    struct StepResult {
+        uint32_t stepIndex;
+        bool isCpuFallback;
+        std::shared_ptr<StepExecutor> executor;
+        int n;
+        std::vector<OutputShape> outputShapes;
+    };
+    std::mutex mutex;
+    std::condition_variable workCondition;
+    std::condition_variable resultsCondition;
+    std::deque<StepWork> work;
+    bool noMoreWork = false;
+    std::vector<StepResult> results;
+    std::vector<std::thread> threads;
+    uint32_t runningStepCount = 0;
+
+    auto runSteps = [&] {
+        while (true) {
+            StepWork step;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                workCondition.wait(lock, [&] { return !work.empty() || noMoreWork; });
+                if (work.empty()) {
+                    return;
+                }
+                step = std::move(work.front());
+                work.pop_front();
+            }
+            auto [stepN, stepOutputShapes, _] =
+                    step.isCpuFallback ? step.executor->computeOnCpuFallback()
+                                       : step.executor->compute(deadline, step.burstController);
+            std::lock_guard<std::mutex> lock(mutex);
+            results.push_back({step.stepIndex, step.isCpuFallback, std::move(step.executor),
+                               stepN, std::move(stepOutputShapes)});
+            resultsCondition.notify_one();
+        }
+    };
+
+    auto launch = [&](uint32_t stepIndex, bool isCpuFallback) {
+        std::shared_ptr<StepExecutor> executor;
+        SharedBurst burstController;
+        const int n = mPlan->makeStepExecutor(controller, stepIndex, &executor,
+                                              isCpuFallback ? nullptr : &burstController,
+                                              &outputShapes);
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            return n;
+        }
+        CHECK(executor != nullptr);
+        ++runningStepCount;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            work.push_back(
+                    {stepIndex, isCpuFallback, std::move(executor), std::move(burstController)});
+        }
+        workCondition.notify_one();
+        if (threads.size() < std::min<size_t>(runningStepCount, kMaxConcurrentSteps)) {
+            threads.emplace_back(runSteps);
+        }
+        return ANEURALNETWORKS_NO_ERROR;
+    };
+
+    // Once an error ends the execution, the remaining running steps are drained and no new steps
+    // are launched. The execution then returns n, or falls back to the CPU for the full model.
+    bool stopped = false;
+    bool doFullFallback = false;
+    int n = ANEURALNETWORKS_NO_ERROR;
+    auto launchOrStop = [&](uint32_t stepIndex, bool isCpuFallback) {
+        if (const int launchN = launch(stepIndex, isCpuFallback);
+            launchN != ANEURALNETWORKS_NO_ERROR) {
+            stopped = true;
+            if (isCpuFallback || mAllowCpuFallback) {
+                doFullFallback = true;
+            } else {
+                n = launchN;
+            }
+        }
+    };
+
+    for (uint32_t stepIndex = 0; stepIndex < stepCount && !stopped; ++stepIndex) {
+        if (pendingDependencyCounts[stepIndex] == 0) {
+            launchOrStop(stepIndex, /*isCpuFallback=*/false);
+        }
+    }
+    while (runningStepCount > 0) {
+        StepResult result;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            resultsCondition.wait(lock, [&results] { return !results.empty(); });
+            result = std::move(results.back());
+            results.pop_back();
+        }
+        --runningStepCount;
+        if (stopped) {
+            continue;
+        }
+
+        // Update global outputs.
+        StepExecutor::UpdateOutputShapes updateOutputShapes = {};
+        if (!result.executor->updateOutputShapes(result.n, result.outputShapes, &outputShapes,
+                                                 &updateOutputShapes)) {
+            result.n = ANEURALNETWORKS_OP_FAILED;
+        }
+
+        // If execution was successful, launch the steps that were only waiting on this one.
+        if (result.n == ANEURALNETWORKS_NO_ERROR) {
+            if (updateOutputShapes.zeroSizedInput) {
+                // We'll need to do full model CPU fallback
+                VLOG(EXECUTION) << "updateOutputShapes.zeroSizedInput";
+                stopped = doFullFallback = true;
+                continue;
+            }
+            for (uint32_t dependentStep : dependentSteps[result.stepIndex]) {
+                if (--pendingDependencyCounts[dependentStep] == 0 && !stopped) {
+                    launchOrStop(dependentStep, /*isCpuFallback=*/false);
+                }
+            }
+            continue;
+        }
+
+        // ANEURALNETWORKS_OUTPUT_INSUFFICIENT_SIZE is not recoverable, as the plan has no dynamic
+        // temporaries.
+        if (result.n == ANEURALNETWORKS_OUTPUT_INSUFFICIENT_SIZE) {
+            VLOG(EXECUTION) << "OUTPUT_INSUFFICIENT_SIZE: " << toString(updateOutputShapes);
+            stopped = true;
+            n = result.n;
+            continue;
+        }
+
+        // If CPU fallback is not allowed and there was an error, end execution.
+        if (!mAllowCpuFallback) {
+            stopped = true;
+            n = result.n;
+            continue;
+        }
+
+        // If CPU execution was already attempted, perform a full CPU fallback.
+        if (result.isCpuFallback || result.executor->isCpu() ||
+            updateOutputShapes.zeroSizedInput) {
+            stopped = doFullFallback = true;
+            continue;
+        }
+
+        // Attempt a partial fallback to CPU. The steps depending on this one are still waiting.
+        VLOG(EXECUTION) << "partial CPU fallback for Step#" << result.stepIndex;
+        launchOrStop(result.stepIndex, /*isCpuFallback=*/true);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        noMoreWork = true;
+    }
+    workCondition.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (doFullFallback) {
+        // If the code has reached this point, a potentially recoverable error
+        // occurred during the step executions. Instead, do a full execution
+        // fallback on the CPU.
+        return cpuFallbackFull(this);
+    }
+    if (n == ANEURALNETWORKS_OUTPUT_INSUFFICIENT_SIZE) {
+        return {n, outputShapes, {}};
+    }
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return {n, {}, {}};
+    }
+    return {ANEURALNETWORKS_NO_ERROR, outputShapes, {}};
+}
+
+std::tuple<int, std::vector<OutputShape>, Timing> CompoundExecutionBuilder::computeStreaming(
+        StreamingPipeline* pipeline, const OptionalTimePoint& deadline,
+        BurstBuilder* burstBuilder) {
+    NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "CompoundExecutionBuilder::computeStreaming");
+    VLOG(EXECUTION) << "CompoundExecutionBuilder::computeStreaming";
+
+    auto controller = mPlan->makeController(this, burstBuilder, /*recycleTemporaries=*/true);
+    std::vector<OutputShape> outputShapes = getInitialOutputShapes();
+
+    // No two steps of this execution run at the same time, so the stages need no further
+    // synchronization to share this state.
+    int n = ANEURALNETWORKS_NO_ERROR;
+    bool doFullFallback = false;
+    auto runStep = [&](uint32_t stepIndex) {
+        std::shared_ptr<StepExecutor> executor;
+        SharedBurst burstController;
+        n = mPlan->makeStepExecutor(controller, stepIndex, &executor, &burstController,
+                                    &outputShapes);
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            doFullFallback = mAllowCpuFallback;
+            return false;
+        }
+        const bool executorIsCpu = executor->isCpu();
+
+        // Attempt to execute a single step of the execution.
+        auto [stepN, stepOutputShapes, _] = executor->compute(deadline, burstController);
+
+        // Update global outputs.
+        StepExecutor::UpdateOutputShapes updateOutputShapes = {};
+        if (!executor->updateOutputShapes(stepN, stepOutputShapes, &outputShapes,
+                                          &updateOutputShapes)) {
+            stepN = ANEURALNETWORKS_OP_FAILED;
+        }
+
+        // If execution was successful, pass the execution on to the next step.
+        if (stepN == ANEURALNETWORKS_NO_ERROR) {
+            if (updateOutputShapes.zeroSizedInput) {
+                // We'll need to do full model CPU fallback
+                VLOG(EXECUTION) << "updateOutputShapes.zeroSizedInput";
+                doFullFallback = true;
+                return false;
+            }
+            return true;
+        }
+
+        // ANEURALNETWORKS_OUTPUT_INSUFFICIENT_SIZE is not recoverable, as the plan has no dynamic
+        // temporaries.
+        if (stepN == ANEURALNETWORKS_OUTPUT_INSUFFICIENT_SIZE) {
+            VLOG(EXECUTION) << "OUTPUT_INSUFFICIENT_SIZE: " << toString(updateOutputShapes);
+            n = stepN;
+            return false;
+        }
+
+        // If CPU fallback is not allowed and there was an error, end execution.
+        if (!mAllowCpuFallback) {
+            n = stepN;
+            return false;
+        }
+
+        // If CPU execution was already attempted, perform a full CPU fallback.
+        if (executorIsCpu || updateOutputShapes.zeroSizedInput) {
+            doFullFallback = true;
+            return false;
+        }
+
+        // Attempt a partial fallback to CPU, within the stage of this step.
+        VLOG(EXECUTION) << "partial CPU fallback for Step#" << stepIndex;
+        std::shared_ptr<StepExecutor> fallbackExecutor;
+        if (mPlan->makeStepExecutor(controller, stepIndex, &fallbackExecutor, nullptr,
+                                    &outputShapes) != ANEURALNETWORKS_NO_ERROR) {
+            doFullFallback = true;
+            return false;
+        }
+        auto [fallbackN, fallbackOutputShapes, fallbackTiming] =
+                fallbackExecutor->computeOnCpuFallback();
+        StepExecutor::UpdateOutputShapes fallbackUpdateOutputShapes = {};
+        if (!fallbackExecutor->updateOutputShapes(fallbackN, fallbackOutputShapes, &outputShapes,
+                                                  &fallbackUpdateOutputShapes)) {
+            fallbackN = ANEURALNETWORKS_OP_FAILED;
+        }
+        if (fallbackN == ANEURALNETWORKS_NO_ERROR && !fallbackUpdateOutputShapes.zeroSizedInput) {
+            return true;
+        }
+        if (fallbackN == ANEURALNETWORKS_OUTPUT_INSUFFICIENT_SIZE) {
+            VLOG(EXECUTION) << "OUTPUT_INSUFFICIENT_SIZE: "
+                            << toString(fallbackUpdateOutputShapes);
+            n = fallbackN;
+            return false;
+        }
+
+        // If the code reaches this point, then there was an error with the
+        // fallback. In this case, attempt full fallback.
+        doFullFallback = true;
+        return false;
+    };
+    pipeline->run(runStep);
+
+    if (doFullFallback) {
+        // If the code has reached this point, a potentially recoverable error
+        // occurred during the step executions. Instead, do a full execution
+        // fallback on the CPU.
+        return cpuFallbackFull(this);
+    }
+    if (n == ANEURALNETWORKS_OUTPUT_INSUFFICIENT_SIZE) {
+        return {n, outputShapes, {}};
+    }
+    if (n != ANEURALNETWORKS_NO_ERROR) {
+        return {n, {}, {}};
+    }
+    return {ANEURALNETWORKS_NO_ERROR, outputShapes, {}};
+}
+
 static bool waitForSyncFences(const std::vector<int>& waitFor) {
     for (int syncFd : waitFor) {
         if (syncFd > 0) {
@@ -948,7 +1276,10 @@ std::tuple<int, int, ExecuteFencedInfoCallback> CompoundExecutionBuilder::comput
     base::unique_fd syncFence;
     ExecuteFencedInfoCallback executeFencedInfoCallback;
 
-    std::shared_ptr<ExecutionPlan::Controller> controller = mPlan->makeController(this, nullptr);
+    // The steps may still be running when this function returns and the controller is released,
+    // so the controller keeps its temporaries to itself.
+    std::shared_ptr<ExecutionPlan::Controller> controller =
+            mPlan->makeController(this, nullptr, /*recycleTemporaries=*/false);
     while (true) {
         VLOG(EXECUTION) << "looking for next StepExecutor";
 
@@ -1092,7 +1423,7 @@ int ExecutionBuilder::compute(std::shared_ptr<ExecutionCallback>* synchronizatio
         }
         const auto [n, outputShapes, timing] = computeInternal(deadline, burstBuilder);
         if (mMeasureTiming) {
-            mTimingWithoutFencedExecutionCallback = timing;
+            reportTimingWithoutFencedExecutionCallback(timing);
         }
         return finishComputation(n, outputShapes, mode);
     } else /* asynchronous */ {
@@ -1515,6 +1846,7 @@ std::tuple<int, std::vector<OutputShape>, Timing> StepExecutor::compute(
     int n;
     std::vector<OutputShape> outputShapes;
     Timing timing;
+    const TimePoint startTime = Clock::now();
     if (mReusable) {
         auto [nCreate, execution] = getReusableExecution();
         if (nCreate != ANEURALNETWORKS_NO_ERROR) {
@@ -1531,9 +1863,36 @@ std::tuple<int, std::vector<OutputShape>, Timing> StepExecutor::compute(
                 loopTimeoutDuration, mExecutionBuilder->getMetadata());
     }
     mExecutionBuilder->reportTimingWithoutFencedExecutionCallback(timing);
+    if (n == ANEURALNETWORKS_NO_ERROR) {
+        recordPerformance(Clock::now() - startTime);
+    }
     return {n, std::move(outputShapes), std::move(timing)};
 }
 
+void StepExecutor::recordPerformance(Duration duration) const {
+    PerformanceProfile* profile = mExecutionBuilder->getCompilation()->getPerformanceProfile();
+    // The profile only covers operations of the main model.
+    if (profile == nullptr ||
+        (mExecutionStep != nullptr &&
+         mExecutionStep->getSourceModelIndex() != kMainModelInSourceModels)) {
+        return;
+    }
+    uint64_t transferBytes = 0;
+    for (const auto* arguments : {&mInputs, &mOutputs}) {
+        for (const ModelArgumentInfo& argument : *arguments) {
+            if (argument.state() == ModelArgumentInfo::POINTER ||
+                argument.state() == ModelArgumentInfo::MEMORY) {
+                transferBytes += argument.length();
+            }
+        }
+    }
+    profile->recordStep(*mDevice,
+                        mExecutionStep != nullptr ? &mExecutionStep->getSourceOperationIndexes()
+                                                  : nullptr,
+                        transferBytes,
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
 std::tuple<int, int, ExecuteFencedInfoCallback> StepExecutor::computeFenced(
         const std::vector<int>& waitFor, uint64_t timeoutDurationAfterFence,
         const OptionalTimePoint& deadline) {
@@ -52,6 +52,7 @@ class RuntimeMemory;
 class RuntimePreparedModel;
 class RuntimeExecution;
 class StepExecutor;
+class StreamingPipeline;
 
 // Execution modes
 enum class ExecutionMode { ASYNC, SYNC, BURST, ASYNC_WITH_DEPS };
@@ -110,6 +111,8 @@ class ExecutionBuilder {
     // Handshake with lower-level execution support
     bool measureTiming() const { return mMeasureTiming; }
     void reportTimingWithoutFencedExecutionCallback(Timing timing) {
+        // Steps of a compound execution may run concurrently.
+        std::lock_guard<std::mutex> lock(mTimingMutex);
         mTimingWithoutFencedExecutionCallback = timing;
     }
 
@@ -215,7 +218,8 @@ class ExecutionBuilder {
 
     // Timing reported from the driver.  This field is only used if
     // mFencedExecutionCallback is nullptr.
-    Timing mTimingWithoutFencedExecutionCallback = {};
+    mutable std::mutex mTimingMutex;
+    Timing mTimingWithoutFencedExecutionCallback GUARDED_BY(mTimingMutex) = {};
 
     // Amount of time to complete or abort the execution.
     std::optional<uint64_t> mTimeoutDuration;
@@ -309,6 +313,18 @@ class CompoundExecutionBuilder : public ExecutionBuilder {
     std::tuple<int, int, ExecuteFencedInfoCallback> computeFencedInternal(
             const std::vector<int>& waitFor, uint64_t timeoutDurationAfterFence,
             const OptionalTimePoint& deadline) override;
+
+   private:
+    // Runs each step of the plan on a small pool of threads as soon as the steps it depends on
+    // have completed. Only used when ExecutionPlan::canRunStepsConcurrently() returns true.
+    std::tuple<int, std::vector<OutputShape>, Timing> computeStepsConcurrently(
+            const OptionalTimePoint& deadline, BurstBuilder* burstBuilder);
+
+    // Runs the steps of the plan in order, each on the stage of the pipeline serving that step.
+    // Used when the compilation is in streaming mode; see DeviceManager::streaming().
+    std::tuple<int, std::vector<OutputShape>, Timing> computeStreaming(
+            StreamingPipeline* pipeline, const OptionalTimePoint& deadline,
+            BurstBuilder* burstBuilder);
 };
 
 // class StepExecutor is used to execute a single "step" in a
@@ -435,6 +451,10 @@ class StepExecutor {
                                    uint32_t offset, uint32_t length, const Dimensions& dimensions,
                                    ModelArgumentInfo* inputOrOutputInfo);
 
+    // Adds a sample for this step to the performance profile of the compilation, if any; see
+    // DeviceManager::getProfileDir().
+    void recordPerformance(Duration duration) const;
+
     // describes the full (possibly multiple-"step") execution
     ExecutionBuilder* mExecutionBuilder;
 
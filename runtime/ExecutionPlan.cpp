@@ -33,13 +33,19 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <functional>
+#include <limits>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <unordered_set>
 #include <utility>
@@ -51,6 +57,8 @@
 #include "ExecutionCallback.h"
 #include "Manager.h"
 #include "ModelBuilder.h"
+#include "PerformanceProfile.h"
+#include "SupportedOperationsMemo.h"
 #include "TypeManager.h"
 
 namespace android {
@@ -134,6 +142,45 @@ int compile(const Device& device, const ModelBuilder& model, int executionPrefer
     return n;
 }
 
+// Compiles the step models of steps, with at most kMaxConcurrentCompilations compilations in
+// flight, and returns the result of each compilation. Once a step fails, the steps after it are
+// not compiled, as the plan is going to fail anyway; their result is ANEURALNETWORKS_OP_FAILED.
+// Those that were already being compiled when the step failed are released, so that the outcome
+// is the same as compiling the steps one at a time.
+std::vector<int> compileStepModels(const std::vector<ExecutionStep*>& steps,
+                                   int32_t executionPreference, int32_t priority) {
+    constexpr size_t kMaxConcurrentCompilations = 4;
+
+    std::vector<int> results(steps.size(), ANEURALNETWORKS_OP_FAILED);
+    std::atomic<size_t> nextStep = 0;
+    std::atomic<size_t> firstFailedStep = steps.size();
+    auto compileSteps = [&] {
+        for (size_t i = nextStep++; i < steps.size() && i < firstFailedStep; i = nextStep++) {
+            results[i] = steps[i]->compileStepModel(executionPreference, priority);
+            if (results[i] != ANEURALNETWORKS_NO_ERROR) {
+                size_t failedStep = firstFailedStep;
+                while (i < failedStep && !firstFailedStep.compare_exchange_weak(failedStep, i)) {
+                }
+            }
+        }
+    };
+
+    // The calling thread compiles too.
+    std::vector<std::thread> threads;
+    for (size_t i = 1, n = std::min(steps.size(), kMaxConcurrentCompilations); i < n; ++i) {
+        threads.emplace_back(compileSteps);
+    }
+    compileSteps();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t i = firstFailedStep + 1; i < steps.size(); ++i) {
+        steps[i]->releasePreparedStepModel();
+        results[i] = ANEURALNETWORKS_OP_FAILED;
+    }
+    return results;
+}
+
 typedef std::function<void(uint32_t)> OperationReadyCallback;
 
 int copyOperandExtraParams(ModelBuilder& model, uint32_t toOperandIndex,
@@ -227,6 +274,62 @@ StaticTemporaryLocation addTemporary(uint32_t* totalSizeOfTemporaries, uint32_t
     return {.offset = offset, .paddedLength = size};
 };
 
+// A static temporary to be placed in the memory of ExecutionPlan::Controller, which is live from
+// the start of step firstStep to the end of step lastStep.
+struct TemporaryInterval {
+    std::map<SourceOperandIndex, StaticTemporaryLocation>* locations;
+    SourceOperandIndex sourceOperandIndex;
+    uint32_t size;
+    uint32_t alignment;
+    uint32_t padding;
+    uint32_t firstStep;
+    uint32_t lastStep;
+};
+
+// Stores a location for every temporary in its locations map such that temporaries that are live
+// during the same step do not overlap, and returns the total size of the locations. Temporaries are
+// placed largest first, each at the lowest aligned offset clear of every placed temporary whose
+// interval overlaps its own. Temporaries that are never live at the same time may thus share
+// memory, and the total size tends towards the largest size of the temporaries live at one step.
+uint32_t packTemporaries(std::vector<TemporaryInterval> temporaries) {
+    std::stable_sort(temporaries.begin(), temporaries.end(),
+                     [](const TemporaryInterval& a, const TemporaryInterval& b) {
+                         return a.size > b.size;
+                     });
+    struct Placement {
+        uint32_t begin;
+        uint32_t end;
+        uint32_t firstStep;
+        uint32_t lastStep;
+    };
+    std::vector<Placement> placements;
+    uint32_t totalSize = 0;
+    for (const TemporaryInterval& temporary : temporaries) {
+        // Placements are kept sorted by offset, so one pass finds the lowest gap that fits.
+        const uint32_t paddedLength = roundUp(temporary.size, temporary.padding);
+        uint32_t offset = 0;
+        for (auto it = placements.begin(); it != placements.end(); ++it) {
+            if (it->begin >= offset + paddedLength) break;
+            if (it->firstStep <= temporary.lastStep && temporary.firstStep <= it->lastStep &&
+                it->end > offset) {
+                offset = roundUp(it->end, temporary.alignment);
+            }
+        }
+        const auto insertionPoint = std::find_if(
+                placements.begin(), placements.end(),
+                [offset](const Placement& placement) { return placement.begin > offset; });
+        placements.insert(insertionPoint, {.begin = offset,
+                                           .end = offset + paddedLength,
+                                           .firstStep = temporary.firstStep,
+                                           .lastStep = temporary.lastStep});
+        totalSize = std::max(totalSize, offset + paddedLength);
+        const StaticTemporaryLocation location = {.offset = offset, .paddedLength = paddedLength};
+        auto [_, isNew] = temporary.locations->emplace(temporary.sourceOperandIndex, location);
+        CHECK(isNew);
+    }
+    return totalSize;
+}
+
 std::string toString(SourceOperandIndex sourceOperandIndex) {
     return "(" + std::to_string(sourceOperandIndex.first) + ", " +
            std::to_string(sourceOperandIndex.second) + ")";
@@ -554,6 +657,7 @@ int ExecutionStep::addOperand(uint32_t sourceOperandIndex, uint32_t* stepOperand
 
 int ExecutionStep::addOperation(int operationIndex) {
     const Operation& operation = getSourceModel()->getOperation(operationIndex);
+    mSourceOperationIndexes.push_back(operationIndex);
     if (mToken.ok()) {
         mToken.update(&mSourceModelIndex, sizeof(mSourceModelIndex));
         mToken.update(&operationIndex, sizeof(operationIndex));
@@ -781,8 +885,7 @@ static bool hasUnknownSize(const Operand& operand) {
     return false;
 }
 
-int ExecutionStep::finishStepModel(const ModelBuilder* mainModel, bool* hasOutputOfUnknownSize,
-                                   int32_t executionPreference, int32_t priority) {
+int ExecutionStep::finishStepModel(const ModelBuilder* mainModel, bool* hasOutputOfUnknownSize) {
     CHECK(mDevice != nullptr);
 
     for (const auto& stepModelOutput : mTempsAsStepModelOutputs) {
@@ -868,10 +971,12 @@ int ExecutionStep::finishStepModel(const ModelBuilder* mainModel, bool* hasOutpu
                    [](auto& e) { return e.second; });
     NN_RETURN_IF_ERROR(mStepModel.identifyInputsAndOutputs(inputs.size(), inputs.data(),
                                                            outputs.size(), outputs.data()));
-    NN_RETURN_IF_ERROR(mStepModel.finish());
+    return mStepModel.finish();
+}
 
-    // TODO: Move compilation elsewhere?
-    VLOG(COMPILATION) << "ExecutionStep::finishStepModel, compilation on " << mDevice->getName();
+int ExecutionStep::compileStepModel(int32_t executionPreference, int32_t priority) {
+    CHECK(mDevice != nullptr);
+    VLOG(COMPILATION) << "ExecutionStep::compileStepModel, compilation on " << mDevice->getName();
     return compile(*mDevice, mStepModel, executionPreference, priority, {}, *mPlan->getCacheInfo(),
                    &mToken, {}, &mPreparedStepModel);
 }
@@ -879,7 +984,7 @@ int ExecutionStep::finishStepModel(const ModelBuilder* mainModel, bool* hasOutpu
 void ExecutionStep::dump() const {
     if (VLOG_IS_ON(COMPILATION)) {
         VLOG(COMPILATION) << "Step#" << mIndex << ": execute on " << mDevice->getName();
-        logModelToInfo(mStepModel.makeModel());
+        logModelToInfo(*mStepModel.makeSharedModel());
     }
 }
 
@@ -933,34 +1038,26 @@ int ExecutionPlan::CompoundBody::finish(const SourceModels* sourceModels,
         return false;
     };
 
+    // Step models are finished in order and then compiled concurrently. The outcome is the same as
+    // finishing and compiling one step at a time: the result is that of the first step to fail,
+    // and no step after it is finished.
+    struct StepToCompile {
+        ExecutionStep* step;
+        bool hasDynamicTemporaries;
+        int finishResult;
+    };
+    std::vector<StepToCompile> stepsToCompile;
     findTempsAsStepModelOutputs();
     for (const auto& logicalStep : mSteps) {
         if (ExecutionStep* step = logicalStep->tryExecutionStep()) {
             bool stepHasDynamicTemporaries = false;
-            int n = step->finishStepModel(mainModel, &stepHasDynamicTemporaries,
-                                          executionPreference, priority);
-            if (stepHasDynamicTemporaries) {
-                mHasDynamicTemporaries = true;
-                if (!isCompliantVersion(kHalVersionV1_2ToApi.canonical,
-                                        step->getDevice()->getFeatureLevel())) {
-                    // Until HAL 1.2, an Operand with lifetime SUBGRAPH_OUTPUT
-                    // must have fully specified dimensions either in the
-                    // Operand or in the RequestArgument.  In the case of a
-                    // dynamic temporary, we won't be able to supply fully
-                    // specified dimensions in either.
-                    VLOG(COMPILATION)
-                            << "ExecutionPlan::CompoundBody::finish -- step#" << step->getIndex()
-                            << " defines dynamic temporaries but is scheduled on pre-1.2 device "
-                            << step->getDevice()->getName();
-                    if (n == ANEURALNETWORKS_NO_ERROR) {
-                        n = ANEURALNETWORKS_OP_FAILED;
-                    }
-                }
-            }
-            if (n != ANEURALNETWORKS_NO_ERROR) {
-                VLOG(COMPILATION)
-                        << "ExecutionPlan::CompoundBody::finish -- finishStepModel failed";
-                return n;
+            const int n = step->finishStepModel(mainModel, &stepHasDynamicTemporaries);
+            stepsToCompile.push_back({step, stepHasDynamicTemporaries, n});
+            if (n != ANEURALNETWORKS_NO_ERROR ||
+                (stepHasDynamicTemporaries &&
+                 !isCompliantVersion(kHalVersionV1_2ToApi.canonical,
+                                     step->getDevice()->getFeatureLevel()))) {
+                break;
             }
         } else if (IfStep* step = logicalStep->tryIfStep()) {
             // The partitioner does not support dynamic temporaries (b/132458982).
@@ -984,6 +1081,49 @@ int ExecutionPlan::CompoundBody::finish(const SourceModels* sourceModels,
         }
     }
 
+    std::vector<ExecutionStep*> finishedSteps;
+    for (const auto& stepToCompile : stepsToCompile) {
+        if (stepToCompile.finishResult == ANEURALNETWORKS_NO_ERROR) {
+            finishedSteps.push_back(stepToCompile.step);
+        }
+    }
+    const std::vector<int> compileResults =
+            compileStepModels(finishedSteps, executionPreference, priority);
+
+    for (size_t i = 0; i < stepsToCompile.size(); ++i) {
+        const auto& [step, stepHasDynamicTemporaries, finishResult] = stepsToCompile[i];
+        // Only the last step can have failed to finish.
+        int n = finishResult == ANEURALNETWORKS_NO_ERROR ? compileResults[i] : finishResult;
+        if (stepHasDynamicTemporaries) {
+            mHasDynamicTemporaries = true;
+            if (!isCompliantVersion(kHalVersionV1_2ToApi.canonical,
+                                    step->getDevice()->getFeatureLevel())) {
+                // Until HAL 1.2, an Operand with lifetime SUBGRAPH_OUTPUT
+                // must have fully specified dimensions either in the
+                // Operand or in the RequestArgument.  In the case of a
+                // dynamic temporary, we won't be able to supply fully
+                // specified dimensions in either.
+                VLOG(COMPILATION)
+                        << "ExecutionPlan::CompoundBody::finish -- step#" << step->getIndex()
+                        << " defines dynamic temporaries but is scheduled on pre-1.2 device "
+                        << step->getDevice()->getName();
+                if (n == ANEURALNETWORKS_NO_ERROR) {
+                    n = ANEURALNETWORKS_OP_FAILED;
+                }
+            }
+        }
+        if (finishResult != ANEURALNETWORKS_NO_ERROR) {
+            VLOG(COMPILATION) << "ExecutionPlan::CompoundBody::finish -- step#" << step->getIndex()
+                              << " failed to finish its step model";
+        } else if (compileResults[i] != ANEURALNETWORKS_NO_ERROR) {
+            VLOG(COMPILATION) << "ExecutionPlan::CompoundBody::finish -- step#" << step->getIndex()
+                              << " failed to compile on " << step->getDevice()->getName();
+        }
+        if (n != ANEURALNETWORKS_NO_ERROR) {
+            return n;
+        }
+    }
+
     if (simulateFailureResultCode != ANEURALNETWORKS_NO_ERROR) {
         VLOG(COMPILATION) << "ExecutionPlan::CompoundeBody::finish: simulating failure, ResultCode "
                           << simulateFailureResultCode;
@@ -1002,6 +1142,8 @@ int ExecutionPlan::CompoundBody::finish(const SourceModels* sourceModels,
     findControlFlowBoundaryConstants(sourceModels);
     findModelOutputsThatAreDownstreamInputs();
     findMemoryStepRoles();
+    findTemporaryLayout(sourceModels);
+    findStepDependencies();
 
     mSuccessfulFinish = true;
     LOG(INFO) << "ExecutionPlan::CompoundBody::finish: compilation finished successfully";
@@ -1135,6 +1277,264 @@ void ExecutionPlan::CompoundBody::findMemoryStepRoles() {
     });
 }
 
+void ExecutionPlan::CompoundBody::findTemporaryLayout(const SourceModels* sourceModels) {
+    // Steps run in index order unless the plan has control flow. IfStep and WhileStep jump between
+    // steps and let referenced models use the memory of their outer operands, so with control flow
+    // every temporary is conservatively considered live throughout the execution.
+    const uint32_t lastStep = mSteps.empty() ? 0 : static_cast<uint32_t>(mSteps.size() - 1);
+    const bool hasControlFlow =
+            std::any_of(mSteps.begin(), mSteps.end(),
+                        [](const auto& logicalStep) { return !logicalStep->isExecution(); });
+
+    // Map from temporary source operand index to the last ExecutionStep reading it.
+    std::map<SourceOperandIndex, uint32_t> temporaryToLastReadingStep;
+    for (const auto& logicalStep : mSteps) {
+        if (const ExecutionStep* step = logicalStep->tryExecutionStep()) {
+            for (const auto& input : step->getTempsAsStepModelInputs()) {
+                const SourceOperandIndex sourceOperandIndex(step->getSourceModelIndex(),
+                                                            input.first);
+                auto& lastReadingStep = temporaryToLastReadingStep[sourceOperandIndex];
+                lastReadingStep = std::max(lastReadingStep, step->getIndex());
+            }
+        }
+    }
+
+    std::vector<TemporaryInterval> temporaries;
+    // This function has two modes of operation:
+    // 1. When lifetime is TEMPORARY_VARIABLE, we allocate memory for
+    //    TEMPORARY_VARIABLE source operands that are not dynamic temporaries,
+    //    skip TEMPORARY_VARIABLE source operands that are dynamic temporaries,
+    //    skip SUBGRAPH_OUTPUT source operands, and panic if we see a source
+    //    operand of another lifetime.
+    // 2. When lifetime is SUBGRAPH_OUTPUT, we allocate memory for
+    //    SUBGRAPH_OUTPUT source operands and panic if we see a source operand
+    //    of another lifetime.
+    auto mapTemporary = [this, sourceModels, &temporaries, hasControlFlow, lastStep](
+                                const SourceOperandIndex& sourceOperandIndex,
+                                std::map<SourceOperandIndex, StaticTemporaryLocation>*
+                                        sourceOperandToLocationOfTemporary,
+                                Operand::LifeTime lifetime = Operand::LifeTime::TEMPORARY_VARIABLE,
+                                std::optional<std::pair<uint32_t, uint32_t>> liveSteps = {}) {
+        CHECK(lifetime == Operand::LifeTime::TEMPORARY_VARIABLE ||
+              lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT);
+        const Operand& sourceOperand = sourceModels->getModel(sourceOperandIndex.first)
+                                               ->getOperand(sourceOperandIndex.second);
+        if (lifetime == Operand::LifeTime::TEMPORARY_VARIABLE &&
+            sourceOperand.lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT) {
+            // See the caller for explanation.
+            return;
+        }
+        CHECK_EQ(sourceOperand.lifetime, lifetime);
+        const uint32_t size = TypeManager::get()->getSizeOfData(sourceOperand);
+        if (size != 0u) {
+            const auto memoryPreference = getMemoryPreferenceOfSourceOperand(sourceOperandIndex);
+            if (hasControlFlow || !liveSteps.has_value()) {
+                liveSteps = {0, lastStep};
+            }
+            temporaries.push_back({.locations = sourceOperandToLocationOfTemporary,
+                                   .sourceOperandIndex = sourceOperandIndex,
+                                   .size = size,
+                                   .alignment = memoryPreference.alignment,
+                                   .padding = memoryPreference.padding,
+                                   .firstStep = liveSteps->first,
+                                   .lastStep = liveSteps->second});
+        } else {
+            // Unknown size, hence dynamic temporary.  The mapping will
+            // be established elsewhere (DynamicTemporaries::allocate()).
+            CHECK_EQ(lifetime, Operand::LifeTime::TEMPORARY_VARIABLE);
+            CHECK_EQ(sourceOperand.lifetime, Operand::LifeTime::TEMPORARY_VARIABLE);
+        }
+    };
+    for (const auto& logicalStep : mSteps) {
+        if (const ExecutionStep* step = logicalStep->tryExecutionStep()) {
+            // Allocate memory for ExecutionStep temporary outputs that are
+            // inputs to other steps, as determined by
+            // ExecutionPlan::CompoundBody::findTempsAsStepModelOutputs().
+            // Such a temporary is live from the step defining it to the last
+            // step reading it.
+            //
+            // We don't allocate memory for step model output operands with
+            // source operand lifetime SUBGRAPH_OUTPUT because they will be
+            // - managed by the client (main model outputs),
+            // - assigned a location of another operand (when this step model
+            //   output is a branch model output of an IF; see
+            //   ExecutionPlan::nextCompound(const IfStep*, ...)), or
+            // - allocated by a WHILE (when this step model output
+            //   is a condition or body model output of a WHILE; see the
+            //   step->bodyOutputOperands and step->condOutputOperand handling
+            //   below).
+            for (const auto& output : step->getTempsAsStepModelOutputs()) {
+                const SourceOperandIndex sourceOperandIndex(step->getSourceModelIndex(),
+                                                            output.first);
+                const auto it = temporaryToLastReadingStep.find(sourceOperandIndex);
+                const uint32_t lastReadingStep = it != temporaryToLastReadingStep.end()
+                                                         ? std::max(it->second, step->getIndex())
+                                                         : step->getIndex();
+                mapTemporary(sourceOperandIndex, &mSourceOperandToLocationOfTemporary,
+                             Operand::LifeTime::TEMPORARY_VARIABLE,
+                             std::make_pair(step->getIndex(), lastReadingStep));
+            }
+        } else if (const IfStep* step = logicalStep->tryIfStep()) {
+            // Allocate memory for all temporary outputs of an IfStep because
+            // they are going to be written to by a branch model. We don't
+            // perform unused output operand optimisation for referenced models.
+            //
+            // We don't allocate memory for branch output operands because they
+            // use the same location as the corresponding outer output operands,
+            // as established in ExecutionPlan::nextCompound(const IfStep*, ...)
+            //
+            // We don't allocate memory for outer output operands with source
+            // operand lifetime SUBGRAPH_OUTPUT because they will be
+            // - managed by the client (main model outputs),
+            // - assigned a location of another operand (when this IF outer
+            //   output is a branch model output of another IF; see
+            //   ExecutionPlan::nextCompound(const IfStep*, ...)), or
+            // - allocated by a WHILE (when this IF outer output
+            //   is a condition or body model output of a WHILE; see the
+            //   step->bodyOutputOperands and step->condOutputOperand handling
+            //   below).
+            for (const auto& sourceOperandIndex : step->outerOutputOperands) {
+                mapTemporary(sourceOperandIndex, &mSourceOperandToLocationOfTemporary);
+            }
+        } else if (const WhileStep* step = logicalStep->tryWhileStep()) {
+            // Allocate memory for all temporary outputs of an WhileStep because
+            // they are going to be written to by the WHILE loop.
+            //
+            // We don't allocate memory for outer output operands with source
+            // operand lifetime SUBGRAPH_OUTPUT because they will be
+            // - managed by the client (main model outputs),
+            // - assigned a location of another operand (when this WHILE outer
+            //   output is a branch model output of an IF; see
+            //   ExecutionPlan::nextCompound(const IfStep*, ...)), or
+            // - allocated by another WHILE (when this WHILE outer output
+            //   is a condition or body model output of another WHILE; see the
+            //   step->bodyOutputOperands and step->condOutputOperand handling
+            //   below).
+            for (const auto& sourceOperandIndex : step->outerOutputOperands) {
+                mapTemporary(sourceOperandIndex, &mSourceOperandToLocationOfTemporary);
+            }
+            // Allocate memory for body model outputs. Note that we could use
+            // the outer output operand memory instead but we currently don't do
+            // so (b/148206073).
+            for (const auto& sourceOperandIndex : step->bodyOutputOperands) {
+                mapTemporary(sourceOperandIndex, &mSourceOperandToLocationOfTemporary,
+                             Operand::LifeTime::SUBGRAPH_OUTPUT);
+                // Allocate another set of temporaries for double buffering.
+                mapTemporary(sourceOperandIndex, &mSourceOperandToLocationOfTemporary2,
+                             Operand::LifeTime::SUBGRAPH_OUTPUT);
+            }
+            // Allocate memory for condition model output.
+            // TODO: Share one condition output memory region between all loops.
+            mapTemporary(step->condOutputOperand, &mSourceOperandToLocationOfTemporary,
+                         Operand::LifeTime::SUBGRAPH_OUTPUT);
+        } else {
+            CHECK(logicalStep->isGoto());
+        }
+    }
+    // Allocate temporary memory for boundary CONSTANT_COPY operands. They are copied in when the
+    // ExecutionPlan::Controller is created, so they are live throughout the execution.
+    for (const auto& [sourceOperandIndex, location] : mSourceOperandToBoundaryConstantCopy) {
+        const auto memoryPreference = getMemoryPreferenceOfSourceOperand(sourceOperandIndex);
+        temporaries.push_back({.locations = &mSourceOperandToLocationOfTemporary,
+                               .sourceOperandIndex = sourceOperandIndex,
+                               .size = location.length,
+                               .alignment = memoryPreference.alignment,
+                               .padding = memoryPreference.padding,
+                               .firstStep = 0,
+                               .lastStep = lastStep});
+    }
+
+    mTotalSizeOfTemporaries = packTemporaries(std::move(temporaries));
+    if (VLOG_IS_ON(COMPILATION)) {
+        for (const auto& [sourceOperandIndex, location] : mSourceOperandToLocationOfTemporary) {
+            VLOG(COMPILATION) << "temp: operand " << toString(sourceOperandIndex)
+                              << " offset = " << location.offset
+                              << " paddedLength = " << location.paddedLength;
+        }
+        VLOG(COMPILATION) << "total size of temporaries = " << mTotalSizeOfTemporaries;
+    }
+}
+
+void ExecutionPlan::CompoundBody::findStepDependencies() {
+    mStepDependencies.clear();
+    mHasIndependentSteps = false;
+    // Control flow steps decide at execution time which step runs next, and dynamic temporaries
+    // are allocated and resized as steps run, so such plans keep running one step at a time.
+    if (mHasDynamicTemporaries ||
+        std::any_of(mSteps.begin(), mSteps.end(),
+                    [](const auto& logicalStep) { return !logicalStep->isExecution(); })) {
+        return;
+    }
+
+    std::vector<std::set<uint32_t>> dependencies(mSteps.size());
+    // Map from temporary source operand index to the steps reading it.
+    std::map<SourceOperandIndex, std::vector<uint32_t>> temporaryToReadingSteps;
+    for (const auto& logicalStep : mSteps) {
+        const ExecutionStep* step = logicalStep->executionStep();
+        const uint32_t stepIndex = step->getIndex();
+        for (const auto& input : step->getTempsAsStepModelInputs()) {
+            const SourceOperandIndex sourceOperandIndex(step->getSourceModelIndex(), input.first);
+            const auto it = mTemporaryToDefiningExecutionStep.find(sourceOperandIndex);
+            CHECK(it != mTemporaryToDefiningExecutionStep.end());
+            dependencies[stepIndex].insert(it->second);
+            temporaryToReadingSteps[sourceOperandIndex].push_back(stepIndex);
+        }
+        for (const auto& output : step->getOutputsAsStepModelInputs()) {
+            const SourceOperandIndex sourceOperandIndex(step->getSourceModelIndex(),
+                                                        output.first);
+            const auto it = mOutputToDefiningExecutionStep.find(sourceOperandIndex);
+            CHECK(it != mOutputToDefiningExecutionStep.end());
+            dependencies[stepIndex].insert(it->second);
+        }
+    }
+
+    // findTemporaryLayout() lets temporaries with disjoint lifetimes share memory. A step defining
+    // a temporary must not start until every step accessing an earlier temporary that overlaps it
+    // has completed.
+    for (const auto& [sourceOperandIndex, location] : mSourceOperandToLocationOfTemporary) {
+        const auto definingStep = mTemporaryToDefiningExecutionStep.find(sourceOperandIndex);
+        if (definingStep == mTemporaryToDefiningExecutionStep.end()) {
+            continue;
+        }
+        for (const auto& [otherSourceOperandIndex, otherLocation] :
+             mSourceOperandToLocationOfTemporary) {
+            const auto otherDefiningStep =
+                    mTemporaryToDefiningExecutionStep.find(otherSourceOperandIndex);
+            if (otherDefiningStep == mTemporaryToDefiningExecutionStep.end() ||
+                otherDefiningStep->second >= definingStep->second ||
+                location.offset >= otherLocation.offset + otherLocation.paddedLength ||
+                otherLocation.offset >= location.offset + location.paddedLength) {
+                continue;
+            }
+            auto& stepDependencies = dependencies[definingStep->second];
+            stepDependencies.insert(otherDefiningStep->second);
+            if (const auto it = temporaryToReadingSteps.find(otherSourceOperandIndex);
+                it != temporaryToReadingSteps.end()) {
+                stepDependencies.insert(it->second.begin(), it->second.end());
+            }
+        }
+    }
+
+    mStepDependencies.resize(mSteps.size());
+    for (uint32_t stepIndex = 0; stepIndex < mSteps.size(); ++stepIndex) {
+        mStepDependencies[stepIndex].assign(dependencies[stepIndex].begin(),
+                                            dependencies[stepIndex].end());
+        if (stepIndex > 0 && dependencies[stepIndex].count(stepIndex - 1) == 0) {
+            mHasIndependentSteps = true;
+        }
+    }
+    if (VLOG_IS_ON(COMPILATION)) {
+        for (uint32_t stepIndex = 0; stepIndex < mSteps.size(); ++stepIndex) {
+            std::ostringstream oss;
+            for (uint32_t dependency : mStepDependencies[stepIndex]) {
+                oss << " " << dependency;
+            }
+            VLOG(COMPILATION) << "step " << stepIndex << " depends on steps:" << oss.str();
+        }
+        VLOG(COMPILATION) << "has independent steps = " << mHasIndependentSteps;
+    }
+}
+
 int ExecutionPlan::SimpleBody::finish(const SourceModels*, int32_t executionPreference,
                                       int32_t priority, const OptionalTimePoint& deadline,
                                       const std::vector<TokenValuePair>& metadata,
@@ -1168,7 +1568,7 @@ int ExecutionPlan::finish(int32_t executionPreference, int32_t priority,
 
 ExecutionPlan::Controller::Controller(
         const ExecutionPlan* plan, ExecutionBuilder* executionBuilder,
-        const BurstBuilder* burstBuilder, uint32_t totalSizeOfTemporaries,
+        const BurstBuilder* burstBuilder, uint32_t totalSizeOfTemporaries, bool recycleTemporaries,
         std::map<SourceOperandIndex, StaticTemporaryLocation> sourceOperandToLocationOfTemporary,
         std::map<SourceOperandIndex, StaticTemporaryLocation> sourceOperandToLocationOfTemporary2,
         std::map<SourceOperandIndex, uint32_t> sourceOperandToInputIndex,
@@ -1184,6 +1584,7 @@ ExecutionPlan::Controller::Controller(
       mSourceOperandToInputIndex(std::move(sourceOperandToInputIndex)),
       mSourceOperandToOutputIndex(std::move(sourceOperandToOutputIndex)),
       mSourceOperandToConstantReference(std::move(sourceOperandToConstantReference)),
+      mRecycleTemporaries(recycleTemporaries),
       mDynamicTemporaries(std::move(dynamicTemporaries)),
       mNextStepIndex(0),
       mFallbackNextStepIndex(kBadStepIndex),
@@ -1191,11 +1592,11 @@ ExecutionPlan::Controller::Controller(
     if (totalSizeOfTemporaries == 0) {
         return;
     }
-    int n;
-    std::tie(n, mTemporaries) = MemoryAshmem::create(totalSizeOfTemporaries);
-    if (n != ANEURALNETWORKS_NO_ERROR) {
+    mTemporaries = plan->acquireTemporaryMemory(totalSizeOfTemporaries);
+    if (mTemporaries == nullptr) {
         LOG(ERROR) << "ExecutionPlan::Controller failed to allocate temporaries";
         mNextStepIndex = kBadStepIndex;
+        return;
     }
     for (const auto& [sourceOperandIndex, location] : sourceOperandToConstantCopy) {
         memcpy(mTemporaries->getPointer() +
@@ -1204,6 +1605,36 @@ ExecutionPlan::Controller::Controller(
     }
 }
 
+ExecutionPlan::Controller::~Controller() {
+    if (mRecycleTemporaries && mTemporaries != nullptr) {
+        mPlan->releaseTemporaryMemory(std::move(mTemporaries));
+    }
+}
+
+std::unique_ptr<MemoryAshmem> ExecutionPlan::acquireTemporaryMemory(uint32_t size) const {
+    {
+        std::lock_guard<std::mutex> lock(mTemporaryMemoriesMutex);
+        if (!mTemporaryMemories.empty()) {
+            std::unique_ptr<MemoryAshmem> memory = std::move(mTemporaryMemories.back());
+            mTemporaryMemories.pop_back();
+            CHECK_GE(memory->getSize(), size);
+            return memory;
+        }
+    }
+    auto [n, memory] = MemoryAshmem::create(size);
+    return n == ANEURALNETWORKS_NO_ERROR ? std::move(memory) : nullptr;
+}
+
+void ExecutionPlan::releaseTemporaryMemory(std::unique_ptr<MemoryAshmem> memory) const {
+    // One memory per concurrent execution of the plan is enough to avoid allocation in steady
+    // state. Beyond that, memories are freed rather than kept for a burst that may not recur.
+    constexpr size_t kMaxPooledTemporaryMemories = 4;
+    std::lock_guard<std::mutex> lock(mTemporaryMemoriesMutex);
+    if (mTemporaryMemories.size() < kMaxPooledTemporaryMemories) {
+        mTemporaryMemories.push_back(std::move(memory));
+    }
+}
+
 // Attempt to create a burst object for each PreparedModel/Partition. If the
 // burst controller object cannot be made, return a nullptr in its place to
 // indicate the regular execution path should be used. This can occur either
@@ -1257,161 +1688,11 @@ std::vector<SharedBurst> ExecutionPlan::makeBursts() const {
 }
 
 std::shared_ptr<ExecutionPlan::Controller> ExecutionPlan::makeController(
-        ExecutionBuilder* executionBuilder, const BurstBuilder* burstBuilder) const {
+        ExecutionBuilder* executionBuilder, const BurstBuilder* burstBuilder,
+        bool recycleTemporaries) const {
     CHECK(isValid());
     CHECK(mState != SIMPLE);
     const auto* body = compound();
-    // Create the layout for a RuntimeMemory object big enough to hold
-    // - every partition boundary TEMPORARY operand that is not a dynamic temporary, and
-    // - buffers required by the control flow implementation.
-    //
-    // TODO: Rethink this approach for managing temporaries.  Some
-    // alternatives:
-    //
-    // 1) Adopt a memory layout scheme analogous to stack allocation,
-    // where objects of non-overlapping lifetime can occupy the same
-    // storage.  We would still have a single Memory object in this
-    // case.
-    //
-    // 2) Do something like what CpuExecutor does, and do allocations
-    // and deallocations on the fly (during execution) before first
-    // reference and after last reference, respectively.  This would
-    // mean having one Memory object per TEMPORARY; or, in a more
-    // complicated implementation, one Memory object per set of
-    // temporaries that have the same lifetime.  Note that the Android
-    // system limits the number of shared memory objects, which are
-    // what our Memory objects represent.
-    //
-    uint32_t totalSizeOfTemporaries = 0;
-    // This function has two modes of operation:
-    // 1. When lifetime is TEMPORARY_VARIABLE, we allocate memory for
-    //    TEMPORARY_VARIABLE source operands that are not dynamic temporaries,
-    //    skip TEMPORARY_VARIABLE source operands that are dynamic temporaries,
-    //    skip SUBGRAPH_OUTPUT source operands, and panic if we see a source
-    //    operand of another lifetime.
-    // 2. When lifetime is SUBGRAPH_OUTPUT, we allocate memory for
-    //    SUBGRAPH_OUTPUT source operands and panic if we see a source operand
-    //    of another lifetime.
-    auto mapTemporary = [body, executionBuilder, &totalSizeOfTemporaries](
-                                const SourceOperandIndex& sourceOperandIndex,
-                                std::map<SourceOperandIndex, StaticTemporaryLocation>*
-                                        sourceOperandToLocationOfTemporary,
-                                Operand::LifeTime lifetime =
-                                        Operand::LifeTime::TEMPORARY_VARIABLE) {
-        CHECK(lifetime == Operand::LifeTime::TEMPORARY_VARIABLE ||
-              lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT);
-        const Operand& sourceOperand = executionBuilder->getSourceOperand(sourceOperandIndex);
-        if (lifetime == Operand::LifeTime::TEMPORARY_VARIABLE &&
-            sourceOperand.lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT) {
-            // See the caller for explanation.
-            return;
-        }
-        CHECK_EQ(sourceOperand.lifetime, lifetime);
-        const uint32_t size = TypeManager::get()->getSizeOfData(sourceOperand);
-        if (size != 0u) {
-            const auto memoryPreference =
-                    body->getMemoryPreferenceOfSourceOperand(sourceOperandIndex);
-            const auto loc = addTemporary(&totalSizeOfTemporaries, size, memoryPreference.alignment,
-                                          memoryPreference.padding);
-            auto [_, isNew] = sourceOperandToLocationOfTemporary->emplace(sourceOperandIndex, loc);
-            CHECK(isNew);
-            VLOG(EXECUTION) << "temp: operand " << toString(sourceOperandIndex)
-                            << " offset = " << loc.offset << " paddedLength = " << loc.paddedLength;
-        } else {
-            // Unknown size, hence dynamic temporary.  The mapping will
-            // be established elsewhere (DynamicTemporaries::allocate()).
-            CHECK_EQ(lifetime, Operand::LifeTime::TEMPORARY_VARIABLE);
-            CHECK_EQ(sourceOperand.lifetime, Operand::LifeTime::TEMPORARY_VARIABLE);
-        }
-    };
-    std::map<SourceOperandIndex, StaticTemporaryLocation> sourceOperandToLocationOfTemporary;
-    std::map<SourceOperandIndex, StaticTemporaryLocation> sourceOperandToLocationOfTemporary2;
-    for (const auto& logicalStep : body->mSteps) {
-        if (const ExecutionStep* step = logicalStep->tryExecutionStep()) {
-            // Allocate memory for ExecutionStep temporary outputs that are
-            // inputs to other steps, as determined by
-            // ExecutionPlan::CompoundBody::findTempsAsStepModelOutputs().
-            //
-            // We don't allocate memory for step model output operands with
-            // source operand lifetime SUBGRAPH_OUTPUT because they will be
-            // - managed by the client (main model outputs),
-            // - assigned a location of another operand (when this step model
-            //   output is a branch model output of an IF; see
-            //   ExecutionPlan::nextCompound(const IfStep*, ...)), or
-            // - allocated by a WHILE (when this step model output
-            //   is a condition or body model output of a WHILE; see the
-            //   step->bodyOutputOperands and step->condOutputOperand handling
-            //   below).
-            for (const auto& output : step->getTempsAsStepModelOutputs()) {
-                mapTemporary(SourceOperandIndex(step->getSourceModelIndex(), output.first),
-                             &sourceOperandToLocationOfTemporary);
-            }
-        } else if (const IfStep* step = logicalStep->tryIfStep()) {
-            // Allocate memory for all temporary outputs of an IfStep because
-            // they are going to be written to by a branch model. We don't
-            // perform unused output operand optimisation for referenced models.
-            //
-            // We don't allocate memory for branch output operands because they
-            // use the same location as the corresponding outer output operands,
-            // as established in ExecutionPlan::nextCompound(const IfStep*, ...)
-            //
-            // We don't allocate memory for outer output operands with source
-            // operand lifetime SUBGRAPH_OUTPUT because they will be
-            // - managed by the client (main model outputs),
-            // - assigned a location of another operand (when this IF outer
-            //   output is a branch model output of another IF; see
-            //   ExecutionPlan::nextCompound(const IfStep*, ...)), or
-            // - allocated by a WHILE (when this IF outer output
-            //   is a condition or body model output of a WHILE; see the
-            //   step->bodyOutputOperands and step->condOutputOperand handling
-            //   below).
-            for (const auto& sourceOperandIndex : step->outerOutputOperands) {
-                mapTemporary(sourceOperandIndex, &sourceOperandToLocationOfTemporary);
-            }
-        } else if (const WhileStep* step = logicalStep->tryWhileStep()) {
-            // Allocate memory for all temporary outputs of an WhileStep because
-            // they are going to be written to by the WHILE loop.
-            //
-            // We don't allocate memory for outer output operands with source
-            // operand lifetime SUBGRAPH_OUTPUT because they will be
-            // - managed by the client (main model outputs),
-            // - assigned a location of another operand (when this WHILE outer
-            //   output is a branch model output of an IF; see
-            //   ExecutionPlan::nextCompound(const IfStep*, ...)), or
-            // - allocated by another WHILE (when this WHILE outer output
-            //   is a condition or body model output of another WHILE; see the
-            //   step->bodyOutputOperands and step->condOutputOperand handling
-            //   below).
-            for (const auto& sourceOperandIndex : step->outerOutputOperands) {
-                mapTemporary(sourceOperandIndex, &sourceOperandToLocationOfTemporary);
-            }
-            // Allocate memory for body model outputs. Note that we could use
-            // the outer output operand memory instead but we currently don't do
-            // so (b/148206073).
-            for (const auto& sourceOperandIndex : step->bodyOutputOperands) {
-                mapTemporary(sourceOperandIndex, &sourceOperandToLocationOfTemporary,
-                             Operand::LifeTime::SUBGRAPH_OUTPUT);
-                // Allocate another set of temporaries for double buffering.
-                mapTemporary(sourceOperandIndex, &sourceOperandToLocationOfTemporary2,
-                             Operand::LifeTime::SUBGRAPH_OUTPUT);
-            }
-            // Allocate memory for condition model output.
-            // TODO: Share one condition output memory region between all loops.
-            mapTemporary(step->condOutputOperand, &sourceOperandToLocationOfTemporary,
-                         Operand::LifeTime::SUBGRAPH_OUTPUT);
-        } else {
-            CHECK(logicalStep->isGoto());
-        }
-    }
-    // Allocate temporary memory for boundary CONSTANT_COPY operands.
-    for (const auto& [sourceOperandIndex, location] : body->mSourceOperandToBoundaryConstantCopy) {
-        const auto memoryPreference = body->getMemoryPreferenceOfSourceOperand(sourceOperandIndex);
-        const auto loc = addTemporary(&totalSizeOfTemporaries, location.length,
-                                      memoryPreference.alignment, memoryPreference.padding);
-        sourceOperandToLocationOfTemporary.emplace(sourceOperandIndex, loc);
-        VLOG(EXECUTION) << "temp (boundary constant): operand " << toString(sourceOperandIndex)
-                        << " offset = " << loc.offset << " paddedLength = " << loc.paddedLength;
-    }
     // Collect dynamic temporaries.
     // TODO(b/157236079): Move some or all of this work to compilation time?
     DynamicTemporaries dynamicTemporaries;
@@ -1431,13 +1712,27 @@ std::shared_ptr<ExecutionPlan::Controller> ExecutionPlan::makeController(
     dynamicTemporaries.vlogDump("finished declarations");
 
     return std::shared_ptr<Controller>(new Controller(
-            this, executionBuilder, burstBuilder, totalSizeOfTemporaries,
-            std::move(sourceOperandToLocationOfTemporary),
-            std::move(sourceOperandToLocationOfTemporary2), body->mSourceOperandToInputIndex,
-            body->mSourceOperandToOutputIndex, body->mSourceOperandToBoundaryConstantCopy,
+            this, executionBuilder, burstBuilder, body->mTotalSizeOfTemporaries,
+            recycleTemporaries, body->mSourceOperandToLocationOfTemporary,
+            body->mSourceOperandToLocationOfTemporary2, body->mSourceOperandToInputIndex,
+            body->mSourceOperandToOutputIndex,
+            body->mSourceOperandToBoundaryConstantCopy,
             body->mSourceOperandToBoundaryConstantReference, std::move(dynamicTemporaries)));
 }
 
+bool ExecutionPlan::hasStepDependencies() const {
+    return mState == COMPOUND && !compound()->mStepDependencies.empty();
+}
+
+bool ExecutionPlan::canRunStepsConcurrently() const {
+    return mState == COMPOUND && compound()->mHasIndependentSteps;
+}
+
+const std::vector<std::vector<uint32_t>>& ExecutionPlan::getStepDependencies() const {
+    CHECK(hasStepDependencies());
+    return compound()->mStepDependencies;
+}
+
 // TODO: Find a better way to provide this functionality.
 int ExecutionPlan::fallback(std::shared_ptr<Controller> controller,
                             std::shared_ptr<StepExecutor>* executor, SharedBurst* burstController,
@@ -1613,6 +1908,38 @@ int ExecutionPlan::nextCompound(const ExecutionStep* step, std::shared_ptr<Contr
     VLOG(EXECUTION) << "next: Step#" << controller->mNextStepIndex << ": execute on "
                     << step->getDevice()->getName();
 
+    NN_RETURN_IF_ERROR(makeStepExecutor(step, controller, executor, burstController,
+                                        mainModelOutputShapes));
+
+    controller->mFallbackNextStepIndex = controller->mNextStepIndex;
+    controller->mNextStepIndex++;
+    return ANEURALNETWORKS_NO_ERROR;
+}
+
+int ExecutionPlan::makeStepExecutor(std::shared_ptr<Controller> controller, uint32_t stepIndex,
+                                    std::shared_ptr<StepExecutor>* executor,
+                                    SharedBurst* burstController,
+                                    const std::vector<OutputShape>* mainModelOutputShapes) const {
+    CHECK(hasStepDependencies());
+    CHECK_LT(stepIndex, compound()->mSteps.size());
+    *executor = nullptr;
+    if (burstController != nullptr) {
+        *burstController = nullptr;
+    }
+    if (controller->mNextStepIndex == Controller::kBadStepIndex) {
+        return ANEURALNETWORKS_OP_FAILED;
+    }
+    const ExecutionStep* step = compound()->mSteps[stepIndex]->executionStep();
+    VLOG(EXECUTION) << "makeStepExecutor: Step#" << stepIndex << ": execute on "
+                    << step->getDevice()->getName();
+    return makeStepExecutor(step, controller, executor, burstController, mainModelOutputShapes);
+}
+
+int ExecutionPlan::makeStepExecutor(const ExecutionStep* step,
+                                    std::shared_ptr<Controller> controller,
+                                    std::shared_ptr<StepExecutor>* executor,
+                                    SharedBurst* burstController,
+                                    const std::vector<OutputShape>* mainModelOutputShapes) const {
     NN_RETURN_IF_ERROR(controller->mDynamicTemporaries.allocate(step->getIndex()));
     controller->mDynamicTemporaries.vlogDump("finished allocating for a step");
 
@@ -1627,11 +1954,8 @@ int ExecutionPlan::nextCompound(const ExecutionStep* step, std::shared_ptr<Contr
             controller->mSourceOperandToInputIndex, controller->mSourceOperandToOutputIndex,
             controller->mSourceOperandToConstantReference);
     if (burstController != nullptr && controller->mBurstBuilder != nullptr) {
-        *burstController = controller->mBurstBuilder->getControllerAt(controller->mNextStepIndex);
+        *burstController = controller->mBurstBuilder->getControllerAt(step->getIndex());
     }
-
-    controller->mFallbackNextStepIndex = controller->mNextStepIndex;
-    controller->mNextStepIndex++;
     return ANEURALNETWORKS_NO_ERROR;
 }
 
@@ -2000,6 +2324,15 @@ const std::vector<std::shared_ptr<LogicalStep>>& ExecutionPlan::forTest_compound
     return compound()->mSteps;
 }
 
+const std::map<SourceOperandIndex, StaticTemporaryLocation>&
+ExecutionPlan::forTest_compoundGetLocationsOfTemporaries() const {
+    return compound()->mSourceOperandToLocationOfTemporary;
+}
+
+uint32_t ExecutionPlan::forTest_compoundGetTotalSizeOfTemporaries() const {
+    return compound()->mTotalSizeOfTemporaries;
+}
+
 std::set<uint32_t> ExecutionPlan::forTest_flatGetDynamicTemporaries() const {
     CHECK_EQ(getSourceModels().size(), size_t(1));
     std::set<uint32_t> ret;
@@ -2132,18 +2465,46 @@ void ExecutionPlan::forEachDynamicTemporary(
     }
 }
 
+namespace {
+
+// Returns the number of distinct models in the tree of models referenced by model, itself included.
+size_t countModelTree(const ModelBuilder* model) {
+    std::set<const ModelBuilder*> models = {model};
+    std::vector<const ModelBuilder*> pending = {model};
+    while (!pending.empty()) {
+        const ModelBuilder* next = pending.back();
+        pending.pop_back();
+        for (uint32_t i = 0; i < next->referencedModelCount(); ++i) {
+            const ModelBuilder* referencedModel = next->getReferencedModel(i);
+            if (models.insert(referencedModel).second) {
+                pending.push_back(referencedModel);
+            }
+        }
+    }
+    return models.size();
+}
+
+}  // anonymous namespace
+
 int ModelBuilder::partitionTheWork(const std::vector<std::shared_ptr<Device>>& devices,
                                    uint32_t preference, uint32_t priority,
                                    const OptionalTimePoint& deadline, ExecutionPlan* plan,
                                    const std::vector<TokenValuePair>& metaData,
-                                   int simulateFailureResultCode) const {
+                                   int simulateFailureResultCode, PerformanceProfile* profile,
+                                   bool minimizeCost, bool cachePerformance) const {
     uint32_t sourceModelIndex = plan->getSourceModels().addModel(this);
+    if (referencedModelCount() > 0) {
+        // Each model of the tree is looked up in turn, and must not evict the others.
+        SupportedOperationsMemo::get()->reserve(countModelTree(this));
+    }
+    PerformanceCache performanceCache = {.enabled = cachePerformance};
     NN_RETURN_IF_ERROR(partitionTheWorkInternal(sourceModelIndex, devices, preference, priority,
-                                                deadline, plan));
+                                                deadline, plan, &performanceCache, profile,
+                                                minimizeCost));
     int n = plan->finish(preference, priority, deadline, metaData, simulateFailureResultCode);
     if (VLOG_IS_ON(COMPILATION)) {
         VLOG(COMPILATION) << "ModelBuilder::partitionTheWork: source model: ";
-        logModelToInfo(makeModel());
+        logModelToInfo(*makeSharedModel());
         plan->dump();
     }
     return n;
@@ -2153,7 +2514,9 @@ int ModelBuilder::partitionTheWorkInternal(uint32_t sourceModelIndex,
                                            const std::vector<std::shared_ptr<Device>>& devices,
                                            uint32_t preference, uint32_t priority,
                                            const OptionalTimePoint& deadline,
-                                           ExecutionPlan* plan) const {
+                                           ExecutionPlan* plan,
+                                           PerformanceCache* performanceCache,
+                                           PerformanceProfile* profile, bool minimizeCost) const {
     // This function uses a heuristic approach to partitioning the graph.
     // It should be good enough for the first release.
 
@@ -2169,8 +2532,9 @@ int ModelBuilder::partitionTheWorkInternal(uint32_t sourceModelIndex,
     // Figure out where each operation will best execute.
     // The value of the vector is the index in the devices vector.
     std::vector<int> bestDeviceForOperation(operationCount);
-    NN_RETURN_IF_ERROR(
-            findBestDeviceForEachOperation(preference, devices, &bestDeviceForOperation));
+    NN_RETURN_IF_ERROR(findBestDeviceForEachOperation(preference, devices, performanceCache,
+                                                      profile, minimizeCost,
+                                                      &bestDeviceForOperation));
 
     // A special value produced by findBestDeviceForEachOperation meaning that
     // this is a control flow operation scheduled for interpreted execution
@@ -2292,11 +2656,13 @@ int ModelBuilder::partitionTheWorkInternal(uint32_t sourceModelIndex,
                             sourceModelIndex, operation.inputs[op::kCondBoolOperand]);
                     ifStep->thenStepIndex = plan->getNextStepIndex();
                     NN_RETURN_IF_ERROR(thenModel->partitionTheWorkInternal(
-                            thenModelIndex, devices, preference, priority, deadline, plan));
+                            thenModelIndex, devices, preference, priority, deadline, plan,
+                            performanceCache, /*profile=*/nullptr, minimizeCost));
                     GotoStep* afterThenBranch = plan->createNewGotoStep();
                     ifStep->elseStepIndex = plan->getNextStepIndex();
                     NN_RETURN_IF_ERROR(elseModel->partitionTheWorkInternal(
-                            elseModelIndex, devices, preference, priority, deadline, plan));
+                            elseModelIndex, devices, preference, priority, deadline, plan,
+                            performanceCache, /*profile=*/nullptr, minimizeCost));
                     afterThenBranch->gotoStepIndex = plan->getNextStepIndex();
 
                     // Outer model operands.
@@ -2350,12 +2716,14 @@ int ModelBuilder::partitionTheWorkInternal(uint32_t sourceModelIndex,
                     WhileStep* whileStep = plan->createNewWhileStep();
                     whileStep->condStepIndex = plan->getNextStepIndex();
                     NN_RETURN_IF_ERROR(condModel->partitionTheWorkInternal(
-                            condModelIndex, devices, preference, priority, deadline, plan));
+                            condModelIndex, devices, preference, priority, deadline, plan,
+                            performanceCache, /*profile=*/nullptr, minimizeCost));
                     GotoStep* afterCond = plan->createNewGotoStep();
                     afterCond->gotoStepIndex = whileStep->index;
                     whileStep->bodyStepIndex = plan->getNextStepIndex();
                     NN_RETURN_IF_ERROR(bodyModel->partitionTheWorkInternal(
-                            bodyModelIndex, devices, preference, priority, deadline, plan));
+                            bodyModelIndex, devices, preference, priority, deadline, plan,
+                            performanceCache, /*profile=*/nullptr, minimizeCost));
                     GotoStep* afterBody = plan->createNewGotoStep();
                     afterBody->gotoStepIndex = whileStep->index;
                     whileStep->exitStepIndex = plan->getNextStepIndex();
@@ -2395,73 +2763,93 @@ int ModelBuilder::partitionTheWorkInternal(uint32_t sourceModelIndex,
     return ANEURALNETWORKS_NO_ERROR;
 }
 
-float ModelBuilder::getPerformance(uint32_t preference,
-                                   const std::shared_ptr<Device> device) const {
+float ModelBuilder::getPerformance(uint32_t preference, const std::shared_ptr<Device> device,
+                                   PerformanceCache* performanceCache) const {
     // Note that we will call this method multiple times per compilation with
     // the same arguments if there are nested control flow operations and we
     // decide to execute the outer operation on the ExecutionPlan::next()
-    // interpreter.
-    //
-    // This is a potential compilation performance problem. To work around it,
-    // the performance value could be cached for the duration of a compilation.
+    // interpreter, so the value is cached for the duration of the compilation.
+    const auto key = std::make_pair(this, device.get());
+    if (const auto it = performanceCache->models.find(key);
+        performanceCache->enabled && it != performanceCache->models.end()) {
+        return it->second;
+    }
     float perf = 0;
     const size_t operationCount = mOperations.size();
     for (size_t operationIndex = 0; operationIndex < operationCount; operationIndex++) {
-        perf += getPerformance(preference, device, operationIndex);
+        perf += getPerformance(preference, device, operationIndex, performanceCache);
+    }
+    if (performanceCache->enabled) {
+        performanceCache->models.emplace(key, perf);
     }
     return perf;
 }
 
 float ModelBuilder::getPerformance(uint32_t preference, const std::shared_ptr<Device> device,
-                                   uint32_t operationIndex) const {
+                                   uint32_t operationIndex,
+                                   PerformanceCache* performanceCache) const {
+    const auto key = std::make_tuple(this, device.get(), operationIndex);
+    if (const auto it = performanceCache->operations.find(key);
+        performanceCache->enabled && it != performanceCache->operations.end()) {
+        return it->second;
+    }
+
     auto applyPreference = [preference](const Capabilities::PerformanceInfo& perf) {
         return preference == ANEURALNETWORKS_PREFER_LOW_POWER ? perf.powerUsage : perf.execTime;
     };
 
-    const Operation& operation = getOperation(operationIndex);
+    auto computePerformance = [&]() -> float {
+        const Operation& operation = getOperation(operationIndex);
 
-    if (operation.type == OperationType::IF) {
-        namespace op = operation_if;
-        const Operand& thenOperand = getOperand(operation.inputs[op::kThenModelOperand]);
-        const Operand& elseOperand = getOperand(operation.inputs[op::kElseModelOperand]);
-        const ModelBuilder* thenModel = getReferencedModel(thenOperand);
-        const ModelBuilder* elseModel = getReferencedModel(elseOperand);
-        return applyPreference(device->getIfPerformance()) +
-               0.5 * (thenModel->getPerformance(preference, device) +
-                      elseModel->getPerformance(preference, device));
-    }
+        if (operation.type == OperationType::IF) {
+            namespace op = operation_if;
+            const Operand& thenOperand = getOperand(operation.inputs[op::kThenModelOperand]);
+            const Operand& elseOperand = getOperand(operation.inputs[op::kElseModelOperand]);
+            const ModelBuilder* thenModel = getReferencedModel(thenOperand);
+            const ModelBuilder* elseModel = getReferencedModel(elseOperand);
+            return applyPreference(device->getIfPerformance()) +
+                   0.5 * (thenModel->getPerformance(preference, device, performanceCache) +
+                          elseModel->getPerformance(preference, device, performanceCache));
+        }
 
-    if (operation.type == OperationType::WHILE) {
-        namespace op = operation_while;
-        const Operand& condOperand = getOperand(operation.inputs[op::kCondModelOperand]);
-        const Operand& bodyOperand = getOperand(operation.inputs[op::kBodyModelOperand]);
-        const ModelBuilder* condModel = getReferencedModel(condOperand);
-        const ModelBuilder* bodyModel = getReferencedModel(bodyOperand);
-        return applyPreference(device->getWhilePerformance()) +
-               condModel->getPerformance(preference, device) +
-               bodyModel->getPerformance(preference, device);
-    }
-
-    // TODO This assumes that the type is dictated by the first operand. This is
-    // currently the case but is not a safe assumption to make in the long term.
-    const uint32_t operandIndex = operation.inputs[0];
-    const OperandType operandType = mOperands[operandIndex].type;
-    switch (operandType) {
-        case OperandType::FLOAT32:
-            if (mRelaxComputationFloat32toFloat16) {
-                return applyPreference(device->getRelaxedFloat32toFloat16PerformanceScalar());
-            }
-            break;
-        case OperandType::TENSOR_FLOAT32:
-            if (mRelaxComputationFloat32toFloat16) {
-                return applyPreference(device->getRelaxedFloat32toFloat16PerformanceTensor());
-            }
-            break;
-        default:
-            break;
-    }
+        if (operation.type == OperationType::WHILE) {
+            namespace op = operation_while;
+            const Operand& condOperand = getOperand(operation.inputs[op::kCondModelOperand]);
+            const Operand& bodyOperand = getOperand(operation.inputs[op::kBodyModelOperand]);
+            const ModelBuilder* condModel = getReferencedModel(condOperand);
+            const ModelBuilder* bodyModel = getReferencedModel(bodyOperand);
+            return applyPreference(device->getWhilePerformance()) +
+                   condModel->getPerformance(preference, device, performanceCache) +
+                   bodyModel->getPerformance(preference, device, performanceCache);
+        }
+
+        // TODO This assumes that the type is dictated by the first operand. This is
+        // currently the case but is not a safe assumption to make in the long term.
+        const uint32_t operandIndex = operation.inputs[0];
+        const OperandType operandType = mOperands[operandIndex].type;
+        switch (operandType) {
+            case OperandType::FLOAT32:
+                if (mRelaxComputationFloat32toFloat16) {
+                    return applyPreference(device->getRelaxedFloat32toFloat16PerformanceScalar());
+                }
+                break;
+            case OperandType::TENSOR_FLOAT32:
+                if (mRelaxComputationFloat32toFloat16) {
+                    return applyPreference(device->getRelaxedFloat32toFloat16PerformanceTensor());
+                }
+                break;
+            default:
+                break;
+        }
 
-    return applyPreference(device->getPerformance(operandType));
+        return applyPreference(device->getPerformance(operandType));
+    };
+
+    const float perf = computePerformance();
+    if (performanceCache->enabled) {
+        performanceCache->operations.emplace(key, perf);
+    }
+    return perf;
 }
 
 bool ModelBuilder::isControlFlowOperationWithOperandOfUnknownSize(uint32_t operationIndex) const {
@@ -2523,8 +2911,8 @@ class CanDo {
    public:
     CanDo() {}
 
-    void initialize(const MetaModel& metaModel, std::shared_ptr<Device> device) {
-        mSupportsOperationByIndex = device->getSupportedOperations(metaModel);
+    void initialize(std::vector<bool> supportsOperationByIndex) {
+        mSupportsOperationByIndex = std::move(supportsOperationByIndex);
     }
 
     bool check(size_t operationIndex) const { return mSupportsOperationByIndex[operationIndex]; }
@@ -2537,14 +2925,86 @@ class CanDo {
 
 int ModelBuilder::findBestDeviceForEachOperation(
         uint32_t preference, const std::vector<std::shared_ptr<Device>>& devices,
+        PerformanceCache* performanceCache, PerformanceProfile* profile, bool minimizeCost,
         std::vector<int>* bestDeviceForOperation) const {
-    const MetaModel metaModel(makeModel(), DeviceManager::get()->strictSlicing());
+    // What a device supports is remembered across compilations of this model, and of other models
+    // with the same key, so the model is only made and sliced for the devices that have not been
+    // asked about it yet. The key is only computed for a device this model has not asked.
+    std::optional<MetaModel> metaModel;
+    auto getSupportedOperations = [&](const std::shared_ptr<Device>& device) {
+        if (auto supported = findSupportedOperations(device)) {
+            return std::move(*supported);
+        }
+        const std::optional<SupportedOperationsMemo::ModelKey> modelKey =
+                getSupportedOperationsKey();
+        std::optional<std::vector<bool>> supported;
+        if (modelKey.has_value()) {
+            supported = SupportedOperationsMemo::get()->lookup(*modelKey, device);
+        }
+        if (!supported.has_value()) {
+            if (!metaModel.has_value()) {
+                metaModel.emplace(*makeSharedModel(), DeviceManager::get()->strictSlicing());
+            }
+            supported = device->getSupportedOperations(*metaModel);
+            if (modelKey.has_value()) {
+                SupportedOperationsMemo::get()->insert(*modelKey, device, *supported);
+            }
+        }
+        rememberSupportedOperations(device, *supported);
+        return std::move(*supported);
+    };
 
     const size_t deviceCount = devices.size();
     std::vector<CanDo> canDo(deviceCount);
     for (size_t deviceIndex = 0; deviceIndex < deviceCount; deviceIndex++) {
-        canDo[deviceIndex].initialize(metaModel, devices[deviceIndex]);
+        canDo[deviceIndex].initialize(getSupportedOperations(devices[deviceIndex]));
+    }
+
+    // With samples in the profile, costs are in nanoseconds and include the time to move the
+    // inputs of an operation to its device. This relies on mOperations being in run order (see
+    // sortIntoRunOrder()), so that the device of an operation defining an input is known.
+    const std::optional<float> nanosPerEstimate =
+            profile != nullptr ? profile->getNanosPerEstimate() : std::nullopt;
+    std::vector<int> operandToDefiningOperation;
+    if (nanosPerEstimate.has_value()) {
+        operandToDefiningOperation.resize(mOperands.size(), -1);
+        for (uint32_t operationIndex = 0; operationIndex < mOperations.size(); ++operationIndex) {
+            for (uint32_t operandIndex : mOperations[operationIndex].outputs) {
+                operandToDefiningOperation[operandIndex] = operationIndex;
+            }
+        }
     }
+    auto getTransferNanos = [&](uint32_t operationIndex, const Device& device) {
+        const Operation& operation = getOperation(operationIndex);
+        float nanos = 0.0f;
+        for (uint32_t operandIndex : operation.inputs) {
+            const Operand& operand = mOperands[operandIndex];
+            const uint32_t size = TypeManager::get()->getSizeOfData(operand);
+            if (operand.lifetime == Operand::LifeTime::SUBGRAPH_INPUT) {
+                nanos += PerformanceProfile::getTransferNanos(device, size);
+            } else if (operand.lifetime == Operand::LifeTime::TEMPORARY_VARIABLE) {
+                const int definingOperation = operandToDefiningOperation[operandIndex];
+                CHECK_GE(definingOperation, 0);
+                const size_t definingDeviceIndex = (*bestDeviceForOperation)[definingOperation];
+                // The control flow interpreter leaves its outputs in memory of the CPU.
+                const Device& definingDevice = definingDeviceIndex < deviceCount
+                                                       ? *devices[definingDeviceIndex]
+                                                       : *DeviceManager::getCpuDevice();
+                if (&definingDevice != &device) {
+                    nanos += PerformanceProfile::getTransferNanos(definingDevice, size) +
+                             PerformanceProfile::getTransferNanos(device, size);
+                }
+            }
+        }
+        for (uint32_t operandIndex : operation.outputs) {
+            const Operand& operand = mOperands[operandIndex];
+            if (operand.lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT) {
+                nanos += PerformanceProfile::getTransferNanos(
+                        device, TypeManager::get()->getSizeOfData(operand));
+            }
+        }
+        return nanos;
+    };
 
     // Figure out the best driver for each operation.
     const size_t operationCount = mOperations.size();
@@ -2570,7 +3030,16 @@ int ModelBuilder::findBestDeviceForEachOperation(
             for (size_t deviceIndex = 0; deviceIndex < deviceCount; deviceIndex++) {
                 const auto& device = devices[deviceIndex];
                 if (canDo[deviceIndex].check(operationIndex)) {
-                    const float perfVal = getPerformance(preference, device, operationIndex);
+                    float perfVal =
+                            getPerformance(preference, device, operationIndex, performanceCache);
+                    if (profile != nullptr) {
+                        profile->setEstimate(*device, operationIndex, perfVal);
+                    }
+                    if (nanosPerEstimate.has_value()) {
+                        perfVal = profile->getOperationNanos(*device, operationIndex)
+                                          .value_or(perfVal * *nanosPerEstimate) +
+                                  getTransferNanos(operationIndex, *device);
+                    }
                     const bool deviceIsPreferred = (device == DeviceManager::getCpuDevice());
                     if (bestChoice < 0 || perfVal < bestPerfVal ||
                         (perfVal == bestPerfVal && deviceIsPreferred)) {
@@ -2607,8 +3076,174 @@ int ModelBuilder::findBestDeviceForEachOperation(
                               << devices[bestChoice]->getName() << ")";
         }
     }
+
+    // Moving operands is costed in time, which cannot be weighed against the power estimates used
+    // for ANEURALNETWORKS_PREFER_LOW_POWER.
+    if (minimizeCost && preference != ANEURALNETWORKS_PREFER_LOW_POWER) {
+        minimizePartitioningCost(
+                preference, devices, performanceCache,
+                nanosPerEstimate.has_value() ? profile : nullptr,
+                [&canDo](uint32_t operationIndex, size_t deviceIndex) {
+                    return canDo[deviceIndex].check(operationIndex);
+                },
+                bestDeviceForOperation);
+    }
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+void ModelBuilder::minimizePartitioningCost(
+        uint32_t preference, const std::vector<std::shared_ptr<Device>>& devices,
+        PerformanceCache* performanceCache, const PerformanceProfile* profile,
+        const std::function<bool(uint32_t operationIndex, size_t deviceIndex)>& canDo,
+        std::vector<int>* bestDeviceForOperation) const {
+    // Finding the assignment of operations to devices with the least total cost is a multiway
+    // cut problem, which is NP-hard for more than two devices. Instead, starting from the
+    // assignment of each operation to its individually best device, this repeatedly moves single
+    // operations to the device that lowers the total cost the most, until no move helps.
+
+    // Without a profile, a static performance estimate of 1.0 (the CPU) is taken to mean this
+    // many nanoseconds, so that it can be weighed against the cost of moving operands. Neither this
+    // nor the cost of moving a byte (see PerformanceProfile::getTransferNanos()) is reported by
+    // drivers; both are rough guesses.
+    constexpr float kNanosPerEstimateWithoutProfile = 10000.0f;
+    // Every pass that moves an operation lowers the total cost, so this only bounds the time spent
+    // on models where many small moves are possible.
+    constexpr int kMaxPasses = 8;
+    // The static estimates must be execution times to be scaled to nanoseconds.
+    CHECK_NE(preference, static_cast<uint32_t>(ANEURALNETWORKS_PREFER_LOW_POWER));
+
+    const size_t deviceCount = devices.size();
+    const size_t operationCount = mOperations.size();
+    const int kControlFlowInterpreter = deviceCount;
+    const float nanosPerEstimate =
+            (profile != nullptr ? profile->getNanosPerEstimate() : std::nullopt)
+                    .value_or(kNanosPerEstimateWithoutProfile);
+
+    // The cost of each operation on each device, infinite if the device cannot run it.
+    std::vector<std::vector<float>> operationNanos(
+            operationCount,
+            std::vector<float>(deviceCount, std::numeric_limits<float>::infinity()));
+    for (uint32_t operationIndex = 0; operationIndex < operationCount; ++operationIndex) {
+        for (size_t deviceIndex = 0; deviceIndex < deviceCount; ++deviceIndex) {
+            if (!canDo(operationIndex, deviceIndex)) {
+                continue;
+            }
+            const Device& device = *devices[deviceIndex];
+            const std::optional<float> measured =
+                    profile != nullptr ? profile->getOperationNanos(device, operationIndex)
+                                       : std::nullopt;
+            operationNanos[operationIndex][deviceIndex] = measured.value_or(
+                    getPerformance(preference, devices[deviceIndex], operationIndex,
+                                   performanceCache) *
+                    nanosPerEstimate);
+        }
+    }
+
+    std::vector<int> operandToDefiningOperation(mOperands.size(), -1);
+    std::vector<std::vector<uint32_t>> operandToReadingOperations(mOperands.size());
+    for (uint32_t operationIndex = 0; operationIndex < operationCount; ++operationIndex) {
+        const Operation& operation = mOperations[operationIndex];
+        for (uint32_t operandIndex : operation.inputs) {
+            auto& readers = operandToReadingOperations[operandIndex];
+            if (readers.empty() || readers.back() != operationIndex) {
+                readers.push_back(operationIndex);
+            }
+        }
+        for (uint32_t operandIndex : operation.outputs) {
+            operandToDefiningOperation[operandIndex] = operationIndex;
+        }
+    }
+
+    // The control flow interpreter leaves its outputs in memory of the CPU.
+    const Device* cpuDevice = DeviceManager::getCpuDevice().get();
+    auto getDevice = [&](uint32_t operationIndex) {
+        const int deviceIndex = (*bestDeviceForOperation)[operationIndex];
+        return deviceIndex == kControlFlowInterpreter ? cpuDevice : devices[deviceIndex].get();
+    };
+
+    // The cost of moving an operand from the device of the operation defining it, or from client
+    // memory for a model input, to the devices of the operations reading it, and of moving a
+    // model output to client memory.
+    auto getOperandTransferNanos = [&](uint32_t operandIndex) {
+        const Operand& operand = mOperands[operandIndex];
+        if (operand.lifetime != Operand::LifeTime::SUBGRAPH_INPUT &&
+            operand.lifetime != Operand::LifeTime::TEMPORARY_VARIABLE &&
+            operand.lifetime != Operand::LifeTime::SUBGRAPH_OUTPUT) {
+            return 0.0f;
+        }
+        const uint32_t size = TypeManager::get()->getSizeOfData(operand);
+        const int definingOperation = operandToDefiningOperation[operandIndex];
+        const Device* definingDevice = definingOperation >= 0 ? getDevice(definingOperation)
+                                                              : nullptr;
+        std::set<const Device*> readingDevices;
+        for (uint32_t operationIndex : operandToReadingOperations[operandIndex]) {
+            readingDevices.insert(getDevice(operationIndex));
+        }
+        float nanos = 0.0f;
+        bool leavesDefiningDevice = operand.lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT;
+        for (const Device* device : readingDevices) {
+            if (device != definingDevice) {
+                nanos += PerformanceProfile::getTransferNanos(*device, size);
+                leavesDefiningDevice = true;
+            }
+        }
+        if (definingDevice != nullptr && leavesDefiningDevice) {
+            nanos += PerformanceProfile::getTransferNanos(*definingDevice, size);
+        }
+        return nanos;
+    };
+
+    // The part of the total cost that depends on the device of the operation.
+    auto getOperationCost = [&](uint32_t operationIndex) {
+        const Operation& operation = mOperations[operationIndex];
+        float nanos = operationNanos[operationIndex][(*bestDeviceForOperation)[operationIndex]];
+        for (uint32_t operandIndex : operation.inputs) {
+            nanos += getOperandTransferNanos(operandIndex);
+        }
+        for (uint32_t operandIndex : operation.outputs) {
+            nanos += getOperandTransferNanos(operandIndex);
+        }
+        return nanos;
+    };
+
+    for (int pass = 0; pass < kMaxPasses; ++pass) {
+        bool moved = false;
+        for (uint32_t operationIndex = 0; operationIndex < operationCount; ++operationIndex) {
+            // Control flow operations stay where findBestDeviceForEachOperation() put them, as
+            // only the CPU or the interpreter may be able to run them.
+            const Operation& operation = mOperations[operationIndex];
+            if (operation.type == OperationType::IF || operation.type == OperationType::WHILE) {
+                continue;
+            }
+            int& deviceIndex = (*bestDeviceForOperation)[operationIndex];
+            const int initialDeviceIndex = deviceIndex;
+            int bestDeviceIndex = initialDeviceIndex;
+            float bestNanos = getOperationCost(operationIndex);
+            for (size_t candidate = 0; candidate < deviceCount; ++candidate) {
+                if (static_cast<int>(candidate) == initialDeviceIndex ||
+                    std::isinf(operationNanos[operationIndex][candidate])) {
+                    continue;
+                }
+                deviceIndex = candidate;
+                const float nanos = getOperationCost(operationIndex);
+                if (nanos < bestNanos) {
+                    bestDeviceIndex = candidate;
+                    bestNanos = nanos;
+                }
+            }
+            deviceIndex = bestDeviceIndex;
+            if (bestDeviceIndex != initialDeviceIndex) {
+                moved = true;
+                VLOG(COMPILATION) << "ModelBuilder::minimizePartitioningCost(" << operation.type
+                                  << ":" << operationIndex << ") = " << bestDeviceIndex << " ("
+                                  << devices[bestDeviceIndex]->getName() << ")";
+            }
+        }
+        if (!moved) {
+            break;
+        }
+    }
+}
+
 }  // namespace nn
 }  // namespace android
@@ -22,6 +22,7 @@
 #include <LegacyUtils.h>
 #include <TokenHasher.h>
 #include <android-base/logging.h>
+#include <android-base/thread_annotations.h>
 #include <nnapi/IBurst.h>
 #include <nnapi/Types.h>
 
@@ -30,6 +31,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <set>
 #include <string>
@@ -267,6 +269,10 @@ class ExecutionStep {
 
     uint32_t getIndex() const { return mIndex; }
     uint32_t getSourceModelIndex() const { return mSourceModelIndex; }
+    // Indexes of the source model operations of this step, in the order they were added.
+    const std::vector<uint32_t>& getSourceOperationIndexes() const {
+        return mSourceOperationIndexes;
+    }
 
     void declareModelOutputIsDownstreamInput(uint32_t mainModelOutputIndex);
     void recordTempAsStepModelOutput(uint32_t stepOperandIndex);
@@ -274,13 +280,19 @@ class ExecutionStep {
     // If this step has a step model output of unknown size, sets
     // *hasOutputOfUnknownSize to true; otherwise, leaves it
     // unchanged.
-    int finishStepModel(const ModelBuilder* mainModel, bool* hasOutputOfUnknownSize,
-                        int32_t executionPreference, int32_t priority);
+    int finishStepModel(const ModelBuilder* mainModel, bool* hasOutputOfUnknownSize);
+
+    // Prepares the step model on the device. Must only be called after
+    // finishStepModel() succeeded. Steps can be compiled concurrently.
+    int compileStepModel(int32_t executionPreference, int32_t priority);
+
+    // Drops what compileStepModel() prepared.
+    void releasePreparedStepModel() { mPreparedStepModel = nullptr; }
 
     const ModelBuilder* getStepModel() const { return &mStepModel; }
     std::shared_ptr<Device> getDevice() const { return mDevice; }
 
-    // only available after calling finishStepModel()
+    // only available after calling compileStepModel()
     std::shared_ptr<RuntimePreparedModel> getPreparedStepModel() const {
         return mPreparedStepModel;
     }
@@ -325,6 +337,7 @@ class ExecutionStep {
     uint32_t mIndex;  // index of step within plan
     uint32_t mSourceModelIndex;
     ModelBuilder mStepModel;  // An excerpt of a source model to be run by one device.
+    std::vector<uint32_t> mSourceOperationIndexes;
     std::shared_ptr<Device> mDevice;
     std::shared_ptr<RuntimePreparedModel> mPreparedStepModel;
 
@@ -590,6 +603,11 @@ class ExecutionPlan {
     class Controller {
         friend class ExecutionPlan;
 
+       public:
+        // Returns the memory of the static temporaries to the pool of the ExecutionPlan if
+        // mRecycleTemporaries is set.
+        ~Controller();
+
        private:
         Controller(const Controller&) = delete;
         Controller& operator=(const Controller&) = delete;
@@ -601,7 +619,7 @@ class ExecutionPlan {
                    const BurstBuilder* burstBuilder,
 
                    // static temporaries
-                   uint32_t totalSizeOfTemporaries,
+                   uint32_t totalSizeOfTemporaries, bool recycleTemporaries,
                    std::map<SourceOperandIndex, StaticTemporaryLocation>
                            sourceOperandToLocationOfTemporary,
                    std::map<SourceOperandIndex, StaticTemporaryLocation>
@@ -627,7 +645,7 @@ class ExecutionPlan {
         // does not generate a sync fence.
         int waitForLastStepSyncFence() const;
 
-        [[maybe_unused]] const ExecutionPlan* mPlan;
+        const ExecutionPlan* mPlan;
         ExecutionBuilder* mExecutionBuilder;
         const BurstBuilder* mBurstBuilder;
         // Map from source operand index to an offset into mTemporaries used
@@ -659,6 +677,8 @@ class ExecutionPlan {
 
         // static temporaries
         std::unique_ptr<MemoryAshmem> mTemporaries;
+        // Whether mTemporaries can be reused by another Controller once this one is destroyed.
+        bool mRecycleTemporaries;
 
         DynamicTemporaries mDynamicTemporaries;
 
@@ -675,8 +695,13 @@ class ExecutionPlan {
     std::vector<SharedBurst> makeBursts() const;
 
     // Only legal to call when mState == COMPOUND.
+    // If recycleTemporaries is true, the memory of the static temporaries of the Controller is
+    // taken from a pool shared by the executions of this plan, and returned to the pool when the
+    // Controller is destroyed. The caller must then ensure that no step is still accessing the
+    // temporaries when it releases the Controller, which is not the case for fenced executions.
     std::shared_ptr<Controller> makeController(ExecutionBuilder* executionBuilder,
-                                               const BurstBuilder* burstBuilder) const;
+                                               const BurstBuilder* burstBuilder,
+                                               bool recycleTemporaries) const;
 
     // Sets up a new StepExecutor and burstController (if applicable) if there
     // is a step to execute. See ExecutionPlan::Controller.
@@ -690,6 +715,28 @@ class ExecutionPlan {
              SharedBurst* burstController, const std::vector<OutputShape>* mainModelOutputShapes,
              int syncFdOfLastStep = -1) const;
 
+    // Returns true if this plan records the dependencies between its steps, so that its steps may
+    // run out of the order of next(). This is only the case for a compound plan with no control
+    // flow and no dynamic temporaries, whose steps are all ExecutionSteps.
+    bool hasStepDependencies() const;
+
+    // Returns true if steps of this plan may run concurrently, as allowed by
+    // getStepDependencies().
+    bool canRunStepsConcurrently() const;
+
+    // For each step, the indexes of the steps that must complete before it may start.
+    // Only legal to call when hasStepDependencies() returns true.
+    const std::vector<std::vector<uint32_t>>& getStepDependencies() const;
+
+    // Sets up a new StepExecutor and burstController (if applicable) for the step with the given
+    // index, without regard to the steps processed by next(). Used to run steps concurrently, once
+    // the steps returned by getStepDependencies() have completed, to pipeline steps across
+    // executions, and to fall back to the CPU for such a step.
+    // Only legal to call when hasStepDependencies() returns true.
+    int makeStepExecutor(std::shared_ptr<Controller> controller, uint32_t stepIndex,
+                         std::shared_ptr<StepExecutor>* executor, SharedBurst* burstController,
+                         const std::vector<OutputShape>* mainModelOutputShapes) const;
+
     // Create the same executor as the last one created by next().
     int fallback(std::shared_ptr<Controller> controller, std::shared_ptr<StepExecutor>* executor,
                  SharedBurst* burstController,
@@ -769,6 +816,9 @@ class ExecutionPlan {
     Kind forTest_getKind() const;
     std::shared_ptr<const Device> forTest_simpleGetDevice() const;
     const std::vector<std::shared_ptr<LogicalStep>>& forTest_compoundGetSteps() const;
+    const std::map<SourceOperandIndex, StaticTemporaryLocation>&
+    forTest_compoundGetLocationsOfTemporaries() const;
+    uint32_t forTest_compoundGetTotalSizeOfTemporaries() const;
     void forTest_compoundForEachStepRoleOfSourceOperand(SourceOperandIndex index,
                                                         const StepRoleCallback& callback) const {
         compound()->forEachStepRoleOfSourceOperand(index, callback);
@@ -819,6 +869,9 @@ class ExecutionPlan {
     int nextCompound(const ExecutionStep* step, std::shared_ptr<Controller> controller,
                      std::shared_ptr<StepExecutor>* executor, SharedBurst* burstController,
                      const std::vector<OutputShape>* mainModelOutputShapes) const;
+    int makeStepExecutor(const ExecutionStep* step, std::shared_ptr<Controller> controller,
+                         std::shared_ptr<StepExecutor>* executor, SharedBurst* burstController,
+                         const std::vector<OutputShape>* mainModelOutputShapes) const;
     int nextCompound(const IfStep* step, std::shared_ptr<Controller> controller,
                      std::shared_ptr<StepExecutor>* executor, SharedBurst* burstController,
                      const std::vector<OutputShape>* mainModelOutputShapes) const;
@@ -938,6 +991,23 @@ class ExecutionPlan {
         // does not have any ExecutionStep role (this may happen with interpreted control flow).
         std::map<SourceOperandIndex, std::set<StepRole>> mSourceOperandToStepRoles;
 
+        // Layout of the static temporaries in ExecutionPlan::Controller::mTemporaries, used to
+        // initialize the similarly named fields of ExecutionPlan::Controller. Temporaries that are
+        // never live during the same step may share memory, so mTotalSizeOfTemporaries can be
+        // less than the sum of the sizes of the temporaries.
+        uint32_t mTotalSizeOfTemporaries = 0;
+        std::map<SourceOperandIndex, StaticTemporaryLocation> mSourceOperandToLocationOfTemporary;
+        std::map<SourceOperandIndex, StaticTemporaryLocation> mSourceOperandToLocationOfTemporary2;
+
+        // For each step, the indexes of the earlier steps that must complete before it may start:
+        // the steps defining the temporaries and main model outputs that it reads, and the steps
+        // accessing temporaries that share memory with the temporaries that it defines.
+        // Only set if the plan has no control flow and no dynamic temporaries.
+        std::vector<std::vector<uint32_t>> mStepDependencies;
+
+        // True if mStepDependencies allows some step to run concurrently with the step before it.
+        bool mHasIndependentSteps = false;
+
         bool mHasDynamicTemporaries = false;
 
        private:
@@ -966,6 +1036,15 @@ class ExecutionPlan {
         // This method will set mSourceOperandToStepRoles.
         void findMemoryStepRoles();
 
+        // Assigns a location to every static temporary from the steps that define and read it.
+        // This method will set mTotalSizeOfTemporaries, mSourceOperandToLocationOfTemporary, and
+        // mSourceOperandToLocationOfTemporary2.
+        void findTemporaryLayout(const SourceModels* sourceModels);
+
+        // This method will set mStepDependencies and mHasIndependentSteps. It must be called
+        // after findTemporaryLayout().
+        void findStepDependencies();
+
         const ExecutionPlan* mPlan;
     };
 
@@ -995,11 +1074,25 @@ class ExecutionPlan {
     void forEachDynamicTemporary(const std::function<void(SourceOperandIndex, const Operand&,
                                                           uint32_t definingStepIndex)>&) const;
 
+    // Returns a memory of at least size bytes for the static temporaries of a Controller, from
+    // mTemporaryMemories if possible. Returns nullptr if a memory cannot be allocated.
+    std::unique_ptr<MemoryAshmem> acquireTemporaryMemory(uint32_t size) const;
+
+    // Makes a memory returned by acquireTemporaryMemory available to later Controllers.
+    void releaseTemporaryMemory(std::unique_ptr<MemoryAshmem> memory) const;
+
     // Pointers to compilation caching information in CompilationBuilder.
     const CacheInfo* mCacheInfo = nullptr;
     const uint8_t* mToken = nullptr;
 
     SourceModels mSourceModels;
+
+    // Memories for the static temporaries of Controllers, released by Controllers that are done
+    // with them. Keeping them lets a steady stream of executions run without allocating and
+    // mapping new shared memory for each one.
+    mutable std::mutex mTemporaryMemoriesMutex;
+    mutable std::vector<std::unique_ptr<MemoryAshmem>> mTemporaryMemories
+            GUARDED_BY(mTemporaryMemoriesMutex);
 };
 
 inline std::ostream& operator<<(std::ostream& out, ExecutionPlan::Kind kind) {
@@ -962,6 +962,7 @@ class CpuPreparedModel : public RuntimePreparedModel {
 
     const Model& getModel() const { return mModel; }
     const std::vector<RunTimePoolInfo>& getModelPoolInfos() const { return mModelPoolInfos; }
+    OperationStateCache* getOperationStateCache() const { return &mOperationStateCache; }
 
    private:
     // TFLite kernels prefers 64 bytes for padding and alignment.
@@ -970,6 +971,8 @@ class CpuPreparedModel : public RuntimePreparedModel {
 
     const Model mModel;
     const std::vector<RunTimePoolInfo> mModelPoolInfos;
+    // State derived from mModel by CPU operations, shared by all executions.
+    mutable OperationStateCache mOperationStateCache;
 };
 
 class CpuExecution : public RuntimeExecution {
@@ -1072,8 +1075,7 @@ std::pair<int, std::shared_ptr<RuntimePreparedModel>> CpuPreparedModel::create(M
 }
 
 static std::tuple<int, std::vector<OutputShape>, Timing> computeOnCpu(
-        const Model& model, const Request& request,
-        const std::vector<RunTimePoolInfo>& modelPoolInfos,
+        const CpuPreparedModel& preparedModel, const Request& request,
         const std::vector<RunTimePoolInfo>& requestPoolInfos, const OptionalTimePoint& deadline,
         const OptionalDuration& loopTimeoutDuration) {
     NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "computeOnCpu");
@@ -1084,7 +1086,9 @@ static std::tuple<int, std::vector<OutputShape>, Timing> computeOnCpu(
     if (deadline.has_value()) {
         executor.setDeadline(*deadline);
     }
-    int err = executor.run(model, request, modelPoolInfos, requestPoolInfos);
+    executor.setOperationStateCache(preparedModel.getOperationStateCache());
+    int err = executor.run(preparedModel.getModel(), request, preparedModel.getModelPoolInfos(),
+                           requestPoolInfos);
     const auto& outputShapes = executor.getOutputShapes();
     return {err, outputShapes, {}};
 }
@@ -1191,14 +1195,12 @@ std::tuple<int, std::vector<OutputShape>, Timing> CpuPreparedModel::execute(
         //              of spinning up a new thread.
         std::tuple<int, std::vector<OutputShape>, Timing> result = {};
         std::thread([this, &request, &requestPoolInfos, &deadline, &loopTimeoutDuration, &result] {
-            result = computeOnCpu(mModel, request, mModelPoolInfos, requestPoolInfos, deadline,
-                                  loopTimeoutDuration);
+            result = computeOnCpu(*this, request, requestPoolInfos, deadline, loopTimeoutDuration);
         }).join();
         return result;
     }
 
-    return computeOnCpu(mModel, request, mModelPoolInfos, requestPoolInfos, deadline,
-                        loopTimeoutDuration);
+    return computeOnCpu(*this, request, requestPoolInfos, deadline, loopTimeoutDuration);
 }
 
 std::pair<int, std::shared_ptr<RuntimeExecution>> CpuPreparedModel::createReusableExecution(
@@ -1227,15 +1229,14 @@ std::tuple<int, std::vector<OutputShape>, Timing> CpuExecution::compute(
         //              of spinning up a new thread.
         std::tuple<int, std::vector<OutputShape>, Timing> result = {};
         std::thread([this, &deadline, &result] {
-            result = computeOnCpu(kPreparedModel.getModel(), kRequest,
-                                  kPreparedModel.getModelPoolInfos(), kRequestPoolInfos, deadline,
+            result = computeOnCpu(kPreparedModel, kRequest, kRequestPoolInfos, deadline,
                                   kLoopTimeoutDuration);
         }).join();
         return result;
     }
 
-    return computeOnCpu(kPreparedModel.getModel(), kRequest, kPreparedModel.getModelPoolInfos(),
-                        kRequestPoolInfos, deadline, kLoopTimeoutDuration);
+    return computeOnCpu(kPreparedModel, kRequest, kRequestPoolInfos, deadline,
+                        kLoopTimeoutDuration);
 }
 
 std::tuple<int, int, ExecuteFencedInfoCallback, Timing> CpuExecution::computeFenced(
@@ -1363,6 +1364,8 @@ DeviceManager::DeviceManager() {
     findAvailableDevices();
 #ifdef NN_DEBUGGABLE
     mStrictSlicing = (getProp("debug.nn.strict-slicing") != 0);
+    mStreaming = (getProp("debug.nn.streaming") != 0);
+    mProfileDir = base::GetProperty("debug.nn.profile-dir", "");
     mPartitioning = getProp("debug.nn.partition", kPartitioningDefault);
     mDebugNNCpuOnly = (getProp("debug.nn.cpuonly") != 0);
     mSyncExecCpu = (getProp("debug.nn.syncexec-cpu", 1) != 0);
@@ -197,14 +197,45 @@ class DeviceManager {
     // 1 - Do graph partitioning; but fall back to non-partitioned
     //     execution if there is a partitioning failure.
     // 2 - Do graph partitioning, and rely on it; there is no fallback.
-    enum { kPartitioningNo = 0, kPartitioningWithFallback = 1, kPartitioningWithoutFallback = 2 };
+    // Adding 4 to either of the last two assigns operations to devices so as
+    // to minimize the total cost of the operations plus the cost of moving
+    // operands between devices, rather than picking the fastest device for
+    // each operation on its own. This has no effect with
+    // ANEURALNETWORKS_PREFER_LOW_POWER. 4 alone is the same as 2 + 4.
+    enum {
+        kPartitioningNo = 0,
+        kPartitioningWithFallback = 1,
+        kPartitioningWithoutFallback = 2,
+        kPartitioningMinimizeCost = 4
+    };
     uint32_t getPartitioning() const { return mPartitioning; }
     static bool partitioningAllowsFallback(uint32_t partitioning) {
-        return partitioning == kPartitioningWithFallback;
+        return (partitioning & ~kPartitioningMinimizeCost) == kPartitioningWithFallback;
+    }
+    static bool partitioningMinimizesCost(uint32_t partitioning) {
+        return (partitioning & kPartitioningMinimizeCost) != 0;
     }
 
     bool strictSlicing() const { return mStrictSlicing; }
 
+    // In streaming mode, the steps of a compound plan are pipelined across executions: a step of
+    // one execution may run while a later step of an earlier execution is still running, so a
+    // stream of executions launched without waiting for each other (e.g., one per video frame)
+    // runs at the throughput of the slowest step. Each execution still runs its own steps in
+    // order, with its own temporaries. Plans with control flow or dynamic temporaries are not
+    // pipelined. When CompilationBuilder is instantiated, it captures this mode from
+    // DeviceManager; CompilationBuilder::setStreaming() overrides it for one compilation.
+    bool streaming() const { return mStreaming; }
+
+    // In profile-guided partitioning mode, executions measure the time each step takes on its
+    // device, and the compilation partitions the model by the measured times of earlier
+    // executions of models of the same architecture, including the time to move operands between
+    // devices. The measurements are kept in this directory, one file per model architecture (see
+    // PerformanceProfile). The profile is not used with ANEURALNETWORKS_PREFER_LOW_POWER. Empty
+    // unless profile-guided partitioning is on. When CompilationBuilder is instantiated, it
+    // captures this directory from DeviceManager.
+    const std::string& getProfileDir() const { return mProfileDir; }
+
     // Returns the singleton manager.
     static DeviceManager* get();
 
@@ -273,6 +304,10 @@ class DeviceManager {
     uint32_t mPartitioning = kPartitioningDefault;
 
     bool mStrictSlicing = false;
+
+    bool mStreaming = false;  // derived from system property debug.nn.streaming
+
+    std::string mProfileDir;  // derived from system property debug.nn.profile-dir
 };
 
 std::vector<SharedDevice> getDevices();
@@ -28,6 +28,7 @@
 #include <nnapi/Validation.h>
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
 #include <set>
 #include <tuple>
@@ -196,6 +197,11 @@ RuntimeMemory::RuntimeMemory(SharedMemory memory, std::unique_ptr<MemoryValidato
 
 RuntimeMemory::RuntimeMemory(SharedBuffer buffer) : kBuffer(std::move(buffer)) {}
 
+uint64_t RuntimeMemory::makeId() {
+    static std::atomic<uint64_t> nextId = 0;
+    return nextId++;
+}
+
 Request::MemoryPool RuntimeMemory::getMemoryPool() const {
     if (kBuffer != nullptr) {
         return kBuffer->getToken();
@@ -178,6 +178,10 @@ class RuntimeMemory {
     virtual uint32_t getSize() const { return nn::getSize(getMemory()); }
     virtual std::optional<RunTimePoolInfo> getRunTimePoolInfo() const;
 
+    // Identifies this memory among all the memories created by the process, unlike its address,
+    // which may be reused once it is freed.
+    uint64_t getId() const { return kId; }
+
     MemoryValidatorBase& getValidator() const {
         CHECK(mValidator != nullptr);
         return *mValidator;
@@ -207,6 +211,10 @@ class RuntimeMemory {
     std::unique_ptr<MemoryValidatorBase> mValidator;
 
    private:
+    static uint64_t makeId();
+
+    const uint64_t kId = makeId();
+
     mutable std::mutex mMutex;
 
     // This set contains `CacheHold` objects, holding it for as long as the Memory object is alive.
@@ -215,7 +215,7 @@ int ModelBuilder::setOperandValueFromModel(uint32_t index, const ModelBuilder* v
             .length = 0,
     };
     mReferencedModels.push_back(value);
-    mReferencedSubgraphsForValidation.push_back(value->makeModel().main);
+    mReferencedSubgraphsForValidation.push_back(value->makeSharedModel()->main);
     return ANEURALNETWORKS_NO_ERROR;
 }
 
@@ -919,9 +919,68 @@ void ModelBuilder::simplifyModel() {
     mSimplifyModel = true;
 }
 
+std::shared_ptr<const Model> ModelBuilder::makeSharedModel() const {
+    if (!mCompletedModel) {
+        // This model may still change, so its Model is not cached.
+        return std::make_shared<const Model>(ModelMaker::run(this, mSimplifyModel));
+    }
+    std::lock_guard<std::mutex> lock(mModelMutex);
+    if (mModel == nullptr) {
+        mModel = std::make_shared<const Model>(ModelMaker::run(this, mSimplifyModel));
+    }
+    return mModel;
+}
+
 Model ModelBuilder::makeModel() const {
-    // TODO: Cache the Model to speed up subsequent calls.
-    return ModelMaker::run(this, mSimplifyModel);
+    if (!mCompletedModel) {
+        return ModelMaker::run(this, mSimplifyModel);
+    }
+    return *makeSharedModel();
+}
+
+std::optional<SupportedOperationsMemo::ModelKey> ModelBuilder::getSupportedOperationsKey() const {
+    if (!mCompletedModel) {
+        return std::nullopt;
+    }
+    std::lock_guard<std::mutex> lock(mModelMutex);
+    if (!mHasSupportedOperationsKey) {
+        mSupportedOperationsKey = SupportedOperationsMemo::makeModelKey(*this);
+        mHasSupportedOperationsKey = true;
+    }
+    return mSupportedOperationsKey;
+}
+
+std::optional<std::vector<bool>> ModelBuilder::findSupportedOperations(
+        const std::shared_ptr<Device>& device) const {
+    if (!mCompletedModel) {
+        return std::nullopt;
+    }
+    std::lock_guard<std::mutex> lock(mModelMutex);
+    for (const SupportedOperations& entry : mSupportedOperations) {
+        if (entry.device.lock() == device) {
+            return entry.supportedOperations;
+        }
+    }
+    return std::nullopt;
+}
+
+void ModelBuilder::rememberSupportedOperations(const std::shared_ptr<Device>& device,
+                                               const std::vector<bool>& supportedOperations) const {
+    if (!mCompletedModel || std::none_of(supportedOperations.begin(), supportedOperations.end(),
+                                         [](bool supported) { return supported; })) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mModelMutex);
+    // Devices that are gone leave room for new ones.
+    auto entryIt = std::find_if(mSupportedOperations.begin(), mSupportedOperations.end(),
+                                [&device](const SupportedOperations& entry) {
+                                    const std::shared_ptr<Device> entryDevice = entry.device.lock();
+                                    return entryDevice == nullptr || entryDevice == device;
+                                });
+    if (entryIt == mSupportedOperations.end()) {
+        entryIt = mSupportedOperations.emplace(mSupportedOperations.end());
+    }
+    *entryIt = {.device = device, .supportedOperations = supportedOperations};
 }
 
 Model ModelBuilder::ModelMaker::run(const ModelBuilder* model, bool simplifyModel) {
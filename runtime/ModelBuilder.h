@@ -21,13 +21,21 @@
 #define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_RUNTIME_MODEL_BUILDER_H
 
 #include <LegacyUtils.h>
+#include <android-base/thread_annotations.h>
 
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "Memory.h"
 #include "ModelArchHasher.h"
 #include "NeuralNetworks.h"
+#include "SupportedOperationsMemo.h"
 
 namespace android {
 namespace nn {
@@ -35,6 +43,7 @@ namespace nn {
 class CompilationBuilder;
 class Device;
 class ExecutionPlan;
+class PerformanceProfile;
 class RuntimeMemory;
 
 class ModelBuilder {
@@ -74,8 +83,17 @@ class ModelBuilder {
                           const std::vector<std::shared_ptr<Device>>& devices,
                           bool explicitDeviceList = false);
 
+    // Returns the canonical Model. Once this model is finished, the Model is
+    // built on the first call and the same immutable Model is shared by all
+    // later calls.
+    std::shared_ptr<const Model> makeSharedModel() const;
+    // Returns a copy of makeSharedModel(), for callers that need to own the Model.
     Model makeModel() const;
 
+    // Returns the key of this model in SupportedOperationsMemo, or std::nullopt if this model is
+    // not finished or has no key. The key is computed on the first call and reused by later ones.
+    std::optional<SupportedOperationsMemo::ModelKey> getSupportedOperationsKey() const;
+
     uint32_t operandCount() const {
         // We don't allow more than uint32_t worth of operands
         return static_cast<uint32_t>(mOperands.size());
@@ -129,10 +147,23 @@ class ModelBuilder {
     }
 
     // simulateFailureResultCode == ANEURALNETWORKS_NO_ERROR means behave normally.
+    //
+    // If profile is not nullptr, operations are assigned to devices by the execution time measured
+    // in the profile where available, and the static performance estimates are recorded in the
+    // profile. See findBestDeviceForEachOperation().
+    //
+    // If minimizeCost is true, the assignment of operations to devices also
+    // accounts for the cost of moving operands between devices; see
+    // DeviceManager::kPartitioningMinimizeCost.
+    //
+    // If cachePerformance is false, static performance estimates are not
+    // memoized; see PerformanceCache.
     int partitionTheWork(const std::vector<std::shared_ptr<Device>>& devices, uint32_t preference,
                          uint32_t priority, const OptionalTimePoint& deadline, ExecutionPlan* plan,
                          const std::vector<TokenValuePair>& metaData,
-                         int simulateFailureResultCode = ANEURALNETWORKS_NO_ERROR) const;
+                         int simulateFailureResultCode = ANEURALNETWORKS_NO_ERROR,
+                         PerformanceProfile* profile = nullptr, bool minimizeCost = false,
+                         bool cachePerformance = true) const;
 
     const uint8_t* getModelArchHash() const;
 
@@ -142,6 +173,19 @@ class ModelBuilder {
     // isControlFlowOperationWithOperandOfUnknownSize, partitionTheWorkInternal,
     // sortIntoRunOrder to CompilationBuilder?
 
+    // Static performance estimates memoized for the duration of one
+    // partitioning, which uses a single preference. Without it, the estimate
+    // of a model referenced by a control flow operation is recomputed for
+    // every model that encloses it, which is quadratic in the nesting depth.
+    struct PerformanceCache {
+        // Keyed by model and device.
+        std::map<std::pair<const ModelBuilder*, const Device*>, float> models;
+        // Keyed by model, device and operation index.
+        std::map<std::tuple<const ModelBuilder*, const Device*, uint32_t>, float> operations;
+        // If false, nothing is remembered. Only used to measure what the cache saves.
+        bool enabled = true;
+    };
+
     // Populates bestDeviceForOperation
     //
     // For 0 <= i < operationCount(), produces
@@ -151,12 +195,41 @@ class ModelBuilder {
     // (*bestDeviceForOperation)[i] == devices.size() is a special value meaning
     // that this is a control flow operation scheduled for interpreted execution
     // (see LogicalStep).
+    //
+    // If profile is not nullptr and has samples, the cost of an operation on a
+    // device is its measured execution time in nanoseconds (or its static
+    // estimate scaled to nanoseconds), plus the time to move to the device
+    // those inputs of the operation that come from another device.
+    //
+    // If minimizeCost is true and preference is not
+    // ANEURALNETWORKS_PREFER_LOW_POWER, the per-operation choices are then
+    // refined by moving single operations between devices for as long as that
+    // lowers the total time of all operations plus the time to move operands
+    // across device boundaries. See minimizePartitioningCost().
     int findBestDeviceForEachOperation(uint32_t preference,
                                        const std::vector<std::shared_ptr<Device>>& devices,
+                                       PerformanceCache* performanceCache,
+                                       PerformanceProfile* profile, bool minimizeCost,
                                        std::vector<int>* bestDeviceForOperation) const;
-    float getPerformance(uint32_t preference, const std::shared_ptr<Device> device) const;
+    // Returns what device->getSupportedOperations() returned for this finished model in an
+    // earlier compilation, or std::nullopt if that is not known.
+    std::optional<std::vector<bool>> findSupportedOperations(
+            const std::shared_ptr<Device>& device) const;
+    // Remembers what device->getSupportedOperations() returned for this finished model. As for
+    // SupportedOperationsMemo::insert(), a result with no supported operation is not remembered.
+    void rememberSupportedOperations(const std::shared_ptr<Device>& device,
+                                     const std::vector<bool>& supportedOperations) const;
+    // Refines bestDeviceForOperation as described for findBestDeviceForEachOperation().
+    // canDo(operationIndex, deviceIndex) tells whether a device supports an operation.
+    void minimizePartitioningCost(
+            uint32_t preference, const std::vector<std::shared_ptr<Device>>& devices,
+            PerformanceCache* performanceCache, const PerformanceProfile* profile,
+            const std::function<bool(uint32_t operationIndex, size_t deviceIndex)>& canDo,
+            std::vector<int>* bestDeviceForOperation) const;
+    float getPerformance(uint32_t preference, const std::shared_ptr<Device> device,
+                         PerformanceCache* performanceCache) const;
     float getPerformance(uint32_t preference, const std::shared_ptr<Device> device,
-                         uint32_t operationIndex) const;
+                         uint32_t operationIndex, PerformanceCache* performanceCache) const;
     bool supportedByControlFlowInterpreter(uint32_t operationIndex) const;
 
     // Returns true if the operation is IF or WHILE and has an inner or outer
@@ -166,7 +239,10 @@ class ModelBuilder {
     int partitionTheWorkInternal(uint32_t sourceModelIndex,
                                  const std::vector<std::shared_ptr<Device>>& devices,
                                  uint32_t preference, uint32_t priority,
-                                 const OptionalTimePoint& deadline, ExecutionPlan* plan) const;
+                                 const OptionalTimePoint& deadline, ExecutionPlan* plan,
+                                 PerformanceCache* performanceCache,
+                                 PerformanceProfile* profile = nullptr,
+                                 bool minimizeCost = false) const;
 
     // Return true if either mCompleteModel or mInvalidModel is true.
     bool badState(const char* name);
@@ -255,6 +331,23 @@ class ModelBuilder {
     // Model architecture hash, used for telemetry.
     uint8_t mModelArchHash[BYTE_SIZE_OF_MODEL_ARCH_HASH];
 
+    // What a device returned from getSupportedOperations() for this finished model. See
+    // findBestDeviceForEachOperation().
+    struct SupportedOperations {
+        std::weak_ptr<Device> device;
+        std::vector<bool> supportedOperations;
+    };
+
+    // The Model shared by makeSharedModel(), the key returned by getSupportedOperationsKey() and
+    // the supported operations remembered by findBestDeviceForEachOperation() once this model is
+    // finished.
+    mutable std::mutex mModelMutex;
+    mutable std::shared_ptr<const Model> mModel GUARDED_BY(mModelMutex);
+    mutable bool mHasSupportedOperationsKey GUARDED_BY(mModelMutex) = false;
+    mutable std::optional<SupportedOperationsMemo::ModelKey> mSupportedOperationsKey
+            GUARDED_BY(mModelMutex);
+    mutable std::vector<SupportedOperations> mSupportedOperations GUARDED_BY(mModelMutex);
+
     class ModelMaker;
 };
 
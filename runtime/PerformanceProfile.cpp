@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PerformanceProfile"
+
+#include "PerformanceProfile.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Manager.h"
+#include "ModelArchHasher.h"
+
+namespace android {
+namespace nn {
+namespace {
+
+// The first line of a profile file. Profile files are text, with one "device" line for each
+// device, followed by one "operation" line for each operation with an estimate or samples on it:
+//
+//     device "<name>/<version>"
+//     operation <index> <estimate> <sample count> <total nanoseconds>
+constexpr char kProfileHeader[] = "nnapi-performance-profile 1";
+
+// The time to move one byte between the CPU and another device. Drivers do not report it, so this
+// assumes a few GB/s, which is typical of copying to and from shared memory.
+constexpr float kTransferNanosPerByte = 0.25f;
+
+std::string getDeviceKey(const Device& device) {
+    return device.getName() + "/" + device.getVersionString();
+}
+
+}  // namespace
+
+PerformanceProfile::PerformanceProfile(std::string fileName, uint32_t operationCount)
+    : mFileName(std::move(fileName)), mOperationCount(operationCount) {}
+
+PerformanceProfile::~PerformanceProfile() {
+    std::thread saver;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopSaving = true;
+        saver = std::move(mSaver);
+    }
+    mSaveCondition.notify_all();
+    if (saver.joinable()) {
+        saver.join();
+    }
+    save();
+}
+
+std::shared_ptr<PerformanceProfile> PerformanceProfile::load(const std::string& dir,
+                                                             const uint8_t* modelArchHash,
+                                                             uint32_t operationCount) {
+    std::string fileName = dir + "/";
+    for (int i = 0; i < BYTE_SIZE_OF_MODEL_ARCH_HASH; ++i) {
+        fileName += base::StringPrintf("%02x", modelArchHash[i]);
+    }
+    fileName += ".profile";
+    auto profile = std::shared_ptr<PerformanceProfile>(
+            new PerformanceProfile(std::move(fileName), operationCount));
+
+    std::string data;
+    if (!base::ReadFileToString(profile->mFileName, &data)) {
+        VLOG(COMPILATION) << "PerformanceProfile::load: no profile in " << profile->mFileName;
+        return profile;
+    }
+    std::istringstream stream(data);
+    std::string line;
+    if (!std::getline(stream, line) || line != kProfileHeader) {
+        LOG(WARNING) << "PerformanceProfile::load: ignoring " << profile->mFileName
+                     << " with unknown header";
+        return profile;
+    }
+    std::map<std::string, std::vector<OperationProfile>> deviceProfiles;
+    std::vector<OperationProfile>* deviceProfile = nullptr;
+    while (std::getline(stream, line)) {
+        std::istringstream lineStream(line);
+        std::string kind;
+        lineStream >> kind;
+        if (kind == "device") {
+            std::string key;
+            if (lineStream >> std::quoted(key)) {
+                deviceProfile = &deviceProfiles[key];
+                deviceProfile->resize(operationCount);
+                continue;
+            }
+        } else if (kind == "operation" && deviceProfile != nullptr) {
+            uint32_t operationIndex;
+            OperationProfile operationProfile;
+            if (lineStream >> operationIndex >> operationProfile.estimate >>
+                        operationProfile.sampleCount >> operationProfile.totalNanos &&
+                operationIndex < operationCount) {
+                (*deviceProfile)[operationIndex] = operationProfile;
+                continue;
+            }
+        }
+        LOG(WARNING) << "PerformanceProfile::load: ignoring " << profile->mFileName
+                     << " with invalid line \"" << line << "\"";
+        return profile;
+    }
+
+    std::lock_guard<std::mutex> lock(profile->mMutex);
+    profile->mDeviceProfiles = std::move(deviceProfiles);
+    return profile;
+}
+
+bool PerformanceProfile::save() {
+    std::lock_guard<std::mutex> saveLock(mSaveMutex);
+    std::ostringstream stream;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mHasNewSamples) {
+            return true;
+        }
+        mHasNewSamples = false;
+        stream << std::setprecision(std::numeric_limits<double>::max_digits10);
+        stream << kProfileHeader << "\n";
+        for (const auto& [key, deviceProfile] : mDeviceProfiles) {
+            stream << "device " << std::quoted(key) << "\n";
+            for (uint32_t operationIndex = 0; operationIndex < mOperationCount; ++operationIndex) {
+                const OperationProfile& operationProfile = deviceProfile[operationIndex];
+                if (operationProfile.estimate > 0.0f || operationProfile.sampleCount > 0) {
+                    stream << "operation " << operationIndex << " " << operationProfile.estimate
+                           << " " << operationProfile.sampleCount << " "
+                           << operationProfile.totalNanos << "\n";
+                }
+            }
+        }
+    }
+
+    // Write to a uniquely named file in the same directory first, so that a concurrent load never
+    // sees a partial profile and other processes saving the same profile do not write to the same
+    // file. The last rename wins.
+    std::string tmpFileName = mFileName + ".XXXXXX";
+    const base::unique_fd fd(mkstemp(tmpFileName.data()));
+    if (fd.get() == -1) {
+        PLOG(ERROR) << "PerformanceProfile::save: failed to create a file next to " << mFileName;
+        return false;
+    }
+    if (!base::WriteStringToFd(stream.str(), fd) ||
+        rename(tmpFileName.c_str(), mFileName.c_str()) != 0) {
+        PLOG(ERROR) << "PerformanceProfile::save: failed to write " << mFileName;
+        unlink(tmpFileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::vector<PerformanceProfile::OperationProfile>& PerformanceProfile::getDeviceProfile(
+        const Device& device) {
+    auto& deviceProfile = mDeviceProfiles[getDeviceKey(device)];
+    deviceProfile.resize(mOperationCount);
+    return deviceProfile;
+}
+
+void PerformanceProfile::setEstimate(const Device& device, uint32_t operationIndex,
+                                     float estimate) {
+    CHECK_LT(operationIndex, mOperationCount);
+    std::lock_guard<std::mutex> lock(mMutex);
+    getDeviceProfile(device)[operationIndex].estimate = estimate;
+}
+
+std::optional<float> PerformanceProfile::getNanosPerEstimate() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    double totalNanos = 0.0;
+    double totalEstimate = 0.0;
+    for (const auto& [key, deviceProfile] : mDeviceProfiles) {
+        for (const OperationProfile& operationProfile : deviceProfile) {
+            if (operationProfile.sampleCount > 0 && operationProfile.estimate > 0.0f) {
+                totalNanos += operationProfile.totalNanos;
+                totalEstimate += operationProfile.estimate * operationProfile.sampleCount;
+            }
+        }
+    }
+    if (totalEstimate == 0.0) {
+        return std::nullopt;
+    }
+    return totalNanos / totalEstimate;
+}
+
+std::optional<float> PerformanceProfile::getOperationNanos(const Device& device,
+                                                           uint32_t operationIndex) const {
+    CHECK_LT(operationIndex, mOperationCount);
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto it = mDeviceProfiles.find(getDeviceKey(device));
+    if (it == mDeviceProfiles.end() || it->second[operationIndex].sampleCount == 0) {
+        return std::nullopt;
+    }
+    const OperationProfile& operationProfile = it->second[operationIndex];
+    return operationProfile.totalNanos / operationProfile.sampleCount;
+}
+
+float PerformanceProfile::getTransferNanos(const Device& device, uint64_t bytes) {
+    if (&device == DeviceManager::getCpuDevice().get()) {
+        return 0.0f;
+    }
+    return bytes * kTransferNanosPerByte;
+}
+
+void PerformanceProfile::recordStep(const Device& device,
+                                    const std::vector<uint32_t>* operationIndexes,
+                                    uint64_t transferBytes, uint64_t nanos) {
+    std::vector<uint32_t> allOperationIndexes;
+    if (operationIndexes == nullptr) {
+        allOperationIndexes.resize(mOperationCount);
+        std::iota(allOperationIndexes.begin(), allOperationIndexes.end(), 0u);
+        operationIndexes = &allOperationIndexes;
+    }
+    if (operationIndexes->empty()) {
+        return;
+    }
+    const double computeNanos =
+            std::max(0.0, static_cast<double>(nanos) - getTransferNanos(device, transferBytes));
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    std::vector<OperationProfile>& deviceProfile = getDeviceProfile(device);
+    // Without an estimate for every operation, attribute the time evenly.
+    const bool haveEstimates = std::all_of(
+            operationIndexes->begin(), operationIndexes->end(), [&deviceProfile](uint32_t index) {
+                CHECK_LT(index, deviceProfile.size());
+                return deviceProfile[index].estimate > 0.0f;
+            });
+    double totalEstimate = 0.0;
+    for (uint32_t operationIndex : *operationIndexes) {
+        totalEstimate += haveEstimates ? deviceProfile[operationIndex].estimate : 1.0;
+    }
+    for (uint32_t operationIndex : *operationIndexes) {
+        OperationProfile& operationProfile = deviceProfile[operationIndex];
+        const double weight = haveEstimates ? operationProfile.estimate : 1.0;
+        operationProfile.sampleCount++;
+        operationProfile.totalNanos += computeNanos * weight / totalEstimate;
+    }
+    mHasNewSamples = true;
+    if (!mSaver.joinable()) {
+        mSaver = std::thread([this] { saveLoop(); });
+    }
+    lock.unlock();
+    mSaveCondition.notify_one();
+}
+
+void PerformanceProfile::saveLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mSaveCondition.wait(lock, [this] { return mStopSaving || mHasNewSamples; });
+        // The destructor saves what is left.
+        if (mStopSaving ||
+            mSaveCondition.wait_for(lock, kSaveInterval, [this] { return mStopSaving; })) {
+            return;
+        }
+        lock.unlock();
+        save();
+        lock.lock();
+    }
+}
+
+}  // namespace nn
+}  // namespace android
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_RUNTIME_PERFORMANCE_PROFILE_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_RUNTIME_PERFORMANCE_PROFILE_H
+
+#include <android-base/thread_annotations.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace nn {
+
+class Device;
+
+// The measured execution time of the operations of one model architecture (see
+// ModelBuilder::getModelArchHash()) on the devices that ran them, kept in a file so that later
+// compilations of the model can partition it by measured rather than static performance. See
+// DeviceManager::getProfileDir().
+//
+// Each successful execution of a step adds a sample for each of its operations: the wall clock
+// duration of the step on its device, less the estimated cost of moving its inputs and outputs, is
+// attributed to the operations of the step in proportion to their static estimates recorded by
+// the partitioner (ModelBuilder::getPerformance()). New samples are written back to the file in
+// batches by a thread that the profile owns, so that executions do not wait for the file system:
+// at most once per kSaveInterval while executions add samples, and once more when the profile is
+// destroyed with the last compilation holding it.
+//
+// All methods are thread-safe.
+class PerformanceProfile {
+   public:
+    ~PerformanceProfile();
+
+    // Loads the profile of a model from dir, or makes an empty profile if there is none yet or the
+    // existing one does not match the model.
+    static std::shared_ptr<PerformanceProfile> load(const std::string& dir,
+                                                    const uint8_t* modelArchHash,
+                                                    uint32_t operationCount);
+
+    // Writes the profile back to its file if samples have been added since it was last written.
+    // Returns false if the file cannot be written. A profile with new samples also does this by
+    // itself; see recordStep().
+    bool save();
+
+    // Records the static performance estimate of an operation on a device, in the units of
+    // Capabilities::PerformanceInfo::execTime.
+    void setEstimate(const Device& device, uint32_t operationIndex, float estimate);
+
+    // Returns the measured time in nanoseconds of one unit of static performance estimate,
+    // averaged over all samples, or std::nullopt if there are no samples. Used to compare the
+    // measured time of an operation on one device with the static estimate on another.
+    std::optional<float> getNanosPerEstimate() const;
+
+    // Returns the average measured time in nanoseconds of an operation on a device, or
+    // std::nullopt if the operation has not run on the device.
+    std::optional<float> getOperationNanos(const Device& device, uint32_t operationIndex) const;
+
+    // Returns the estimated time in nanoseconds to move the given number of bytes between the
+    // device and the client or the CPU.
+    static float getTransferNanos(const Device& device, uint64_t bytes);
+
+    // Adds a sample for the operations with the given indexes, or all operations if
+    // operationIndexes is nullptr, that ran on the device as one step taking the given time, with
+    // inputs and outputs of the given total size. The sample is written back to the profile file
+    // with the others of its batch.
+    void recordStep(const Device& device, const std::vector<uint32_t>* operationIndexes,
+                    uint64_t transferBytes, uint64_t nanos);
+
+   private:
+    // How long the samples of a batch accumulate before they are written back to the file.
+    static constexpr std::chrono::seconds kSaveInterval{5};
+
+    struct OperationProfile {
+        float estimate = 0.0f;
+        uint64_t sampleCount = 0;
+        double totalNanos = 0.0;
+    };
+
+    PerformanceProfile(std::string fileName, uint32_t operationCount);
+
+    // Returns the profile of each operation on the device, creating an empty one if needed.
+    std::vector<OperationProfile>& getDeviceProfile(const Device& device) REQUIRES(mMutex);
+
+    // Run by mSaver: waits for new samples, lets them accumulate for kSaveInterval and saves
+    // them, until the profile is destroyed.
+    void saveLoop();
+
+    const std::string mFileName;
+    const uint32_t mOperationCount;
+
+    // Serializes save(), so that the file is written in the order in which samples were added.
+    // Acquired before mMutex.
+    std::mutex mSaveMutex;
+
+    mutable std::mutex mMutex;
+    // Keyed by device name and version.
+    std::map<std::string, std::vector<OperationProfile>> mDeviceProfiles GUARDED_BY(mMutex);
+    bool mHasNewSamples GUARDED_BY(mMutex) = false;
+    // Signaled on new samples and on destruction.
+    std::condition_variable mSaveCondition;
+    bool mStopSaving GUARDED_BY(mMutex) = false;
+    // Started by the first recordStep().
+    std::thread mSaver GUARDED_BY(mMutex);
+};
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_RUNTIME_PERFORMANCE_PROFILE_H
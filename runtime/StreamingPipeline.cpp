@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "StreamingPipeline"
+
+#include "StreamingPipeline.h"
+
+#include <android-base/logging.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace nn {
+
+StreamingPipeline::StreamingPipeline(uint32_t stageCount) : mStageQueues(stageCount) {
+    CHECK_GT(stageCount, 0u);
+    mThreads.reserve(stageCount);
+    for (uint32_t stageIndex = 0; stageIndex < stageCount; ++stageIndex) {
+        mThreads.emplace_back([this, stageIndex] { serve(stageIndex); });
+    }
+}
+
+StreamingPipeline::~StreamingPipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+        for (auto& stageQueue : mStageQueues) {
+            CHECK(stageQueue.jobs.empty());
+            stageQueue.condition.notify_one();
+        }
+    }
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void StreamingPipeline::run(const Stage& stage) {
+    Job job = {.stage = &stage};
+    std::unique_lock<std::mutex> lock(mMutex);
+    mStageQueues.front().jobs.push_back(&job);
+    mStageQueues.front().condition.notify_one();
+    mJobDone.wait(lock, [&job] { return job.done; });
+}
+
+void StreamingPipeline::serve(uint32_t stageIndex) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    const bool isLastStage = stageIndex + 1 == mStageQueues.size();
+    while (true) {
+        StageQueue& stageQueue = mStageQueues[stageIndex];
+        stageQueue.condition.wait(
+                lock, [this, &stageQueue] { return mStopping || !stageQueue.jobs.empty(); });
+        if (stageQueue.jobs.empty()) {
+            return;
+        }
+        Job* job = stageQueue.jobs.front();
+        stageQueue.jobs.pop_front();
+
+        lock.unlock();
+        const bool proceed = (*job->stage)(stageIndex);
+        lock.lock();
+
+        if (proceed && !isLastStage) {
+            StageQueue& nextStageQueue = mStageQueues[stageIndex + 1];
+            nextStageQueue.jobs.push_back(job);
+            nextStageQueue.condition.notify_one();
+        } else {
+            job->done = true;
+            mJobDone.notify_all();
+        }
+    }
+}
+
+}  // namespace nn
+}  // namespace android
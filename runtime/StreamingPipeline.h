@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_RUNTIME_STREAMING_PIPELINE_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_RUNTIME_STREAMING_PIPELINE_H
+
+#include <android-base/thread_annotations.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace nn {
+
+// Runs jobs through a fixed sequence of stages, each served by its own thread from its own queue.
+// A stage runs one job at a time, in the order in which the jobs reached it, so different stages
+// work on different jobs at the same time: while stage k + 1 runs job N, stage k may already run
+// job N + 1. The throughput of a steady stream of jobs is then bound by the slowest stage rather
+// than by the sum of all stages.
+//
+// A CompilationBuilder in streaming mode uses one to pipeline the steps of its compound plan
+// across executions; see DeviceManager::streaming().
+class StreamingPipeline {
+   public:
+    // Runs the given stage of a job. Returns false if the remaining stages of the job are to be
+    // skipped.
+    using Stage = std::function<bool(uint32_t stageIndex)>;
+
+    explicit StreamingPipeline(uint32_t stageCount);
+
+    // All jobs must have left the pipeline.
+    ~StreamingPipeline();
+
+    StreamingPipeline(const StreamingPipeline&) = delete;
+    StreamingPipeline& operator=(const StreamingPipeline&) = delete;
+
+    // Runs each stage of a job in turn, until a stage returns false, and returns once the job has
+    // left the pipeline. May be called from multiple threads at the same time. No two stages of
+    // the same job run at the same time.
+    void run(const Stage& stage);
+
+   private:
+    struct Job {
+        const Stage* stage;
+        bool done = false;
+    };
+    struct StageQueue {
+        std::condition_variable condition;
+        std::deque<Job*> jobs;
+    };
+
+    void serve(uint32_t stageIndex);
+
+    std::mutex mMutex;
+    std::vector<StageQueue> mStageQueues GUARDED_BY(mMutex);
+    std::condition_variable mJobDone;
+    bool mStopping GUARDED_BY(mMutex) = false;
+    std::vector<std::thread> mThreads;
+};
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_RUNTIME_STREAMING_PIPELINE_H
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SupportedOperationsMemo"
+
+#include "SupportedOperationsMemo.h"
+
+#include <CpuExecutor.h>
+#include <LegacyUtils.h>
+#include <android-base/logging.h>
+#include <openssl/sha.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "Manager.h"
+#include "Memory.h"
+#include "ModelBuilder.h"
+
+namespace android {
+namespace nn {
+namespace {
+
+static_assert(std::tuple_size_v<SupportedOperationsMemo::ModelKey> == SHA256_DIGEST_LENGTH);
+
+bool update(SHA256_CTX* hasher, const void* bytes, size_t length) {
+    return SHA256_Update(hasher, bytes, length) != 0;
+}
+
+template <typename T>
+bool update(SHA256_CTX* hasher, const std::vector<T>& values) {
+    const size_t size = values.size();
+    return update(hasher, &size, sizeof(size)) &&
+           update(hasher, values.data(), size * sizeof(values[0]));
+}
+
+bool updateOperand(SHA256_CTX* hasher, const Operand& operand) {
+    bool success = update(hasher, &operand.type, sizeof(operand.type));
+    success &= update(hasher, operand.dimensions);
+    success &= update(hasher, &operand.scale, sizeof(operand.scale));
+    success &= update(hasher, &operand.zeroPoint, sizeof(operand.zeroPoint));
+    success &= update(hasher, &operand.lifetime, sizeof(operand.lifetime));
+    success &= update(hasher, &operand.location.poolIndex, sizeof(operand.location.poolIndex));
+    success &= update(hasher, &operand.location.offset, sizeof(operand.location.offset));
+    success &= update(hasher, &operand.location.length, sizeof(operand.location.length));
+    const size_t extraParamsIndex = operand.extraParams.index();
+    success &= update(hasher, &extraParamsIndex, sizeof(extraParamsIndex));
+    if (const auto* params =
+                std::get_if<Operand::SymmPerChannelQuantParams>(&operand.extraParams)) {
+        success &= update(hasher, params->scales);
+        success &= update(hasher, &params->channelDim, sizeof(params->channelDim));
+    } else if (const auto* data = std::get_if<Operand::ExtensionParams>(&operand.extraParams)) {
+        success &= update(hasher, *data);
+    }
+    return success;
+}
+
+std::string getDeviceKey(const Device& device) {
+    return device.getName() + "/" + device.getVersionString();
+}
+
+}  // namespace
+
+SupportedOperationsMemo* SupportedOperationsMemo::get() {
+    static SupportedOperationsMemo memo;
+    return &memo;
+}
+
+std::optional<SupportedOperationsMemo::ModelKey> SupportedOperationsMemo::makeModelKey(
+        const ModelBuilder& model) {
+    SHA256_CTX hasher;
+    if (SHA256_Init(&hasher) == 0) {
+        return std::nullopt;
+    }
+    bool success = true;
+    // Mapped lazily, as most pools of a model are never referenced by one of its constants.
+    std::map<uint32_t, std::optional<RunTimePoolInfo>> pools;
+    for (uint32_t i = 0; i < model.operandCount(); ++i) {
+        const Operand& operand = model.getOperand(i);
+        success &= updateOperand(&hasher, operand);
+        if (operand.lifetime == Operand::LifeTime::CONSTANT_COPY) {
+            success &= update(&hasher, model.getPointerToOperandValue(operand.location.offset),
+                              operand.location.length);
+        } else if (operand.lifetime == Operand::LifeTime::CONSTANT_REFERENCE) {
+            const uint32_t poolIndex = operand.location.poolIndex;
+            const RuntimeMemory* memory = model.getMemories()[poolIndex];
+            if (memory->getSize() > kMaxHashedPoolSize) {
+                const uint64_t memoryId = memory->getId();
+                success &= update(&hasher, &memoryId, sizeof(memoryId));
+                continue;
+            }
+            auto poolIt = pools.find(poolIndex);
+            if (poolIt == pools.end()) {
+                poolIt = pools.emplace(poolIndex, memory->getRunTimePoolInfo()).first;
+            }
+            const std::optional<RunTimePoolInfo>& pool = poolIt->second;
+            if (!pool.has_value() ||
+                uint64_t{operand.location.offset} + operand.location.length > pool->getSize()) {
+                VLOG(COMPILATION) << "SupportedOperationsMemo::makeModelKey: cannot read pool "
+                                  << poolIndex;
+                return std::nullopt;
+            }
+            success &= update(&hasher, pool->getBuffer() + operand.location.offset,
+                              operand.location.length);
+        }
+    }
+    for (const Operation& operation : model.getOperations()) {
+        success &= update(&hasher, &operation.type, sizeof(operation.type));
+        success &= update(&hasher, operation.inputs);
+        success &= update(&hasher, operation.outputs);
+    }
+    success &= update(&hasher, model.getInputOperandIndexes());
+    success &= update(&hasher, model.getOutputOperandIndexes());
+    // Referenced models contribute their own keys, which they compute once, so that the key of a
+    // model does not cost more than its own operands as models are nested deeper.
+    for (uint32_t i = 0; i < model.referencedModelCount(); ++i) {
+        const std::optional<ModelKey> referencedKey =
+                model.getReferencedModel(i)->getSupportedOperationsKey();
+        if (!referencedKey.has_value()) {
+            return std::nullopt;
+        }
+        success &= update(&hasher, referencedKey->data(), referencedKey->size());
+    }
+    const bool relaxed = model.isComputationFloat32RelaxedToFloat16();
+    success &= update(&hasher, &relaxed, sizeof(relaxed));
+
+    ModelKey key;
+    if (!success || SHA256_Final(key.data(), &hasher) == 0) {
+        return std::nullopt;
+    }
+    return key;
+}
+
+std::optional<std::vector<bool>> SupportedOperationsMemo::lookup(
+        const ModelKey& modelKey, const std::shared_ptr<Device>& device) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto modelIt = mModels.find(modelKey);
+    if (modelIt == mModels.end()) {
+        return std::nullopt;
+    }
+    ModelEntry& modelEntry = modelIt->second;
+    const auto deviceIt = modelEntry.devices.find(getDeviceKey(*device));
+    if (deviceIt == modelEntry.devices.end() || deviceIt->second.device.lock() != device) {
+        return std::nullopt;
+    }
+    modelEntry.lastUse = ++mUseCount;
+    return deviceIt->second.supportedOperations;
+}
+
+void SupportedOperationsMemo::insert(const ModelKey& modelKey,
+                                     const std::shared_ptr<Device>& device,
+                                     std::vector<bool> supportedOperations) {
+    if (std::none_of(supportedOperations.begin(), supportedOperations.end(),
+                     [](bool supported) { return supported; })) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    ModelEntry& modelEntry = mModels[modelKey];
+    modelEntry.devices[getDeviceKey(*device)] = {.device = device,
+                                                 .supportedOperations =
+                                                         std::move(supportedOperations)};
+    modelEntry.lastUse = ++mUseCount;
+    if (mModels.size() > mMaxModelCount) {
+        mModels.erase(std::min_element(mModels.begin(), mModels.end(),
+                                       [](const auto& a, const auto& b) {
+                                           return a.second.lastUse < b.second.lastUse;
+                                       }));
+    }
+}
+
+void SupportedOperationsMemo::reserve(size_t modelCount) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMaxModelCount = std::max(mMaxModelCount, kMinModelCount + modelCount);
+}
+
+}  // namespace nn
+}  // namespace android
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_RUNTIME_SUPPORTED_OPERATIONS_MEMO_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_RUNTIME_SUPPORTED_OPERATIONS_MEMO_H
+
+#include <android-base/thread_annotations.h>
+#include <nnapi/Types.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace nn {
+
+class Device;
+class ModelBuilder;
+
+// Remembers, for the lifetime of the process, which operations of a model each device supports,
+// so that compiling the same model again (for example with another preference or caching setting)
+// does not ask the drivers again. Used by ModelBuilder::findBestDeviceForEachOperation().
+//
+// A model is identified by a hash of everything a driver may look at: its operands, including
+// their values and their extra parameters, its operations, inputs and outputs, relaxed
+// computation, and the keys of the models it references. The values in a memory pool larger than
+// kMaxHashedPoolSize are identified by the pool instead, so that the weights of a large model are
+// neither mapped nor hashed to compile it. Each finished ModelBuilder computes its key once (see
+// ModelBuilder::getSupportedOperationsKey()), and only if it does not remember the answer itself.
+// A device is identified by its name and version, and a remembered answer is only used for the
+// same Device object that gave it.
+//
+// All methods are thread-safe.
+class SupportedOperationsMemo {
+   public:
+    using ModelKey = std::array<uint8_t, 32>;
+
+    static SupportedOperationsMemo* get();
+
+    // Returns the key of a finished model, or std::nullopt if a memory pool of the model or of a
+    // model it references cannot be read.
+    static std::optional<ModelKey> makeModelKey(const ModelBuilder& model);
+
+    // Returns what device->getSupportedOperations() returned for the model, or std::nullopt if
+    // that is not known.
+    std::optional<std::vector<bool>> lookup(const ModelKey& modelKey,
+                                            const std::shared_ptr<Device>& device);
+
+    // Remembers what device->getSupportedOperations() returned for the model. A result with no
+    // supported operation is not remembered, as that is also what a failed query returns.
+    void insert(const ModelKey& modelKey, const std::shared_ptr<Device>& device,
+                std::vector<bool> supportedOperations);
+
+    // Makes room for the modelCount models of a model and the models it references, which a
+    // compilation looks up one after the other, so that they do not evict each other.
+    void reserve(size_t modelCount);
+
+   private:
+    // The values in memory pools up to this size are hashed into the key of a model.
+    static constexpr uint32_t kMaxHashedPoolSize = 64 * 1024;
+
+    // Models beyond this many more than the largest reserve(), least recently used first, are
+    // forgotten.
+    static constexpr size_t kMinModelCount = 64;
+
+    struct DeviceEntry {
+        std::weak_ptr<Device> device;
+        std::vector<bool> supportedOperations;
+    };
+    struct ModelEntry {
+        // Keyed by device name and version.
+        std::map<std::string, DeviceEntry> devices;
+        uint64_t lastUse = 0;
+    };
+
+    SupportedOperationsMemo() = default;
+
+    std::mutex mMutex;
+    std::map<ModelKey, ModelEntry> mModels GUARDED_BY(mMutex);
+    uint64_t mUseCount GUARDED_BY(mMutex) = 0;
+    size_t mMaxModelCount GUARDED_BY(mMutex) = kMinModelCount;
+};
+
+}  // namespace nn
+}  // namespace android
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_RUNTIME_SUPPORTED_OPERATIONS_MEMO_H
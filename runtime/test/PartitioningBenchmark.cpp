@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <deque>
+
+#include "CompilationBuilder.h"
+#include "TestNeuralNetworksWrapper.h"
+
+// Measures the compilation of models made of IF operations nested state.range(0) deep, which the
+// partitioner runs on the control flow interpreter one level at a time. Each level estimates the
+// performance of all the levels below it; those estimates are computed once per compilation,
+// unless the benchmark is run without the cache, which is quadratic in the depth.
+//
+// Each level also asks the devices which of its operations they support, and the Model a device is
+// given holds all the levels below it. Each level remembers the answers after the first
+// compilation (see ModelBuilder::findSupportedOperations()), so later compilations do not make
+// that Model again.
+
+namespace android {
+namespace nn {
+namespace {
+
+using test_wrapper::Compilation;
+using test_wrapper::Model;
+using test_wrapper::OperandType;
+using test_wrapper::Result;
+using test_wrapper::Type;
+
+constexpr int32_t kNoActivation = ANEURALNETWORKS_FUSED_NONE;
+
+// Builds the model
+//
+//     level(0, cond, x) = x + x
+//     level(n, cond, x) = cond ? level(n - 1, cond, x) : level(0, cond, x)
+//
+// and returns level(depth). The referenced models are kept in models.
+const Model& makeNestedIfModel(uint32_t depth, std::deque<Model>* models) {
+    const OperandType boolType(Type::TENSOR_BOOL8, {1});
+    const OperandType tensorType(Type::TENSOR_FLOAT32, {1});
+    const OperandType activationType(Type::INT32, {});
+
+    Model& leafModel = models->emplace_back();
+    {
+        const uint32_t cond = leafModel.addOperand(&boolType);
+        const uint32_t x = leafModel.addOperand(&tensorType);
+        const uint32_t activation = leafModel.addConstantOperand(&activationType, kNoActivation);
+        const uint32_t y = leafModel.addOperand(&tensorType);
+        leafModel.addOperation(ANEURALNETWORKS_ADD, {x, x, activation}, {y});
+        leafModel.identifyInputsAndOutputs({cond, x}, {y});
+        CHECK(leafModel.finish() == Result::NO_ERROR);
+    }
+
+    const Model* innerModel = &leafModel;
+    for (uint32_t level = 1; level <= depth; ++level) {
+        Model& model = models->emplace_back();
+        const uint32_t cond = model.addOperand(&boolType);
+        const uint32_t x = model.addOperand(&tensorType);
+        const uint32_t thenModel = model.addModelOperand(innerModel);
+        const uint32_t elseModel = model.addModelOperand(&leafModel);
+        const uint32_t y = model.addOperand(&tensorType);
+        model.addOperation(ANEURALNETWORKS_IF, {cond, thenModel, elseModel, cond, x}, {y});
+        model.identifyInputsAndOutputs({cond, x}, {y});
+        CHECK(model.finish() == Result::NO_ERROR);
+        innerModel = &model;
+    }
+    return *innerModel;
+}
+
+void BM_CompileNestedIf(benchmark::State& state, bool cachePerformance) {
+    std::deque<Model> models;
+    const Model& model = makeNestedIfModel(state.range(0), &models);
+    for (auto _ : state) {
+        Compilation compilation(&model);
+        CHECK_EQ(reinterpret_cast<CompilationBuilder*>(compilation.getHandle())
+                         ->forTest_setPerformanceCaching(cachePerformance),
+                 ANEURALNETWORKS_NO_ERROR);
+        CHECK(compilation.finish() == Result::NO_ERROR);
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK_CAPTURE(BM_CompileNestedIf, Cached, true)
+        ->RangeMultiplier(2)
+        ->Range(1, 256)
+        ->Complexity();
+BENCHMARK_CAPTURE(BM_CompileNestedIf, Uncached, false)
+        ->RangeMultiplier(2)
+        ->Range(1, 256)
+        ->Complexity();
+
+}  // namespace
+}  // namespace nn
+}  // namespace android
+
+BENCHMARK_MAIN();
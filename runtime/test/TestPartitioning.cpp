@@ -22,6 +22,7 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <array>
 #include <filesystem>
 #include <functional>
 #include <iostream>
@@ -31,6 +32,7 @@
 #include <queue>
 #include <set>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -43,6 +45,7 @@
 #include "ModelBuilder.h"
 #include "NeuralNetworks.h"
 #include "NeuralNetworksOEM.h"
+#include "PerformanceProfile.h"
 #include "TestNeuralNetworksWrapper.h"
 #include "TmpDirectoryUtils.h"
 
@@ -367,7 +370,7 @@ class PartitioningDriver : public SampleDriver {
 
         // NOTE: We verify that all operations in the model are supported.
         V1_3::ErrorStatus outStatus = V1_3::ErrorStatus::INVALID_ARGUMENT;
-        auto ret = getSupportedOperations_1_3(
+        auto ret = reportSupportedOperations(
                 model, [&outStatus](V1_3::ErrorStatus inStatus,
                                     const hardware::hidl_vec<bool>& supportedOperations) {
                     if (inStatus == V1_3::ErrorStatus::NONE) {
@@ -397,12 +400,8 @@ class PartitioningDriver : public SampleDriver {
 
     hardware::Return<void> getSupportedOperations_1_3(const V1_3::Model& model,
                                                       getSupportedOperations_1_3_cb cb) override {
-        if (!android::nn::validateModel(model)) {
-            cb(V1_3::ErrorStatus::INVALID_ARGUMENT, std::vector<bool>());
-            return hardware::Void();
-        }
-        cb(V1_3::ErrorStatus::NONE, getSupportedOperationsForSubgraph(model, model.main));
-        return hardware::Void();
+        ++mSupportedOperationsQueryCount;
+        return reportSupportedOperations(model, cb);
     }
 
     hardware::Return<void> getNumberOfCacheFilesNeeded(getNumberOfCacheFilesNeeded_cb cb) override {
@@ -410,7 +409,20 @@ class PartitioningDriver : public SampleDriver {
         return hardware::Void();
     }
 
+    // Returns how many times the runtime called getSupportedOperations_1_3().
+    uint32_t getSupportedOperationsQueryCount() const { return mSupportedOperationsQueryCount; }
+
    private:
+    hardware::Return<void> reportSupportedOperations(const V1_3::Model& model,
+                                                     getSupportedOperations_1_3_cb cb) {
+        if (!android::nn::validateModel(model)) {
+            cb(V1_3::ErrorStatus::INVALID_ARGUMENT, std::vector<bool>());
+            return hardware::Void();
+        }
+        cb(V1_3::ErrorStatus::NONE, getSupportedOperationsForSubgraph(model, model.main));
+        return hardware::Void();
+    }
+
     std::vector<bool> getSupportedOperationsForSubgraph(const V1_3::Model& model,
                                                         const V1_3::Subgraph& subgraph) {
         CHECK(&subgraph == &model.main ||
@@ -469,6 +481,7 @@ class PartitioningDriver : public SampleDriver {
     uint32_t mOperationMask;
     OEM mOEM;
     std::set<V1_3::OperationType> mOperationTypes;
+    uint32_t mSupportedOperationsQueryCount = 0;
 };
 
 // Like PartitioningDriver, but implementing 1.2
@@ -958,10 +971,26 @@ class PartitioningCompilation : public WrapperCompilation {
                 builder()->forTest_failPartitioning(static_cast<int>(Result::OP_FAILED)));
     }
 
+    Result setStreaming(bool streaming) {
+        return static_cast<Result>(builder()->setStreaming(streaming));
+    }
+
+    Result setProfileGuidedPartitioning(const std::string& profileDir) {
+        return static_cast<Result>(builder()->forTest_setProfileGuidedPartitioning(profileDir));
+    }
+
     using WrapperCompilation::finish;
 
     const ExecutionPlan& getExecutionPlan() const { return builder()->forTest_getExecutionPlan(); }
 
+    const StreamingPipeline* getStreamingPipeline() const {
+        return builder()->getStreamingPipeline();
+    }
+
+    PerformanceProfile* getPerformanceProfile() const {
+        return builder()->getPerformanceProfile();
+    }
+
    private:
     CompilationBuilder* builder() { return reinterpret_cast<CompilationBuilder*>(getHandle()); }
 
@@ -2096,6 +2125,127 @@ TEST_F(PartitioningTest, OemOperations) {
     ASSERT_EQ(compilationNoDrivers.finish(), Result::BAD_DATA);
 }
 
+// A step that fails to compile in the middle of a compound plan fails the plan with its result
+// code, and leaves the steps after it uncompiled, even though steps are compiled concurrently.
+//
+// opnd0 = model input
+// opnd1 = operation0(opnd0, opnd0)  // on device "0"
+// opnd2 = OEM(opnd1)                // on device "indecisiveOEM", which fails to prepare it
+// opnd3 = operation1(opnd2, opnd2)  // model output, on device "1"
+TEST_F(PartitioningTest, StepFailsToCompile) {
+    PartitioningModel model;
+    const uint32_t opnd0 = model.addFloatOperand();
+    const uint32_t opnd1 = model.addOperation2To1V1_0(0, opnd0, opnd0);
+    const uint32_t opnd2 = model.addOperationOEM1To1(opnd1);
+    const uint32_t opnd3 = model.addOperation2To1V1_0(1, opnd2, opnd2);
+    model.identifyInputsAndOutputs({opnd0}, {opnd3});
+    ASSERT_EQ(model.finish(), Result::NO_ERROR);
+
+    const auto devices =
+            makeDevices({{"0", 0.5, 1 << 0},
+                         {"indecisiveOEM", 0.5, 0U, PartitioningDriver::OEMIndecisive},
+                         {"1", 0.5, 1 << 1}});
+    ExecutionPlan plan;
+    const int n = model.partitionTheWork(devices, ExecutePreference::PREFER_LOW_POWER,
+                                         ExecutePriority::DEFAULT, {}, &plan);
+    ASSERT_NE(n, ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(plan.forTest_getKind(), ExecutionPlan::Kind::COMPOUND);
+    const auto& steps = plan.forTest_compoundGetSteps();
+    ASSERT_EQ(steps.size(), size_t(3));
+    EXPECT_EQ(steps[0]->executionStep()->getDevice()->getName(), "0");
+    EXPECT_NE(steps[0]->executionStep()->getPreparedStepModel(), nullptr);
+    EXPECT_EQ(steps[1]->executionStep()->getDevice()->getName(), "indecisiveOEM");
+    EXPECT_EQ(steps[1]->executionStep()->getPreparedStepModel(), nullptr);
+    EXPECT_EQ(steps[2]->executionStep()->getDevice()->getName(), "1");
+    EXPECT_EQ(steps[2]->executionStep()->getPreparedStepModel(), nullptr);
+
+    // The result is that of compiling the failing step on its own.
+    PartitioningModel oemModel;
+    const uint32_t oemOpnd0 = oemModel.addFloatOperand();
+    const uint32_t oemOpnd1 = oemModel.addOperationOEM1To1(oemOpnd0);
+    oemModel.identifyInputsAndOutputs({oemOpnd0}, {oemOpnd1});
+    ASSERT_EQ(oemModel.finish(), Result::NO_ERROR);
+    ExecutionPlan oemPlan;
+    EXPECT_EQ(oemModel.partitionTheWork(devices, ExecutePreference::PREFER_LOW_POWER,
+                                        ExecutePriority::DEFAULT, {}, &oemPlan),
+              n);
+}
+
+// Builds two chains of two operations, each of kind k on device "k" of {"0", "1", "2", "3"}, so
+// that the partitioner makes one step per operation, in the order 3, 2, 1, 0:
+//     step 0: temp0 = op3(input0)
+//     step 1: output0 = op2(temp0)
+//     step 2: temp1 = op1(input1)
+//     step 3: output1 = op0(temp1), or op0(temp1, temp0) if secondChainReadsFirst
+// temp0 is live during steps 0 and 1 (or 0 to 3), and temp1 during steps 2 and 3.
+TEST_F(PartitioningTest, TemporaryLayoutAndStepDependencies) {
+    const auto devices = makeDevices(
+            {{"0", 0.5, 1 << 0}, {"1", 0.5, 1 << 1}, {"2", 0.5, 1 << 2}, {"3", 0.5, 1 << 3}});
+
+    auto partition = [&devices](bool secondChainReadsFirst, PartitioningModel* model,
+                                ExecutionPlan* plan, SourceOperandIndex* temp0,
+                                SourceOperandIndex* temp1) {
+        const uint32_t input0 = model->addFloatOperand();
+        const uint32_t input1 = model->addFloatOperand();
+        temp0->second = model->addOperation2To1V1_0(3, input0, input0);
+        const uint32_t output0 = model->addOperation2To1V1_0(2, temp0->second, temp0->second);
+        temp1->second = model->addOperation2To1V1_0(1, input1, input1);
+        const uint32_t output1 = model->addOperation2To1V1_0(
+                0, temp1->second, secondChainReadsFirst ? temp0->second : temp1->second);
+        model->identifyInputsAndOutputs({input0, input1}, {output0, output1});
+        ASSERT_EQ(model->finish(), Result::NO_ERROR);
+        ASSERT_EQ(model->partitionTheWork(devices, ExecutePreference::PREFER_LOW_POWER,
+                                          ExecutePriority::DEFAULT, {}, plan),
+                  ANEURALNETWORKS_NO_ERROR);
+        ASSERT_EQ(plan->forTest_getKind(), ExecutionPlan::Kind::COMPOUND);
+        const auto& steps = plan->forTest_compoundGetSteps();
+        ASSERT_EQ(steps.size(), size_t(4));
+        for (uint32_t i = 0; i < steps.size(); ++i) {
+            EXPECT_EQ(steps[i]->executionStep()->getDevice()->getName(), std::to_string(3 - i));
+        }
+        ASSERT_EQ(plan->forTest_compoundGetLocationsOfTemporaries().size(), size_t(2));
+    };
+
+    {
+        // temp0 and temp1 are never live during the same step, so they share memory. Step 2
+        // defines temp1 over temp0, so it waits for step 1 to have read temp0, and no steps run
+        // concurrently.
+        PartitioningModel model;
+        ExecutionPlan plan;
+        SourceOperandIndex temp0(0, 0), temp1(0, 0);
+        ASSERT_NO_FATAL_FAILURE(
+                partition(/*secondChainReadsFirst=*/false, &model, &plan, &temp0, &temp1));
+        const auto& locations = plan.forTest_compoundGetLocationsOfTemporaries();
+        EXPECT_EQ(locations.at(temp0).offset, locations.at(temp1).offset);
+        EXPECT_EQ(plan.forTest_compoundGetTotalSizeOfTemporaries(),
+                  std::max(locations.at(temp0).paddedLength, locations.at(temp1).paddedLength));
+        ASSERT_TRUE(plan.hasStepDependencies());
+        const std::vector<std::vector<uint32_t>> expected = {{}, {0}, {0, 1}, {2}};
+        EXPECT_EQ(plan.getStepDependencies(), expected);
+        EXPECT_FALSE(plan.canRunStepsConcurrently());
+    }
+    {
+        // temp0 is still live when temp1 is defined, so they do not share memory, and step 2
+        // depends on no step.
+        PartitioningModel model;
+        ExecutionPlan plan;
+        SourceOperandIndex temp0(0, 0), temp1(0, 0);
+        ASSERT_NO_FATAL_FAILURE(
+                partition(/*secondChainReadsFirst=*/true, &model, &plan, &temp0, &temp1));
+        const auto& locations = plan.forTest_compoundGetLocationsOfTemporaries();
+        const StaticTemporaryLocation& location0 = locations.at(temp0);
+        const StaticTemporaryLocation& location1 = locations.at(temp1);
+        EXPECT_TRUE(location0.offset + location0.paddedLength <= location1.offset ||
+                    location1.offset + location1.paddedLength <= location0.offset);
+        EXPECT_GE(plan.forTest_compoundGetTotalSizeOfTemporaries(),
+                  location0.paddedLength + location1.paddedLength);
+        ASSERT_TRUE(plan.hasStepDependencies());
+        const std::vector<std::vector<uint32_t>> expected = {{}, {0}, {}, {0, 2}};
+        EXPECT_EQ(plan.getStepDependencies(), expected);
+        EXPECT_TRUE(plan.canRunStepsConcurrently());
+    }
+}
+
 TEST_F(PartitioningTest, RelaxedFP) {
     const auto devices = makeDevices({// Best choice for non-relaxed model.
                                       {"f32", 0.8, 0.9 /* relaxed */, ~0U},
@@ -2210,6 +2360,62 @@ TEST_F(PartitioningTest, Perf) {
     }
 }
 
+TEST_F(PartitioningTest, RememberSupportedOperations) {
+    // Model computing opnd0 + constant.
+    auto makeModel = [](PartitioningModel* model, float constant) {
+        const uint32_t opnd0 = model->addFloatOperand();
+        const uint32_t opnd1 = model->addFloatOperand();
+        model->setOperandValue(opnd1, &constant);
+        const uint32_t opnd2 = model->addOperation2To1V1_0(0, opnd0, opnd1);
+        model->identifyInputsAndOutputs({opnd0}, {opnd2});
+        ASSERT_EQ(model->finish(), Result::NO_ERROR);
+    };
+    PartitioningModel model;
+    makeModel(&model, 1.0f);
+    PartitioningModel sameModel;
+    makeModel(&sameModel, 1.0f);
+    PartitioningModel otherConstantModel;
+    makeModel(&otherConstantModel, 2.0f);
+
+    const DeviceSpecification specification("remember", 0.5, ~0U);
+    const sp<PartitioningDriver> driver = new PartitioningDriver(
+            specification.mName.c_str(), specification.mVersionString.c_str(),
+            specification.mCapabilities, specification.mOperationMask);
+    const std::vector<std::shared_ptr<Device>> devices = {
+            DeviceManager::forTest_makeDriverDevice(
+                    android::nn::makeSharedDevice(specification.mName, driver)),
+            DeviceManager::getCpuDevice()};
+    auto partition = [&devices](PartitioningModel* model) {
+        ExecutionPlan plan;
+        ASSERT_EQ(model->partitionTheWork(devices, ExecutePreference::PREFER_LOW_POWER,
+                                          ExecutePriority::DEFAULT, {}, &plan),
+                  ANEURALNETWORKS_NO_ERROR);
+        ASSERT_EQ(plan.forTest_getKind(), ExecutionPlan::Kind::SIMPLE);
+        ASSERT_EQ(plan.forTest_simpleGetDevice()->getName(), "remember");
+    };
+
+    partition(&model);
+    EXPECT_EQ(driver->getSupportedOperationsQueryCount(), 1u);
+
+    // The same model, or another model with the same contents, is not queried again.
+    partition(&model);
+    partition(&sameModel);
+    EXPECT_EQ(driver->getSupportedOperationsQueryCount(), 1u);
+
+    // A model that only differs in the value of a constant is.
+    partition(&otherConstantModel);
+    EXPECT_EQ(driver->getSupportedOperationsQueryCount(), 2u);
+
+    // So is the same model on another device with the same name and version.
+    const auto otherDevices = makeDevices({{"remember", 0.5, ~0U}});
+    ExecutionPlan plan;
+    ASSERT_EQ(model.partitionTheWork(otherDevices, ExecutePreference::PREFER_LOW_POWER,
+                                     ExecutePriority::DEFAULT, {}, &plan),
+              ANEURALNETWORKS_NO_ERROR);
+    partition(&model);
+    EXPECT_EQ(driver->getSupportedOperationsQueryCount(), 3u);
+}
+
 TEST_F(PartitioningTest, ZeroInputStepModel) {
     PartitioningModel model;
     const uint32_t opnd0 = model.addFloatZeroOperand();
@@ -2248,6 +2454,196 @@ TEST_F(PartitioningTest, ZeroOutputStepModel) {
     checkExecutionPlanSteps(compilation.getExecutionPlan(), {cpuDeviceName});
 }
 
+// Test streaming mode, in which the steps of a compound plan are pipelined across executions.
+//
+// opnd0 = model input                    // tensor to pad
+// opnd1 = model input                    // padding
+// opnd2 = PAD(opnd0, opnd1)              // on device "pad"
+// opnd3 = ADD(opnd2, opnd2, FUSED_NONE)  // model output, on device "add"
+TEST_F(PartitioningTest, Streaming) {
+    PartitioningModel model;
+    const uint32_t opndActivation = model.addIntScalarOperand(ANEURALNETWORKS_FUSED_NONE);
+    const uint32_t opnd0 = model.addFloatOperand(Dimensioned::YES_2);
+    const uint32_t opnd1 = model.addIntOperand(Dimensioned::RANK_2);
+    const uint32_t opnd2 =
+            model.addExplicitOperationXTo1(ANEURALNETWORKS_PAD, {opnd0, opnd1},
+                                           WrapperType::TENSOR_FLOAT32, Dimensioned::YES_4);
+    const uint32_t opnd3 = model.addExplicitOperationXTo1(
+            ANEURALNETWORKS_ADD, {opnd2, opnd2, opndActivation}, WrapperType::TENSOR_FLOAT32,
+            Dimensioned::YES_4);
+    model.identifyInputsAndOutputs({opnd0, opnd1}, {opnd3});
+    ASSERT_EQ(model.finish(), Result::NO_ERROR);
+
+    const auto devices = makeDevices({{"pad", 0.9, 0U, PartitioningDriver::OEMNo,
+                                       HalVersion::LATEST, {V1_3::OperationType::PAD}},
+                                      {"add", 0.9, 0U, PartitioningDriver::OEMNo,
+                                       HalVersion::LATEST, {V1_3::OperationType::ADD}}});
+
+    // Streaming is off unless requested.
+    {
+        PartitioningCompilation compilation(&model, devices);
+        ASSERT_EQ(compilation.finish(), Result::NO_ERROR);
+        EXPECT_EQ(compilation.getStreamingPipeline(), nullptr);
+    }
+
+    PartitioningCompilation compilation(&model, devices);
+    ASSERT_EQ(compilation.setPartitioning(DeviceManager::kPartitioningWithoutFallback),
+              Result::NO_ERROR);
+    ASSERT_EQ(compilation.setStreaming(true), Result::NO_ERROR);
+    ASSERT_EQ(compilation.finish(), Result::NO_ERROR);
+    ASSERT_NO_FATAL_FAILURE(
+            checkExecutionPlanSteps(compilation.getExecutionPlan(), {"pad", "add"}));
+    ASSERT_NE(compilation.getStreamingPipeline(), nullptr);
+    EXPECT_EQ(compilation.setStreaming(false), Result::BAD_STATE);
+
+    // Executions launched without waiting for each other share the pipeline, but each computes
+    // its own output from its own input.
+    constexpr uint32_t kExecutionCount = 8;
+    std::vector<std::array<float, 4>> outputs(kExecutionCount);
+    std::vector<Result> results(kExecutionCount, Result::OP_FAILED);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < kExecutionCount; ++i) {
+        threads.emplace_back([&compilation, &outputs, &results, i] {
+            WrapperExecution execution(&compilation);
+            const float padTensorValue[] = {static_cast<float>(i), static_cast<float>(i + 1)};
+            execution.setInput(0, &padTensorValue);
+            WrapperOperandType paddingsType(WrapperType::TENSOR_INT32, {1, 2});
+            const int paddings[1][2] = {{1, 1}};
+            execution.setInput(1, &paddings, &paddingsType.operandType);
+            execution.setOutput(0, outputs[i].data(), sizeof(outputs[i]));
+            results[i] = execution.compute();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (uint32_t i = 0; i < kExecutionCount; ++i) {
+        ASSERT_EQ(results[i], Result::NO_ERROR) << "execution " << i;
+        const std::array<float, 4> expected = {0.0f, 2.0f * i, 2.0f * (i + 1), 0.0f};
+        EXPECT_EQ(outputs[i], expected) << "execution " << i;
+    }
+}
+
+TEST_F(PartitioningTest, ProfileGuidedPartitioning) {
+    PartitioningModel model;
+    const uint32_t opnd0 = model.addFloatOperand();
+    const uint32_t opnd1 = model.addFloatOperand();
+    const uint32_t opnd2 = model.addOperation2To1V1_0(0, opnd0, opnd1);
+    model.identifyInputsAndOutputs({opnd0, opnd1}, {opnd2});
+    ASSERT_EQ(model.finish(), Result::NO_ERROR);
+    const ModelBuilder* modelBuilder = reinterpret_cast<const ModelBuilder*>(model.getHandle());
+
+    char profileDirTemp[] = NN_TMP_DIR "/TestPartitioningProfileXXXXXX";
+    const char* profileDir = mkdtemp(profileDirTemp);
+    ASSERT_NE(profileDir, nullptr);
+
+    // By its capabilities, "fast" is the better device, but it measured slower than "slow".
+    const auto devices = makeDevices({{"fast", 0.5, ~0U}, {"slow", 0.9, ~0U}});
+    {
+        const auto profile = PerformanceProfile::load(
+                profileDir, modelBuilder->getModelArchHash(), modelBuilder->operationCount());
+        profile->setEstimate(*devices[0], 0, 0.5f);
+        profile->setEstimate(*devices[1], 0, 0.9f);
+        profile->recordStep(*devices[0], nullptr, /*transferBytes=*/0, /*nanos=*/1000000);
+        profile->recordStep(*devices[1], nullptr, /*transferBytes=*/0, /*nanos=*/1000);
+        ASSERT_TRUE(profile->save());
+    }
+
+    // Without profile-guided partitioning, the capabilities decide.
+    {
+        PartitioningCompilation compilation(&model, devices);
+        ASSERT_EQ(compilation.finish(), Result::NO_ERROR);
+        ASSERT_NO_FATAL_FAILURE(checkExecutionPlanSteps(compilation.getExecutionPlan(), {"fast"}));
+        EXPECT_EQ(compilation.getPerformanceProfile(), nullptr);
+    }
+
+    // With it, the measured times do.
+    PartitioningCompilation compilation(&model, devices);
+    ASSERT_EQ(compilation.setProfileGuidedPartitioning(profileDir), Result::NO_ERROR);
+    ASSERT_EQ(compilation.finish(), Result::NO_ERROR);
+    ASSERT_NO_FATAL_FAILURE(checkExecutionPlanSteps(compilation.getExecutionPlan(), {"slow"}));
+    PerformanceProfile* profile = compilation.getPerformanceProfile();
+    ASSERT_NE(profile, nullptr);
+    EXPECT_EQ(profile->getOperationNanos(*devices[1], 0), 1000.0f);
+
+    // An execution adds a sample, which is written back to the profile file.
+    WrapperExecution execution(&compilation);
+    const float input0 = 1.0f, input1 = 2.0f;
+    float output = 0.0f;
+    ASSERT_EQ(execution.setInput(0, &input0), Result::NO_ERROR);
+    ASSERT_EQ(execution.setInput(1, &input1), Result::NO_ERROR);
+    ASSERT_EQ(execution.setOutput(0, &output), Result::NO_ERROR);
+    ASSERT_EQ(execution.compute(), Result::NO_ERROR);
+    const std::optional<float> slowNanos = profile->getOperationNanos(*devices[1], 0);
+    ASSERT_TRUE(slowNanos.has_value());
+    EXPECT_NE(*slowNanos, 1000.0f);
+    ASSERT_TRUE(profile->save());
+    const auto reloadedProfile = PerformanceProfile::load(
+            profileDir, modelBuilder->getModelArchHash(), modelBuilder->operationCount());
+    EXPECT_EQ(reloadedProfile->getOperationNanos(*devices[1], 0), slowNanos);
+    EXPECT_EQ(reloadedProfile->getOperationNanos(*devices[0], 0), 1000000.0f);
+
+    std::filesystem::remove_all(profileDir);
+}
+
+// A chain of operations alternating between one that both devices support and one that only
+// "alternate" supports, where "alternate" is marginally faster. Picking the fastest device for each
+// operation on its own switches devices at every operation; minimizing the total cost keeps the
+// whole chain on "base", as the time saved on "alternate" is less than the time to move operands.
+//
+// opnd0, opnd1 = model inputs
+// opnd2 = operation0(opnd0, opnd1)
+// opnd3 = operation1(opnd2, opnd1)
+// opnd4 = operation0(opnd3, opnd1)
+// opnd5 = operation1(opnd4, opnd1)  // model output
+TEST_F(PartitioningTest, MinimizeCost) {
+    PartitioningModel model;
+    const uint32_t opnd0 = model.addFloatOperand(Dimensioned::YES_4);
+    const uint32_t opnd1 = model.addFloatOperand(Dimensioned::YES_4);
+    const uint32_t opnd2 = model.addOperation2To1V1_0(0, opnd0, opnd1, Dimensioned::YES_4);
+    const uint32_t opnd3 = model.addOperation2To1V1_0(1, opnd2, opnd1, Dimensioned::YES_4);
+    const uint32_t opnd4 = model.addOperation2To1V1_0(0, opnd3, opnd1, Dimensioned::YES_4);
+    const uint32_t opnd5 = model.addOperation2To1V1_0(1, opnd4, opnd1, Dimensioned::YES_4);
+    model.identifyInputsAndOutputs({opnd0, opnd1}, {opnd5});
+    ASSERT_EQ(model.finish(), Result::NO_ERROR);
+
+    const auto devices = makeDevices({{"base", 0.5, ~0U}, {"alternate", 0.4995, 1 << 1}});
+    auto compile = [](PartitioningCompilation* compilation, uint32_t partitioning,
+                      ExecutePreference preference) {
+        ASSERT_EQ(compilation->setPartitioning(partitioning), Result::NO_ERROR);
+        ASSERT_EQ(compilation->setPreference(preference), Result::NO_ERROR);
+        ASSERT_EQ(compilation->finish(), Result::NO_ERROR);
+    };
+    const std::vector<std::string> pingPongSteps = {"base", "alternate", "base", "alternate"};
+
+    {
+        PartitioningCompilation compilation(&model, devices);
+        ASSERT_NO_FATAL_FAILURE(compile(&compilation, DeviceManager::kPartitioningWithoutFallback,
+                                        ExecutePreference::PREFER_FAST_SINGLE_ANSWER));
+        ASSERT_NO_FATAL_FAILURE(
+                checkExecutionPlanSteps(compilation.getExecutionPlan(), pingPongSteps));
+    }
+    {
+        PartitioningCompilation compilation(&model, devices);
+        ASSERT_NO_FATAL_FAILURE(compile(&compilation,
+                                        DeviceManager::kPartitioningWithoutFallback |
+                                                DeviceManager::kPartitioningMinimizeCost,
+                                        ExecutePreference::PREFER_FAST_SINGLE_ANSWER));
+        ASSERT_NO_FATAL_FAILURE(checkExecutionPlanSteps(compilation.getExecutionPlan(), {"base"}));
+    }
+
+    // Moving operands is costed in time, so it does not change a partitioning for low power.
+    {
+        PartitioningCompilation compilation(&model, devices);
+        ASSERT_NO_FATAL_FAILURE(compile(&compilation,
+                                        DeviceManager::kPartitioningWithoutFallback |
+                                                DeviceManager::kPartitioningMinimizeCost,
+                                        ExecutePreference::PREFER_LOW_POWER));
+        ASSERT_NO_FATAL_FAILURE(
+                checkExecutionPlanSteps(compilation.getExecutionPlan(), pingPongSteps));
+    }
+}
+
 // Test dynamic temporaries and related parts of the partitioning implementation.
 //
 // opnd0 = model input                   // tensor to pad
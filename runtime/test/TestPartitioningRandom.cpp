@@ -1396,7 +1396,7 @@ TEST_P(RandomPartitioningTest, Test) {
 
     // Compare the outputs of the partitioned execution to the save
     // area containing the outpus of the non-partitioned execution.
-    {
+    auto compareOutputs = [&ioDescriptors, &ioMemories, &nonPartitionedOutputs, problemSize] {
         uint32_t outputIndex = 0;
         for (const auto& desc : ioDescriptors) {
             if (desc.mKind != InputOutputDescriptor::OUTPUT) {
@@ -1422,7 +1422,22 @@ TEST_P(RandomPartitioningTest, Test) {
             }
             outputIndex++;
         }
-    }
+    };
+    ASSERT_NO_FATAL_FAILURE(compareOutputs());
+
+    // Partitioned execution, with operations assigned to devices so as to
+    // minimize the cost of the operations plus the cost of moving operands
+    // between devices. This may use fewer devices than there are signatures,
+    // including the CPU, so we only check that the outputs are unchanged.
+    TestCompilation c3(&model, devices);
+    ASSERT_EQ(c3.setPartitioning(DeviceManager::kPartitioningWithFallback |
+                                 DeviceManager::kPartitioningMinimizeCost),
+              Result::NO_ERROR);
+    ASSERT_EQ(c3.finish(), Result::NO_ERROR);
+    WrapperExecution e3(&c3);
+    ASSERT_NO_FATAL_FAILURE(prepareForExecution(&e3));
+    ASSERT_EQ(e3.compute(computeMode), Result::NO_ERROR);
+    ASSERT_NO_FATAL_FAILURE(compareOutputs());
 }
 
 }  // namespace